@@ -0,0 +1,38 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <cstdint>
+
+// Heap allocation counting. Built with MPS_ALLOC_STATS (make ALLOCS=1), the
+// global operator new and delete count every allocation per thread and in
+// total; without it the counters stay at zero and nothing is replaced. Scopes
+// read the calling thread's counters at both ends, which is how the frame
+// profiler reports allocations per frame, the trace replayer per input event,
+// and tests assert that a hot path does not allocate at all.
+namespace AllocStats {
+    struct Counters {
+        uint64_t allocations = 0;
+        uint64_t frees = 0;
+        uint64_t bytes = 0;            // Requested by those allocations
+    };
+
+    Counters operator-(const Counters& end, const Counters& start);
+
+    // True when operator new is instrumented
+    bool Enabled();
+
+    // Calling thread since it started, and every thread together
+    Counters ThreadCounters();
+    Counters TotalCounters();
+
+    // Allocations made by this thread since construction
+    class Scope {
+    public:
+        Scope() : start(ThreadCounters()) {}
+        Counters Elapsed() const { return ThreadCounters() - start; }
+    private:
+        Counters start;
+    };
+}
+
+#endif // ALLOC_STATS_H
@@ -2,6 +2,8 @@
 #define APP_STATE_H
 
 #include "types.h"
+#include "config.h"
+#include <cstdint>
 
 // Global application state
 class AppState {
@@ -12,10 +14,21 @@ public:
     std::vector<UndoState> redoStack;
     bool isDrawing = false;
     
+    // Document identity (see DocumentJournal)
+    std::string documentPath;          // File the document autosaves to
+    uint64_t documentGeneration = 0;   // Bumped by every full save
+    
+    // Reference layer: an imported image shown under the strokes at the
+    // document origin. Not part of the document; not saved or journaled.
+    RasterImage referenceImage;
+    uint32_t referenceRevision = 0;    // Bumped on every change so views can refresh caches
+    
     // Temporary drawing state for shapes/preview
     int drawStartX = 0, drawStartY = 0;
     int drawCurrentX = 0, drawCurrentY = 0;
     bool hasPreview = false;
+    StrokeSettings stroke;             // Settings of the stroke in progress
+    double strokeTolerance = STROKE_TOLERANCE;   // Brush point decimation; 0 keeps every point
     
     // Current settings
     COLORREF currentColor = RGB(0, 0, 0);
@@ -27,6 +40,9 @@ public:
     float zoomLevel = 1.0f;
     int panX = 0, panY = 0;
     bool showGrid = false;
+    bool showPerformanceHud = false;   // Frame profiler overlay (F3)
+    bool smoothStrokes = true;         // Brush input through StrokeFilter
+    bool predictStrokeTail = false;    // Draw the predicted tail ahead of the pen
     bool showAdvancedColorPicker = false;
     int pickerX = 400, pickerY = 200;
     
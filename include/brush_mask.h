@@ -0,0 +1,55 @@
+#ifndef BRUSH_MASK_H
+#define BRUSH_MASK_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Anti-aliased brush-tip coverage masks, so a stamp is a blend of a stored
+// mask rather than a disc rasterized from scratch. Masks are keyed by brush
+// size, hardness, output scale and the stamp's sub-pixel offset, generated
+// on first use and kept in a least-recently-used cache. Each thread has its
+// own cache (a fixed arena allocated on the thread's first stamp), so the
+// renderers may stamp from several threads without locking.
+namespace BrushMask {
+    const int SUBPIXEL_STEPS = 4;          // Offsets per axis a stamp centre snaps to
+    const int MAX_SIZE = 32;               // Widest cached mask in output pixels; larger tips fill analytically
+    const size_t CAPACITY = 512;           // Masks per thread
+    const int HARD = 100;                  // Hardness in percent: 100 is a solid tip with an anti-aliased rim
+
+    // Coverage 0-255 of the pixels around a stamp centred at (x, y): entry
+    // (i, j) covers pixel (floor(x) + left + i, floor(y) + top + j), with
+    // pixel centres at whole coordinates as in RasterRenderer
+    struct Mask {
+        int left, top;
+        int width, height;
+        const uint8_t* coverage;           // height rows of width
+    };
+
+    // Output radius of a tip: half the brush size at 'scale', at least half a pixel
+    double Radius(int brushSize, double scale);
+    // Coverage of a pixel whose centre is 'distance' from the tip's centre;
+    // what masks hold, for tips too wide to cache
+    uint8_t Coverage(double distance, double radius, int hardness);
+
+    // The mask for a brushSize tip drawn at 'scale', centred at fraction
+    // (fracX, fracY) of a pixel, each in [0, 1). Null when the tip is wider
+    // than MAX_SIZE. Valid until the calling thread's next Find.
+    const Mask* Find(int brushSize, int hardness, double scale, double fracX, double fracY);
+
+    // Blends pixel over count pixels of row by coverage. Pixels are packed
+    // 8-bit channels; every channel, alpha included, blends the same way.
+    void BlendRow(uint32_t* row, const uint8_t* coverage, int count, uint32_t pixel);
+    void BlendRowScalar(uint32_t* row, const uint8_t* coverage, int count, uint32_t pixel);   // Reference kernel
+
+    // The calling thread's cache
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;               // Masks generated
+        uint64_t evictions = 0;
+        size_t masks = 0;                  // Cached now
+    };
+    Stats GetStats();
+    void Clear();                          // Drops the calling thread's masks and stats
+}
+
+#endif // BRUSH_MASK_H
@@ -0,0 +1,49 @@
+#ifndef BRUSH_STAMPS_H
+#define BRUSH_STAMPS_H
+
+#include "types.h"
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Brush strokes are painted as round stamps spaced evenly along the path a
+// fixed fraction of the diameter apart, however far apart the positions that
+// define it arrived. The distance since the last stamp carries across points,
+// so slow input does not pile stamps on each other and fast input leaves no
+// gaps. A stroke also stamps its first and last point. Stamp positions are
+// in document space, so every renderer and zoom places them alike.
+namespace BrushStamps {
+    // Document pixels between stamps for a brush of this size
+    double Spacing(int brushSize);
+
+    // Calls stamp(x, y) for each stamp on the segment a-b, given the distance
+    // travelled past the last stamp on arriving at a. Returns that distance on
+    // arriving at b, for the next segment.
+    template <typename StampFn>
+    double WalkSegment(double ax, double ay, double bx, double by, double spacing, double carried, StampFn stamp)
+    {
+        double dx = bx - ax;
+        double dy = by - ay;
+        double length = std::sqrt(dx * dx + dy * dy);
+        double along = spacing - carried;
+        if (length > 0.0) {
+            for (; along <= length; along += spacing) {
+                stamp(ax + dx * along / length, ay + dy * along / length);
+            }
+        }
+        return length + spacing - along;
+    }
+
+    // The brush point ends its stroke: no continuing brush point follows it.
+    // Points is a vector or a DocumentVersion::Points.
+    template <typename Points>
+    inline bool EndsStroke(const Points& points, size_t index)
+    {
+        return index + 1 == points.size() || points[index + 1].toolType != TOOL_BRUSH || points[index + 1].isStart;
+    }
+
+    // Stamps the stroke starting at points[start] paints, to measure spacing
+    size_t StrokeStamps(const std::vector<DrawPoint>& points, size_t start);
+}
+
+#endif // BRUSH_STAMPS_H
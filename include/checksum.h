@@ -0,0 +1,19 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Checksums used by the native file formats
+namespace Checksum {
+    // CRC-32 (ISO-HDLC polynomial); pass the previous result to continue a running checksum
+    uint32_t Crc32(const void* data, size_t size, uint32_t crc = 0);
+    
+    // Adler-32 (zlib trailer); pass the previous result to continue a running checksum
+    uint32_t Adler32(const void* data, size_t size, uint32_t adler = 1);
+    
+    // Adler-32 of A followed by B, given Adler-32 of A, Adler-32 of B and the length of B
+    uint32_t Adler32Combine(uint32_t adlerA, uint32_t adlerB, uint64_t lengthB);
+}
+
+#endif // CHECKSUM_H
@@ -1,7 +1,7 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-#include <windows.h>
+#include "types.h"
 
 // UI Layout constants
 extern const int TOOLBAR_HEIGHT;
@@ -9,6 +9,30 @@ extern const int STATUSBAR_HEIGHT;
 extern const int MENUBAR_HEIGHT;
 extern const int COLOR_PICKER_WIDTH;
 
+// Autosave / crash recovery
+extern const UINT AUTOSAVE_INTERVAL_MS;
+extern const char AUTOSAVE_DOCUMENT[];  // Backing file for untitled documents
+
+// Stroke ingestion
+extern const double STROKE_TOLERANCE;      // Brush points this close to the line through their neighbours are dropped
+
+// Brush rendering
+extern const double STAMP_SPACING;         // Distance between brush stamps, as a fraction of the diameter
+extern const double MIN_STAMP_SPACING;     // Document pixels; keeps hairline brushes from stamping densely
+
+// File loading
+extern const uint32_t LOAD_PARALLEL_MIN_POINTS;  // Native files this large decode on several threads
+
+// Image export
+extern const size_t EXPORT_MEMORY_BUDGET;  // Working memory for rendering and encoding
+extern const double EXPORT_BASE_DPI;       // Physical resolution of a 1x export
+extern const int EXPORT_MAX_SAMPLES;       // Largest supersampling grid (per axis)
+extern const double EXPORT_PRINT_SCALE;    // File > Export for Print
+extern const int EXPORT_PRINT_SAMPLES;
+
+// Background jobs
+extern const int JOB_WORKERS;              // Exports render on their encoder's workers too, so a few suffice
+
 // Menu IDs
 #define IDM_FILE_NEW        1001
 #define IDM_FILE_OPEN       1002
@@ -29,6 +53,26 @@ extern const int COLOR_PICKER_WIDTH;
 #define IDM_TOOLS_CIRCLE    1017
 #define IDM_TOOLS_LINE      1018
 #define IDM_HELP_ABOUT      1019
+#define IDM_FILE_EXPORT_PRINT 1020
+#define IDM_FILE_IMPORT_REFERENCE 1021
+#define IDM_FILE_CLEAR_REFERENCE 1022
+#define IDM_TOOLS_RECORD_TRACE 1023
+#define IDM_VIEW_PERF_HUD   1024
+#define IDM_TOOLS_SAVE_PERF_REPORT 1025
+#define IDM_TOOLS_SAVE_TRACE 1026      // Only in MPS_TRACE_EVENTS builds
+#define IDM_VIEW_MEMORY_USAGE 1027
+#define IDM_VIEW_SMOOTH_STROKES 1028
+#define IDM_VIEW_PREDICT_TAIL 1029
+#define IDM_FILE_CANCEL_JOBS 1030
+
+// Timer IDs
+#define IDT_AUTOSAVE        2001
+#define IDT_PRESENT         2002    // Presents frames while a modal loop runs
+
+// Posted by the engine thread when it publishes a document snapshot
+#define WM_ENGINE_PUBLISHED (WM_APP + 1)
+// Posted by a job worker when a job finishes or makes progress
+#define WM_JOBS_CHANGED     (WM_APP + 2)
 
 // Color palette
 extern COLORREF colorPalette[];
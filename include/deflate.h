@@ -0,0 +1,23 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// In-house DEFLATE (RFC 1951) compressor used by the image encoders
+namespace Deflate {
+    // Compression effort, roughly matching zlib levels 1-9
+    const int LEVEL_FAST = 1;
+    const int LEVEL_DEFAULT = 6;
+    const int LEVEL_BEST = 9;
+    
+    // Compresses one independent piece of a deflate stream and appends it to out.
+    // Pieces never reference each other's data, and a non-final piece ends
+    // byte-aligned with an empty stored block, so pieces compressed on different
+    // threads can be concatenated into one valid stream.
+    void CompressPiece(const uint8_t* data, size_t size, bool finalPiece,
+                       std::vector<uint8_t>& out, int level = LEVEL_DEFAULT);
+}
+
+#endif // DEFLATE_H
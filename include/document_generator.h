@@ -0,0 +1,52 @@
+#ifndef DOCUMENT_GENERATOR_H
+#define DOCUMENT_GENERATOR_H
+
+#include "types.h"
+#include <cstdint>
+
+// Seeded synthetic documents for stress and scaling tests. Brush strokes are
+// smooth random walks sampled like mouse input; shapes come from the engine's
+// own rasterizers. The same parameters always give the same points.
+namespace DocumentGenerator {
+    enum ShapeKind {
+        SHAPE_BRUSH = 0,
+        SHAPE_LINE,
+        SHAPE_RECTANGLE,
+        SHAPE_CIRCLE,
+        SHAPE_KIND_COUNT
+    };
+    
+    struct Params {
+        uint64_t seed = 1;
+        size_t points = 100000;          // Total points (the last stroke is cut to fit); 0: no limit
+        size_t strokes = 0;              // Stroke count; 0: as many as the points need
+    
+        // Stroke length in points: log-normal around the median
+        double medianLength = 120.0;
+        double lengthSigma = 0.8;
+        size_t maxLength = 20000;
+    
+        int minBrushSize = 1;            // Log-uniform between min and max
+        int maxBrushSize = 30;
+        int colors = 16;                 // Palette size; 0: every stroke gets its own color
+    
+        double shapeWeights[SHAPE_KIND_COUNT] = {0.85, 0.05, 0.05, 0.05};
+    
+        // Strokes start around cluster centers (normal spread); 0 clusters: uniform
+        int clusters = 8;
+        double clusterSpread = 300.0;
+        int canvasWidth = 4000;
+        int canvasHeight = 3000;
+    };
+    
+    struct Stats {
+        size_t points = 0;
+        size_t strokes = 0;
+        size_t byKind[SHAPE_KIND_COUNT] = {};
+    };
+    
+    // Replaces points with a generated document
+    Stats Generate(const Params& params, std::vector<DrawPoint>& points);
+}
+
+#endif // DOCUMENT_GENERATOR_H
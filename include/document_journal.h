@@ -0,0 +1,56 @@
+#ifndef DOCUMENT_JOURNAL_H
+#define DOCUMENT_JOURNAL_H
+
+#include "types.h"
+#include "document_version.h"
+#include <cstdint>
+#include <functional>
+
+// Append-only journal of committed document operations, stored next to the
+// document as "<document>.journal". Autosave appends only what changed since
+// the last commit; compaction folds the journal into a full v2 save in
+// "<document>.autosave". The document itself is only written by an explicit save.
+namespace DocumentJournal {
+    // Document lifecycle
+    bool NewDocument();                                    // Empty untitled document (AUTOSAVE_DOCUMENT)
+    bool OpenDocument(const std::string& documentPath, size_t* recoveredRecords = nullptr);
+    bool SaveDocument(const std::string& documentPath);   // Full save, then journal against it
+    void CloseDocument();                                  // Clean shutdown; unsaved work stays recoverable
+
+    // The same with the file I/O on a worker (JobPool). ReadDocument loads a
+    // document and replays its journal into points, touching nothing else;
+    // FinishOpen then puts them in place of the open document. A save writes
+    // a pinned version to savedPath (DrawingEngine::SaveDrawing) and
+    // FinishSave moves it over documentPath, journaling the edits made since
+    // the pin. The Finish steps run on the engine thread (EngineThread::Run).
+    bool ReadDocument(const std::string& documentPath, std::vector<DrawPoint>& points, uint64_t& generation,
+                      size_t* recoveredRecords = nullptr, const std::function<bool(double)>& progress = nullptr);
+    bool FinishOpen(const std::string& documentPath, std::vector<DrawPoint>& points, uint64_t generation, size_t recoveredRecords);
+    bool FinishSave(const std::string& savedPath, const std::string& documentPath, const DocumentVersion::Points& saved);
+
+    // Crash recovery
+    std::string JournalPathFor(const std::string& documentPath);
+    std::string SnapshotPathFor(const std::string& documentPath);   // Untitled documents are their own snapshot
+    bool HasRecoverableJournal(const std::string& documentPath);
+    size_t Replay(const std::string& documentPath);       // Applies valid records onto the loaded document
+
+    // Journaling the currently attached document
+    bool Attach(const std::string& documentPath);
+    void Detach(bool discardJournal);
+    bool IsAttached();
+
+    // Operation records (buffered until Commit)
+    void RecordErase(int x, int y, int radius, size_t removedPoints);
+    void RecordClear();
+    void RecordReplace(const std::vector<DrawPoint>& before, const std::vector<DrawPoint>& after);
+    void Commit();                                         // Appends new points and flushes records
+    size_t JournaledPoints();                              // Leading points already recorded; changing them needs a record
+
+    // Compaction
+    bool ShouldCompact();
+    bool Compact();
+    void Autosave();                                       // Commit, then compact if worthwhile
+    uint64_t JournalBytes();
+}
+
+#endif // DOCUMENT_JOURNAL_H
@@ -0,0 +1,57 @@
+#ifndef DOCUMENT_VERSION_H
+#define DOCUMENT_VERSION_H
+
+#include "types.h"
+#include "memory_stats.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Immutable versions of the document's points for readers on other threads
+// (painting, exports). A version is a table of fixed-size chunks, and the
+// next version shares every chunk whose points did not change, so publishing
+// while a stroke grows copies the chunks the stroke touched rather than the
+// whole document. A reader pins a version by holding it; the chunks it
+// shares stay alive until the last version using them is dropped.
+namespace DocumentVersion {
+    const size_t CHUNK_SHIFT = 12;
+    const size_t CHUNK_POINTS = (size_t)1 << CHUNK_SHIFT;
+
+    struct Chunk {
+        std::vector<DrawPoint> points;     // CHUNK_POINTS, fewer only in a version's last chunk
+        MemoryStats::Allocation memory{MemoryStats::MEM_DOCUMENT};
+    };
+
+    struct BuildStats {
+        size_t shared = 0;                 // Chunks taken over from the previous version
+        size_t copied = 0;                 // Chunks built from the document
+    };
+
+    class Points {
+    public:
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const DrawPoint& operator[](size_t index) const {
+            return chunks[index >> CHUNK_SHIFT]->points[index & (CHUNK_POINTS - 1)];
+        }
+
+        size_t ChunkCount() const { return chunks.size(); }
+        const Chunk* ChunkAt(size_t chunk) const { return chunks[chunk].get(); }
+
+        void CopyTo(std::vector<DrawPoint>& points) const;   // Replaces points with a flat copy
+
+    private:
+        friend Points Build(const std::vector<DrawPoint>& points, const Points& previous, size_t unchangedBefore,
+                            BuildStats* stats);
+        std::vector<std::shared_ptr<const Chunk>> chunks;
+        size_t count = 0;
+    };
+
+    // The document's points as a new version. Chunks of previous are shared
+    // when they lie wholly before unchangedBefore (the caller knows those
+    // points are untouched) or when their points compare equal.
+    Points Build(const std::vector<DrawPoint>& points, const Points& previous = Points(), size_t unchangedBefore = 0,
+                 BuildStats* stats = nullptr);
+}
+
+#endif // DOCUMENT_VERSION_H
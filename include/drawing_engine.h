@@ -2,16 +2,41 @@
 #define DRAWING_ENGINE_H
 
 #include "types.h"
+#include "document_version.h"
+#include "memory_stats.h"
+#include <functional>
+#include <memory>
 
 // Drawing system functions
 namespace DrawingEngine {
     // Color utilities
     COLORREF HSVtoRGB(float h, float s, float v);
     
+    // Strokes keep the settings they started with until EndDrawing
+    StrokeSettings CurrentStrokeSettings();
+    
     // Drawing operations
-    void StartDrawing(int x, int y);
+    void StartDrawing(int x, int y);   // With the current settings
+    void StartDrawing(int x, int y, const StrokeSettings& settings);
     void ContinueDrawing(int x, int y);
     void EndDrawing();
+    size_t LastStrokeStamps();         // Stamps the last finished brush stroke paints (BrushStamps)
+    
+    // Coalesced pointer input: every position the pointer passed through
+    // since the last call, oldest first
+    struct StrokePoint {
+        int x, y;
+    };
+    // Document-space area a change touched, right/bottom exclusive and empty
+    // when right <= left; whole when it has no cheap bound (erasing)
+    struct Damage {
+        int left = 0, top = 0, right = 0, bottom = 0;
+        bool whole = false;
+    };
+    // ContinueDrawing for a run of positions: grows the document once, skips
+    // repeats of the previous position and reports one combined damage area.
+    // Returns the positions applied.
+    size_t ContinueDrawingBatch(const StrokePoint* points, size_t count, Damage* damage = nullptr);
     void ClearCanvas();
     
     // Tool-specific operations
@@ -19,7 +44,10 @@ namespace DrawingEngine {
     void DrawCircle(int centerX, int centerY, int radius);
     void DrawLine(int startX, int startY, int endX, int endY);
     void EraseAtPoint(int x, int y);
+    size_t RemovePointsNear(std::vector<DrawPoint>& points, int x, int y, int radius);
+#ifdef _WIN32
     COLORREF PickColorAt(HDC hdc, int x, int y);
+#endif
     
     // Undo/Redo system
     void SaveState();
@@ -28,11 +56,47 @@ namespace DrawingEngine {
     
     // File operations
     bool SaveDrawing(const std::string& filename);
+    // Large native files decode on several threads
     bool LoadDrawing(const std::string& filename);
-    bool ExportAsBitmap(const std::string& filename, int width, int height);
+    bool ExportAsBitmap(const std::string& filename, int width, int height);   // Canvas area plus anything drawn outside it
+    // scale multiplies resolution (and DPI); samples > 1 anti-aliases with a samples x samples grid
+    bool ExportRegion(const std::string& filename, int left, int top, int width, int height, double scale, int samples = 1);
+    bool ExportDocument(const std::string& filename, double scale, int samples = 1);   // Document bounds only
+    // Exports are PNG, or QOI when the filename ends in ".qoi"
+    
+    // Exports on worker threads (JobPool) render a pinned version of the
+    // document, so editing carries on while they run
+    struct DocumentCopy {
+        DocumentVersion::Points points;
+        RasterImage reference;
+        MemoryStats::Allocation memory{MemoryStats::MEM_FILE_BUFFERS};
+    };
+    std::shared_ptr<const DocumentCopy> CopyDocument();                                     // Builds a version of the live points
+    std::shared_ptr<const DocumentCopy> CopyDocument(const DocumentVersion::Points& points);   // Shares a published one
+    // Receives the fraction of rows rendered, possibly from several threads;
+    // returning false cancels the export and removes the partial file
+    typedef std::function<bool(double fraction)> ExportProgress;
+    bool ExportAsBitmap(const DocumentCopy& document, const std::string& filename, int width, int height,
+                        const ExportProgress& progress);
+    bool ExportDocument(const DocumentCopy& document, const std::string& filename, double scale, int samples,
+                        const ExportProgress& progress);
+    
+    // Native saves and loads on workers take the same progress. A worker
+    // save writes a pinned version to a file of its own; ReplaceDrawing then
+    // gives that file its generation and moves it over filename. A worker
+    // load fills points and generation and leaves the document alone.
+    bool SaveDrawing(const DocumentVersion::Points& points, const std::string& filename, const ExportProgress& progress);
+    bool ReplaceDrawing(const std::string& savedPath, const std::string& filename, uint64_t generation);
+    bool LoadDrawing(const std::string& filename, std::vector<DrawPoint>& points, uint64_t& generation, const ExportProgress& progress);
+    
+    // Reference layer (QOI images). It belongs to the UI thread; the window
+    // decodes on a worker and sets the result.
+    bool ImportReferenceImage(const std::string& filename);
+    bool DecodeReferenceImage(const std::string& filename, RasterImage& image);
+    void SetReferenceImage(RasterImage image);
+    void ClearReferenceImage();
     
     // Helper functions for file operations
-    int GetEncoderClsid(const WCHAR* format, CLSID* pClsid);
     std::string EnsureFileExtension(const std::string& filename, const std::string& extension);
     
     // Tool operations
@@ -0,0 +1,89 @@
+#ifndef ENGINE_THREAD_H
+#define ENGINE_THREAD_H
+
+#include "types.h"
+#include "drawing_engine.h"
+#include "document_version.h"
+#include "memory_stats.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+// Document mutation off the UI thread. WindowProcedure pushes document
+// commands into a lock-free single-producer/single-consumer ring and returns;
+// the engine thread applies them through DrawingEngine and, after each batch,
+// publishes an immutable snapshot of the document that painting and exports
+// read. Successive snapshots share the chunks of points that did not change
+// (DocumentVersion). Until Start (tests, tools) every command applies inline
+// on the calling thread.
+namespace EngineThread {
+    const size_t QUEUE_CAPACITY = 4096;   // Commands beyond it wait, in order, on the UI side
+    const size_t POINT_CAPACITY = 16384;  // Moves of the queued CMD_CONTINUE commands
+    const size_t MAX_BATCH_POINTS = POINT_CAPACITY / 4;   // Longer batches post as several commands
+
+    // Never modified once published; painting holds a reference for the frame
+    struct Snapshot {
+        DocumentVersion::Points points;
+        uint64_t version = 0;              // Bumped per publish
+        uint64_t appliedSequence = 0;      // Last command applied (commands are numbered from 1)
+        MemoryStats::Report memory;        // Collected on the engine thread at publish
+    };
+
+    // notify runs on the engine thread after a publish, and not again until the
+    // UI calls HandlePublished; it should post a message and return
+    bool Start(std::function<void()> notify);
+    void Stop();                           // Applies everything queued (tasks too, not their done), joins
+    bool IsRunning();
+
+    // Document commands (UI thread); never wait on the engine
+    void StartDrawing(int x, int y, const StrokeSettings& settings);
+    void ContinueDrawing(int x, int y);
+    // A batch of moves is one command, its points carried in a ring of their
+    // own; consecutive moves reach DrawingEngine as one ContinueDrawingBatch
+    void ContinueDrawing(const DrawingEngine::StrokePoint* points, size_t count);
+    void EndDrawing();
+    void Undo();
+    void Redo();
+    void ClearCanvas();
+    void Autosave();
+
+    // Response to notify (UI thread): re-arms it, queues commands the full
+    // ring turned away and runs finished tasks' done. True when nothing is
+    // left waiting. damage receives the document area changed since the
+    // previous call.
+    bool HandlePublished(DrawingEngine::Damage* damage = nullptr);
+
+    // Latest published snapshot; null before the first publish and when inline
+    std::shared_ptr<const Snapshot> Latest();
+    // Marks the inputs the snapshot applied for input-to-present latency (UI thread)
+    void ReportApplied(const Snapshot& snapshot);
+
+    // For the status bar: from the latest snapshot, or measured now when inline
+    struct Status {
+        size_t points = 0;
+        MemoryStats::Report memory;
+    };
+    Status CurrentStatus();
+
+    // Whole-document work (new, finishing a save or open) as a command: task
+    // runs on the engine thread with every earlier command applied and
+    // published, and done runs on the UI thread from HandlePublished with its
+    // result and the first snapshot to include it. Either may be empty; an
+    // empty task pins the document as of the call. Inline, both run before
+    // Run returns. The UI never waits on the engine.
+    typedef std::function<bool()> Task;
+    typedef std::function<void(bool result, const Snapshot& snapshot)> TaskDone;
+    void Run(Task task, TaskDone done = nullptr);
+
+    struct Stats {
+        uint64_t commands = 0;             // Applied on the engine thread
+        uint64_t batches = 0;              // Snapshots published
+        uint64_t overflowed = 0;           // Commands that waited for room in the ring
+        size_t maxQueueDepth = 0;          // Deepest the ring was seen by the engine
+        uint64_t chunksShared = 0;         // Point chunks snapshots took over from the previous one
+        uint64_t chunksCopied = 0;
+    };
+    Stats GetStats();
+}
+
+#endif // ENGINE_THREAD_H
@@ -2,6 +2,7 @@
 #define EVENT_HANDLER_H
 
 #include "types.h"
+#include "document_version.h"
 
 // Event handling functions
 namespace EventHandler {
@@ -24,10 +25,23 @@ namespace EventHandler {
     void OnPaintGPU(HWND hwnd, RECT clientRect);
     void OnPaintSoftware(HDC hdc, RECT clientRect);
     void OnSize(HWND hwnd, WPARAM wParam, LPARAM lParam);
+    void OnTimer(HWND hwnd, WPARAM wParam);
+    void OnEnginePublished(HWND hwnd);
+    void OnJobsChanged(HWND hwnd);
+    
+    // Message loop: paints the damage FrameScheduler gathered once a frame is due
+    void PresentFrame(HWND hwnd);
+    // Live resize/move and menu loops: IDT_PRESENT presents due frames until exit
+    void OnEnterModalLoop(HWND hwnd);
+    void OnExitModalLoop(HWND hwnd);
     
     // GPU rendering helpers
     void DrawGridGPU(RECT clientRect);
-    void DrawPointsGPU();
+    void DrawPointsGPU(const DocumentVersion::Points& points);
+    
+    // Reference layer, drawn under the strokes (bitmaps cached per referenceRevision)
+    void DrawReferenceGPU();
+    void DrawReferenceSoftware(HDC hdc);
 }
 
 #endif // EVENT_HANDLER_H
\ No newline at end of file
@@ -0,0 +1,115 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include "trace_events.h"
+#include "alloc_stats.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Always-on frame profiler: scoped timers around the paint phases feed a
+// lock-free ring of the last FRAME_HISTORY frames, and pointer input is
+// followed from arrival to the frame that first shows it. The UI thread is
+// the only writer; any thread may read summaries or dump the history to a file.
+namespace FrameProfiler {
+    enum Phase {
+        PHASE_CLEAR = 0,           // Background (and back buffer setup)
+        PHASE_GRID,
+        PHASE_REFERENCE,
+        PHASE_STROKES,
+        PHASE_TOOLBAR,
+        PHASE_STATUS_BAR,
+        PHASE_COLOR_PICKER,
+        PHASE_HUD,
+        PHASE_PRESENT,             // EndDraw / BitBlt
+        PHASE_COUNT
+    };
+
+    const size_t FRAME_HISTORY = 256;
+    const size_t LATENCY_HISTORY = 4096;   // Input-to-present samples
+
+    const char* PhaseName(Phase phase);
+
+    struct FrameRecord {
+        uint64_t index = 0;              // Frames since startup
+        uint64_t startMicros = 0;        // Since the profiler started
+        float totalMicros = 0.0f;
+        float phaseMicros[PHASE_COUNT] = {};
+        uint32_t pointsDrawn = 0;
+        uint32_t inputsPresented = 0;    // Inputs this frame showed first
+        float inputLatencyMicros = 0.0f; // Oldest of them, arrival to present
+        uint32_t allocations = 0;        // Heap allocations on the UI thread (ALLOCS=1 builds)
+        uint64_t allocatedBytes = 0;
+        bool gpu = false;
+    };
+
+    struct Summary {
+        size_t frames = 0;               // Frames in the history
+        double framesPerSecond = 0.0;    // Over the span of the history
+        double meanMicros = 0.0;
+        double p50Micros = 0.0;
+        double p99Micros = 0.0;
+        double maxMicros = 0.0;
+        double phaseMeanMicros[PHASE_COUNT] = {};
+        uint32_t pointsDrawn = 0;        // Latest frame
+        bool gpu = false;
+        double allocationsPerFrame = 0.0;   // Mean; zero unless AllocStats::Enabled()
+        double allocatedBytesPerFrame = 0.0;
+        uint32_t maxAllocations = 0;
+
+        // Input arrival to the end of EndDraw/BitBlt, over the latency history
+        size_t latencySamples = 0;
+        double latencyP50Micros = 0.0;
+        double latencyP95Micros = 0.0;
+        double latencyP99Micros = 0.0;
+        double latencyMaxMicros = 0.0;
+    };
+
+    // Frame bracketing (UI thread)
+    void BeginFrame(bool gpu);
+    void EndFrame(uint32_t pointsDrawn);
+
+    // Input-to-present latency (UI thread): WindowProcedure stamps pointer
+    // messages on arrival, DrawingEngine marks the input applied once it changes
+    // the canvas (EngineThread does, for inputs its published snapshot applied),
+    // and the end of the next PHASE_PRESENT measures it
+    uint64_t NowMicros();                  // Profiler clock, as in FrameRecord::startMicros
+    void InputArrived();
+    void InputArrived(uint64_t arrivalMicros);
+    void InputApplied();
+    uint64_t TakeArrivingInput();          // Hands over the calling thread's unapplied input, 0 when none
+    void SetLatencySink(std::vector<double>* sink);   // Also receives every sample (replay)
+
+    // Adds time to a phase of the current frame
+    class ScopedPhase {
+    public:
+        explicit ScopedPhase(Phase phase)
+            : phase(phase), start(std::chrono::steady_clock::now())
+#ifdef MPS_TRACE_EVENTS
+            , trace(TraceEvents::CAT_PAINT, PhaseName(phase))
+#endif
+        {}
+        ~ScopedPhase();
+    private:
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+#ifdef MPS_TRACE_EVENTS
+        TraceEvents::Scope trace;        // Same span on the engine timeline
+#endif
+    };
+
+    // Appends a finished frame (EndFrame uses it; tests feed synthetic frames)
+    void Record(const FrameRecord& frame);
+    void Reset();
+
+    // Readers: oldest first
+    size_t Snapshot(std::vector<FrameRecord>& frames);
+    size_t LatencySnapshot(std::vector<double>& micros);
+    Summary Summarize();
+    Summary Summarize(const std::vector<FrameRecord>& frames);
+    void SummarizeLatency(std::vector<double>& micros, Summary& summary);   // Sorts micros
+    bool DumpToFile(const std::string& filename);
+}
+
+#endif // FRAME_PROFILER_H
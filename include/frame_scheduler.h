@@ -0,0 +1,55 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Repaint pacing for the UI thread. Handlers report damage here instead of
+// invalidating the window; the message loop asks when the next frame is due
+// and presents everything gathered since the last frame at most once per
+// interval. The interval stretches while painting costs more than it allows,
+// so input keeps getting time, and nothing is scheduled while nothing changes.
+namespace FrameScheduler {
+    const uint64_t DEFAULT_INTERVAL_MICROS = 16667;   // 60 Hz until the display says otherwise
+    const uint64_t MAX_INTERVAL_MICROS = 100000;      // Stretching stops at 10 frames a second
+    const uint64_t IDLE = UINT64_MAX;                 // TimeUntilDue with nothing to paint
+    const size_t MAX_RECTS = 8;                       // Beyond it, damage merges into its bounds
+
+    // Client coordinates; right/bottom exclusive
+    struct Rect {
+        int left, top, right, bottom;
+    };
+
+    struct Frame {
+        Rect rects[MAX_RECTS];
+        size_t count = 0;
+        bool whole = false;                // The entire client area
+    };
+
+    void Invalidate(const Rect& rect);
+    void InvalidateAll();
+
+    // Microseconds until the pending frame is due: 0 when due now, IDLE when
+    // there is none. A frame after a quiet spell is due at once.
+    uint64_t TimeUntilDue();
+    // Hands over the gathered damage once a frame is due; false otherwise
+    bool TakeFrame(Frame& frame);
+    // What painting the frame cost; feeds the adaptive interval
+    void FramePresented(uint64_t paintMicros);
+
+    void SetTargetInterval(uint64_t micros);   // From the display refresh rate
+    uint64_t CurrentInterval();                 // Target, or longer while frames are expensive
+
+    // Tests drive the scheduler from a fake clock; null restores FrameProfiler::NowMicros
+    void SetClock(uint64_t (*now)());
+
+    struct Stats {
+        uint64_t requests = 0;             // Invalidate and InvalidateAll calls
+        uint64_t coalesced = 0;            // Requests folded into a frame already pending
+        uint64_t frames = 0;               // Frames handed out by TakeFrame
+    };
+    Stats GetStats();
+    void Reset();                          // Drops pending damage, history and stats
+}
+
+#endif // FRAME_SCHEDULER_H
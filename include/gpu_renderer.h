@@ -2,6 +2,7 @@
 #define GPU_RENDERER_H
 
 #include "types.h"
+#include "frame_profiler.h"
 #include <d2d1.h>
 #include <d2d1helper.h>
 #include <dwrite.h>
@@ -69,14 +70,15 @@ public:
     
     // Texture/bitmap operations
     static ID2D1Bitmap* CreateBitmapFromHDC(HDC hdc, int width, int height);
+    static ID2D1Bitmap* CreateBitmapFromPixels(const uint32_t* pixels, int width, int height);   // RasterRenderer layout; caller releases
     static void DrawBitmap(ID2D1Bitmap* bitmap, float x, float y, float opacity = 1.0f);
     
     // Color utilities
     static D2D1::ColorF ColorFromCOLORREF(COLORREF color, float alpha = 1.0f);
     static void UpdateDynamicBrush(COLORREF color, float alpha = 1.0f);
     
-    // Performance monitoring
-    static void GetPerformanceStats();
+    // Performance monitoring (frame profiler summary of recent paints)
+    static FrameProfiler::Summary GetPerformanceStats();
     
 private:
     static GPUContext context;
@@ -0,0 +1,24 @@
+#ifndef IMAGE_STREAM_H
+#define IMAGE_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Callback types shared by the streaming image codecs. Pixels use the
+// RasterRenderer layout: R | G << 8 | B << 16 | A << 24.
+namespace ImageStream {
+    // Fills rows [firstRow, firstRow + rowCount); may be called concurrently for disjoint ranges
+    typedef std::function<bool(int firstRow, int rowCount, uint32_t* pixels)> RowSource;
+    
+    // Receives decoded rows in order, one row of 'width' pixels at a time
+    typedef std::function<bool(int row, const uint32_t* pixels)> RowSink;
+    
+    // Receives encoded bytes in order
+    typedef std::function<bool(const void* data, size_t size)> ByteSink;
+    
+    // Reads up to 'size' bytes; returns how many were read (0 at end of input)
+    typedef std::function<size_t(void* data, size_t size)> ByteSource;
+}
+
+#endif // IMAGE_STREAM_H
@@ -0,0 +1,104 @@
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include "types.h"
+#include "frame_profiler.h"
+#include <cstdint>
+#include <string>
+
+// Input traces: the window messages that drive the document, recorded with
+// timestamps to a compact binary file, and a headless replayer that feeds them
+// through DrawingEngine as fast as possible. Turns real sessions into
+// repeatable benchmarks.
+namespace InputTrace {
+    enum EventType : uint8_t {
+        EVENT_BUTTON_DOWN = 0,     // x, y: client coordinates
+        EVENT_MOUSE_MOVE,          // x, y; FLAG_LBUTTON while dragging
+        EVENT_BUTTON_UP,           // x, y
+        EVENT_KEY_DOWN,            // code: virtual key; FLAG_CTRL
+        EVENT_COMMAND,             // code: IDM_* menu command
+        EVENT_MOUSE_WHEEL,         // code: wheel delta; FLAG_CTRL (zoom and pan move later clicks)
+        EVENT_RESIZE,              // x, y: new client size (moves the canvas bottom edge)
+        EVENT_TYPE_COUNT
+    };
+    
+    const uint8_t FLAG_LBUTTON = 0x01;
+    const uint8_t FLAG_CTRL = 0x02;
+    
+    struct Event {
+        uint64_t timeMicros = 0;   // Since recording started
+        EventType type = EVENT_MOUSE_MOVE;
+        uint8_t flags = 0;
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t code = 0;
+    };
+    
+    // Application state when recording started; replays begin from it
+    struct Session {
+        int clientWidth = 0;
+        int clientHeight = 0;
+        float zoomLevel = 1.0f;
+        int panX = 0;
+        int panY = 0;
+        ToolType tool = TOOL_BRUSH;
+        int brushSize = 5;
+        COLORREF color = RGB(0, 0, 0);
+        bool showAdvancedColorPicker = false;
+        int pickerX = 0;
+        int pickerY = 0;
+        std::vector<DrawPoint> document;
+    };
+    
+    struct Trace {
+        Session session;
+        std::vector<Event> events;
+    };
+    
+    // Recording: captures the current AppState, then streams each Record call to the file
+    bool StartRecording(const std::string& filename, int clientWidth, int clientHeight);
+    // The same in two steps, for a document that arrives later (the engine
+    // thread's): Begin captures the view and tool and holds events in memory
+    // until Complete writes the starting document and streams from there
+    bool BeginRecording(const std::string& filename, int clientWidth, int clientHeight);
+    bool CompleteRecording(const std::vector<DrawPoint>& document);
+    bool StopRecording();
+    bool IsRecording();
+    void Record(EventType type, int x, int y, int code = 0, uint8_t flags = 0);   // No-op unless recording
+    
+    // Storage (Load keeps every complete event of a trace cut short by a crash)
+    bool Save(const std::string& filename, const Trace& trace);
+    bool Load(const std::string& filename, Trace& trace);
+    
+    // Replay
+    struct Latency {
+        size_t count = 0;
+        double p50Micros = 0.0;
+        double p90Micros = 0.0;
+        double p99Micros = 0.0;
+        double maxMicros = 0.0;
+        double allocationsPerEvent = 0.0;   // Zero unless AllocStats::Enabled()
+    };
+    
+    struct ReplayStats {
+        size_t events = 0;
+        size_t ignored = 0;        // Events that only open dialogs or touch the window
+        double seconds = 0.0;
+        double eventsPerSecond = 0.0;
+        Latency all;
+        Latency byType[EVENT_TYPE_COUNT];
+        AllocStats::Counters allocated;    // Applying every event (ALLOCS=1 builds)
+        uint64_t maxEventAllocations = 0;
+        size_t frames = 0;             // Paced replays only
+        FrameProfiler::Summary paint;  // Frame times (latest FRAME_HISTORY) and input-to-present latency
+    };
+    
+    // Resets AppState to the session, then applies every event back to back.
+    // Paced replays feed events at their recorded times instead and paint a
+    // software frame whenever no event is due, like the message loop's WM_PAINT.
+    ReplayStats Replay(const Trace& trace, bool paced = false);
+    
+    const char* EventName(EventType type);
+}
+
+#endif // INPUT_TRACE_H
@@ -0,0 +1,77 @@
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Long operations (exports, filters) off the UI thread. Jobs queue for a small
+// pool of workers; a running job reports its progress and polls for
+// cancellation through its Progress, and its completion runs back on the UI
+// thread when the UI answers notify with HandleCompleted. Until Start (tests,
+// tools) a job runs inline and completes before Submit returns.
+namespace JobPool {
+    const int MAX_WORKERS = 8;
+
+    typedef uint64_t JobId;                // Numbered from 1
+
+    enum Result {
+        JOB_SUCCEEDED,
+        JOB_FAILED,
+        JOB_CANCELLED                      // Cancelled before it ran, or gave up when asked
+    };
+
+    struct Job;
+
+    // A running job's view of itself; safe to use from any thread the job starts
+    class Progress {
+    public:
+        explicit Progress(Job& owner) : job(owner) {}
+        void Report(double fraction) const;   // 0 to 1
+        bool Cancelled() const;               // The job should stop and return false
+    private:
+        Job& job;
+    };
+
+    typedef std::function<bool(const Progress&)> Work;   // True on success
+    typedef std::function<void(Result)> Completion;      // UI thread
+
+    // notify runs on a worker when a job finishes or its progress moves a
+    // whole percent, and not again until the UI calls HandleCompleted; it
+    // should post a message and return
+    bool Start(int workers, std::function<void()> notify);
+    // Cancels every job, waits for running ones to return, then runs every
+    // completion not yet handled on the calling thread
+    void Stop();
+    bool IsRunning();
+
+    JobId Submit(const std::string& name, Work work, Completion done = nullptr);
+    void Cancel(JobId id);                 // Queued jobs never run; running ones see Cancelled
+    void CancelAll();
+
+    // Response to notify (UI thread): runs the completions of finished jobs,
+    // oldest first, and re-arms notify. Returns how many ran.
+    size_t HandleCompleted();
+
+    // For the status bar: jobs not yet finished, oldest first
+    struct JobStatus {
+        JobId id = 0;
+        std::string name;
+        double progress = 0.0;
+        bool running = false;              // Otherwise queued
+        bool cancelling = false;
+    };
+    std::vector<JobStatus> ActiveJobs();
+
+    struct Stats {
+        uint64_t submitted = 0;
+        uint64_t succeeded = 0;
+        uint64_t failed = 0;
+        uint64_t cancelled = 0;
+    };
+    Stats GetStats();
+}
+
+#endif // JOB_POOL_H
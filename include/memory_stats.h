@@ -0,0 +1,61 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Live memory accounting per subsystem. Document and undo/redo bytes are
+// measured from AppState when a report is collected; the reference image,
+// caches, GPU resources and transient file buffers register themselves
+// through an Allocation, so their counters are always current and keep a peak.
+namespace MemoryStats {
+    enum Subsystem {
+        MEM_DOCUMENT = 0,          // AppState::drawingPoints
+        MEM_UNDO,                  // Full document snapshots
+        MEM_REDO,
+        MEM_REFERENCE,             // Imported reference image
+        MEM_RASTER,                // Scene indices and software caches
+        MEM_GPU,                   // Render target and device bitmaps (estimated)
+        MEM_FILE_BUFFERS,          // Save/load blocks, journal, encoder buffers
+        MEM_COUNT
+    };
+
+    const char* SubsystemName(Subsystem subsystem);
+
+    // Adds its size to a subsystem's counter for as long as it lives
+    class Allocation {
+    public:
+        explicit Allocation(Subsystem subsystem, size_t bytes = 0);
+        ~Allocation();
+        Allocation(const Allocation&) = delete;
+        Allocation& operator=(const Allocation&) = delete;
+
+        void Resize(size_t bytes);
+        size_t Bytes() const { return bytes; }
+    private:
+        Subsystem subsystem;
+        size_t bytes;
+    };
+
+    struct Report {
+        size_t bytes[MEM_COUNT] = {};
+        size_t peakBytes[MEM_COUNT] = {};   // Tracked subsystems only; measured ones report current
+        size_t totalBytes = 0;
+        size_t points = 0;
+        size_t undoStates = 0;
+        size_t redoStates = 0;
+    };
+
+    // Measures AppState and reads the tracked counters (engine thread while it runs)
+    Report Collect();
+    // Tracked counter alone, from any thread
+    size_t TrackedBytes(Subsystem subsystem);
+    void ResetPeaks();
+
+    // One line per subsystem, then the total
+    std::string FormatReport(const Report& report);
+    bool WriteReport(const std::string& filename);
+}
+
+#endif // MEMORY_STATS_H
@@ -0,0 +1,58 @@
+#ifndef MPSP_FORMAT_H
+#define MPSP_FORMAT_H
+
+#include "types.h"
+#include <cstdint>
+
+// Native .mpsp file format shared by the drawing engine and the document journal
+namespace MpspFormat {
+    const char MAGIC[4] = {'M', 'P', 'S', 'P'};
+    
+    // Version 1: header + point count + field-by-field point records
+    // Version 2: header + point count + reserved + generation + packed 16-byte records
+    const uint32_t VERSION_1 = 1;
+    const uint32_t VERSION_2 = 2;
+    
+    // Size of the v2 header (magic, version, point count, reserved, generation)
+    const size_t HEADER_V2_SIZE = 24;
+    
+    // Size of a v1 point record (fields written one after another, no padding)
+    const size_t RECORD_V1_SIZE = 3 * sizeof(int) + sizeof(COLORREF) + sizeof(bool) + sizeof(ToolType);
+    
+    const uint8_t FLAG_STROKE_START = 0x01;
+    
+    // Fixed-size point record used by v2 files and journal append records
+    struct PackedPoint {
+        int32_t x;
+        int32_t y;
+        uint32_t color;
+        uint16_t brushSize;
+        uint8_t toolType;
+        uint8_t flags;
+    };
+    static_assert(sizeof(PackedPoint) == 16, "PackedPoint must stay 16 bytes on disk");
+    
+    inline PackedPoint Pack(const DrawPoint& point) {
+        PackedPoint packed;
+        packed.x = point.x;
+        packed.y = point.y;
+        packed.color = point.color;
+        packed.brushSize = (uint16_t)point.brushSize;
+        packed.toolType = (uint8_t)point.toolType;
+        packed.flags = point.isStart ? FLAG_STROKE_START : 0;
+        return packed;
+    }
+    
+    inline DrawPoint Unpack(const PackedPoint& packed) {
+        DrawPoint point;
+        point.x = packed.x;
+        point.y = packed.y;
+        point.color = packed.color;
+        point.isStart = (packed.flags & FLAG_STROKE_START) != 0;
+        point.brushSize = packed.brushSize;
+        point.toolType = (ToolType)packed.toolType;
+        return point;
+    }
+}
+
+#endif // MPSP_FORMAT_H
@@ -0,0 +1,36 @@
+#ifndef PNG_ENCODER_H
+#define PNG_ENCODER_H
+
+#include "deflate.h"
+#include "image_stream.h"
+#include <cstdint>
+#include <string>
+
+// Streaming PNG encoder. Rows are requested in groups; each group is filtered
+// and deflated independently on a worker thread and written as its own IDAT
+// chunk, so memory stays bounded by (threads x group size) for any image height.
+namespace PngEncoder {
+    // Row ranges handed to the source may overlap by one row (filters look upward)
+    typedef ImageStream::RowSource RowSource;
+    typedef ImageStream::ByteSink ByteSink;
+    
+    struct Options {
+        int threads = 0;                        // 0 = hardware concurrency
+        bool alpha = false;                     // RGBA instead of RGB
+        int level = Deflate::LEVEL_DEFAULT;
+        size_t groupBytes = 1 << 20;            // Approximate filtered bytes per row group
+        size_t memoryBudget = 0;                // Caps groups in flight (0 = one per thread)
+        size_t sourceScratchBytes = 0;          // Row source working memory per call, counted against the budget
+        double dpi = 0.0;                       // Physical resolution for the pHYs chunk (0 = omit)
+    };
+    
+    // Approximate working memory of one in-flight row group
+    size_t GroupFootprint(int width, int rowsPerGroup, bool alpha);
+    
+    bool Encode(int width, int height, const RowSource& rows, const ByteSink& sink,
+                const Options& options = Options());
+    bool EncodeToFile(const std::string& filename, int width, int height, const RowSource& rows,
+                      const Options& options = Options());
+}
+
+#endif // PNG_ENCODER_H
@@ -0,0 +1,35 @@
+#ifndef QOI_CODEC_H
+#define QOI_CODEC_H
+
+#include "image_stream.h"
+#include "types.h"
+#include <string>
+
+// "Quite OK Image" codec (qoiformat.org): lossless, single pass, several
+// hundred MB/s each way. Used for fast raster round trips between tools and
+// for reference images.
+namespace QoiCodec {
+    struct Options {
+        int threads = 0;                        // Row render-ahead workers (0 = hardware concurrency)
+        bool alpha = false;                     // 4 channels instead of 3
+        size_t chunkBytes = 1 << 20;            // Approximate pixel bytes rendered per request
+    };
+    
+    struct Info {
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+    };
+    
+    // Streams rows from the source (rendered ahead on workers) into the sink
+    bool Encode(int width, int height, const ImageStream::RowSource& rows, const ImageStream::ByteSink& sink,
+                const Options& options = Options());
+    bool EncodeToFile(const std::string& filename, int width, int height, const ImageStream::RowSource& rows,
+                      const Options& options = Options());
+    
+    // Streams decoded rows to the sink; info is filled in before the first row
+    bool Decode(const ImageStream::ByteSource& source, Info& info, const ImageStream::RowSink& rows);
+    bool DecodeFile(const std::string& filename, RasterImage& image);
+}
+
+#endif // QOI_CODEC_H
@@ -0,0 +1,75 @@
+#ifndef RASTER_RENDERER_H
+#define RASTER_RENDERER_H
+
+#include "types.h"
+#include <cstdint>
+
+// Portable software rasterizer for exports. Renders any horizontal band of the
+// output independently, so callers can stream or parallelize by rows.
+// Pixels are packed R | G << 8 | B << 16 | A << 24 (COLORREF plus opaque alpha).
+namespace RasterRenderer {
+    inline uint32_t ToPixel(COLORREF color) { return (uint32_t)color | 0xFF000000u; }
+    
+    // Output pixel (x, y) shows document point (originX + x / scale, originY + y / scale)
+    struct View {
+        double originX = 0.0;
+        double originY = 0.0;
+        double scale = 1.0;
+    };
+    
+    // Document-space box covering every painted pixel; right/bottom are exclusive
+    struct Bounds {
+        int left, top, right, bottom;
+    };
+    
+    // False for an empty document
+    bool DocumentBounds(const std::vector<DrawPoint>& points, Bounds& bounds);
+    
+    // Grows bounds to cover a reference image placed at the document origin
+    void IncludeReference(const RasterImage& reference, Bounds& bounds);
+    
+    // One brush stamp as the renderers paint it (a cached BrushMask blend),
+    // centred at output pixel (cx, cy) of a width x height image and clipped
+    // to it. Channels blend independently, so pixel may use any packing.
+    void StampBrush(uint32_t* pixels, int width, int height, double cx, double cy,
+                    int brushSize, double scale, uint32_t pixel);
+    
+    // Renders output rows [firstRow, firstRow + rowCount), 'width' pixels wide, into
+    // pixels (rowCount * width entries). Visits every point; safe to call concurrently.
+    void RenderRows(const std::vector<DrawPoint>& points, const View& view, int width,
+                    int firstRow, int rowCount, COLORREF background, uint32_t* pixels);
+    
+    // Points bucketed by the output rows they touch, so rendering a band only
+    // visits what lands in it. Build once per export; the points must outlive it.
+    // With samples > 1 every output pixel averages a samples x samples grid.
+    // An optional reference image is composited under the strokes, pixel
+    // (i, j) covering document [i, i + 1) x [j, j + 1).
+    class SceneIndex {
+    public:
+        SceneIndex(const std::vector<DrawPoint>& points, const View& view, int outputHeight, int samples = 1,
+                   const RasterImage* reference = nullptr);
+        
+        // Same output as the free RenderRows when samples == 1; safe to call concurrently
+        void RenderRows(int width, int firstRow, int rowCount, COLORREF background, uint32_t* pixels) const;
+        
+        size_t MemoryBytes() const;
+        size_t ScratchBytes(int width) const;   // Per-call working memory of RenderRows
+        
+    private:
+        void RenderSamples(int width, int firstRow, int rowCount, COLORREF background, uint32_t* pixels) const;
+        void DrawReference(int width, int firstRow, int rowCount, uint32_t* pixels) const;
+        int ScratchRows(int width) const;
+        
+        const std::vector<DrawPoint>& points;
+        const RasterImage* reference;
+        View view;                          // Sample-grid view (output view scaled by samples)
+        int samples;
+        int bandRows;
+        std::vector<int32_t> penFrom;       // Brush point each brush point connects from, or -1
+        std::vector<double> stampCarry;     // Stamp spacing carried into each brush point's segment
+        std::vector<uint32_t> bandStart;    // Offsets into entries, one per band plus end
+        std::vector<uint32_t> entries;      // Point indices per band, in document order
+    };
+}
+
+#endif // RASTER_RENDERER_H
@@ -0,0 +1,76 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free ring for exactly one producer thread and one consumer
+// thread. Push and Pop never block or allocate: each side owns one index and
+// reads the other's with acquire ordering, and the two indices live on
+// separate cache lines so the threads do not fight over them.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer; false when full
+    bool Push(const T& item) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - cachedHead == Capacity) {
+            cachedHead = headIndex.load(std::memory_order_acquire);
+            if (tail - cachedHead == Capacity) {
+                return false;
+            }
+        }
+        items[tail & (Capacity - 1)] = item;
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer; all count items from first on, or none when they do not fit
+    template <typename Iterator>
+    bool Push(Iterator first, size_t count) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (Capacity - (tail - cachedHead) < count) {
+            cachedHead = headIndex.load(std::memory_order_acquire);
+            if (Capacity - (tail - cachedHead) < count) {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < count; i++, ++first) {
+            items[(tail + i) & (Capacity - 1)] = *first;
+        }
+        tailIndex.store(tail + count, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer; false when empty
+    bool Pop(T& item) {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == cachedTail) {
+            cachedTail = tailIndex.load(std::memory_order_acquire);
+            if (head == cachedTail) {
+                return false;
+            }
+        }
+        item = items[head & (Capacity - 1)];
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Either side; exact only while the other side is idle
+    size_t Size() const {
+        return tailIndex.load(std::memory_order_acquire) - headIndex.load(std::memory_order_acquire);
+    }
+    bool Empty() const { return Size() == 0; }
+    static constexpr size_t MaxSize() { return Capacity; }
+
+private:
+    alignas(64) std::atomic<size_t> headIndex{0};   // Next slot to pop
+    size_t cachedTail = 0;                          // Consumer's last view of tailIndex
+    alignas(64) std::atomic<size_t> tailIndex{0};   // Next slot to push
+    size_t cachedHead = 0;                          // Producer's last view of headIndex
+    alignas(64) T items[Capacity];
+};
+
+#endif // SPSC_QUEUE_H
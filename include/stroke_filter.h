@@ -0,0 +1,39 @@
+#ifndef STROKE_FILTER_H
+#define STROKE_FILTER_H
+
+#include <cstdint>
+
+// Streaming pointer smoothing for brush strokes: a 1€ filter (Casiez et al.),
+// a low-pass whose cutoff rises with the pointer's speed. Slow movement loses
+// its jitter and fast strokes keep up. Every sample comes out as it goes in,
+// so nothing is held back to look ahead. Prediction extrapolates the filtered
+// velocity for the tail drawn ahead of the pen; it never reaches the document.
+namespace StrokeFilter {
+    struct Params {
+        double minCutoff = 1.0;            // Hz at rest; lower smooths more
+        double beta = 0.04;                // Cutoff gained per unit/s of speed; higher lags less
+        double derivativeCutoff = 1.0;     // Hz, for the speed estimate
+    };
+
+    struct Position {
+        double x = 0.0, y = 0.0;
+    };
+
+    struct Filter {
+        Params params;
+        Position position;                 // Last filtered position
+        Position sample;                   // Last raw sample
+        Position velocity;                 // Filtered, units per second
+        uint64_t lastMicros = 0;
+    };
+
+    // A stroke starts exactly where the pointer went down, at rest
+    void Reset(Filter& filter, double x, double y, uint64_t micros);
+    // Filters one sample; samples with the same time count as 1 ms apart
+    Position Apply(Filter& filter, double x, double y, uint64_t micros);
+    // Where the filtered pen will be after aheadMicros at its current
+    // velocity, at most maxDistance away
+    Position Predict(const Filter& filter, uint64_t aheadMicros, double maxDistance);
+}
+
+#endif // STROKE_FILTER_H
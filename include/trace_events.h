@@ -0,0 +1,78 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+#include <cstdint>
+#include <string>
+
+// Engine activity timeline: scoped events for input handling, document
+// mutations, undo snapshots, rasterization, file I/O and paint phases, kept in
+// per-thread buffers and written as Chrome trace-event JSON (chrome://tracing,
+// ui.perfetto.dev). Only built with MPS_TRACE_EVENTS (make TRACE=1); otherwise
+// the TRACE_* macros expand to nothing and no code or data is linked in.
+namespace TraceEvents {
+    enum Category : uint8_t {
+        CAT_INPUT = 0,
+        CAT_DOCUMENT,              // Point list mutations
+        CAT_UNDO,                  // Snapshots and restores
+        CAT_RASTER,
+        CAT_FILE_IO,
+        CAT_PAINT,                 // Frames and their phases
+        CAT_COUNT
+    };
+
+#ifdef MPS_TRACE_EVENTS
+    const size_t MAX_EVENTS_PER_THREAD = 1 << 20;  // Later events are dropped (and counted)
+
+    struct Event {
+        const char* name = nullptr;      // Static strings only
+        const char* argName = nullptr;   // Optional numeric argument
+        int64_t arg = 0;
+        uint64_t startNanos = 0;         // Since the first event
+        uint64_t durationNanos = 0;
+        Category category = CAT_INPUT;
+        bool instant = false;
+    };
+
+    // Records a complete event from construction to destruction
+    class Scope {
+    public:
+        Scope(Category category, const char* name, const char* argName = nullptr, int64_t arg = 0);
+        ~Scope();
+    private:
+        const char* name;
+        const char* argName;
+        int64_t arg;
+        uint64_t startNanos;
+        Category category;
+    };
+
+    void Instant(Category category, const char* name);
+    void SetThreadName(const char* name);
+
+    // Writes every buffered event; buffers keep their contents
+    bool Flush(const std::string& filename);
+    // Flushes when the process exits, to $MPS_TRACE_FILE if set
+    void FlushOnExit(const std::string& defaultFilename);
+
+    size_t EventCount();
+    size_t DroppedCount();
+    void Clear();
+
+    const char* CategoryName(Category category);
+#endif
+}
+
+#ifdef MPS_TRACE_EVENTS
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(category, name) TraceEvents::Scope TRACE_CONCAT(traceScope, __LINE__)(category, name)
+#define TRACE_SCOPE_ARG(category, name, argName, arg) \
+    TraceEvents::Scope TRACE_CONCAT(traceScope, __LINE__)(category, name, argName, (int64_t)(arg))
+#define TRACE_INSTANT(category, name) TraceEvents::Instant(category, name)
+#else
+#define TRACE_SCOPE(category, name) ((void)0)
+#define TRACE_SCOPE_ARG(category, name, argName, arg) ((void)0)
+#define TRACE_INSTANT(category, name) ((void)0)
+#endif
+
+#endif // TRACE_EVENTS_H
@@ -8,12 +8,15 @@
 #define _UNICODE
 #endif
 
-#include <windows.h>
 #include <vector>
+#include <cstdint>
 #include <cstdio>
 #include <string>
 #include <cmath>
 #include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
 #include <commdlg.h>
 #include <gdiplus.h>
 
@@ -27,6 +30,10 @@ LRESULT CALLBACK WindowProcedure(HWND, UINT, WPARAM, LPARAM);
 
 // Application constants
 extern const WCHAR szClassName[];
+#else
+// Headless engine build (tests, tools)
+#include "win32_compat.h"
+#endif
 
 // Tool types
 enum ToolType {
@@ -47,6 +54,20 @@ struct DrawPoint {
     ToolType toolType;  // Track what tool created this point
 };
 
+// Tool, color and size a stroke keeps from its first point to its last
+struct StrokeSettings {
+    ToolType tool = TOOL_BRUSH;
+    COLORREF color = RGB(0, 0, 0);
+    int brushSize = 5;
+};
+
+// Decoded raster image, pixels packed R | G << 8 | B << 16 | A << 24
+struct RasterImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> pixels;
+};
+
 // Structure for undo system
 struct UndoState {
     std::vector<DrawPoint> points;
@@ -10,8 +10,15 @@ namespace UIRenderer {
     void DrawToolbarSoftware(HDC hdc, RECT clientRect);  // Software fallback
     void DrawStatusBar(HDC hdc, RECT clientRect);
     void DrawStatusBarGPU(RECT clientRect);  // GPU-accelerated version
+    std::wstring JobsStatusText();          // " | Jobs: ..." while background jobs run, else empty
     void DrawAdvancedColorPicker(HDC hdc);
     void DrawAdvancedColorPickerGPU(RECT clientRect);  // GPU-accelerated version
+    
+    // Frame profiler overlay in the top-right corner of the canvas
+    std::vector<std::wstring> PerformanceHudLines();
+    void DrawPerformanceHud(HDC hdc, RECT clientRect);
+    void DrawPerformanceHudGPU(RECT clientRect);
+    
     HMENU CreateMenuBar();
 }
 
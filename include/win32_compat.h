@@ -0,0 +1,23 @@
+#ifndef WIN32_COMPAT_H
+#define WIN32_COMPAT_H
+
+// Minimal Win32 type definitions for the headless (non-Windows) engine build.
+// Only what the drawing engine, file formats and exporters need; anything
+// touching windows, DCs or GDI+ stays behind _WIN32.
+
+#include <cstdint>
+
+typedef unsigned char BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef unsigned int UINT;
+typedef uint32_t COLORREF;
+typedef uintptr_t ULONG_PTR;
+typedef wchar_t WCHAR;
+
+#define RGB(r, g, b) ((COLORREF)(((BYTE)(r) | ((WORD)((BYTE)(g)) << 8)) | (((DWORD)(BYTE)(b)) << 16)))
+#define GetRValue(rgb) ((BYTE)(rgb))
+#define GetGValue(rgb) ((BYTE)(((WORD)(rgb)) >> 8))
+#define GetBValue(rgb) ((BYTE)((rgb) >> 16))
+
+#endif // WIN32_COMPAT_H
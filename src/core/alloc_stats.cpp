@@ -0,0 +1,129 @@
+#include "../../include/alloc_stats.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace AllocStats {
+
+// Plain thread-locals: constant-initialized, so operator new can touch them
+// before any constructor runs on a new thread
+static thread_local uint64_t threadAllocations = 0;
+static thread_local uint64_t threadFrees = 0;
+static thread_local uint64_t threadBytes = 0;
+
+static std::atomic<uint64_t> totalAllocations{0};
+static std::atomic<uint64_t> totalFrees{0};
+static std::atomic<uint64_t> totalBytes{0};
+
+#ifdef MPS_ALLOC_STATS
+static void CountAllocation(size_t size)
+{
+    threadAllocations++;
+    threadBytes += size;
+    totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    totalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+static void CountFree()
+{
+    threadFrees++;
+    totalFrees.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void* Allocate(size_t size)
+{
+    if (size == 0) {
+        size = 1;
+    }
+    for (;;) {
+        void* memory = std::malloc(size);
+        if (memory) {
+            CountAllocation(size);
+            return memory;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+static void Free(void* memory)
+{
+    if (memory) {
+        CountFree();
+        std::free(memory);
+    }
+}
+#endif
+
+Counters operator-(const Counters& end, const Counters& start)
+{
+    Counters delta;
+    delta.allocations = end.allocations - start.allocations;
+    delta.frees = end.frees - start.frees;
+    delta.bytes = end.bytes - start.bytes;
+    return delta;
+}
+
+bool Enabled()
+{
+#ifdef MPS_ALLOC_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+Counters ThreadCounters()
+{
+    Counters counters;
+    counters.allocations = threadAllocations;
+    counters.frees = threadFrees;
+    counters.bytes = threadBytes;
+    return counters;
+}
+
+Counters TotalCounters()
+{
+    Counters counters;
+    counters.allocations = totalAllocations.load(std::memory_order_relaxed);
+    counters.frees = totalFrees.load(std::memory_order_relaxed);
+    counters.bytes = totalBytes.load(std::memory_order_relaxed);
+    return counters;
+}
+
+}
+
+#ifdef MPS_ALLOC_STATS
+// Replacements for the ordinary forms; over-aligned new keeps the library's
+// own allocator (and its matching delete) and is not counted
+void* operator new(size_t size) { return AllocStats::Allocate(size); }
+void* operator new[](size_t size) { return AllocStats::Allocate(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return AllocStats::Allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return AllocStats::Allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* memory) noexcept { AllocStats::Free(memory); }
+void operator delete[](void* memory) noexcept { AllocStats::Free(memory); }
+void operator delete(void* memory, size_t) noexcept { AllocStats::Free(memory); }
+void operator delete[](void* memory, size_t) noexcept { AllocStats::Free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { AllocStats::Free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { AllocStats::Free(memory); }
+#endif
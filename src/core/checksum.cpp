@@ -0,0 +1,72 @@
+#include "../../include/checksum.h"
+
+namespace Checksum {
+
+struct Crc32Table {
+    uint32_t entries[256];
+    
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[i] = c;
+        }
+    }
+};
+
+uint32_t Crc32(const void* data, size_t size, uint32_t crc)
+{
+    // Function-local static so concurrent first use is safe
+    static const Crc32Table crcTable;
+    const uint32_t* table = crcTable.entries;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static const uint32_t ADLER_BASE = 65521;
+static const size_t ADLER_NMAX = 5552;  // Largest n such that the sums cannot overflow 32 bits
+
+uint32_t Adler32(const void* data, size_t size, uint32_t adler)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    
+    while (size > 0) {
+        size_t chunk = size < ADLER_NMAX ? size : ADLER_NMAX;
+        size -= chunk;
+        for (size_t i = 0; i < chunk; i++) {
+            a += bytes[i];
+            b += a;
+        }
+        bytes += chunk;
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+    return (b << 16) | a;
+}
+
+uint32_t Adler32Combine(uint32_t adlerA, uint32_t adlerB, uint64_t lengthB)
+{
+    uint32_t remainder = (uint32_t)(lengthB % ADLER_BASE);
+    uint32_t a = adlerA & 0xFFFF;
+    uint32_t b = (uint32_t)(((uint64_t)remainder * a) % ADLER_BASE);
+    
+    a += (adlerB & 0xFFFF) + ADLER_BASE - 1;
+    b += (adlerA >> 16) + (adlerB >> 16) + ADLER_BASE - remainder;
+    
+    if (a >= ADLER_BASE) a -= ADLER_BASE;
+    if (a >= ADLER_BASE) a -= ADLER_BASE;
+    if (b >= (ADLER_BASE << 1)) b -= (ADLER_BASE << 1);
+    if (b >= ADLER_BASE) b -= ADLER_BASE;
+    return (b << 16) | a;
+}
+
+} // namespace Checksum
@@ -6,6 +6,30 @@ const int STATUSBAR_HEIGHT = 25;
 const int MENUBAR_HEIGHT = 25;
 const int COLOR_PICKER_WIDTH = 200;
 
+// Autosave / crash recovery
+const UINT AUTOSAVE_INTERVAL_MS = 30000;
+const char AUTOSAVE_DOCUMENT[] = "untitled.mpsp";
+
+// Stroke ingestion
+const double STROKE_TOLERANCE = 0.75;    // Document pixels; half of it again at EndDrawing
+
+// Brush rendering
+const double STAMP_SPACING = 0.25;
+const double MIN_STAMP_SPACING = 0.5;
+
+// File loading
+const uint32_t LOAD_PARALLEL_MIN_POINTS = 1 << 20;
+
+// Image export
+const size_t EXPORT_MEMORY_BUDGET = 64 * 1024 * 1024;
+const double EXPORT_BASE_DPI = 96.0;
+const int EXPORT_MAX_SAMPLES = 8;
+const double EXPORT_PRINT_SCALE = 4.0;   // 384 DPI
+const int EXPORT_PRINT_SAMPLES = 2;
+
+// Background jobs
+const int JOB_WORKERS = 2;
+
 // Color palette
 COLORREF colorPalette[] = {
     RGB(0, 0, 0), RGB(128, 128, 128), RGB(255, 0, 0), RGB(255, 128, 0),
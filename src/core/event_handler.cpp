@@ -4,10 +4,48 @@
 #include "../../include/ui_renderer.h"
 #include "../../include/drawing_engine.h"
 #include "../../include/gpu_renderer.h"
+#include "../../include/document_journal.h"
+#include "../../include/input_trace.h"
+#include "../../include/frame_profiler.h"
+#include "../../include/trace_events.h"
+#include "../../include/memory_stats.h"
+#include "../../include/engine_thread.h"
+#include "../../include/job_pool.h"
+#include "../../include/frame_scheduler.h"
+#include "../../include/stroke_filter.h"
+#include "../../include/brush_stamps.h"
+#include "../../include/raster_renderer.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <functional>
+
+static uint8_t TraceCtrlFlag() {
+    return (GetKeyState(VK_CONTROL) & 0x8000) ? InputTrace::FLAG_CTRL : 0;
+}
+
+#ifdef MPS_TRACE_EVENTS
+// Timeline names for input messages; painting is traced by phase instead
+static const char* InputMessageName(UINT message) {
+    switch (message) {
+        case WM_LBUTTONDOWN: return "WM_LBUTTONDOWN";
+        case WM_MOUSEMOVE:   return "WM_MOUSEMOVE";
+        case WM_LBUTTONUP:   return "WM_LBUTTONUP";
+        case WM_RBUTTONDOWN: return "WM_RBUTTONDOWN";
+        case WM_MOUSEWHEEL:  return "WM_MOUSEWHEEL";
+        case WM_KEYDOWN:     return "WM_KEYDOWN";
+        case WM_COMMAND:     return "WM_COMMAND";
+        case WM_SIZE:        return "WM_SIZE";
+        case WM_TIMER:       return "WM_TIMER";
+        default:             return nullptr;
+    }
+}
+#endif
 
 // Forward declaration for main window procedure
 LRESULT CALLBACK WindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
+    TRACE_SCOPE(TraceEvents::CAT_INPUT, InputMessageName(message));
     switch (message)
     {
         case WM_PAINT:
@@ -15,15 +53,22 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM
             break;
             
         case WM_LBUTTONDOWN:
+            FrameProfiler::InputArrived();
+            InputTrace::Record(InputTrace::EVENT_BUTTON_DOWN, LOWORD(lParam), HIWORD(lParam));
             EventHandler::OnLeftButtonDown(hwnd, LOWORD(lParam), HIWORD(lParam));
             break;
             
         case WM_MOUSEMOVE:
+            FrameProfiler::InputArrived();
+            InputTrace::Record(InputTrace::EVENT_MOUSE_MOVE, LOWORD(lParam), HIWORD(lParam), 0,
+                               (wParam & MK_LBUTTON) ? InputTrace::FLAG_LBUTTON : 0);
             EventHandler::OnMouseMove(hwnd, wParam, LOWORD(lParam), HIWORD(lParam));
             EventHandler::OnMouseHover(hwnd, LOWORD(lParam), HIWORD(lParam));
             break;
             
         case WM_LBUTTONUP:
+            FrameProfiler::InputArrived();
+            InputTrace::Record(InputTrace::EVENT_BUTTON_UP, LOWORD(lParam), HIWORD(lParam));
             EventHandler::OnLeftButtonUp(hwnd, LOWORD(lParam), HIWORD(lParam));
             break;
             
@@ -32,22 +77,54 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM
             break;
             
         case WM_MOUSEWHEEL:
+            InputTrace::Record(InputTrace::EVENT_MOUSE_WHEEL, 0, 0, GET_WHEEL_DELTA_WPARAM(wParam), TraceCtrlFlag());
             EventHandler::OnMouseWheel(hwnd, wParam, lParam);
             break;
             
         case WM_KEYDOWN:
+            InputTrace::Record(InputTrace::EVENT_KEY_DOWN, 0, 0, (int)wParam, TraceCtrlFlag());
             EventHandler::OnKeyDown(hwnd, wParam);
             break;
             
         case WM_COMMAND:
+            InputTrace::Record(InputTrace::EVENT_COMMAND, 0, 0, LOWORD(wParam));
             EventHandler::OnCommand(hwnd, wParam);
             break;
             
         case WM_SIZE:
+            InputTrace::Record(InputTrace::EVENT_RESIZE, LOWORD(lParam), HIWORD(lParam));
             EventHandler::OnSize(hwnd, wParam, lParam);
             break;
             
+        case WM_TIMER:
+            EventHandler::OnTimer(hwnd, wParam);
+            break;
+            
+        case WM_ENTERSIZEMOVE:
+        case WM_ENTERMENULOOP:
+            EventHandler::OnEnterModalLoop(hwnd);
+            break;
+            
+        case WM_EXITSIZEMOVE:
+        case WM_EXITMENULOOP:
+            EventHandler::OnExitModalLoop(hwnd);
+            break;
+            
+        case WM_ENGINE_PUBLISHED:
+            EventHandler::OnEnginePublished(hwnd);
+            break;
+            
+        case WM_JOBS_CHANGED:
+            EventHandler::OnJobsChanged(hwnd);
+            break;
+            
         case WM_DESTROY:
+            KillTimer(hwnd, IDT_AUTOSAVE);
+            KillTimer(hwnd, IDT_PRESENT);
+            InputTrace::StopRecording();
+            JobPool::Stop();        // Cancels running exports, which remove their partial files
+            EngineThread::Stop();   // Applies and journals everything queued
+            DocumentJournal::CloseDocument();
             PostQuitMessage(0);
             break;
             
@@ -59,6 +136,29 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM
 
 namespace EventHandler {
 
+// The gesture in progress as the UI sees it. The document side (AppState's
+// drawing state) belongs to the engine thread; the XOR and brush previews are
+// drawn from this copy.
+struct Gesture {
+    bool active = false;
+    ToolType tool = TOOL_BRUSH;
+    COLORREF color = RGB(0, 0, 0);
+    int brushSize = 1;
+    int startX = 0, startY = 0;        // World coordinates
+    int currentX = 0, currentY = 0;
+    StrokeFilter::Filter filter;       // Brush strokes, in client coordinates
+    bool hasTail = false;              // Predicted tail from current to tail
+    int tailX = 0, tailY = 0;
+};
+
+const double MAX_TAIL_PIXELS = 48.0;
+
+static Gesture gesture;
+
+static bool IsShapeTool(ToolType tool) {
+    return tool == TOOL_RECTANGLE || tool == TOOL_CIRCLE || tool == TOOL_LINE;
+}
+
 // Helper functions for coordinate transformation
 static int ScreenToWorldX(int screenX, const AppState& app) {
     return (int)((screenX - app.panX) / app.zoomLevel);
@@ -76,6 +176,11 @@ static int WorldToScreenY(int worldY, const AppState& app) {
     return (int)(worldY * app.zoomLevel + app.panY + TOOLBAR_HEIGHT);
 }
 
+// Repaints are paced by the frame scheduler; the message loop presents them
+static void ScheduleRepaint(const RECT& rect) {
+    FrameScheduler::Invalidate({(int)rect.left, (int)rect.top, (int)rect.right, (int)rect.bottom});
+}
+
 // Helper function to invalidate only the necessary parts
 static void InvalidateCanvas(HWND hwnd) {
     RECT clientRect;
@@ -86,23 +191,302 @@ static void InvalidateCanvas(HWND hwnd) {
         clientRect.right, 
         clientRect.bottom - STATUSBAR_HEIGHT
     };
-    InvalidateRect(hwnd, &canvasRect, FALSE);
+    ScheduleRepaint(canvasRect);
 }
 
 static void InvalidateToolbar(HWND hwnd) {
     RECT toolbarRect = {0, 0, 9999, TOOLBAR_HEIGHT};
-    InvalidateRect(hwnd, &toolbarRect, FALSE);
+    ScheduleRepaint(toolbarRect);
 }
 
 static void InvalidateStatusBar(HWND hwnd) {
     RECT clientRect;
     GetClientRect(hwnd, &clientRect);
     RECT statusRect = {0, clientRect.bottom - STATUSBAR_HEIGHT, clientRect.right, clientRect.bottom};
-    InvalidateRect(hwnd, &statusRect, FALSE);
+    ScheduleRepaint(statusRect);
+}
+
+// Repaints a document-space area, clipped to the canvas
+static void InvalidateDamage(HWND hwnd, const DrawingEngine::Damage& damage) {
+    AppState& app = AppState::Instance();
+    RECT clientRect;
+    GetClientRect(hwnd, &clientRect);
+    // A pixel of slack for pen widths rounded up at this zoom
+    int left = std::max(0, WorldToScreenX(damage.left, app) - 1);
+    int top = std::max(TOOLBAR_HEIGHT, WorldToScreenY(damage.top, app) - 1);
+    int right = std::min((int)clientRect.right, WorldToScreenX(damage.right, app) + 1);
+    int bottom = std::min((int)clientRect.bottom - STATUSBAR_HEIGHT, WorldToScreenY(damage.bottom, app) + 1);
+    if (right > left && bottom > top) {
+        RECT damageRect = {left, top, right, bottom};
+        ScheduleRepaint(damageRect);
+    }
+}
+
+// Windows coalesces WM_MOUSEMOVE while the queue is busy; its move history
+// still has the positions in between. Fills points with those since the last
+// move handled, oldest first and ending at (x, y), in client coordinates.
+struct MoveHistory {
+    DWORD time = 0;
+    int screenX = 0, screenY = 0;      // Display coordinates, as the history has them
+};
+
+static MoveHistory lastMove;
+
+static void ResetMoveHistory(HWND hwnd, int x, int y) {
+    POINT screen = {x, y};
+    ClientToScreen(hwnd, &screen);
+    lastMove.time = GetMessageTime();
+    lastMove.screenX = screen.x;
+    lastMove.screenY = screen.y;
+}
+
+static size_t PendingMovePoints(HWND hwnd, int x, int y, POINT* points, uint64_t* micros, size_t capacity) {
+    const int HISTORY = 64;
+    POINT screen = {x, y};
+    ClientToScreen(hwnd, &screen);
+    MOUSEMOVEPOINT current = {};
+    current.x = screen.x & 0xFFFF;
+    current.y = screen.y & 0xFFFF;
+    current.time = GetMessageTime();
+    MOUSEMOVEPOINT history[HISTORY];
+    int found = GetMouseMovePointsEx(sizeof(MOUSEMOVEPOINT), &current, history, HISTORY, GMMP_USE_DISPLAY_POINTS);
+    
+    // history[0] is this move; walk back, newest first, to the last one handled
+    size_t count = 0;
+    for (int i = 1; i < found && count + 1 < capacity; i++) {
+        int historyX = history[i].x > 32767 ? history[i].x - 65536 : history[i].x;
+        int historyY = history[i].y > 32767 ? history[i].y - 65536 : history[i].y;
+        if (history[i].time < lastMove.time ||
+            (history[i].time == lastMove.time && historyX == lastMove.screenX && historyY == lastMove.screenY)) {
+            break;
+        }
+        POINT point = {historyX, historyY};
+        ScreenToClient(hwnd, &point);
+        micros[count] = (uint64_t)history[i].time * 1000;
+        points[count++] = point;
+    }
+    std::reverse(points, points + count);
+    std::reverse(micros, micros + count);
+    points[count].x = x;
+    points[count].y = y;
+    micros[count] = (uint64_t)current.time * 1000;
+    
+    lastMove.time = current.time;
+    lastMove.screenX = screen.x;
+    lastMove.screenY = screen.y;
+    return count + 1;
+}
+
+// The predicted tail is painted over the document and never stored
+static void InvalidateStrokeTail(const AppState& app) {
+    if (!gesture.hasTail) {
+        return;
+    }
+    int radius = (int)(gesture.brushSize * app.zoomLevel) / 2 + 2;
+    int fromX = WorldToScreenX(gesture.currentX, app);
+    int fromY = WorldToScreenY(gesture.currentY, app);
+    int toX = WorldToScreenX(gesture.tailX, app);
+    int toY = WorldToScreenY(gesture.tailY, app);
+    RECT tailRect = {
+        std::min(fromX, toX) - radius,
+        std::max(std::min(fromY, toY) - radius, TOOLBAR_HEIGHT),
+        std::max(fromX, toX) + radius + 1,
+        std::max(fromY, toY) + radius + 1
+    };
+    ScheduleRepaint(tailRect);
+}
+
+// Replaces the tail (already invalidated) with one to where the filter
+// expects the pen a frame from now
+static void UpdateStrokeTail(const AppState& app) {
+    gesture.hasTail = false;
+    if (!app.predictStrokeTail || gesture.tool != TOOL_BRUSH) {
+        return;
+    }
+    StrokeFilter::Position ahead = StrokeFilter::Predict(gesture.filter, FrameScheduler::CurrentInterval(), MAX_TAIL_PIXELS);
+    gesture.tailX = ScreenToWorldX((int)std::lround(ahead.x), app);
+    gesture.tailY = ScreenToWorldY((int)std::lround(ahead.y), app);
+    gesture.hasTail = gesture.tailX != gesture.currentX || gesture.tailY != gesture.currentY;
+    InvalidateStrokeTail(app);
+}
+
+// After a document command: the engine's publish repaints once it has applied
+// it; inline, it already has
+static void InvalidateDocument(HWND hwnd) {
+    if (!EngineThread::IsRunning()) {
+        FrameScheduler::InvalidateAll();
+    }
+}
+
+typedef std::function<bool(const DrawingEngine::DocumentCopy& document, const std::string& filename,
+                           const DrawingEngine::ExportProgress& progress)> ExportJob;
+
+// Hands use the document as of every command posted so far, once the engine
+// has published it: that version is pinned rather than the points copied
+static void WithPinnedDocument(std::function<void(const DocumentVersion::Points&)> use) {
+    EngineThread::Run(nullptr, [use](bool, const EngineThread::Snapshot& snapshot) { use(snapshot.points); });
+}
+
+// A job's name in the status bar
+static std::string JobName(const std::string& filename) {
+    size_t slash = filename.find_last_of("\\/");
+    return (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+}
+
+// The engine's file progress, reported to the job and cancelled from it
+static DrawingEngine::ExportProgress JobProgress(const JobPool::Progress& progress) {
+    return [&progress](double fraction) {
+        progress.Report(fraction);
+        return !progress.Cancelled();
+    };
+}
+
+// Image exports run on the job pool against a copy of the document, so the
+// window stays live and several can run at once; the status bar shows their
+// progress and a failure is reported when the job completes
+static void SubmitExport(HWND hwnd, const std::string& filename, ExportJob exportJob) {
+    WithPinnedDocument([hwnd, filename, exportJob](const DocumentVersion::Points& points) {
+        std::shared_ptr<const DrawingEngine::DocumentCopy> document = DrawingEngine::CopyDocument(points);
+        JobPool::Submit(JobName(filename),
+            [document, filename, exportJob](const JobPool::Progress& progress) {
+                return exportJob(*document, filename, JobProgress(progress));
+            },
+            [hwnd](JobPool::Result result) {
+                if (result == JobPool::JOB_FAILED) {
+                    MessageBox(hwnd, L"Failed to export file!", L"Error", MB_OK | MB_ICONERROR);
+                }
+            });
+        InvalidateStatusBar(hwnd);
+    });
+}
+
+// Native saves and opens replace the document or its file when they
+// complete, so one runs at a time; saves, opens and New Canvas asked for
+// meanwhile wait their turn, in order
+static bool fileJobPending = false;
+static std::deque<std::function<void()>> waitingFileJobs;
+
+static void RunFileJob(std::function<void()> start) {
+    if (fileJobPending) {
+        waitingFileJobs.push_back(std::move(start));
+    } else {
+        start();
+    }
+}
+
+// After the finished job has posted its engine task, so the next one's lands behind it
+static void FileJobDone() {
+    fileJobPending = false;
+    if (!JobPool::IsRunning()) {
+        waitingFileJobs.clear();   // Shutting down
+    }
+    while (!fileJobPending && !waitingFileJobs.empty()) {
+        std::function<void()> start = std::move(waitingFileJobs.front());
+        waitingFileJobs.pop_front();
+        start();
+    }
+}
+
+// Native saves write a pinned version on the job pool to a file of their
+// own, which replaces the document's file when the job completes; the
+// journal picks up from there with whatever was drawn meanwhile
+static void ReportSaved(HWND hwnd, bool saved) {
+    if (saved) {
+        MessageBox(hwnd, L"File saved successfully!", L"Save", MB_OK | MB_ICONINFORMATION);
+    } else {
+        MessageBox(hwnd, L"Failed to save file!", L"Error", MB_OK | MB_ICONERROR);
+    }
+}
+
+static void SubmitSave(HWND hwnd, const std::string& filename) {
+    fileJobPending = true;
+    WithPinnedDocument([hwnd, filename](const DocumentVersion::Points& points) {
+        std::shared_ptr<const DocumentVersion::Points> pinned = std::make_shared<const DocumentVersion::Points>(points);
+        std::string savedPath = filename + ".saving";
+        JobPool::Submit(JobName(filename),
+            [pinned, savedPath](const JobPool::Progress& progress) {
+                return DrawingEngine::SaveDrawing(*pinned, savedPath, JobProgress(progress));
+            },
+            [hwnd, pinned, savedPath, filename](JobPool::Result result) {
+                // The engine takes the file over in order with the strokes drawn
+                // meanwhile; a cancelled worker removed its file
+                if (result == JobPool::JOB_SUCCEEDED) {
+                    EngineThread::Run(
+                        [pinned, savedPath, filename]() { return DocumentJournal::FinishSave(savedPath, filename, *pinned); },
+                        [hwnd](bool saved, const EngineThread::Snapshot&) { ReportSaved(hwnd, saved); });
+                }
+                FileJobDone();
+                if (result == JobPool::JOB_FAILED) {
+                    ReportSaved(hwnd, false);
+                }
+            });
+        InvalidateStatusBar(hwnd);
+    });
+}
+
+// Opening decodes the file (and replays its journal) on the job pool into a
+// list of its own, which takes the open document's place when the job
+// completes; until then the open document stays editable
+static void SubmitOpen(HWND hwnd, const std::string& filename) {
+    struct Loaded {
+        std::vector<DrawPoint> points;
+        uint64_t generation = 0;
+        size_t recovered = 0;
+    };
+    std::shared_ptr<Loaded> loaded = std::make_shared<Loaded>();
+    fileJobPending = true;
+    JobPool::Submit(JobName(filename),
+        [loaded, filename](const JobPool::Progress& progress) {
+            return DocumentJournal::ReadDocument(filename, loaded->points, loaded->generation, &loaded->recovered,
+                                                 JobProgress(progress));
+        },
+        [hwnd, loaded, filename](JobPool::Result result) {
+            if (result != JobPool::JOB_SUCCEEDED) {
+                FileJobDone();
+                if (result == JobPool::JOB_FAILED) {
+                    MessageBox(hwnd, L"Failed to load file!", L"Error", MB_OK | MB_ICONERROR);
+                }
+                return;
+            }
+            EngineThread::Run(
+                [loaded, filename]() {
+                    return DocumentJournal::FinishOpen(filename, loaded->points, loaded->generation, loaded->recovered);
+                },
+                [hwnd, loaded](bool opened, const EngineThread::Snapshot&) {
+                    if (!opened) {
+                        MessageBox(hwnd, L"Failed to load file!", L"Error", MB_OK | MB_ICONERROR);
+                        return;
+                    }
+                    FrameScheduler::InvalidateAll();
+                    if (loaded->recovered > 0) {
+                        MessageBox(hwnd, L"File loaded successfully!\n\nUnsaved changes from a previous session were recovered.",
+                                   L"Open", MB_OK | MB_ICONINFORMATION);
+                    } else {
+                        MessageBox(hwnd, L"File loaded successfully!", L"Open", MB_OK | MB_ICONINFORMATION);
+                    }
+                });
+            FileJobDone();
+        });
+    InvalidateStatusBar(hwnd);
+}
+
+// The document a frame paints: the engine's latest snapshot, held for the
+// frame, or a version of the live points when the engine runs inline
+static const DocumentVersion::Points& PaintedPoints(std::shared_ptr<const EngineThread::Snapshot>& snapshot) {
+    snapshot = EngineThread::Latest();
+    if (snapshot) {
+        EngineThread::ReportApplied(*snapshot);
+        return snapshot->points;
+    }
+    static DocumentVersion::Points inlinePoints;
+    inlinePoints = DocumentVersion::Build(AppState::Instance().drawingPoints, inlinePoints);
+    return inlinePoints;
 }
 
 void OnPaint(HWND hwnd)
 {
+    TRACE_SCOPE(TraceEvents::CAT_PAINT, "WM_PAINT");
+    uint64_t paintStart = FrameProfiler::NowMicros();
     PAINTSTRUCT ps;
     HDC hdc = BeginPaint(hwnd, &ps);
     
@@ -119,18 +503,60 @@ void OnPaint(HWND hwnd)
     }
     
     EndPaint(hwnd, &ps);
+    FrameScheduler::FramePresented(FrameProfiler::NowMicros() - paintStart);
+}
+
+void PresentFrame(HWND hwnd)
+{
+    FrameScheduler::Frame frame;
+    if (!FrameScheduler::TakeFrame(frame)) {
+        return;
+    }
+    
+    if (frame.whole) {
+        InvalidateRect(hwnd, NULL, FALSE);
+    }
+    for (size_t i = 0; i < frame.count; i++) {
+        const FrameScheduler::Rect& damage = frame.rects[i];
+        RECT rect = {damage.left, damage.top, damage.right, damage.bottom};
+        InvalidateRect(hwnd, &rect, FALSE);
+    }
+    UpdateWindow(hwnd);   // Paints now, while the frame is due
+}
+
+// Set between WM_ENTERSIZEMOVE/WM_ENTERMENULOOP and the matching exit, while
+// the modal loop runs instead of main's, which is the one that presents frames
+static bool inModalLoop = false;
+
+void OnEnterModalLoop(HWND hwnd)
+{
+    inModalLoop = true;
+    UINT interval = (UINT)((FrameScheduler::CurrentInterval() + 999) / 1000);
+    SetTimer(hwnd, IDT_PRESENT, interval, NULL);
+}
+
+void OnExitModalLoop(HWND hwnd)
+{
+    inModalLoop = false;
+    KillTimer(hwnd, IDT_PRESENT);
 }
 
 void OnPaintGPU(HWND hwnd, RECT clientRect)
 {
     AppState& app = AppState::Instance();
+    FrameProfiler::BeginFrame(true);
+    std::shared_ptr<const EngineThread::Snapshot> snapshot;
+    const DocumentVersion::Points& points = PaintedPoints(snapshot);
     
     // Begin GPU rendering
-    GPURenderer::GPURenderingEngine::BeginDraw();
-    
-    // Clear background with GPU
-    COLORREF bgColor = (app.currentTheme == THEME_LIGHT) ? RGB(255, 255, 255) : RGB(30, 30, 30);
-    GPURenderer::GPURenderingEngine::Clear(bgColor);
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_CLEAR);
+        GPURenderer::GPURenderingEngine::BeginDraw();
+        
+        // Clear background with GPU
+        COLORREF bgColor = (app.currentTheme == THEME_LIGHT) ? RGB(255, 255, 255) : RGB(30, 30, 30);
+        GPURenderer::GPURenderingEngine::Clear(bgColor);
+    }
     
     // Set up zoom and pan transform
     D2D1_MATRIX_3X2_F transform = D2D1::Matrix3x2F::Scale(app.zoomLevel, app.zoomLevel) *
@@ -139,46 +565,105 @@ void OnPaintGPU(HWND hwnd, RECT clientRect)
     
     // Draw grid if enabled - GPU accelerated!
     if (app.showGrid) {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_GRID);
         DrawGridGPU(clientRect);
     }
     
-    // Draw all drawing points - GPU accelerated!
-    DrawPointsGPU();
+    // Reference image under the strokes
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_REFERENCE);
+        DrawReferenceGPU();
+    }
     
+    // Draw all drawing points - GPU accelerated!
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_STROKES);
+        DrawPointsGPU(points);
+        
+        // Predicted tail of the stroke in progress, over the document
+        if (gesture.hasTail) {
+            GPURenderer::GPURenderingEngine::DrawLine(
+                (float)gesture.currentX, (float)gesture.currentY,
+                (float)gesture.tailX, (float)gesture.tailY,
+                gesture.color, (float)gesture.brushSize);
+        }
+    }
     
     // Reset transform for UI elements
     GPURenderer::GPURenderingEngine::ResetTransform();
     
     // Draw UI elements - GPU accelerated!
-    UIRenderer::DrawToolbarGPU(clientRect);
-    UIRenderer::DrawStatusBarGPU(clientRect);
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_TOOLBAR);
+        UIRenderer::DrawToolbarGPU(clientRect);
+    }
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_STATUS_BAR);
+        UIRenderer::DrawStatusBarGPU(clientRect);
+    }
     
     // Draw advanced color picker if visible - GPU accelerated!
     if (app.showAdvancedColorPicker) {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_COLOR_PICKER);
         UIRenderer::DrawAdvancedColorPickerGPU(clientRect);
     }
     
-    // End GPU rendering
-    GPURenderer::GPURenderingEngine::EndDraw();
+    if (app.showPerformanceHud) {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_HUD);
+        UIRenderer::DrawPerformanceHudGPU(clientRect);
+    }
+    
+    // End GPU rendering (presents the frame)
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_PRESENT);
+        GPURenderer::GPURenderingEngine::EndDraw();
+    }
+    FrameProfiler::EndFrame((uint32_t)points.size());
 }
 
 void OnPaintSoftware(HDC hdc, RECT clientRect)
 {
     AppState& app = AppState::Instance();
+    FrameProfiler::BeginFrame(false);
+    std::shared_ptr<const EngineThread::Snapshot> snapshot;
+    const DocumentVersion::Points& points = PaintedPoints(snapshot);
     
-    // Double buffering: Create memory DC and bitmap
-    HDC memDC = CreateCompatibleDC(hdc);
-    HBITMAP memBitmap = CreateCompatibleBitmap(hdc, clientRect.right, clientRect.bottom);
-    HBITMAP oldBitmap = (HBITMAP)SelectObject(memDC, memBitmap);
+    // Double buffering: a top-down 32bpp DIB section, so strokes can be
+    // stamped straight into its pixels and GDI draws everything else
+    HDC memDC;
+    HBITMAP memBitmap, oldBitmap;
+    uint32_t* backPixels = nullptr;
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_CLEAR);
+        memDC = CreateCompatibleDC(hdc);
+        BITMAPINFO backInfo = {};
+        backInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        backInfo.bmiHeader.biWidth = clientRect.right;
+        backInfo.bmiHeader.biHeight = -clientRect.bottom;
+        backInfo.bmiHeader.biPlanes = 1;
+        backInfo.bmiHeader.biBitCount = 32;
+        backInfo.bmiHeader.biCompression = BI_RGB;
+        void* bits = nullptr;
+        memBitmap = CreateDIBSection(hdc, &backInfo, DIB_RGB_COLORS, &bits, NULL, 0);
+        backPixels = (uint32_t*)bits;
+        oldBitmap = (HBITMAP)SelectObject(memDC, memBitmap);
+        
+        // Clear background on memory DC
+        COLORREF bgColor = (app.currentTheme == THEME_LIGHT) ? RGB(255, 255, 255) : RGB(30, 30, 30);
+        HBRUSH bgBrush = CreateSolidBrush(bgColor);
+        FillRect(memDC, &clientRect, bgBrush);
+        DeleteObject(bgBrush);
+    }
     
-    // Clear background on memory DC
-    COLORREF bgColor = (app.currentTheme == THEME_LIGHT) ? RGB(255, 255, 255) : RGB(30, 30, 30);
-    HBRUSH bgBrush = CreateSolidBrush(bgColor);
-    FillRect(memDC, &clientRect, bgBrush);
-    DeleteObject(bgBrush);
+    // Reference image under the grid and strokes
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_REFERENCE);
+        DrawReferenceSoftware(memDC);
+    }
     
     // Draw grid if enabled
     if (app.showGrid) {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_GRID);
         HPEN gridPen = CreatePen(PS_SOLID, 1, RGB(200, 200, 200));
         HPEN oldPen = (HPEN)SelectObject(memDC, gridPen);
         
@@ -196,91 +681,85 @@ void OnPaintSoftware(HDC hdc, RECT clientRect)
         DeleteObject(gridPen);
     }
     
-    // Draw all drawing points with smooth lines
-    if (!app.drawingPoints.empty()) {
-        DrawPoint* prevPoint = nullptr;
+    // Stamp every stroke with the cached brush masks the exports use, straight
+    // into the back buffer; no GDI objects per stroke or per stamp
+    if (!points.empty() && backPixels) {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_STROKES);
+        GdiFlush(); // Finish the GDI fills before touching the pixels
+        const DrawPoint* prevPoint = nullptr;
+        double carried = 0.0;
         
-        for (size_t i = 0; i < app.drawingPoints.size(); i++) {
-            const DrawPoint& point = app.drawingPoints[i];
+        for (size_t i = 0; i < points.size(); i++) {
+            const DrawPoint& point = points[i];
+            // DIB pixels are B | G << 8 | R << 16
+            uint32_t pixel = GetBValue(point.color) | (GetGValue(point.color) << 8) |
+                             ((uint32_t)GetRValue(point.color) << 16) | 0xFF000000u;
+            auto stamp = [&](double x, double y) {
+                RasterRenderer::StampBrush(backPixels, clientRect.right, clientRect.bottom,
+                                           x * app.zoomLevel + app.panX, y * app.zoomLevel + app.panY + TOOLBAR_HEIGHT,
+                                           point.brushSize, app.zoomLevel, pixel);
+            };
             
             if (point.isStart) {
-                // Start new stroke - just remember this point
-                prevPoint = const_cast<DrawPoint*>(&point);
+                stamp(point.x, point.y);
+                prevPoint = &point;
+                carried = 0.0;
             } else if (prevPoint != nullptr) {
-                // Apply zoom and pan transformations
-                int prevX = (int)(prevPoint->x * app.zoomLevel + app.panX);
-                int prevY = (int)(prevPoint->y * app.zoomLevel + app.panY + TOOLBAR_HEIGHT);
-                int currX = (int)(point.x * app.zoomLevel + app.panX);
-                int currY = (int)(point.y * app.zoomLevel + app.panY + TOOLBAR_HEIGHT);
-                int scaledBrushSize = (int)(point.brushSize * app.zoomLevel);
-                
-                // Draw line from previous point to current point with brush size
-                HPEN strokePen = CreatePen(PS_SOLID, scaledBrushSize, point.color);
-                HPEN oldPen = (HPEN)SelectObject(memDC, strokePen);
-                
-                // Draw thick line between points
-                MoveToEx(memDC, prevX, prevY, NULL);
-                LineTo(memDC, currX, currY);
-                
-                // Draw circular brush at current point for smooth appearance
-                HBRUSH pointBrush = CreateSolidBrush(point.color);
-                HBRUSH oldBrush = (HBRUSH)SelectObject(memDC, pointBrush);
-                SelectObject(memDC, GetStockObject(NULL_PEN)); // No outline
-                
-                Ellipse(memDC, 
-                        currX - scaledBrushSize/2, 
-                        currY - scaledBrushSize/2,
-                        currX + scaledBrushSize/2, 
-                        currY + scaledBrushSize/2);
-                
-                SelectObject(memDC, oldBrush);
-                DeleteObject(pointBrush);
-                SelectObject(memDC, oldPen);
-                DeleteObject(strokePen);
-                
-                prevPoint = const_cast<DrawPoint*>(&point);
-            }
-        }
-        
-        // Draw starting points that don't have connections
-        for (const DrawPoint& point : app.drawingPoints) {
-            if (point.isStart) {
-                // Apply zoom and pan transformations
-                int x = (int)(point.x * app.zoomLevel + app.panX);
-                int y = (int)(point.y * app.zoomLevel + app.panY + TOOLBAR_HEIGHT);
-                int scaledBrushSize = (int)(point.brushSize * app.zoomLevel);
-                
-                HBRUSH pointBrush = CreateSolidBrush(point.color);
-                HBRUSH oldBrush = (HBRUSH)SelectObject(memDC, pointBrush);
-                SelectObject(memDC, GetStockObject(NULL_PEN)); // No outline
-                
-                Ellipse(memDC, 
-                        x - scaledBrushSize/2, 
-                        y - scaledBrushSize/2,
-                        x + scaledBrushSize/2, 
-                        y + scaledBrushSize/2);
-                
-                SelectObject(memDC, oldBrush);
-                DeleteObject(pointBrush);
+                // Zoomed far out the document spacing falls under a device
+                // pixel; stamp at most once per pixel of screen travel
+                double spacing = std::max(BrushStamps::Spacing(point.brushSize), 1.0 / app.zoomLevel);
+                carried = BrushStamps::WalkSegment(prevPoint->x, prevPoint->y, point.x, point.y,
+                                                   spacing, carried, stamp);
+                if (BrushStamps::EndsStroke(points, i) && carried > 0.0) {
+                    stamp(point.x, point.y);
+                }
+                prevPoint = &point;
             }
         }
     }
     
+    // Predicted tail of the stroke in progress, over the document
+    if (gesture.hasTail) {
+        int scaledBrushSize = std::max(1, (int)(gesture.brushSize * app.zoomLevel));
+        HPEN tailPen = CreatePen(PS_SOLID, scaledBrushSize, gesture.color);
+        HPEN oldPen = (HPEN)SelectObject(memDC, tailPen);
+        MoveToEx(memDC, WorldToScreenX(gesture.currentX, app), WorldToScreenY(gesture.currentY, app), NULL);
+        LineTo(memDC, WorldToScreenX(gesture.tailX, app), WorldToScreenY(gesture.tailY, app));
+        SelectObject(memDC, oldPen);
+        DeleteObject(tailPen);
+    }
+    
     // Draw UI elements on memory DC
-    UIRenderer::DrawToolbar(memDC, clientRect);
-    UIRenderer::DrawStatusBar(memDC, clientRect);
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_TOOLBAR);
+        UIRenderer::DrawToolbar(memDC, clientRect);
+    }
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_STATUS_BAR);
+        UIRenderer::DrawStatusBar(memDC, clientRect);
+    }
     
     if (app.showAdvancedColorPicker) {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_COLOR_PICKER);
         UIRenderer::DrawAdvancedColorPicker(memDC);
     }
     
+    if (app.showPerformanceHud) {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_HUD);
+        UIRenderer::DrawPerformanceHud(memDC, clientRect);
+    }
+    
     // Blit the memory DC to the screen DC (eliminates flicker!)
-    BitBlt(hdc, 0, 0, clientRect.right, clientRect.bottom, memDC, 0, 0, SRCCOPY);
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_PRESENT);
+        BitBlt(hdc, 0, 0, clientRect.right, clientRect.bottom, memDC, 0, 0, SRCCOPY);
+    }
     
     // Clean up double buffering resources
     SelectObject(memDC, oldBitmap);
     DeleteObject(memBitmap);
     DeleteDC(memDC);
+    FrameProfiler::EndFrame((uint32_t)points.size());
 }
 
 void OnLeftButtonDown(HWND hwnd, int x, int y)
@@ -312,7 +791,7 @@ void OnLeftButtonDown(HWND hwnd, int x, int y)
             InvalidateStatusBar(hwnd);
         } else if (x >= 750 && x <= 820) { // Theme toggle
             app.currentTheme = (app.currentTheme == THEME_LIGHT) ? THEME_DARK : THEME_LIGHT;
-            InvalidateRect(hwnd, NULL, FALSE); // Theme affects entire screen - keep full redraw
+            FrameScheduler::InvalidateAll(); // Theme affects entire screen - keep full redraw
         }
     } else if (app.showAdvancedColorPicker && 
                x >= app.pickerX && x <= app.pickerX + 200 && 
@@ -331,7 +810,7 @@ void OnLeftButtonDown(HWND hwnd, int x, int y)
             
             COLORREF newColor = DrawingEngine::HSVtoRGB(angle, saturation, 0.9f);
             DrawingEngine::SetColor(newColor);
-            InvalidateRect(hwnd, NULL, FALSE);
+            FrameScheduler::InvalidateAll();
         }
     } else {
         // Start drawing on canvas
@@ -382,8 +861,18 @@ void OnLeftButtonDown(HWND hwnd, int x, int y)
                 // Transform screen coordinates to world coordinates
                 int worldX = ScreenToWorldX(x, app);
                 int worldY = ScreenToWorldY(y, app);
-                DrawingEngine::StartDrawing(worldX, worldY);
-                InvalidateCanvas(hwnd);
+                StrokeSettings settings = DrawingEngine::CurrentStrokeSettings();
+                gesture.active = true;
+                gesture.tool = settings.tool;
+                gesture.color = settings.color;
+                gesture.brushSize = settings.brushSize;
+                gesture.startX = gesture.currentX = worldX;
+                gesture.startY = gesture.currentY = worldY;
+                gesture.hasTail = false;
+                ResetMoveHistory(hwnd, x, y);
+                StrokeFilter::Reset(gesture.filter, x, y, (uint64_t)GetMessageTime() * 1000);
+                EngineThread::StartDrawing(worldX, worldY, settings);
+                InvalidateDocument(hwnd);
             }
         }
     }
@@ -397,35 +886,50 @@ void OnMouseMove(HWND hwnd, WPARAM wParam, int x, int y)
         if (y > TOOLBAR_HEIGHT && y < clientRect.bottom - STATUSBAR_HEIGHT) {
             AppState& app = AppState::Instance();
             
-            if (app.currentTool == TOOL_BRUSH || app.currentTool == TOOL_ERASER) {
-                // Transform screen coordinates to world coordinates
-                int worldX = ScreenToWorldX(x, app);
-                int worldY = ScreenToWorldY(y, app);
-                DrawingEngine::ContinueDrawing(worldX, worldY);
-                
-                // Invalidate only a small area around the drawing point (in screen space)
-                int scaledBrushSize = (int)(app.brushSize * app.zoomLevel);
-                RECT updateRect = {
-                    x - scaledBrushSize - 5, y - scaledBrushSize - 5,
-                    x + scaledBrushSize + 5, y + scaledBrushSize + 5
-                };
-                InvalidateRect(hwnd, &updateRect, FALSE);
-            } else if (app.currentTool == TOOL_RECTANGLE || app.currentTool == TOOL_CIRCLE || app.currentTool == TOOL_LINE) {
+            if (gesture.active && (gesture.tool == TOOL_BRUSH || gesture.tool == TOOL_ERASER)) {
+                // Every position since the last message, in world coordinates;
+                // brush positions pass through the smoothing filter as they come
+                const size_t MAX_MOVES = 64;
+                POINT moves[MAX_MOVES];
+                uint64_t times[MAX_MOVES];
+                DrawingEngine::StrokePoint points[MAX_MOVES];
+                size_t count = PendingMovePoints(hwnd, x, y, moves, times, MAX_MOVES);
+                for (size_t i = 0; i < count; i++) {
+                    if (gesture.tool == TOOL_BRUSH) {
+                        StrokeFilter::Position smoothed = StrokeFilter::Apply(gesture.filter, moves[i].x, moves[i].y, times[i]);
+                        if (app.smoothStrokes) {
+                            moves[i].x = (int)std::lround(smoothed.x);
+                            moves[i].y = (int)std::lround(smoothed.y);
+                        }
+                    }
+                    points[i].x = ScreenToWorldX(moves[i].x, app);
+                    points[i].y = ScreenToWorldY(moves[i].y, app);
+                }
+                InvalidateStrokeTail(app);   // Drawn from the old current point
+                gesture.currentX = points[count - 1].x;
+                gesture.currentY = points[count - 1].y;
+                EngineThread::ContinueDrawing(points, count);
+                UpdateStrokeTail(app);
+                InvalidateDocument(hwnd);
+            } else if (gesture.active && IsShapeTool(gesture.tool)) {
                 // For shapes, update preview coordinates but use XOR drawing to avoid flashing
-                int oldX = app.drawCurrentX;
-                int oldY = app.drawCurrentY;
+                int oldX = gesture.currentX;
+                int oldY = gesture.currentY;
                 int worldX = ScreenToWorldX(x, app);
                 int worldY = ScreenToWorldY(y, app);
-                DrawingEngine::ContinueDrawing(worldX, worldY);
+                gesture.currentX = worldX;
+                gesture.currentY = worldY;
+                FrameProfiler::TakeArrivingInput();   // The preview below is not a frame
+                EngineThread::ContinueDrawing(worldX, worldY);
                 
                 // Use direct drawing with XOR for preview (no invalidate needed)
                 // Convert world coordinates to screen coordinates for XOR drawing
-                int screenStartX = WorldToScreenX(app.drawStartX, app);
-                int screenStartY = WorldToScreenY(app.drawStartY, app);
+                int screenStartX = WorldToScreenX(gesture.startX, app);
+                int screenStartY = WorldToScreenY(gesture.startY, app);
                 int screenOldX = WorldToScreenX(oldX, app);
                 int screenOldY = WorldToScreenY(oldY, app);
-                int screenNewX = WorldToScreenX(app.drawCurrentX, app);
-                int screenNewY = WorldToScreenY(app.drawCurrentY, app);
+                int screenNewX = WorldToScreenX(gesture.currentX, app);
+                int screenNewY = WorldToScreenY(gesture.currentY, app);
                 
                 HDC hdc = GetDC(hwnd);
                 SetROP2(hdc, R2_XORPEN);
@@ -433,37 +937,37 @@ void OnMouseMove(HWND hwnd, WPARAM wParam, int x, int y)
                 HPEN oldPen = (HPEN)SelectObject(hdc, xorPen);
                 
                 // Erase old preview
-                if (app.currentTool == TOOL_RECTANGLE) {
+                if (gesture.tool == TOOL_RECTANGLE) {
                     HBRUSH nullBrush = (HBRUSH)GetStockObject(NULL_BRUSH);
                     HBRUSH oldBrush = (HBRUSH)SelectObject(hdc, nullBrush);
                     Rectangle(hdc, screenStartX, screenStartY, screenOldX, screenOldY);
                     SelectObject(hdc, oldBrush);
-                } else if (app.currentTool == TOOL_CIRCLE) {
-                    int oldRadius = (int)(sqrt(pow(oldX - app.drawStartX, 2) + pow(oldY - app.drawStartY, 2)) * app.zoomLevel);
+                } else if (gesture.tool == TOOL_CIRCLE) {
+                    int oldRadius = (int)(sqrt(pow(oldX - gesture.startX, 2) + pow(oldY - gesture.startY, 2)) * app.zoomLevel);
                     HBRUSH nullBrush = (HBRUSH)GetStockObject(NULL_BRUSH);
                     HBRUSH oldBrush = (HBRUSH)SelectObject(hdc, nullBrush);
                     Ellipse(hdc, screenStartX - oldRadius, screenStartY - oldRadius, 
                             screenStartX + oldRadius, screenStartY + oldRadius);
                     SelectObject(hdc, oldBrush);
-                } else if (app.currentTool == TOOL_LINE) {
+                } else if (gesture.tool == TOOL_LINE) {
                     MoveToEx(hdc, screenStartX, screenStartY, NULL);
                     LineTo(hdc, screenOldX, screenOldY);
                 }
                 
                 // Draw new preview
-                if (app.currentTool == TOOL_RECTANGLE) {
+                if (gesture.tool == TOOL_RECTANGLE) {
                     HBRUSH nullBrush = (HBRUSH)GetStockObject(NULL_BRUSH);
                     HBRUSH oldBrush = (HBRUSH)SelectObject(hdc, nullBrush);
                     Rectangle(hdc, screenStartX, screenStartY, screenNewX, screenNewY);
                     SelectObject(hdc, oldBrush);
-                } else if (app.currentTool == TOOL_CIRCLE) {
-                    int newRadius = (int)(sqrt(pow(app.drawCurrentX - app.drawStartX, 2) + pow(app.drawCurrentY - app.drawStartY, 2)) * app.zoomLevel);
+                } else if (gesture.tool == TOOL_CIRCLE) {
+                    int newRadius = (int)(sqrt(pow(gesture.currentX - gesture.startX, 2) + pow(gesture.currentY - gesture.startY, 2)) * app.zoomLevel);
                     HBRUSH nullBrush = (HBRUSH)GetStockObject(NULL_BRUSH);
                     HBRUSH oldBrush = (HBRUSH)SelectObject(hdc, nullBrush);
                     Ellipse(hdc, screenStartX - newRadius, screenStartY - newRadius, 
                             screenStartX + newRadius, screenStartY + newRadius);
                     SelectObject(hdc, oldBrush);
-                } else if (app.currentTool == TOOL_LINE) {
+                } else if (gesture.tool == TOOL_LINE) {
                     MoveToEx(hdc, screenStartX, screenStartY, NULL);
                     LineTo(hdc, screenNewX, screenNewY);
                 }
@@ -483,7 +987,7 @@ void OnMouseMove(HWND hwnd, WPARAM wParam, int x, int y)
         // Handle brush preview for drawing canvas area
         bool inCanvasArea = (y > TOOLBAR_HEIGHT && y < clientRect.bottom - STATUSBAR_HEIGHT);
         
-        if (inCanvasArea && app.currentTool == TOOL_BRUSH && !app.isDrawing) {
+        if (inCanvasArea && app.currentTool == TOOL_BRUSH && !gesture.active) {
             // Get DC for immediate drawing
             HDC hdc = GetDC(hwnd);
             SetROP2(hdc, R2_XORPEN);
@@ -567,31 +1071,31 @@ void OnLeftButtonUp(HWND hwnd, int x, int y)
     AppState& app = AppState::Instance();
     
     // If we were drawing a shape with XOR preview, clear it first
-    if (app.hasPreview && (app.currentTool == TOOL_RECTANGLE || app.currentTool == TOOL_CIRCLE || app.currentTool == TOOL_LINE)) {
+    if (gesture.active && IsShapeTool(gesture.tool)) {
         HDC hdc = GetDC(hwnd);
         SetROP2(hdc, R2_XORPEN);
         HPEN xorPen = CreatePen(PS_SOLID, 1, RGB(255, 255, 255));
         HPEN oldPen = (HPEN)SelectObject(hdc, xorPen);
         
         // Clear the preview by drawing it again (XOR toggles) - use screen coordinates
-        int screenStartX = WorldToScreenX(app.drawStartX, app);
-        int screenStartY = WorldToScreenY(app.drawStartY, app);
-        int screenCurrentX = WorldToScreenX(app.drawCurrentX, app);
-        int screenCurrentY = WorldToScreenY(app.drawCurrentY, app);
+        int screenStartX = WorldToScreenX(gesture.startX, app);
+        int screenStartY = WorldToScreenY(gesture.startY, app);
+        int screenCurrentX = WorldToScreenX(gesture.currentX, app);
+        int screenCurrentY = WorldToScreenY(gesture.currentY, app);
         
-        if (app.currentTool == TOOL_RECTANGLE) {
+        if (gesture.tool == TOOL_RECTANGLE) {
             HBRUSH nullBrush = (HBRUSH)GetStockObject(NULL_BRUSH);
             HBRUSH oldBrush = (HBRUSH)SelectObject(hdc, nullBrush);
             Rectangle(hdc, screenStartX, screenStartY, screenCurrentX, screenCurrentY);
             SelectObject(hdc, oldBrush);
-        } else if (app.currentTool == TOOL_CIRCLE) {
-            int radius = (int)(sqrt(pow(app.drawCurrentX - app.drawStartX, 2) + pow(app.drawCurrentY - app.drawStartY, 2)) * app.zoomLevel);
+        } else if (gesture.tool == TOOL_CIRCLE) {
+            int radius = (int)(sqrt(pow(gesture.currentX - gesture.startX, 2) + pow(gesture.currentY - gesture.startY, 2)) * app.zoomLevel);
             HBRUSH nullBrush = (HBRUSH)GetStockObject(NULL_BRUSH);
             HBRUSH oldBrush = (HBRUSH)SelectObject(hdc, nullBrush);
             Ellipse(hdc, screenStartX - radius, screenStartY - radius, 
                     screenStartX + radius, screenStartY + radius);
             SelectObject(hdc, oldBrush);
-        } else if (app.currentTool == TOOL_LINE) {
+        } else if (gesture.tool == TOOL_LINE) {
             MoveToEx(hdc, screenStartX, screenStartY, NULL);
             LineTo(hdc, screenCurrentX, screenCurrentY);
         }
@@ -602,8 +1106,21 @@ void OnLeftButtonUp(HWND hwnd, int x, int y)
         ReleaseDC(hwnd, hdc);
     }
     
-    DrawingEngine::EndDrawing();
-    InvalidateCanvas(hwnd); // Redraw the final shape
+    if (gesture.active) {
+        InvalidateStrokeTail(app);
+        gesture.hasTail = false;
+        
+        // Smoothing trails the pen slightly; the stroke ends where it lifted
+        RECT clientRect;
+        GetClientRect(hwnd, &clientRect);
+        if (gesture.tool == TOOL_BRUSH && app.smoothStrokes &&
+            y > TOOLBAR_HEIGHT && y < clientRect.bottom - STATUSBAR_HEIGHT) {
+            EngineThread::ContinueDrawing(ScreenToWorldX(x, app), ScreenToWorldY(y, app));
+        }
+        gesture.active = false;
+        EngineThread::EndDrawing();
+        InvalidateDocument(hwnd); // Redraw the final shape
+    }
 }
 
 void OnRightButtonDown(HWND hwnd, int x, int y)
@@ -649,7 +1166,7 @@ void OnMouseWheel(HWND hwnd, WPARAM wParam, LPARAM lParam)
         app.panY += (delta > 0) ? 20 : -20;
     }
     
-    InvalidateRect(hwnd, NULL, FALSE);
+    FrameScheduler::InvalidateAll();
 }
 
 void OnKeyDown(HWND hwnd, WPARAM wParam)
@@ -660,17 +1177,15 @@ void OnKeyDown(HWND hwnd, WPARAM wParam)
     switch (wParam) {
         case 'Z':
             if (ctrlPressed) {
-                if (DrawingEngine::Undo()) {
-                    InvalidateRect(hwnd, NULL, FALSE);
-                }
+                EngineThread::Undo();
+                InvalidateDocument(hwnd);
             }
             break;
             
         case 'Y':
             if (ctrlPressed) {
-                if (DrawingEngine::Redo()) {
-                    InvalidateRect(hwnd, NULL, FALSE);
-                }
+                EngineThread::Redo();
+                InvalidateDocument(hwnd);
             }
             break;
             
@@ -688,15 +1203,14 @@ void OnKeyDown(HWND hwnd, WPARAM wParam)
             
         case 'N':
             if (ctrlPressed) {
-                DrawingEngine::ClearCanvas();
-                InvalidateRect(hwnd, NULL, FALSE);
+                OnCommand(hwnd, MAKEWPARAM(IDM_FILE_NEW, 0));
             }
             break;
             
         case 'T':
             if (ctrlPressed) {
                 app.currentTheme = (app.currentTheme == THEME_LIGHT) ? THEME_DARK : THEME_LIGHT;
-                InvalidateRect(hwnd, NULL, FALSE);
+                FrameScheduler::InvalidateAll();
             }
             break;
             
@@ -724,6 +1238,10 @@ void OnKeyDown(HWND hwnd, WPARAM wParam)
             break;
         }
         
+        case VK_F3: // Performance overlay
+            OnCommand(hwnd, IDM_VIEW_PERF_HUD);
+            break;
+            
         case VK_F1: // Help
             MessageBox(hwnd, 
                 L"Modern Paint Studio Pro v2.0\n\n"
@@ -738,6 +1256,7 @@ void OnKeyDown(HWND hwnd, WPARAM wParam)
                 L"• Ctrl+N: New canvas\n"
                 L"• Ctrl+T: Toggle theme\n"
                 L"• G: Toggle grid\n"
+                L"• F3: Performance overlay\n"
                 L"• 1-9: Brush sizes\n"
                 L"• Right-click: Context menu\n"
                 L"• Ctrl+Mouse wheel: Zoom\n"
@@ -759,8 +1278,12 @@ void OnCommand(HWND hwnd, WPARAM wParam)
     
     switch (commandId) {
         case IDM_FILE_NEW:
-            DrawingEngine::ClearCanvas();
-            InvalidateRect(hwnd, NULL, FALSE);
+            // A new untitled document: the open one is detached first, with its
+            // unsaved work left recoverable, so clearing never reaches it
+            RunFileJob([hwnd]() {
+                EngineThread::Run(DocumentJournal::NewDocument);
+                InvalidateDocument(hwnd);
+            });
             break;
             
         case IDM_FILE_SAVE:
@@ -773,7 +1296,7 @@ void OnCommand(HWND hwnd, WPARAM wParam)
             ofn.hwndOwner = hwnd;
             ofn.lpstrFile = szFile;
             ofn.nMaxFile = sizeof(szFile);
-            ofn.lpstrFilter = L"Paint Studio Files (*.mpsp)\0*.MPSP\0PNG Files (*.png)\0*.PNG\0All Files (*.*)\0*.*\0";
+            ofn.lpstrFilter = L"Paint Studio Files (*.mpsp)\0*.MPSP\0PNG Files (*.png)\0*.PNG\0QOI Images (*.qoi)\0*.QOI\0All Files (*.*)\0*.*\0";
             ofn.nFilterIndex = 1;
             ofn.lpstrFileTitle = NULL;
             ofn.nMaxFileTitle = 0;
@@ -787,39 +1310,73 @@ void OnCommand(HWND hwnd, WPARAM wParam)
                 filename.resize(strlen(filename.c_str())); // Remove null terminator
                 
                 // Determine file type from filter index and ensure proper extension
-                bool success = false;
+                RECT rect;
+                GetClientRect(hwnd, &rect);
+                int canvasWidth = rect.right;
+                int canvasHeight = rect.bottom - TOOLBAR_HEIGHT - STATUSBAR_HEIGHT;
+                ExportJob exportCanvas = [canvasWidth, canvasHeight](const DrawingEngine::DocumentCopy& document, const std::string& path,
+                                                                     const DrawingEngine::ExportProgress& progress) {
+                    return DrawingEngine::ExportAsBitmap(document, path, canvasWidth, canvasHeight, progress);
+                };
+                
+                bool exporting = false;
                 if (ofn.nFilterIndex == 1) {
                     // Save as native format - ensure .mpsp extension
                     filename = DrawingEngine::EnsureFileExtension(filename, ".mpsp");
-                    success = DrawingEngine::SaveDrawing(filename);
-                } else if (ofn.nFilterIndex == 2) {
-                    // Export as PNG - ensure .png extension
-                    filename = DrawingEngine::EnsureFileExtension(filename, ".png");
-                    RECT rect;
-                    GetClientRect(hwnd, &rect);
-                    success = DrawingEngine::ExportAsBitmap(filename, rect.right, rect.bottom - TOOLBAR_HEIGHT - STATUSBAR_HEIGHT);
+                } else if (ofn.nFilterIndex == 2 || ofn.nFilterIndex == 3) {
+                    // Export as PNG or QOI - the extension picks the encoder
+                    filename = DrawingEngine::EnsureFileExtension(filename, ofn.nFilterIndex == 2 ? ".png" : ".qoi");
+                    exporting = true;
                 } else {
                     // All files - determine by existing extension or default to native format
-                    if (filename.find(".png") != std::string::npos) {
-                        filename = DrawingEngine::EnsureFileExtension(filename, ".png");
-                        RECT rect;
-                        GetClientRect(hwnd, &rect);
-                        success = DrawingEngine::ExportAsBitmap(filename, rect.right, rect.bottom - TOOLBAR_HEIGHT - STATUSBAR_HEIGHT);
+                    if (filename.find(".png") != std::string::npos || filename.find(".qoi") != std::string::npos) {
+                        bool qoi = filename.find(".qoi") != std::string::npos;
+                        filename = DrawingEngine::EnsureFileExtension(filename, qoi ? ".qoi" : ".png");
+                        exporting = true;
                     } else {
                         filename = DrawingEngine::EnsureFileExtension(filename, ".mpsp");
-                        success = DrawingEngine::SaveDrawing(filename);
                     }
                 }
                 
-                if (success) {
-                    MessageBox(hwnd, L"File saved successfully!", L"Save", MB_OK | MB_ICONINFORMATION);
+                if (exporting) {
+                    SubmitExport(hwnd, filename, exportCanvas);
                 } else {
-                    MessageBox(hwnd, L"Failed to save file!", L"Error", MB_OK | MB_ICONERROR);
+                    RunFileJob([hwnd, filename]() { SubmitSave(hwnd, filename); });
                 }
             }
             break;
         }
         
+        case IDM_FILE_EXPORT_PRINT:
+        {
+            OPENFILENAME ofn;
+            WCHAR szFile[260] = {0};
+            
+            ZeroMemory(&ofn, sizeof(ofn));
+            ofn.lStructSize = sizeof(ofn);
+            ofn.hwndOwner = hwnd;
+            ofn.lpstrFile = szFile;
+            ofn.nMaxFile = sizeof(szFile);
+            ofn.lpstrFilter = L"PNG Files (*.png)\0*.PNG\0";
+            ofn.nFilterIndex = 1;
+            ofn.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT;
+            
+            if (GetSaveFileName(&ofn)) {
+                std::string filename;
+                filename.resize(WideCharToMultiByte(CP_UTF8, 0, szFile, -1, NULL, 0, NULL, NULL));
+                WideCharToMultiByte(CP_UTF8, 0, szFile, -1, &filename[0], filename.size(), NULL, NULL);
+                filename.resize(strlen(filename.c_str())); // Remove null terminator
+                filename = DrawingEngine::EnsureFileExtension(filename, ".png");
+                
+                // Document bounds at print resolution, anti-aliased
+                SubmitExport(hwnd, filename, [](const DrawingEngine::DocumentCopy& document, const std::string& path,
+                                                const DrawingEngine::ExportProgress& progress) {
+                    return DrawingEngine::ExportDocument(document, path, EXPORT_PRINT_SCALE, EXPORT_PRINT_SAMPLES, progress);
+                });
+            }
+            break;
+        }
+        
         case IDM_FILE_OPEN:
         {
             OPENFILENAME ofn;
@@ -843,87 +1400,262 @@ void OnCommand(HWND hwnd, WPARAM wParam)
                 WideCharToMultiByte(CP_UTF8, 0, szFile, -1, &filename[0], filename.size(), NULL, NULL);
                 filename.resize(strlen(filename.c_str())); // Remove null terminator
                 
-                if (DrawingEngine::LoadDrawing(filename)) {
-                    InvalidateRect(hwnd, NULL, FALSE);
-                    MessageBox(hwnd, L"File loaded successfully!", L"Open", MB_OK | MB_ICONINFORMATION);
-                } else {
-                    MessageBox(hwnd, L"Failed to load file!", L"Error", MB_OK | MB_ICONERROR);
-                }
+                RunFileJob([hwnd, filename]() { SubmitOpen(hwnd, filename); });
             }
             break;
         }
         
+        case IDM_FILE_IMPORT_REFERENCE:
+        {
+            OPENFILENAME ofn;
+            WCHAR szFile[260] = {0};
+            
+            ZeroMemory(&ofn, sizeof(ofn));
+            ofn.lStructSize = sizeof(ofn);
+            ofn.hwndOwner = hwnd;
+            ofn.lpstrFile = szFile;
+            ofn.nMaxFile = sizeof(szFile);
+            ofn.lpstrFilter = L"QOI Images (*.qoi)\0*.QOI\0All Files (*.*)\0*.*\0";
+            ofn.nFilterIndex = 1;
+            ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST;
+            
+            if (GetOpenFileName(&ofn)) {
+                std::string filename;
+                filename.resize(WideCharToMultiByte(CP_UTF8, 0, szFile, -1, NULL, 0, NULL, NULL));
+                WideCharToMultiByte(CP_UTF8, 0, szFile, -1, &filename[0], filename.size(), NULL, NULL);
+                filename.resize(strlen(filename.c_str())); // Remove null terminator
+                
+                // Decoded on the job pool; shown under the strokes at the document origin
+                std::shared_ptr<RasterImage> image = std::make_shared<RasterImage>();
+                JobPool::Submit(JobName(filename),
+                    [image, filename](const JobPool::Progress&) {
+                        return DrawingEngine::DecodeReferenceImage(filename, *image);
+                    },
+                    [hwnd, image](JobPool::Result result) {
+                        if (result == JobPool::JOB_SUCCEEDED) {
+                            DrawingEngine::SetReferenceImage(std::move(*image));
+                            FrameScheduler::InvalidateAll();
+                        } else if (result == JobPool::JOB_FAILED) {
+                            MessageBox(hwnd, L"Failed to import reference image!", L"Error", MB_OK | MB_ICONERROR);
+                        }
+                    });
+                InvalidateStatusBar(hwnd);
+            }
+            break;
+        }
+        
+        case IDM_FILE_CLEAR_REFERENCE:
+            DrawingEngine::ClearReferenceImage();
+            FrameScheduler::InvalidateAll();
+            break;
+        
+        case IDM_FILE_CANCEL_JOBS:
+            JobPool::CancelAll();
+            InvalidateStatusBar(hwnd);
+            break;
+        
         case IDM_FILE_EXIT:
             PostQuitMessage(0);
             break;
             
         case IDM_EDIT_UNDO:
-            if (DrawingEngine::Undo()) {
-                InvalidateRect(hwnd, NULL, FALSE);
-            }
+            EngineThread::Undo();
+            InvalidateDocument(hwnd);
             break;
             
         case IDM_EDIT_REDO:
-            if (DrawingEngine::Redo()) {
-                InvalidateRect(hwnd, NULL, FALSE);
-            }
+            EngineThread::Redo();
+            InvalidateDocument(hwnd);
             break;
             
         case IDM_EDIT_CLEAR:
-            DrawingEngine::ClearCanvas();
-            InvalidateRect(hwnd, NULL, FALSE);
+            EngineThread::ClearCanvas();
+            InvalidateDocument(hwnd);
             break;
             
         case IDM_VIEW_ZOOM_IN:
             app.zoomLevel = (app.zoomLevel * 1.1f > 5.0f) ? 5.0f : app.zoomLevel * 1.1f;
-            InvalidateRect(hwnd, NULL, FALSE);
+            FrameScheduler::InvalidateAll();
             break;
             
         case IDM_VIEW_ZOOM_OUT:
             app.zoomLevel = (app.zoomLevel / 1.1f < 0.2f) ? 0.2f : app.zoomLevel / 1.1f;
-            InvalidateRect(hwnd, NULL, FALSE);
+            FrameScheduler::InvalidateAll();
             break;
             
         case IDM_VIEW_ZOOM_FIT:
             app.zoomLevel = 1.0f;
             app.panX = app.panY = 0;
-            InvalidateRect(hwnd, NULL, FALSE);
+            FrameScheduler::InvalidateAll();
             break;
             
         case IDM_VIEW_GRID:
             app.showGrid = !app.showGrid;
-            InvalidateRect(hwnd, NULL, FALSE);
+            FrameScheduler::InvalidateAll();
+            break;
+            
+        case IDM_VIEW_SMOOTH_STROKES:
+            app.smoothStrokes = !app.smoothStrokes;
+            CheckMenuItem(GetMenu(hwnd), IDM_VIEW_SMOOTH_STROKES, MF_BYCOMMAND | (app.smoothStrokes ? MF_CHECKED : MF_UNCHECKED));
+            break;
+            
+        case IDM_VIEW_PREDICT_TAIL:
+            app.predictStrokeTail = !app.predictStrokeTail;
+            CheckMenuItem(GetMenu(hwnd), IDM_VIEW_PREDICT_TAIL, MF_BYCOMMAND | (app.predictStrokeTail ? MF_CHECKED : MF_UNCHECKED));
+            break;
+            
+        case IDM_VIEW_PERF_HUD:
+            app.showPerformanceHud = !app.showPerformanceHud;
+            CheckMenuItem(GetMenu(hwnd), IDM_VIEW_PERF_HUD, MF_BYCOMMAND | (app.showPerformanceHud ? MF_CHECKED : MF_UNCHECKED));
+            FrameScheduler::InvalidateAll();
             break;
             
         case IDM_VIEW_THEME:
             app.currentTheme = (app.currentTheme == THEME_LIGHT) ? THEME_DARK : THEME_LIGHT;
-            InvalidateRect(hwnd, NULL, FALSE);
+            FrameScheduler::InvalidateAll();
             break;
             
         case IDM_TOOLS_BRUSH:
             DrawingEngine::SetTool(TOOL_BRUSH);
-            InvalidateRect(hwnd, NULL, FALSE);
+            FrameScheduler::InvalidateAll();
             break;
             
         case IDM_TOOLS_ERASER:
             DrawingEngine::SetTool(TOOL_ERASER);
-            InvalidateRect(hwnd, NULL, FALSE);
+            FrameScheduler::InvalidateAll();
             break;
             
         case IDM_TOOLS_RECT:
             DrawingEngine::SetTool(TOOL_RECTANGLE);
-            InvalidateRect(hwnd, NULL, FALSE);
+            FrameScheduler::InvalidateAll();
             break;
             
         case IDM_TOOLS_CIRCLE:
             DrawingEngine::SetTool(TOOL_CIRCLE);
-            InvalidateRect(hwnd, NULL, FALSE);
+            FrameScheduler::InvalidateAll();
             break;
             
         case IDM_TOOLS_LINE:
             DrawingEngine::SetTool(TOOL_LINE);
-            InvalidateRect(hwnd, NULL, FALSE);
+            FrameScheduler::InvalidateAll();
+            break;
+            
+        case IDM_TOOLS_RECORD_TRACE:
+        {
+            if (InputTrace::IsRecording()) {
+                InputTrace::StopRecording();
+                CheckMenuItem(GetMenu(hwnd), IDM_TOOLS_RECORD_TRACE, MF_BYCOMMAND | MF_UNCHECKED);
+                MessageBox(hwnd, L"Input trace saved.", L"Record Input Trace", MB_OK | MB_ICONINFORMATION);
+                break;
+            }
+            
+            OPENFILENAME ofn;
+            WCHAR szFile[260] = {0};
+            
+            ZeroMemory(&ofn, sizeof(ofn));
+            ofn.lStructSize = sizeof(ofn);
+            ofn.hwndOwner = hwnd;
+            ofn.lpstrFile = szFile;
+            ofn.nMaxFile = sizeof(szFile);
+            ofn.lpstrFilter = L"Input Traces (*.mpst)\0*.MPST\0";
+            ofn.nFilterIndex = 1;
+            ofn.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT;
+            
+            if (GetSaveFileName(&ofn)) {
+                std::string filename;
+                filename.resize(WideCharToMultiByte(CP_UTF8, 0, szFile, -1, NULL, 0, NULL, NULL));
+                WideCharToMultiByte(CP_UTF8, 0, szFile, -1, &filename[0], filename.size(), NULL, NULL);
+                filename.resize(strlen(filename.c_str())); // Remove null terminator
+                filename = DrawingEngine::EnsureFileExtension(filename, ".mpst");
+                
+                // Replays start from the current drawing, tool and view
+                RECT clientRect;
+                GetClientRect(hwnd, &clientRect);
+                // Events are held until the engine reaches this point and hands
+                // over the document they start from
+                if (InputTrace::BeginRecording(filename, clientRect.right, clientRect.bottom)) {
+                    CheckMenuItem(GetMenu(hwnd), IDM_TOOLS_RECORD_TRACE, MF_BYCOMMAND | MF_CHECKED);
+                    EngineThread::Run(nullptr, [hwnd](bool, const EngineThread::Snapshot& snapshot) {
+                        std::vector<DrawPoint> document;
+                        snapshot.points.CopyTo(document);
+                        if (InputTrace::IsRecording() && !InputTrace::CompleteRecording(document)) {
+                            CheckMenuItem(GetMenu(hwnd), IDM_TOOLS_RECORD_TRACE, MF_BYCOMMAND | MF_UNCHECKED);
+                            MessageBox(hwnd, L"Failed to start recording!", L"Error", MB_OK | MB_ICONERROR);
+                        }
+                    });
+                } else {
+                    MessageBox(hwnd, L"Failed to start recording!", L"Error", MB_OK | MB_ICONERROR);
+                }
+            }
             break;
+        }
+            
+        case IDM_VIEW_MEMORY_USAGE:
+        {
+            // Collected by the engine with its latest snapshot
+            std::string report = MemoryStats::FormatReport(EngineThread::CurrentStatus().memory);
+            std::wstring text(report.begin(), report.end());
+            MessageBox(hwnd, text.c_str(), L"Memory Usage", MB_OK | MB_ICONINFORMATION);
+            break;
+        }
+            
+        case IDM_TOOLS_SAVE_PERF_REPORT:
+        {
+            OPENFILENAME ofn;
+            WCHAR szFile[260] = L"frame_profile.csv";
+            
+            ZeroMemory(&ofn, sizeof(ofn));
+            ofn.lStructSize = sizeof(ofn);
+            ofn.hwndOwner = hwnd;
+            ofn.lpstrFile = szFile;
+            ofn.nMaxFile = sizeof(szFile);
+            ofn.lpstrFilter = L"Frame Profiles (*.csv)\0*.CSV\0";
+            ofn.nFilterIndex = 1;
+            ofn.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT;
+            
+            if (GetSaveFileName(&ofn)) {
+                std::string filename;
+                filename.resize(WideCharToMultiByte(CP_UTF8, 0, szFile, -1, NULL, 0, NULL, NULL));
+                WideCharToMultiByte(CP_UTF8, 0, szFile, -1, &filename[0], filename.size(), NULL, NULL);
+                filename.resize(strlen(filename.c_str())); // Remove null terminator
+                filename = DrawingEngine::EnsureFileExtension(filename, ".csv");
+                
+                if (!FrameProfiler::DumpToFile(filename)) {
+                    MessageBox(hwnd, L"Failed to save performance report!", L"Error", MB_OK | MB_ICONERROR);
+                }
+            }
+            break;
+        }
+            
+#ifdef MPS_TRACE_EVENTS
+        case IDM_TOOLS_SAVE_TRACE:
+        {
+            OPENFILENAME ofn;
+            WCHAR szFile[260] = L"modernpaint_trace.json";
+            
+            ZeroMemory(&ofn, sizeof(ofn));
+            ofn.lStructSize = sizeof(ofn);
+            ofn.hwndOwner = hwnd;
+            ofn.lpstrFile = szFile;
+            ofn.nMaxFile = sizeof(szFile);
+            ofn.lpstrFilter = L"Chrome Trace Files (*.json)\0*.JSON\0";
+            ofn.nFilterIndex = 1;
+            ofn.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT;
+            
+            if (GetSaveFileName(&ofn)) {
+                std::string filename;
+                filename.resize(WideCharToMultiByte(CP_UTF8, 0, szFile, -1, NULL, 0, NULL, NULL));
+                WideCharToMultiByte(CP_UTF8, 0, szFile, -1, &filename[0], filename.size(), NULL, NULL);
+                filename.resize(strlen(filename.c_str())); // Remove null terminator
+                filename = DrawingEngine::EnsureFileExtension(filename, ".json");
+                
+                if (!TraceEvents::Flush(filename)) {
+                    MessageBox(hwnd, L"Failed to save engine timeline!", L"Error", MB_OK | MB_ICONERROR);
+                }
+            }
+            break;
+        }
+#endif
             
         case IDM_HELP_ABOUT:
             OnKeyDown(hwnd, VK_F1);
@@ -974,13 +1706,46 @@ void OnMouseHover(HWND hwnd, int x, int y)
         
         // Invalidate just the toolbar area for efficiency
         RECT toolbarRect = {0, 0, 1000, TOOLBAR_HEIGHT};
-        InvalidateRect(hwnd, &toolbarRect, FALSE);
+        ScheduleRepaint(toolbarRect);
     }
 }
 
 void OnSize(HWND hwnd, WPARAM wParam, LPARAM lParam)
 {
-    InvalidateRect(hwnd, NULL, FALSE);
+    FrameScheduler::InvalidateAll();
+}
+
+void OnTimer(HWND hwnd, WPARAM wParam)
+{
+    if (wParam == IDT_AUTOSAVE) {
+        // Cost is proportional to the work done since the last autosave
+        EngineThread::Autosave();
+    } else if (wParam == IDT_PRESENT) {
+        // Presents for main's loop while a modal loop runs
+        if (inModalLoop && FrameScheduler::TimeUntilDue() == 0) {
+            PresentFrame(hwnd);
+        }
+    }
+}
+
+void OnEnginePublished(HWND hwnd)
+{
+    // Only what the applied commands touched
+    DrawingEngine::Damage damage;
+    EngineThread::HandlePublished(&damage);
+    if (damage.whole) {
+        InvalidateCanvas(hwnd);
+    } else if (damage.right > damage.left) {
+        InvalidateDamage(hwnd, damage);
+    }
+    InvalidateStatusBar(hwnd);
+}
+
+void OnJobsChanged(HWND hwnd)
+{
+    // Finished jobs' completions, then the job list in the status bar
+    JobPool::HandleCompleted();
+    InvalidateStatusBar(hwnd);
 }
 
 void DrawGridGPU(RECT clientRect)
@@ -1009,18 +1774,18 @@ void DrawGridGPU(RECT clientRect)
     }
 }
 
-void DrawPointsGPU()
+void DrawPointsGPU(const DocumentVersion::Points& points)
 {
-    AppState& app = AppState::Instance();
-    
-    if (app.drawingPoints.empty()) return;
+    if (points.empty()) return;
     
-    // Convert drawing points to GPU format and render them
-    std::vector<D2D1_POINT_2F> currentStroke;
-    DrawPoint* prevPoint = nullptr;
+    // Convert drawing points to GPU format and render them; the buffer keeps its
+    // capacity between frames so steady-state painting does not allocate
+    static std::vector<D2D1_POINT_2F> currentStroke;
+    currentStroke.clear();
+    const DrawPoint* prevPoint = nullptr;
     
-    for (size_t i = 0; i < app.drawingPoints.size(); i++) {
-        const DrawPoint& point = app.drawingPoints[i];
+    for (size_t i = 0; i < points.size(); i++) {
+        const DrawPoint& point = points[i];
         
         if (point.isStart) {
             // Finish previous stroke if any
@@ -1033,11 +1798,11 @@ void DrawPointsGPU()
             
             // Start new stroke
             currentStroke.push_back(D2D1::Point2F((float)point.x, (float)point.y));
-            prevPoint = const_cast<DrawPoint*>(&point);
+            prevPoint = &point;
         } else if (prevPoint != nullptr) {
             // Continue stroke
             currentStroke.push_back(D2D1::Point2F((float)point.x, (float)point.y));
-            prevPoint = const_cast<DrawPoint*>(&point);
+            prevPoint = &point;
         }
     }
     
@@ -1049,4 +1814,72 @@ void DrawPointsGPU()
     }
 }
 
+void DrawReferenceGPU()
+{
+    AppState& app = AppState::Instance();
+    GPURenderer::GPUContext& context = GPURenderer::GPURenderingEngine::GetContext();
+    
+    // Device bitmaps belong to one render target; rebuild after device loss
+    static ID2D1Bitmap* bitmap = nullptr;
+    static ID2D1HwndRenderTarget* bitmapTarget = nullptr;
+    static uint32_t bitmapRevision = 0;
+    static MemoryStats::Allocation bitmapMemory(MemoryStats::MEM_GPU);
+    
+    if (bitmap && (bitmapTarget != context.renderTarget || bitmapRevision != app.referenceRevision)) {
+        bitmap->Release();
+        bitmap = nullptr;
+        bitmapMemory.Resize(0);
+    }
+    if (app.referenceImage.pixels.empty() || !context.renderTarget) return;
+    
+    if (!bitmap) {
+        bitmap = GPURenderer::GPURenderingEngine::CreateBitmapFromPixels(
+            app.referenceImage.pixels.data(), app.referenceImage.width, app.referenceImage.height);
+        bitmapTarget = context.renderTarget;
+        bitmapRevision = app.referenceRevision;
+        bitmapMemory.Resize(bitmap ? app.referenceImage.pixels.size() * sizeof(uint32_t) : 0);
+    }
+    if (bitmap) {
+        GPURenderer::GPURenderingEngine::DrawBitmap(bitmap, 0.0f, 0.0f);
+    }
+}
+
+void DrawReferenceSoftware(HDC hdc)
+{
+    AppState& app = AppState::Instance();
+    const RasterImage& image = app.referenceImage;
+    if (image.pixels.empty()) return;
+    
+    // DIB copy: BGR order, blended onto white (StretchDIBits ignores alpha)
+    static std::vector<uint32_t> dib;
+    static uint32_t dibRevision = 0;
+    static MemoryStats::Allocation dibMemory(MemoryStats::MEM_RASTER);
+    if (dib.empty() || dibRevision != app.referenceRevision) {
+        dib.resize(image.pixels.size());
+        dibMemory.Resize(dib.capacity() * sizeof(uint32_t));
+        for (size_t i = 0; i < dib.size(); i++) {
+            uint32_t pixel = image.pixels[i];
+            uint32_t alpha = pixel >> 24;
+            uint32_t r = (GetRValue(pixel) * alpha + 255 * (255 - alpha) + 127) / 255;
+            uint32_t g = (GetGValue(pixel) * alpha + 255 * (255 - alpha) + 127) / 255;
+            uint32_t b = (GetBValue(pixel) * alpha + 255 * (255 - alpha) + 127) / 255;
+            dib[i] = b | g << 8 | r << 16;
+        }
+        dibRevision = app.referenceRevision;
+    }
+    
+    BITMAPINFO info = {};
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = image.width;
+    info.bmiHeader.biHeight = -image.height;   // Top-down
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+    
+    SetStretchBltMode(hdc, COLORONCOLOR);
+    StretchDIBits(hdc, app.panX, app.panY + TOOLBAR_HEIGHT,
+                  (int)(image.width * app.zoomLevel), (int)(image.height * app.zoomLevel),
+                  0, 0, image.width, image.height, dib.data(), &info, DIB_RGB_COLORS, SRCCOPY);
+}
+
 } // namespace EventHandler
\ No newline at end of file
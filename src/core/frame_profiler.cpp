@@ -0,0 +1,351 @@
+#include "../../include/frame_profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+namespace FrameProfiler {
+
+typedef std::chrono::steady_clock Clock;
+
+// Each slot is a seqlock: the sequence is odd while the writer is inside, and
+// the record is stored as atomic words so a torn read is detected, not UB
+static const size_t RECORD_WORDS = (sizeof(FrameRecord) + 7) / 8;
+static_assert(std::is_trivially_copyable<FrameRecord>::value, "FrameRecord is copied word by word");
+
+struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint64_t> words[RECORD_WORDS];
+};
+
+static Slot slots[FRAME_HISTORY];
+static std::atomic<uint64_t> framesWritten{0};
+
+// Latency samples are one word each: the sample number (plus one) above the
+// float bits, so a reader can tell a stale or reused slot
+static std::atomic<uint64_t> latencySlots[LATENCY_HISTORY];
+static std::atomic<uint64_t> latencyWritten{0};
+
+// Frame being painted (UI thread only)
+static const Clock::time_point origin = Clock::now();
+static Clock::time_point frameStart;
+static FrameRecord current;
+static bool inFrame = false;
+static AllocStats::Counters frameAllocations;   // Thread counters at BeginFrame
+
+// Inputs on their way to the screen (UI thread only). The arriving input is
+// per thread so document mutations on the engine thread do not claim it.
+static thread_local uint64_t arrivingInput = 0;   // Pointer message being handled, 0 when none
+static std::vector<uint64_t> appliedInputs;
+static uint64_t presentMicros = 0;     // End of this frame's PHASE_PRESENT
+static std::vector<double>* latencySink = nullptr;
+
+static double MicrosSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static void StoreSlot(Slot& slot, const FrameRecord& frame)
+{
+    uint64_t words[RECORD_WORDS] = {};
+    std::memcpy(words, &frame, sizeof(FrameRecord));
+    
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < RECORD_WORDS; i++) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// False if the writer kept overwriting the slot while we read it
+static bool LoadSlot(const Slot& slot, FrameRecord& frame)
+{
+    for (int attempt = 0; attempt < 8; attempt++) {
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        
+        uint64_t words[RECORD_WORDS];
+        for (size_t i = 0; i < RECORD_WORDS; i++) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before) {
+            std::memcpy(&frame, words, sizeof(FrameRecord));
+            return true;
+        }
+    }
+    return false;
+}
+
+static void RecordLatency(double micros)
+{
+    uint32_t bits;
+    float value = (float)micros;
+    std::memcpy(&bits, &value, sizeof(bits));
+    
+    uint64_t index = latencyWritten.load(std::memory_order_relaxed);
+    latencySlots[index % LATENCY_HISTORY].store(((index + 1) << 32) | bits, std::memory_order_relaxed);
+    latencyWritten.store(index + 1, std::memory_order_release);
+    if (latencySink) {
+        latencySink->push_back(micros);
+    }
+}
+
+// Nearest rank
+static double Percentile(const std::vector<double>& sorted, double q)
+{
+    return sorted[(size_t)std::ceil(sorted.size() * q) - 1];
+}
+
+void BeginFrame(bool gpu)
+{
+    current = FrameRecord();
+    current.gpu = gpu;
+    frameStart = Clock::now();
+    current.startMicros = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(frameStart - origin).count();
+    presentMicros = 0;
+    frameAllocations = AllocStats::ThreadCounters();
+    inFrame = true;
+}
+
+void EndFrame(uint32_t pointsDrawn)
+{
+    if (!inFrame) return;
+    inFrame = false;
+    current.totalMicros = (float)MicrosSince(frameStart);
+    current.pointsDrawn = pointsDrawn;
+    AllocStats::Counters allocated = AllocStats::ThreadCounters() - frameAllocations;
+    current.allocations = (uint32_t)allocated.allocations;
+    current.allocatedBytes = allocated.bytes;
+    
+    // Everything applied before this frame is on screen now
+    uint64_t presented = presentMicros ? presentMicros : NowMicros();
+    for (uint64_t arrival : appliedInputs) {
+        double latency = presented > arrival ? (double)(presented - arrival) : 0.0;
+        current.inputLatencyMicros = std::max(current.inputLatencyMicros, (float)latency);
+        RecordLatency(latency);
+    }
+    current.inputsPresented = (uint32_t)appliedInputs.size();
+    appliedInputs.clear();
+    Record(current);
+}
+
+ScopedPhase::~ScopedPhase()
+{
+    if (inFrame) {
+        current.phaseMicros[phase] += (float)MicrosSince(start);
+        if (phase == PHASE_PRESENT) {
+            presentMicros = NowMicros();
+        }
+    }
+}
+
+uint64_t NowMicros()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - origin).count();
+}
+
+void InputArrived()
+{
+    arrivingInput = NowMicros();
+}
+
+void InputArrived(uint64_t arrivalMicros)
+{
+    arrivingInput = arrivalMicros;
+}
+
+uint64_t TakeArrivingInput()
+{
+    uint64_t arrival = arrivingInput;
+    arrivingInput = 0;
+    return arrival;
+}
+
+void InputApplied()
+{
+    // Once per input; a window that never paints stops collecting
+    if (arrivingInput && appliedInputs.size() < LATENCY_HISTORY) {
+        appliedInputs.push_back(arrivingInput);
+    }
+    arrivingInput = 0;
+}
+
+void SetLatencySink(std::vector<double>* sink)
+{
+    latencySink = sink;
+}
+
+void Record(const FrameRecord& frame)
+{
+    uint64_t index = framesWritten.load(std::memory_order_relaxed);
+    FrameRecord stored = frame;
+    stored.index = index;
+    StoreSlot(slots[index % FRAME_HISTORY], stored);
+    framesWritten.store(index + 1, std::memory_order_release);
+}
+
+void Reset()
+{
+    FrameRecord empty;
+    empty.index = UINT64_MAX;
+    for (Slot& slot : slots) {
+        StoreSlot(slot, empty);
+    }
+    framesWritten.store(0, std::memory_order_release);
+    for (std::atomic<uint64_t>& slot : latencySlots) {
+        slot.store(0, std::memory_order_relaxed);
+    }
+    latencyWritten.store(0, std::memory_order_release);
+    inFrame = false;
+    arrivingInput = 0;
+    appliedInputs.clear();
+}
+
+size_t Snapshot(std::vector<FrameRecord>& frames)
+{
+    frames.clear();
+    uint64_t end = framesWritten.load(std::memory_order_acquire);
+    uint64_t begin = end > FRAME_HISTORY ? end - FRAME_HISTORY : 0;
+    for (uint64_t index = begin; index < end; index++) {
+        FrameRecord frame;
+        // Skip slots already reused for newer frames
+        if (LoadSlot(slots[index % FRAME_HISTORY], frame) && frame.index == index) {
+            frames.push_back(frame);
+        }
+    }
+    return frames.size();
+}
+
+size_t LatencySnapshot(std::vector<double>& micros)
+{
+    micros.clear();
+    uint64_t end = latencyWritten.load(std::memory_order_acquire);
+    uint64_t begin = end > LATENCY_HISTORY ? end - LATENCY_HISTORY : 0;
+    for (uint64_t index = begin; index < end; index++) {
+        uint64_t word = latencySlots[index % LATENCY_HISTORY].load(std::memory_order_relaxed);
+        if ((word >> 32) != ((index + 1) & 0xFFFFFFFFu)) continue;
+        uint32_t bits = (uint32_t)word;
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        micros.push_back(value);
+    }
+    return micros.size();
+}
+
+Summary Summarize()
+{
+    std::vector<FrameRecord> frames;
+    Snapshot(frames);
+    Summary summary = Summarize(frames);
+    
+    std::vector<double> latencies;
+    LatencySnapshot(latencies);
+    SummarizeLatency(latencies, summary);
+    return summary;
+}
+
+void SummarizeLatency(std::vector<double>& micros, Summary& summary)
+{
+    summary.latencySamples = micros.size();
+    if (micros.empty()) return;
+    
+    std::sort(micros.begin(), micros.end());
+    summary.latencyP50Micros = Percentile(micros, 0.50);
+    summary.latencyP95Micros = Percentile(micros, 0.95);
+    summary.latencyP99Micros = Percentile(micros, 0.99);
+    summary.latencyMaxMicros = micros.back();
+}
+
+Summary Summarize(const std::vector<FrameRecord>& frames)
+{
+    Summary summary;
+    summary.frames = frames.size();
+    if (frames.empty()) return summary;
+    
+    std::vector<double> totals;
+    for (const FrameRecord& frame : frames) {
+        totals.push_back(frame.totalMicros);
+        summary.meanMicros += frame.totalMicros;
+        summary.allocationsPerFrame += frame.allocations;
+        summary.allocatedBytesPerFrame += (double)frame.allocatedBytes;
+        summary.maxAllocations = std::max(summary.maxAllocations, frame.allocations);
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            summary.phaseMeanMicros[phase] += frame.phaseMicros[phase];
+        }
+    }
+    summary.meanMicros /= frames.size();
+    summary.allocationsPerFrame /= frames.size();
+    summary.allocatedBytesPerFrame /= frames.size();
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        summary.phaseMeanMicros[phase] /= frames.size();
+    }
+    
+    std::sort(totals.begin(), totals.end());
+    summary.p50Micros = Percentile(totals, 0.50);
+    summary.p99Micros = Percentile(totals, 0.99);
+    summary.maxMicros = totals.back();
+    
+    const FrameRecord& last = frames.back();
+    double span = last.startMicros + last.totalMicros - frames.front().startMicros;
+    summary.framesPerSecond = span > 0.0 ? frames.size() * 1e6 / span : 0.0;
+    summary.pointsDrawn = last.pointsDrawn;
+    summary.gpu = last.gpu;
+    return summary;
+}
+
+// Comment header with the summary, then one CSV row per frame
+bool DumpToFile(const std::string& filename)
+{
+    std::vector<FrameRecord> frames;
+    Snapshot(frames);
+    Summary summary = Summarize(frames);
+    std::vector<double> latencies;
+    LatencySnapshot(latencies);
+    SummarizeLatency(latencies, summary);
+    
+    std::FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    
+    std::fprintf(file, "# Modern Paint Studio Pro frame profile (%s renderer)\n", summary.gpu ? "GPU" : "software");
+    std::fprintf(file, "# %zu frames, %.1f frames/s, mean %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us, %u points; "
+                 "input to present p50 %.1f us, p95 %.1f us, p99 %.1f us over %zu inputs; "
+                 "%.1f allocations (%.0f bytes) per frame, max %u\n",
+                 summary.frames, summary.framesPerSecond, summary.meanMicros, summary.p50Micros,
+                 summary.p99Micros, summary.maxMicros, summary.pointsDrawn, summary.latencyP50Micros,
+                 summary.latencyP95Micros, summary.latencyP99Micros, summary.latencySamples,
+                 summary.allocationsPerFrame, summary.allocatedBytesPerFrame, summary.maxAllocations);
+    std::fprintf(file, "frame,start_us,total_us");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        std::fprintf(file, ",%s_us", PhaseName((Phase)phase));
+    }
+    std::fprintf(file, ",points,renderer,inputs,input_latency_us,allocations,allocated_bytes\n");
+    
+    for (const FrameRecord& frame : frames) {
+        std::fprintf(file, "%llu,%llu,%.1f", (unsigned long long)frame.index,
+                     (unsigned long long)frame.startMicros, frame.totalMicros);
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            std::fprintf(file, ",%.1f", frame.phaseMicros[phase]);
+        }
+        std::fprintf(file, ",%u,%s,%u,%.1f,%u,%llu\n", frame.pointsDrawn, frame.gpu ? "gpu" : "software",
+                     frame.inputsPresented, frame.inputLatencyMicros, frame.allocations,
+                     (unsigned long long)frame.allocatedBytes);
+    }
+    return std::fclose(file) == 0;
+}
+
+const char* PhaseName(Phase phase)
+{
+    static const char* names[PHASE_COUNT] = {
+        "clear", "grid", "reference", "strokes", "toolbar", "status_bar", "color_picker", "hud", "present"
+    };
+    return (phase >= 0 && phase < PHASE_COUNT) ? names[phase] : "unknown";
+}
+
+}
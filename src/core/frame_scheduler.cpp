@@ -0,0 +1,145 @@
+#include "../../include/frame_scheduler.h"
+#include "../../include/frame_profiler.h"
+#include <algorithm>
+
+namespace FrameScheduler {
+
+// UI thread only
+static uint64_t (*nowMicros)() = FrameProfiler::NowMicros;
+static Frame pending;
+static bool hasPending = false;
+static uint64_t lastFrameMicros = 0;
+static bool framed = false;            // A frame went out since Reset
+static uint64_t targetInterval = DEFAULT_INTERVAL_MICROS;
+static double paintCost = 0.0;         // Moving average of FramePresented
+static bool measured = false;
+static Stats stats;
+
+// Touching rectangles merge too: two halves of a stroke repaint as one
+static bool Overlaps(const Rect& a, const Rect& b)
+{
+    return a.left <= b.right && b.left <= a.right && a.top <= b.bottom && b.top <= a.bottom;
+}
+
+static void Include(Rect& into, const Rect& rect)
+{
+    into.left = std::min(into.left, rect.left);
+    into.top = std::min(into.top, rect.top);
+    into.right = std::max(into.right, rect.right);
+    into.bottom = std::max(into.bottom, rect.bottom);
+}
+
+static void Request()
+{
+    stats.requests++;
+    if (hasPending) {
+        stats.coalesced++;
+    }
+    hasPending = true;
+}
+
+void Invalidate(const Rect& rect)
+{
+    if (rect.right <= rect.left || rect.bottom <= rect.top) {
+        return;
+    }
+    Request();
+    if (pending.whole) {
+        return;
+    }
+    
+    for (size_t i = 0; i < pending.count; i++) {
+        if (Overlaps(pending.rects[i], rect)) {
+            Include(pending.rects[i], rect);
+            return;
+        }
+    }
+    if (pending.count == MAX_RECTS) {
+        for (size_t i = 1; i < pending.count; i++) {
+            Include(pending.rects[0], pending.rects[i]);
+        }
+        Include(pending.rects[0], rect);
+        pending.count = 1;
+        return;
+    }
+    pending.rects[pending.count++] = rect;
+}
+
+void InvalidateAll()
+{
+    Request();
+    pending.whole = true;
+    pending.count = 0;
+}
+
+uint64_t TimeUntilDue()
+{
+    if (!hasPending) {
+        return IDLE;
+    }
+    if (!framed) {
+        return 0;
+    }
+    uint64_t due = lastFrameMicros + CurrentInterval();
+    uint64_t now = nowMicros();
+    return now >= due ? 0 : due - now;
+}
+
+bool TakeFrame(Frame& frame)
+{
+    if (TimeUntilDue() != 0) {
+        return false;
+    }
+    frame = pending;
+    pending = Frame();
+    hasPending = false;
+    lastFrameMicros = nowMicros();
+    framed = true;
+    stats.frames++;
+    return true;
+}
+
+void FramePresented(uint64_t paintMicros)
+{
+    if (!measured) {
+        paintCost = (double)paintMicros;
+        measured = true;
+    } else {
+        paintCost += ((double)paintMicros - paintCost) / 8.0;
+    }
+}
+
+void SetTargetInterval(uint64_t micros)
+{
+    targetInterval = std::max<uint64_t>(micros, 1);
+}
+
+uint64_t CurrentInterval()
+{
+    // Painting gets at most half of each interval; input handling the rest
+    uint64_t stretched = std::min(MAX_INTERVAL_MICROS, (uint64_t)(paintCost * 2.0));
+    return std::max(targetInterval, stretched);
+}
+
+void SetClock(uint64_t (*now)())
+{
+    nowMicros = now ? now : FrameProfiler::NowMicros;
+}
+
+Stats GetStats()
+{
+    return stats;
+}
+
+void Reset()
+{
+    pending = Frame();
+    hasPending = false;
+    lastFrameMicros = 0;
+    framed = false;
+    paintCost = 0.0;
+    measured = false;
+    stats = Stats();
+}
+
+}
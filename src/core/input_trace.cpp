@@ -0,0 +1,664 @@
+#include "../../include/input_trace.h"
+#include "../../include/app_state.h"
+#include "../../include/config.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/mpsp_format.h"
+#include "../../include/raster_renderer.h"
+#include "../../include/trace_events.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace InputTrace {
+
+// File layout: magic, version, session fields, starting document (v2 packed
+// points), then events until end of file. Each event is a tag byte (type in
+// the low nibble, flags in the high nibble), the varint time delta in
+// microseconds, and zigzag varint operands; pointer positions are deltas
+// from the previous pointer event.
+static const char MAGIC[4] = {'M', 'P', 'S', 'T'};
+static const uint32_t VERSION = 1;
+
+typedef std::chrono::steady_clock Clock;
+
+// Delta state shared by the encoder and decoder
+struct Cursor {
+    uint64_t timeMicros = 0;
+    int32_t x = 0;
+    int32_t y = 0;
+};
+
+static std::FILE* recordFile = nullptr;
+static Clock::time_point recordStart;
+static Cursor recordCursor;
+static std::vector<uint8_t> recordBytes;   // Reused per event
+static std::string recordFilename;
+static Session recordSession;
+static bool recordHeaderWritten = false;
+static std::vector<uint8_t> recordPending; // Events recorded before the header
+
+static bool IsPointerEvent(EventType type)
+{
+    return type == EVENT_BUTTON_DOWN || type == EVENT_MOUSE_MOVE || type == EVENT_BUTTON_UP;
+}
+
+static void PutVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static void PutSigned(std::vector<uint8_t>& out, int64_t value)
+{
+    PutVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static bool GetVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (in == end) return false;
+        uint8_t byte = *in++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+static bool GetSigned(const uint8_t*& in, const uint8_t* end, int64_t& value)
+{
+    uint64_t raw;
+    if (!GetVarint(in, end, raw)) return false;
+    value = (int64_t)(raw >> 1) ^ -(int64_t)(raw & 1);
+    return true;
+}
+
+static void EncodeEvent(std::vector<uint8_t>& out, const Event& event, Cursor& cursor)
+{
+    out.push_back((uint8_t)(event.type | (event.flags & 0x0F) << 4));
+    PutVarint(out, event.timeMicros >= cursor.timeMicros ? event.timeMicros - cursor.timeMicros : 0);
+    cursor.timeMicros = std::max(cursor.timeMicros, event.timeMicros);
+    
+    if (IsPointerEvent(event.type)) {
+        PutSigned(out, (int64_t)event.x - cursor.x);
+        PutSigned(out, (int64_t)event.y - cursor.y);
+        cursor.x = event.x;
+        cursor.y = event.y;
+    } else if (event.type == EVENT_RESIZE) {
+        PutSigned(out, event.x);
+        PutSigned(out, event.y);
+    } else {
+        PutSigned(out, event.code);
+    }
+}
+
+static bool DecodeEvent(const uint8_t*& in, const uint8_t* end, Event& event, Cursor& cursor)
+{
+    if (in == end) return false;
+    uint8_t tag = *in++;
+    if ((tag & 0x0F) >= EVENT_TYPE_COUNT) return false;
+    event = Event();
+    event.type = (EventType)(tag & 0x0F);
+    event.flags = tag >> 4;
+    
+    uint64_t delta;
+    if (!GetVarint(in, end, delta)) return false;
+    cursor.timeMicros += delta;
+    event.timeMicros = cursor.timeMicros;
+    
+    int64_t a, b;
+    if (IsPointerEvent(event.type)) {
+        if (!GetSigned(in, end, a) || !GetSigned(in, end, b)) return false;
+        cursor.x = event.x = (int32_t)(cursor.x + a);
+        cursor.y = event.y = (int32_t)(cursor.y + b);
+    } else if (event.type == EVENT_RESIZE) {
+        if (!GetSigned(in, end, a) || !GetSigned(in, end, b)) return false;
+        event.x = (int32_t)a;
+        event.y = (int32_t)b;
+    } else {
+        if (!GetSigned(in, end, a)) return false;
+        event.code = (int32_t)a;
+    }
+    return true;
+}
+
+static bool WriteHeader(std::FILE* file, const Session& session)
+{
+    int32_t fields[] = { session.clientWidth, session.clientHeight, session.panX, session.panY,
+                         (int32_t)session.tool, session.brushSize, (int32_t)session.color,
+                         session.showAdvancedColorPicker ? 1 : 0, session.pickerX, session.pickerY };
+    uint32_t pointCount = (uint32_t)session.document.size();
+    bool ok = std::fwrite(MAGIC, 1, 4, file) == 4 &&
+              std::fwrite(&VERSION, sizeof(uint32_t), 1, file) == 1 &&
+              std::fwrite(&session.zoomLevel, sizeof(float), 1, file) == 1 &&
+              std::fwrite(fields, sizeof(fields), 1, file) == 1 &&
+              std::fwrite(&pointCount, sizeof(uint32_t), 1, file) == 1;
+    
+    for (size_t i = 0; ok && i < session.document.size(); i++) {
+        MpspFormat::PackedPoint packed = MpspFormat::Pack(session.document[i]);
+        ok = std::fwrite(&packed, sizeof(packed), 1, file) == 1;
+    }
+    return ok;
+}
+
+static bool ReadHeader(std::FILE* file, Session& session)
+{
+    char magic[4];
+    uint32_t version = 0, pointCount = 0;
+    int32_t fields[10];
+    if (std::fread(magic, 1, 4, file) != 4 || std::memcmp(magic, MAGIC, 4) != 0 ||
+        std::fread(&version, sizeof(uint32_t), 1, file) != 1 || version != VERSION ||
+        std::fread(&session.zoomLevel, sizeof(float), 1, file) != 1 ||
+        std::fread(fields, sizeof(fields), 1, file) != 1 ||
+        std::fread(&pointCount, sizeof(uint32_t), 1, file) != 1) {
+        return false;
+    }
+    
+    session.clientWidth = fields[0];
+    session.clientHeight = fields[1];
+    session.panX = fields[2];
+    session.panY = fields[3];
+    session.tool = (ToolType)fields[4];
+    session.brushSize = fields[5];
+    session.color = (COLORREF)fields[6];
+    session.showAdvancedColorPicker = fields[7] != 0;
+    session.pickerX = fields[8];
+    session.pickerY = fields[9];
+    
+    std::vector<MpspFormat::PackedPoint> packed(pointCount);
+    if (pointCount > 0 && std::fread(packed.data(), sizeof(MpspFormat::PackedPoint), pointCount, file) != pointCount) {
+        return false;
+    }
+    session.document.resize(pointCount);
+    for (uint32_t i = 0; i < pointCount; i++) {
+        session.document[i] = MpspFormat::Unpack(packed[i]);
+    }
+    return true;
+}
+
+bool BeginRecording(const std::string& filename, int clientWidth, int clientHeight)
+{
+    StopRecording();
+    
+    AppState& app = AppState::Instance();
+    Session& session = recordSession;
+    session = Session();
+    session.clientWidth = clientWidth;
+    session.clientHeight = clientHeight;
+    session.zoomLevel = app.zoomLevel;
+    session.panX = app.panX;
+    session.panY = app.panY;
+    session.tool = app.currentTool;
+    session.brushSize = app.brushSize;
+    session.color = app.currentColor;
+    session.showAdvancedColorPicker = app.showAdvancedColorPicker;
+    session.pickerX = app.pickerX;
+    session.pickerY = app.pickerY;
+    
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    
+    recordFile = file;
+    recordFilename = filename;
+    recordHeaderWritten = false;
+    recordStart = Clock::now();
+    recordCursor = Cursor();
+    recordPending.clear();
+    return true;
+}
+
+bool CompleteRecording(const std::vector<DrawPoint>& document)
+{
+    if (!recordFile || recordHeaderWritten) {
+        return false;
+    }
+    
+    recordSession.document = document;
+    bool ok = WriteHeader(recordFile, recordSession) &&
+              (recordPending.empty() || std::fwrite(recordPending.data(), 1, recordPending.size(), recordFile) == recordPending.size());
+    std::vector<DrawPoint>().swap(recordSession.document);
+    std::vector<uint8_t>().swap(recordPending);
+    if (!ok) {
+        std::fclose(recordFile);
+        recordFile = nullptr;
+        std::remove(recordFilename.c_str());
+        return false;
+    }
+    recordHeaderWritten = true;
+    return true;
+}
+
+bool StartRecording(const std::string& filename, int clientWidth, int clientHeight)
+{
+    return BeginRecording(filename, clientWidth, clientHeight) && CompleteRecording(AppState::Instance().drawingPoints);
+}
+
+bool StopRecording()
+{
+    if (!recordFile) {
+        return false;
+    }
+    bool ok = std::fclose(recordFile) == 0 && recordHeaderWritten;
+    recordFile = nullptr;
+    if (!recordHeaderWritten) {
+        std::remove(recordFilename.c_str());   // Never got its document
+        std::vector<uint8_t>().swap(recordPending);
+    }
+    return ok;
+}
+
+bool IsRecording()
+{
+    return recordFile != nullptr;
+}
+
+void Record(EventType type, int x, int y, int code, uint8_t flags)
+{
+    if (!recordFile) return;
+    
+    Event event;
+    event.timeMicros = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - recordStart).count();
+    event.type = type;
+    event.flags = flags;
+    event.x = x;
+    event.y = y;
+    event.code = code;
+    
+    // Buffered by stdio; a crash loses at most the tail of the trace
+    if (!recordHeaderWritten) {
+        EncodeEvent(recordPending, event, recordCursor);
+        return;
+    }
+    recordBytes.clear();
+    EncodeEvent(recordBytes, event, recordCursor);
+    std::fwrite(recordBytes.data(), 1, recordBytes.size(), recordFile);
+}
+
+bool Save(const std::string& filename, const Trace& trace)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "SaveInputTrace");
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    
+    std::vector<uint8_t> bytes;
+    Cursor cursor;
+    for (const Event& event : trace.events) {
+        EncodeEvent(bytes, event, cursor);
+    }
+    
+    bool ok = WriteHeader(file, trace.session) &&
+              (bytes.empty() || std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size());
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok) {
+        std::remove(filename.c_str());
+    }
+    return ok;
+}
+
+bool Load(const std::string& filename, Trace& trace)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "LoadInputTrace");
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    
+    Trace loaded;
+    if (!ReadHeader(file, loaded.session)) {
+        std::fclose(file);
+        return false;
+    }
+    
+    std::vector<uint8_t> bytes;
+    uint8_t buffer[64 * 1024];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + read);
+    }
+    std::fclose(file);
+    
+    const uint8_t* in = bytes.data();
+    const uint8_t* end = in + bytes.size();
+    Cursor cursor;
+    Event event;
+    while (in < end && DecodeEvent(in, end, event, cursor)) {
+        loaded.events.push_back(event);
+    }
+    
+    trace = std::move(loaded);
+    return true;
+}
+
+// Headless counterpart of EventHandler: the same effects on the document,
+// tools and view, without painting, dialogs or window handles
+struct ReplayContext {
+    int clientWidth;
+    int clientHeight;
+};
+
+static int ScreenToWorldX(int screenX, const AppState& app)
+{
+    return (int)((screenX - app.panX) / app.zoomLevel);
+}
+
+static int ScreenToWorldY(int screenY, const AppState& app)
+{
+    return (int)((screenY - app.panY - TOOLBAR_HEIGHT) / app.zoomLevel);
+}
+
+static bool InCanvas(const ReplayContext& context, int y)
+{
+    return y > TOOLBAR_HEIGHT && y < context.clientHeight - STATUSBAR_HEIGHT;
+}
+
+static bool ApplyButtonDown(const ReplayContext& context, int x, int y)
+{
+    AppState& app = AppState::Instance();
+    
+    if (y < TOOLBAR_HEIGHT) {
+        if (x < 300) {
+            int toolIndex = x / 50;
+            if (toolIndex >= 0 && toolIndex < 6) DrawingEngine::SetTool((ToolType)toolIndex);
+        } else if (x >= 350 && x < 542) {
+            int colorIndex = (x - 350) / 12;
+            if (colorIndex >= 0 && colorIndex < 16) DrawingEngine::SetColor(colorPalette[colorIndex]);
+        } else if (x >= 545 && x <= 590) {
+            app.showAdvancedColorPicker = !app.showAdvancedColorPicker;
+        } else if (x >= 600 && x <= 700) {
+            DrawingEngine::SetBrushSize(1 + ((x - 600) * 19) / 100);
+        } else {
+            return false;   // Theme toggle and empty toolbar space
+        }
+        return true;
+    }
+    
+    if (app.showAdvancedColorPicker &&
+        x >= app.pickerX && x <= app.pickerX + 200 && y >= app.pickerY && y <= app.pickerY + 200) {
+        int dx = x - (app.pickerX + 100);
+        int dy = y - (app.pickerY + 100);
+        float distance = sqrt(dx * dx + dy * dy);
+        if (distance <= 80) {
+            float angle = atan2(dy, dx) * 180.0f / 3.14159f;
+            if (angle < 0) angle += 360;
+            DrawingEngine::SetColor(DrawingEngine::HSVtoRGB(angle, distance / 80.0f, 0.9f));
+        }
+        return true;
+    }
+    
+    // The color picker tool samples the screen, which a headless replay does not have
+    if (!InCanvas(context, y) || app.currentTool == TOOL_PICKER) {
+        return false;
+    }
+    DrawingEngine::StartDrawing(ScreenToWorldX(x, app), ScreenToWorldY(y, app));
+    return true;
+}
+
+// What DocumentJournal::NewDocument does to the document; a replay has no
+// files attached, so none are touched
+static void NewCanvas()
+{
+    AppState& app = AppState::Instance();
+    app.drawingPoints.clear();
+    app.undoStack.clear();
+    app.redoStack.clear();
+}
+
+static bool ApplyKeyDown(int key, bool ctrl)
+{
+    AppState& app = AppState::Instance();
+    
+    switch (key) {
+        case 'Z': if (!ctrl) return false; DrawingEngine::Undo(); return true;
+        case 'Y': if (!ctrl) return false; DrawingEngine::Redo(); return true;
+        case 'N': if (!ctrl) return false; NewCanvas(); return true;
+        case 'G': app.showGrid = !app.showGrid; return true;
+        case 'B': DrawingEngine::SetTool(TOOL_BRUSH); return true;
+        case 'E': DrawingEngine::SetTool(TOOL_ERASER); return true;
+        case 'R': DrawingEngine::SetTool(TOOL_RECTANGLE); return true;
+        case 'C': DrawingEngine::SetTool(TOOL_CIRCLE); return true;
+        case 'L': DrawingEngine::SetTool(TOOL_LINE); return true;
+    }
+    if (key >= '1' && key <= '9') {
+        DrawingEngine::SetBrushSize((key - '0') * 2);
+        return true;
+    }
+    return false;   // Theme, dialogs, help and exit
+}
+
+static bool ApplyCommand(int command)
+{
+    AppState& app = AppState::Instance();
+    
+    switch (command) {
+        case IDM_FILE_NEW:      NewCanvas(); return true;
+        case IDM_EDIT_CLEAR:    DrawingEngine::ClearCanvas(); return true;
+        case IDM_EDIT_UNDO:     DrawingEngine::Undo(); return true;
+        case IDM_EDIT_REDO:     DrawingEngine::Redo(); return true;
+        case IDM_VIEW_ZOOM_IN:  app.zoomLevel = (app.zoomLevel * 1.1f > 5.0f) ? 5.0f : app.zoomLevel * 1.1f; return true;
+        case IDM_VIEW_ZOOM_OUT: app.zoomLevel = (app.zoomLevel / 1.1f < 0.2f) ? 0.2f : app.zoomLevel / 1.1f; return true;
+        case IDM_VIEW_ZOOM_FIT: app.zoomLevel = 1.0f; app.panX = app.panY = 0; return true;
+        case IDM_VIEW_GRID:     app.showGrid = !app.showGrid; return true;
+        case IDM_TOOLS_BRUSH:   DrawingEngine::SetTool(TOOL_BRUSH); return true;
+        case IDM_TOOLS_ERASER:  DrawingEngine::SetTool(TOOL_ERASER); return true;
+        case IDM_TOOLS_RECT:    DrawingEngine::SetTool(TOOL_RECTANGLE); return true;
+        case IDM_TOOLS_CIRCLE:  DrawingEngine::SetTool(TOOL_CIRCLE); return true;
+        case IDM_TOOLS_LINE:    DrawingEngine::SetTool(TOOL_LINE); return true;
+    }
+    return false;   // File dialogs, theme and help
+}
+
+static bool ApplyEvent(ReplayContext& context, const Event& event)
+{
+    TRACE_SCOPE(TraceEvents::CAT_INPUT, EventName(event.type));
+    AppState& app = AppState::Instance();
+    
+    switch (event.type) {
+        case EVENT_BUTTON_DOWN:
+            return ApplyButtonDown(context, event.x, event.y);
+        
+        case EVENT_MOUSE_MOVE:
+            // Moves without the button only update the hover preview
+            if (!(event.flags & FLAG_LBUTTON) || !InCanvas(context, event.y) || app.currentTool == TOOL_PICKER) {
+                return false;
+            }
+            DrawingEngine::ContinueDrawing(ScreenToWorldX(event.x, app), ScreenToWorldY(event.y, app));
+            return true;
+        
+        case EVENT_BUTTON_UP:
+            DrawingEngine::EndDrawing();
+            return true;
+        
+        case EVENT_KEY_DOWN:
+            return ApplyKeyDown(event.code, (event.flags & FLAG_CTRL) != 0);
+        
+        case EVENT_COMMAND:
+            return ApplyCommand(event.code);
+        
+        case EVENT_MOUSE_WHEEL:
+            if (event.flags & FLAG_CTRL) {
+                if (event.code > 0) {
+                    app.zoomLevel = (app.zoomLevel * 1.1f > 5.0f) ? 5.0f : app.zoomLevel * 1.1f;
+                } else {
+                    app.zoomLevel = (app.zoomLevel / 1.1f < 0.2f) ? 0.2f : app.zoomLevel / 1.1f;
+                }
+            } else {
+                app.panY += (event.code > 0) ? 20 : -20;
+            }
+            return true;
+        
+        case EVENT_RESIZE:
+            context.clientWidth = event.x;
+            context.clientHeight = event.y;
+            return true;
+        
+        default:
+            return false;
+    }
+}
+
+// Renders the visible canvas like OnPaintSoftware, then copies it out as BitBlt would
+static void PaintFrame(const ReplayContext& context, std::vector<uint32_t>& canvas, std::vector<uint32_t>& screen)
+{
+    AppState& app = AppState::Instance();
+    int width = std::max(1, context.clientWidth);
+    int height = std::max(1, context.clientHeight - TOOLBAR_HEIGHT - STATUSBAR_HEIGHT);
+    canvas.resize((size_t)width * height);
+    screen.resize(canvas.size());
+    
+    FrameProfiler::BeginFrame(false);
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_STROKES);
+        RasterRenderer::View view;
+        view.originX = -app.panX / app.zoomLevel;
+        view.originY = -app.panY / app.zoomLevel;
+        view.scale = app.zoomLevel;
+        RasterRenderer::RenderRows(app.drawingPoints, view, width, 0, height, RGB(255, 255, 255), canvas.data());
+    }
+    {
+        FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_PRESENT);
+        std::copy(canvas.begin(), canvas.end(), screen.begin());
+    }
+    FrameProfiler::EndFrame((uint32_t)app.drawingPoints.size());
+}
+
+static Latency Summarize(std::vector<double>& micros)
+{
+    Latency latency;
+    latency.count = micros.size();
+    if (micros.empty()) {
+        return latency;
+    }
+    
+    std::sort(micros.begin(), micros.end());
+    auto rank = [&micros](double percentile) {
+        size_t index = (size_t)std::ceil(percentile * micros.size());
+        return micros[std::min(micros.size() - 1, index > 0 ? index - 1 : 0)];
+    };
+    latency.p50Micros = rank(0.50);
+    latency.p90Micros = rank(0.90);
+    latency.p99Micros = rank(0.99);
+    latency.maxMicros = micros.back();
+    return latency;
+}
+
+ReplayStats Replay(const Trace& trace, bool paced)
+{
+    const Session& session = trace.session;
+    AppState& app = AppState::Instance();
+    
+    // Undo history from before the recording is not part of the trace
+    app.drawingPoints = session.document;
+    app.undoStack.clear();
+    app.redoStack.clear();
+    app.isDrawing = false;
+    app.hasPreview = false;
+    app.zoomLevel = session.zoomLevel;
+    app.panX = session.panX;
+    app.panY = session.panY;
+    app.currentTool = session.tool;
+    app.brushSize = session.brushSize;
+    app.currentColor = session.color;
+    app.showAdvancedColorPicker = session.showAdvancedColorPicker;
+    app.pickerX = session.pickerX;
+    app.pickerY = session.pickerY;
+    
+    ReplayContext context = { session.clientWidth, session.clientHeight };
+    ReplayStats stats;
+    std::vector<double> all;
+    std::vector<double> byType[EVENT_TYPE_COUNT];
+    uint64_t typeAllocations[EVENT_TYPE_COUNT] = {};
+    all.reserve(trace.events.size());
+    
+    // Paced replays measure from each event's recorded arrival, so time spent
+    // behind schedule counts as latency
+    std::vector<double> presentLatency;
+    std::vector<uint32_t> canvas, screen;
+    bool dirty = false;
+    if (paced) {
+        FrameProfiler::Reset();
+        FrameProfiler::SetLatencySink(&presentLatency);
+    }
+    
+    Clock::time_point start = Clock::now();
+    uint64_t startMicros = FrameProfiler::NowMicros();
+    for (const Event& event : trace.events) {
+        if (paced) {
+            Clock::time_point due = start + std::chrono::microseconds(event.timeMicros);
+            if (dirty && Clock::now() < due) {
+                PaintFrame(context, canvas, screen);
+                stats.frames++;
+                dirty = false;
+            }
+            std::this_thread::sleep_until(due);
+            FrameProfiler::InputArrived(startMicros + event.timeMicros);
+        }
+        
+        Clock::time_point before = Clock::now();
+        AllocStats::Scope allocations;
+        bool applied = ApplyEvent(context, event);
+        AllocStats::Counters allocated = allocations.Elapsed();
+        double micros = std::chrono::duration<double, std::micro>(Clock::now() - before).count();
+        
+        stats.events++;
+        if (!applied) {
+            stats.ignored++;
+        }
+        dirty = dirty || applied;
+        all.push_back(micros);
+        byType[event.type].push_back(micros);
+        stats.allocated.allocations += allocated.allocations;
+        stats.allocated.frees += allocated.frees;
+        stats.allocated.bytes += allocated.bytes;
+        stats.maxEventAllocations = std::max(stats.maxEventAllocations, allocated.allocations);
+        typeAllocations[event.type] += allocated.allocations;
+    }
+    if (paced) {
+        if (dirty) {
+            PaintFrame(context, canvas, screen);
+            stats.frames++;
+        }
+        FrameProfiler::SetLatencySink(nullptr);
+        stats.paint = FrameProfiler::Summarize();
+        FrameProfiler::SummarizeLatency(presentLatency, stats.paint);
+    }
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    stats.eventsPerSecond = stats.seconds > 0 ? stats.events / stats.seconds : 0.0;
+    
+    stats.all = Summarize(all);
+    if (stats.events > 0) {
+        stats.all.allocationsPerEvent = (double)stats.allocated.allocations / stats.events;
+    }
+    for (int type = 0; type < EVENT_TYPE_COUNT; type++) {
+        stats.byType[type] = Summarize(byType[type]);
+        if (!byType[type].empty()) {
+            stats.byType[type].allocationsPerEvent = (double)typeAllocations[type] / byType[type].size();
+        }
+    }
+    return stats;
+}
+
+const char* EventName(EventType type)
+{
+    switch (type) {
+        case EVENT_BUTTON_DOWN: return "button down";
+        case EVENT_MOUSE_MOVE:  return "mouse move";
+        case EVENT_BUTTON_UP:   return "button up";
+        case EVENT_KEY_DOWN:    return "key down";
+        case EVENT_COMMAND:     return "command";
+        case EVENT_MOUSE_WHEEL: return "mouse wheel";
+        case EVENT_RESIZE:      return "resize";
+        default:                return "unknown";
+    }
+}
+
+} // namespace InputTrace
@@ -0,0 +1,299 @@
+#include "../../include/job_pool.h"
+#include "../../include/trace_events.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+namespace JobPool {
+
+struct Job {
+    JobId id = 0;
+    std::string name;
+    Work work;
+    Completion done;
+    std::atomic<bool> cancelled{false};
+    std::atomic<int> permille{0};      // Progress
+    std::atomic<int> notifiedPercent{0};
+    bool running = false;              // Under poolLock
+    Result result = JOB_FAILED;
+};
+
+static std::vector<std::thread> workers;
+static std::atomic<bool> running{false};
+static std::function<void()> notify;
+static std::atomic<bool> notifyPending{false};
+
+// Queued and running jobs in submission order, the queued ones also in
+// 'queue'; finished jobs wait in 'finished' for HandleCompleted
+static std::mutex poolLock;
+static std::condition_variable workSignal;
+static bool stopRequested = false;
+static std::deque<std::shared_ptr<Job>> active;
+static std::deque<std::shared_ptr<Job>> queue;
+static std::deque<std::shared_ptr<Job>> finished;
+static JobId nextId = 0;
+static Stats stats;
+
+static void Notify()
+{
+    if (notify && !notifyPending.exchange(true)) {
+        notify();
+    }
+}
+
+void Progress::Report(double fraction) const
+{
+    int permille = (int)(std::max(0.0, std::min(1.0, fraction)) * 1000.0);
+    job.permille.store(permille, std::memory_order_relaxed);
+    
+    // Redraws of the status bar follow whole percents
+    int percent = permille / 10;
+    int notified = job.notifiedPercent.load(std::memory_order_relaxed);
+    if (percent > notified && job.notifiedPercent.compare_exchange_strong(notified, percent)) {
+        Notify();
+    }
+}
+
+bool Progress::Cancelled() const
+{
+    return job.cancelled.load(std::memory_order_relaxed);
+}
+
+static Result Run(Job& job)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "Job");
+    bool ok = false;
+    if (!job.cancelled.load()) {
+        ok = job.work(Progress(job));
+    }
+    return ok ? JOB_SUCCEEDED : job.cancelled.load() ? JOB_CANCELLED : JOB_FAILED;
+}
+
+// Called with poolLock held
+static void Finish(const std::shared_ptr<Job>& job, Result result)
+{
+    job->result = result;
+    job->work = nullptr;               // Releases what the work captured
+    active.erase(std::find(active.begin(), active.end(), job));
+    finished.push_back(job);
+    switch (result) {
+        case JOB_SUCCEEDED: stats.succeeded++; break;
+        case JOB_FAILED:    stats.failed++; break;
+        case JOB_CANCELLED: stats.cancelled++; break;
+    }
+}
+
+static void WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(poolLock);
+    for (;;) {
+        workSignal.wait(lock, []() { return stopRequested || !queue.empty(); });
+        if (stopRequested) {
+            return;
+        }
+        std::shared_ptr<Job> job = queue.front();
+        queue.pop_front();
+        job->running = true;
+        
+        lock.unlock();
+        Result result = Run(*job);
+        lock.lock();
+        
+        Finish(job, result);
+        lock.unlock();
+        Notify();
+        lock.lock();
+    }
+}
+
+bool Start(int workerCount, std::function<void()> notifyFn)
+{
+    if (running) {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(poolLock);
+        stopRequested = false;
+    }
+    notify = std::move(notifyFn);
+    notifyPending = false;
+    
+    workerCount = std::max(1, std::min(MAX_WORKERS, workerCount));
+    try {
+        for (int i = 0; i < workerCount; i++) {
+            workers.emplace_back(WorkerLoop);
+        }
+    } catch (const std::system_error&) {
+        if (workers.empty()) {
+            notify = nullptr;
+            return false;
+        }
+    }
+    running = true;
+    return true;
+}
+
+void Stop()
+{
+    if (!running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(poolLock);
+        stopRequested = true;
+        for (const std::shared_ptr<Job>& job : active) {
+            job->cancelled = true;
+        }
+    }
+    workSignal.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    
+    // Queued jobs never ran. Every completion still pending runs here, oldest
+    // first: one may be what keeps a finished job's output (a save's rename)
+    std::deque<std::shared_ptr<Job>> completed;
+    {
+        std::lock_guard<std::mutex> lock(poolLock);
+        while (!queue.empty()) {
+            Finish(queue.front(), JOB_CANCELLED);
+            queue.pop_front();
+        }
+        completed.swap(finished);
+        notifyPending = false;
+        running = false;
+        notify = nullptr;
+    }
+    for (const std::shared_ptr<Job>& job : completed) {
+        if (job->done) {
+            job->done(job->result);
+        }
+    }
+}
+
+bool IsRunning()
+{
+    return running;
+}
+
+JobId Submit(const std::string& name, Work work, Completion done)
+{
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->name = name;
+    job->work = std::move(work);
+    job->done = std::move(done);
+    
+    if (!running) {
+        {
+            std::lock_guard<std::mutex> lock(poolLock);
+            job->id = ++nextId;
+            stats.submitted++;
+            active.push_back(job);
+            job->running = true;
+        }
+        Result result = Run(*job);
+        {
+            std::lock_guard<std::mutex> lock(poolLock);
+            Finish(job, result);
+            finished.erase(std::find(finished.begin(), finished.end(), job));
+        }
+        if (job->done) {
+            job->done(result);
+        }
+        return job->id;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(poolLock);
+        job->id = ++nextId;
+        stats.submitted++;
+        active.push_back(job);
+        queue.push_back(job);
+    }
+    workSignal.notify_one();
+    return job->id;
+}
+
+void Cancel(JobId id)
+{
+    bool dequeued = false;
+    {
+        std::lock_guard<std::mutex> lock(poolLock);
+        for (const std::shared_ptr<Job>& job : active) {
+            if (job->id != id) continue;
+            job->cancelled = true;
+            if (!job->running) {
+                // Completes now, in order with the jobs that ran
+                queue.erase(std::find(queue.begin(), queue.end(), job));
+                Finish(job, JOB_CANCELLED);
+                dequeued = true;
+            }
+            break;
+        }
+    }
+    if (dequeued) {
+        Notify();
+    }
+}
+
+void CancelAll()
+{
+    std::vector<JobId> ids;
+    {
+        std::lock_guard<std::mutex> lock(poolLock);
+        for (const std::shared_ptr<Job>& job : active) {
+            ids.push_back(job->id);
+        }
+    }
+    for (JobId id : ids) {
+        Cancel(id);
+    }
+}
+
+size_t HandleCompleted()
+{
+    std::deque<std::shared_ptr<Job>> completed;
+    {
+        std::lock_guard<std::mutex> lock(poolLock);
+        completed.swap(finished);
+        notifyPending = false;
+    }
+    
+    for (const std::shared_ptr<Job>& job : completed) {
+        if (job->done) {
+            job->done(job->result);
+        }
+    }
+    return completed.size();
+}
+
+std::vector<JobStatus> ActiveJobs()
+{
+    std::lock_guard<std::mutex> lock(poolLock);
+    std::vector<JobStatus> jobs;
+    jobs.reserve(active.size());
+    for (const std::shared_ptr<Job>& job : active) {
+        JobStatus status;
+        status.id = job->id;
+        status.name = job->name;
+        status.progress = job->permille.load(std::memory_order_relaxed) / 1000.0;
+        status.running = job->running;
+        status.cancelling = job->cancelled.load();
+        jobs.push_back(status);
+    }
+    return jobs;
+}
+
+Stats GetStats()
+{
+    std::lock_guard<std::mutex> lock(poolLock);
+    return stats;
+}
+
+}
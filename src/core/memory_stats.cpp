@@ -0,0 +1,118 @@
+#include "../../include/memory_stats.h"
+#include "../../include/app_state.h"
+#include <atomic>
+#include <cstdio>
+
+namespace MemoryStats {
+
+static std::atomic<int64_t> tracked[MEM_COUNT];
+static std::atomic<int64_t> peaks[MEM_COUNT];
+
+static void Adjust(Subsystem subsystem, int64_t delta)
+{
+    int64_t now = tracked[subsystem].fetch_add(delta, std::memory_order_relaxed) + delta;
+    int64_t peak = peaks[subsystem].load(std::memory_order_relaxed);
+    while (now > peak && !peaks[subsystem].compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+}
+
+// Heap bytes held by a snapshot stack, including the vector of states itself
+static size_t StackBytes(const std::vector<UndoState>& stack)
+{
+    size_t bytes = stack.capacity() * sizeof(UndoState);
+    for (const UndoState& state : stack) {
+        bytes += state.points.capacity() * sizeof(DrawPoint);
+    }
+    return bytes;
+}
+
+Allocation::Allocation(Subsystem subsystem, size_t bytes)
+    : subsystem(subsystem), bytes(0)
+{
+    Resize(bytes);
+}
+
+Allocation::~Allocation()
+{
+    Resize(0);
+}
+
+void Allocation::Resize(size_t newBytes)
+{
+    if (newBytes == bytes) return;
+    Adjust(subsystem, (int64_t)newBytes - (int64_t)bytes);
+    bytes = newBytes;
+}
+
+size_t TrackedBytes(Subsystem subsystem)
+{
+    int64_t bytes = tracked[subsystem].load(std::memory_order_relaxed);
+    return bytes > 0 ? (size_t)bytes : 0;
+}
+
+void ResetPeaks()
+{
+    for (int subsystem = 0; subsystem < MEM_COUNT; subsystem++) {
+        peaks[subsystem].store(tracked[subsystem].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+Report Collect()
+{
+    AppState& app = AppState::Instance();
+    Report report;
+    report.bytes[MEM_DOCUMENT] = app.drawingPoints.capacity() * sizeof(DrawPoint);
+    report.bytes[MEM_UNDO] = StackBytes(app.undoStack);
+    report.bytes[MEM_REDO] = StackBytes(app.redoStack);
+    for (int subsystem = 0; subsystem < MEM_COUNT; subsystem++) {
+        report.bytes[subsystem] += TrackedBytes((Subsystem)subsystem);
+        int64_t peak = peaks[subsystem].load(std::memory_order_relaxed);
+        report.peakBytes[subsystem] = peak > 0 ? (size_t)peak : 0;
+        if (report.peakBytes[subsystem] < report.bytes[subsystem]) {
+            report.peakBytes[subsystem] = report.bytes[subsystem];
+        }
+        report.totalBytes += report.bytes[subsystem];
+    }
+    report.points = app.drawingPoints.size();
+    report.undoStates = app.undoStack.size();
+    report.redoStates = app.redoStack.size();
+    return report;
+}
+
+std::string FormatReport(const Report& report)
+{
+    char line[160];
+    std::string text;
+    for (int subsystem = 0; subsystem < MEM_COUNT; subsystem++) {
+        std::snprintf(line, sizeof(line), "%-13s %10.2f MB   (peak %.2f MB)\n", SubsystemName((Subsystem)subsystem),
+                      report.bytes[subsystem] / 1048576.0, report.peakBytes[subsystem] / 1048576.0);
+        text += line;
+    }
+    std::snprintf(line, sizeof(line), "%-13s %10.2f MB   %zu points, %zu undo / %zu redo snapshots\n", "total",
+                  report.totalBytes / 1048576.0, report.points, report.undoStates, report.redoStates);
+    text += line;
+    return text;
+}
+
+bool WriteReport(const std::string& filename)
+{
+    std::FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    
+    std::string text = FormatReport(Collect());
+    bool ok = std::fprintf(file, "# Modern Paint Studio Pro memory usage\n") > 0 &&
+              std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    return (std::fclose(file) == 0) && ok;
+}
+
+const char* SubsystemName(Subsystem subsystem)
+{
+    static const char* names[MEM_COUNT] = {
+        "document", "undo", "redo", "reference", "raster", "gpu", "file_buffers"
+    };
+    return (subsystem >= 0 && subsystem < MEM_COUNT) ? names[subsystem] : "unknown";
+}
+
+} // namespace MemoryStats
@@ -0,0 +1,228 @@
+#include "../../include/trace_events.h"
+
+#ifdef MPS_TRACE_EVENTS
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace TraceEvents {
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t CHUNK_EVENTS = 4096;
+
+// One buffer per thread that ever recorded an event. Buffers outlive their
+// threads so a flush at exit still sees short-lived workers. Events fill
+// fixed chunks, so recording never copies what is already there; chunks come
+// from malloc, keeping the timeline's own memory out of AllocStats.
+struct ThreadBuffer {
+    std::mutex lock;               // Only contended while flushing
+    Event* chunks[MAX_EVENTS_PER_THREAD / CHUNK_EVENTS] = {};   // Allocated as they fill; kept by Clear
+    size_t count = 0;
+    size_t dropped = 0;
+    uint32_t threadId = 0;
+    std::string threadName;
+};
+
+static const Clock::time_point origin = Clock::now();
+static std::mutex registryLock;
+static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+static thread_local ThreadBuffer* localBuffer = nullptr;
+static std::string exitFilename;
+
+static uint64_t NowNanos()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count();
+}
+
+static ThreadBuffer& LocalBuffer()
+{
+    if (!localBuffer) {
+        std::lock_guard<std::mutex> guard(registryLock);
+        buffers.emplace_back(new ThreadBuffer());
+        localBuffer = buffers.back().get();
+        localBuffer->threadId = (uint32_t)buffers.size();
+    }
+    return *localBuffer;
+}
+
+static void Append(const Event& event)
+{
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    if (buffer.count >= MAX_EVENTS_PER_THREAD) {
+        buffer.dropped++;
+        return;
+    }
+    Event*& chunk = buffer.chunks[buffer.count / CHUNK_EVENTS];
+    if (!chunk) {
+        chunk = (Event*)std::malloc(CHUNK_EVENTS * sizeof(Event));
+        if (!chunk) {
+            buffer.dropped++;
+            return;
+        }
+    }
+    new (&chunk[buffer.count % CHUNK_EVENTS]) Event(event);
+    buffer.count++;
+}
+
+// Names are our own literals, but thread names come from callers
+static void WriteString(std::FILE* file, const char* text)
+{
+    std::fputc('"', file);
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            std::fputc('\\', file);
+            std::fputc(*c, file);
+        } else if ((unsigned char)*c < 0x20) {
+            std::fprintf(file, "\\u%04x", (unsigned char)*c);
+        } else {
+            std::fputc(*c, file);
+        }
+    }
+    std::fputc('"', file);
+}
+
+static void WriteEvent(std::FILE* file, const Event& event, uint32_t threadId)
+{
+    std::fprintf(file, ",\n{\"ph\":\"%s\",\"cat\":\"%s\",\"name\":", event.instant ? "i" : "X",
+                 CategoryName(event.category));
+    WriteString(file, event.name);
+    std::fprintf(file, ",\"pid\":1,\"tid\":%u,\"ts\":%.3f", threadId, event.startNanos / 1000.0);
+    if (event.instant) {
+        std::fprintf(file, ",\"s\":\"t\"");
+    } else {
+        std::fprintf(file, ",\"dur\":%.3f", event.durationNanos / 1000.0);
+    }
+    if (event.argName) {
+        std::fprintf(file, ",\"args\":{");
+        WriteString(file, event.argName);
+        std::fprintf(file, ":%lld}", (long long)event.arg);
+    }
+    std::fputc('}', file);
+}
+
+static void FlushAtExit()
+{
+    Flush(exitFilename);
+}
+
+Scope::Scope(Category category, const char* name, const char* argName, int64_t arg)
+    : name(name), argName(argName), arg(arg), startNanos(NowNanos()), category(category)
+{
+}
+
+Scope::~Scope()
+{
+    if (!name) return;
+    Event event;
+    event.name = name;
+    event.argName = argName;
+    event.arg = arg;
+    event.startNanos = startNanos;
+    event.durationNanos = NowNanos() - startNanos;
+    event.category = category;
+    Append(event);
+}
+
+void Instant(Category category, const char* name)
+{
+    if (!name) return;
+    Event event;
+    event.name = name;
+    event.startNanos = NowNanos();
+    event.category = category;
+    event.instant = true;
+    Append(event);
+}
+
+void SetThreadName(const char* name)
+{
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    buffer.threadName = name;
+}
+
+bool Flush(const std::string& filename)
+{
+    std::FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    std::fprintf(file, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"Modern Paint Studio Pro\"}}");
+    
+    std::lock_guard<std::mutex> registryGuard(registryLock);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        std::lock_guard<std::mutex> guard(buffer->lock);
+        if (!buffer->threadName.empty()) {
+            std::fprintf(file, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                         buffer->threadId);
+            WriteString(file, buffer->threadName.c_str());
+            std::fprintf(file, "}}");
+        }
+        for (size_t i = 0; i < buffer->count; i++) {
+            WriteEvent(file, buffer->chunks[i / CHUNK_EVENTS][i % CHUNK_EVENTS], buffer->threadId);
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+void FlushOnExit(const std::string& defaultFilename)
+{
+    const char* overridden = std::getenv("MPS_TRACE_FILE");
+    bool registered = !exitFilename.empty();
+    exitFilename = (overridden && *overridden) ? overridden : defaultFilename;
+    if (!registered) {
+        std::atexit(FlushAtExit);
+    }
+}
+
+size_t EventCount()
+{
+    std::lock_guard<std::mutex> registryGuard(registryLock);
+    size_t count = 0;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        std::lock_guard<std::mutex> guard(buffer->lock);
+        count += buffer->count;
+    }
+    return count;
+}
+
+size_t DroppedCount()
+{
+    std::lock_guard<std::mutex> registryGuard(registryLock);
+    size_t dropped = 0;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        std::lock_guard<std::mutex> guard(buffer->lock);
+        dropped += buffer->dropped;
+    }
+    return dropped;
+}
+
+void Clear()
+{
+    std::lock_guard<std::mutex> registryGuard(registryLock);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        std::lock_guard<std::mutex> guard(buffer->lock);
+        buffer->count = 0;
+        buffer->dropped = 0;
+    }
+}
+
+const char* CategoryName(Category category)
+{
+    static const char* names[CAT_COUNT] = { "input", "document", "undo", "raster", "file_io", "paint" };
+    return category < CAT_COUNT ? names[category] : "unknown";
+}
+
+} // namespace TraceEvents
+
+#endif // MPS_TRACE_EVENTS
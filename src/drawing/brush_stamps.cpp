@@ -0,0 +1,32 @@
+#include "../../include/brush_stamps.h"
+#include "../../include/config.h"
+#include <algorithm>
+
+namespace BrushStamps {
+
+double Spacing(int brushSize)
+{
+    return std::max(MIN_STAMP_SPACING, STAMP_SPACING * std::max(1, brushSize));
+}
+
+size_t StrokeStamps(const std::vector<DrawPoint>& points, size_t start)
+{
+    if (start >= points.size() || points[start].toolType != TOOL_BRUSH) {
+        return 0;
+    }
+    
+    size_t stamps = 1;   // The start point
+    double carried = 0.0;
+    for (size_t i = start + 1; i < points.size() && points[i].toolType == TOOL_BRUSH && !points[i].isStart; i++) {
+        const DrawPoint& from = points[i - 1];
+        const DrawPoint& to = points[i];
+        carried = WalkSegment(from.x, from.y, to.x, to.y, Spacing(to.brushSize), carried,
+                              [&stamps](double, double) { stamps++; });
+        if (EndsStroke(points, i) && carried > 0.0) {
+            stamps++;
+        }
+    }
+    return stamps;
+}
+
+}
@@ -0,0 +1,212 @@
+#include "../../include/document_generator.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/app_state.h"
+#include <algorithm>
+#include <cmath>
+
+namespace DocumentGenerator {
+
+static const double PI = 3.14159265358979323846;
+
+// splitmix64: the std distributions differ between standard libraries
+struct Random {
+    uint64_t state;
+};
+
+static uint64_t NextBits(Random& random)
+{
+    uint64_t z = (random.state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// [low, high)
+static double Uniform(Random& random, double low = 0.0, double high = 1.0)
+{
+    return low + (high - low) * ((NextBits(random) >> 11) * (1.0 / 9007199254740992.0));
+}
+
+// Standard normal (Box-Muller, one value per call)
+static double Normal(Random& random)
+{
+    double u = 1.0 - Uniform(random);
+    return std::sqrt(-2.0 * std::log(u)) * std::cos(2.0 * PI * Uniform(random));
+}
+
+struct Generator {
+    const Params& params;
+    Random random;
+    std::vector<COLORREF> palette;
+    std::vector<std::pair<double, double>> centers;
+};
+
+static size_t StrokeLength(Generator& gen)
+{
+    double length = gen.params.medianLength * std::exp(gen.params.lengthSigma * Normal(gen.random));
+    return std::max<size_t>(2, std::min(gen.params.maxLength, (size_t)length));
+}
+
+// Log-uniform: small brushes are more common than large ones
+static int BrushSize(Generator& gen)
+{
+    int low = std::max(1, gen.params.minBrushSize);
+    int high = std::max(low, gen.params.maxBrushSize);
+    double size = std::exp(Uniform(gen.random, std::log((double)low), std::log(high + 1.0)));
+    return std::min(high, (int)size);
+}
+
+// Early palette entries are the favourites, as in real drawings
+static COLORREF StrokeColor(Generator& gen)
+{
+    if (gen.palette.empty()) {
+        uint64_t bits = NextBits(gen.random);
+        return RGB(bits & 0xFF, (bits >> 8) & 0xFF, (bits >> 16) & 0xFF);
+    }
+    double u = Uniform(gen.random);
+    return gen.palette[std::min(gen.palette.size() - 1, (size_t)(u * u * gen.palette.size()))];
+}
+
+static ShapeKind StrokeKind(Generator& gen)
+{
+    double total = 0.0;
+    for (double weight : gen.params.shapeWeights) total += std::max(0.0, weight);
+    if (total <= 0.0) return SHAPE_BRUSH;
+    
+    double pick = Uniform(gen.random) * total;
+    for (int kind = 0; kind < SHAPE_KIND_COUNT; kind++) {
+        pick -= std::max(0.0, gen.params.shapeWeights[kind]);
+        if (pick < 0.0) return (ShapeKind)kind;
+    }
+    return SHAPE_BRUSH;
+}
+
+static int ClampX(const Generator& gen, double x)
+{
+    return std::max(0, std::min(gen.params.canvasWidth - 1, (int)std::lround(x)));
+}
+
+static int ClampY(const Generator& gen, double y)
+{
+    return std::max(0, std::min(gen.params.canvasHeight - 1, (int)std::lround(y)));
+}
+
+static void StartPoint(Generator& gen, int& x, int& y)
+{
+    if (gen.centers.empty()) {
+        x = ClampX(gen, Uniform(gen.random, 0.0, gen.params.canvasWidth));
+        y = ClampY(gen, Uniform(gen.random, 0.0, gen.params.canvasHeight));
+        return;
+    }
+    const std::pair<double, double>& center = gen.centers[NextBits(gen.random) % gen.centers.size()];
+    x = ClampX(gen, center.first + Normal(gen.random) * gen.params.clusterSpread);
+    y = ClampY(gen, center.second + Normal(gen.random) * gen.params.clusterSpread);
+}
+
+// Mouse-like samples: steady speed per stroke and a gently curving heading
+// that bounces off the canvas edges
+static void AddBrushStroke(Generator& gen, std::vector<DrawPoint>& points, size_t length, size_t limit)
+{
+    AppState& app = AppState::Instance();
+    int startX, startY;
+    StartPoint(gen, startX, startY);
+    double x = startX;
+    double y = startY;
+    double heading = Uniform(gen.random, 0.0, 2.0 * PI);
+    double turn = Normal(gen.random) * 0.02;
+    double speed = 3.0 * std::exp(0.5 * Normal(gen.random));
+    
+    for (size_t i = 0; i < length && points.size() < limit; i++) {
+        points.push_back({ClampX(gen, x), ClampY(gen, y), app.currentColor, i == 0, app.brushSize, TOOL_BRUSH});
+        
+        turn = turn * 0.9 + Normal(gen.random) * 0.03;
+        heading += turn;
+        x += std::cos(heading) * speed;
+        y += std::sin(heading) * speed;
+        if (x < 0.0 || x > gen.params.canvasWidth - 1) heading = PI - heading;
+        if (y < 0.0 || y > gen.params.canvasHeight - 1) heading = -heading;
+    }
+}
+
+// Extents are chosen so the rasterized outline has about 'length' points
+static void AddShape(Generator& gen, ShapeKind kind, size_t length)
+{
+    int x, y;
+    StartPoint(gen, x, y);
+    
+    if (kind == SHAPE_LINE) {
+        double angle = Uniform(gen.random, 0.0, 2.0 * PI);
+        DrawingEngine::DrawLine(x, y, ClampX(gen, x + std::cos(angle) * length), ClampY(gen, y + std::sin(angle) * length));
+    } else if (kind == SHAPE_RECTANGLE) {
+        double aspect = Uniform(gen.random, 0.25, 0.75);
+        int width = std::max(1, (int)(length * aspect / 2));
+        int height = std::max(1, (int)(length * (1.0 - aspect) / 2));
+        DrawingEngine::DrawRectangle(x, y, ClampX(gen, x + width), ClampY(gen, y + height));
+    } else {
+        // Kept inside the canvas; an outline has about 5.66 points per pixel of radius
+        int radius = std::max(1, (int)(length / 5.66));
+        int room = std::min(std::min(x, gen.params.canvasWidth - 1 - x), std::min(y, gen.params.canvasHeight - 1 - y));
+        DrawingEngine::DrawCircle(x, y, std::max(0, std::min(radius, room)));
+    }
+}
+
+Stats Generate(const Params& params, std::vector<DrawPoint>& points)
+{
+    AppState& app = AppState::Instance();
+    Stats stats;
+    points.clear();
+    
+    // Shapes are rasterized into AppState, so the document is built there and
+    // swapped out; the caller's document and settings are left as they were
+    bool borrowed = &points != &app.drawingPoints;
+    if (borrowed) {
+        app.drawingPoints.swap(points);
+    }
+    COLORREF savedColor = app.currentColor;
+    int savedBrushSize = app.brushSize;
+    
+    std::vector<DrawPoint>& document = app.drawingPoints;
+    size_t limit = params.points > 0 ? params.points : SIZE_MAX;
+    if (params.points > 0) {
+        document.reserve(params.points);
+    }
+    
+    Generator gen = {params, {params.seed}, {}, {}};
+    for (int i = 0; i < params.colors; i++) {
+        gen.palette.push_back(DrawingEngine::HSVtoRGB((float)Uniform(gen.random, 0.0, 359.0),
+                                                      (float)Uniform(gen.random, 0.4, 1.0),
+                                                      (float)Uniform(gen.random, 0.3, 1.0)));
+    }
+    for (int i = 0; i < params.clusters; i++) {
+        gen.centers.push_back({Uniform(gen.random, 0.0, params.canvasWidth), Uniform(gen.random, 0.0, params.canvasHeight)});
+    }
+    
+    bool bounded = params.points > 0 || params.strokes > 0;
+    while (bounded && document.size() < limit && (params.strokes == 0 || stats.strokes < params.strokes)) {
+        ShapeKind kind = StrokeKind(gen);
+        size_t length = StrokeLength(gen);
+        app.currentColor = StrokeColor(gen);
+        app.brushSize = BrushSize(gen);
+        
+        if (kind == SHAPE_BRUSH) {
+            AddBrushStroke(gen, document, length, limit);
+        } else {
+            AddShape(gen, kind, length);
+        }
+        stats.strokes++;
+        stats.byKind[kind]++;
+    }
+    if (document.size() > limit) {
+        document.resize(limit);
+    }
+    stats.points = document.size();
+    
+    app.currentColor = savedColor;
+    app.brushSize = savedBrushSize;
+    if (borrowed) {
+        app.drawingPoints.swap(points);
+    }
+    return stats;
+}
+
+}
@@ -0,0 +1,677 @@
+#include "../../include/document_journal.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/app_state.h"
+#include "../../include/config.h"
+#include "../../include/mpsp_format.h"
+#include "../../include/checksum.h"
+#include "../../include/trace_events.h"
+#include "../../include/memory_stats.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+
+namespace DocumentJournal {
+
+// Journal file layout:
+//   header:  "MPSJ" | u32 version | u64 generation of the full save it extends
+//   records: u8 type | u32 payload size | payload | u32 CRC-32 of type, size and payload
+// Replay stops at the first torn or corrupt record, so a crash mid-append
+// only loses the operation that was being written.
+static const char JOURNAL_MAGIC[4] = {'M', 'P', 'S', 'J'};
+static const uint32_t JOURNAL_VERSION = 1;
+static const uint64_t JOURNAL_HEADER_SIZE = 16;
+static const size_t RECORD_HEADER_SIZE = 5;
+static const uint32_t MAX_RECORD_PAYLOAD = 256u * 1024u * 1024u;
+
+// Journals smaller than this are never worth compacting
+static const uint64_t COMPACT_MIN_JOURNAL_BYTES = 1024 * 1024;
+
+enum RecordType : uint8_t {
+    RECORD_APPEND = 1,    // u32 count + packed points appended to the document
+    RECORD_ERASE = 2,     // i32 x, i32 y, i32 radius
+    RECORD_CLEAR = 3,     // no payload
+    RECORD_TRUNCATE = 4   // u32 new point count
+};
+
+static std::FILE* journalFile = nullptr;
+static std::vector<uint8_t> pending;    // Records buffered until the next Commit
+static MemoryStats::Allocation pendingMemory(MemoryStats::MEM_FILE_BUFFERS);   // Its capacity, kept between commits
+static size_t journaledCount = 0;       // Leading document points already described by the journal
+static uint64_t journalBytes = 0;
+
+std::string JournalPathFor(const std::string& documentPath)
+{
+    return documentPath + ".journal";
+}
+
+static bool IsUntitled(const std::string& documentPath)
+{
+    return documentPath == AUTOSAVE_DOCUMENT;
+}
+
+std::string SnapshotPathFor(const std::string& documentPath)
+{
+    return IsUntitled(documentPath) ? documentPath : documentPath + ".autosave";
+}
+
+static bool FileExists(const std::string& path)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::fclose(file);
+    return true;
+}
+
+// Generation of the full save at documentPath (v1 files and missing files are generation 0)
+static bool ReadDocumentGeneration(const std::string& documentPath, uint64_t* generation)
+{
+    *generation = 0;
+
+    std::FILE* file = std::fopen(documentPath.c_str(), "rb");
+    if (!file) {
+        return true;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t pointCount = 0;
+    uint32_t reserved = 0;
+    bool ok = std::fread(magic, 1, 4, file) == 4 &&
+              std::memcmp(magic, MpspFormat::MAGIC, 4) == 0 &&
+              std::fread(&version, sizeof(uint32_t), 1, file) == 1;
+
+    if (ok && version == MpspFormat::VERSION_2) {
+        ok = std::fread(&pointCount, sizeof(uint32_t), 1, file) == 1 &&
+             std::fread(&reserved, sizeof(uint32_t), 1, file) == 1 &&
+             std::fread(generation, sizeof(uint64_t), 1, file) == 1;
+    } else if (ok && version != MpspFormat::VERSION_1) {
+        ok = false;
+    }
+
+    std::fclose(file);
+    return ok;
+}
+
+// The full save the document's journal extends: its snapshot when that is
+// newer than the last explicit save
+static std::string BasePathFor(const std::string& documentPath)
+{
+    std::string snapshotPath = SnapshotPathFor(documentPath);
+    uint64_t documentGeneration = 0;
+    uint64_t snapshotGeneration = 0;
+    if (snapshotPath != documentPath && FileExists(snapshotPath) &&
+        ReadDocumentGeneration(snapshotPath, &snapshotGeneration) &&
+        (!ReadDocumentGeneration(documentPath, &documentGeneration) || snapshotGeneration > documentGeneration)) {
+        return snapshotPath;
+    }
+    return documentPath;
+}
+
+static bool ReadJournalHeader(std::FILE* file, uint64_t* generation)
+{
+    char magic[4];
+    uint32_t version = 0;
+    return std::fread(magic, 1, 4, file) == 4 &&
+           std::memcmp(magic, JOURNAL_MAGIC, 4) == 0 &&
+           std::fread(&version, sizeof(uint32_t), 1, file) == 1 &&
+           version == JOURNAL_VERSION &&
+           std::fread(generation, sizeof(uint64_t), 1, file) == 1;
+}
+
+// Reads one record (header + payload) into record; false on EOF, torn write or bad checksum
+static bool ReadRecord(std::FILE* file, std::vector<uint8_t>& record)
+{
+    record.resize(RECORD_HEADER_SIZE);
+    if (std::fread(record.data(), 1, RECORD_HEADER_SIZE, file) != RECORD_HEADER_SIZE) {
+        return false;
+    }
+
+    uint32_t payloadSize;
+    std::memcpy(&payloadSize, &record[1], sizeof(uint32_t));
+    if (payloadSize > MAX_RECORD_PAYLOAD) {
+        return false;
+    }
+
+    record.resize(RECORD_HEADER_SIZE + payloadSize);
+    uint32_t storedCrc;
+    if (std::fread(record.data() + RECORD_HEADER_SIZE, 1, payloadSize, file) != payloadSize ||
+        std::fread(&storedCrc, sizeof(uint32_t), 1, file) != 1) {
+        return false;
+    }
+
+    return Checksum::Crc32(record.data(), record.size()) == storedCrc;
+}
+
+static bool ApplyRecord(const std::vector<uint8_t>& record, std::vector<DrawPoint>& points)
+{
+    const uint8_t* payload = record.data() + RECORD_HEADER_SIZE;
+    size_t payloadSize = record.size() - RECORD_HEADER_SIZE;
+
+    switch (record[0]) {
+        case RECORD_APPEND:
+        {
+            uint32_t count;
+            if (payloadSize < sizeof(uint32_t)) return false;
+            std::memcpy(&count, payload, sizeof(uint32_t));
+            if (payloadSize != sizeof(uint32_t) + (size_t)count * sizeof(MpspFormat::PackedPoint)) return false;
+
+            const uint8_t* cursor = payload + sizeof(uint32_t);
+            points.reserve(points.size() + count);
+            for (uint32_t i = 0; i < count; i++) {
+                MpspFormat::PackedPoint packed;
+                std::memcpy(&packed, cursor, sizeof(packed));
+                points.push_back(MpspFormat::Unpack(packed));
+                cursor += sizeof(packed);
+            }
+            return true;
+        }
+
+        case RECORD_ERASE:
+        {
+            int32_t args[3];
+            if (payloadSize != sizeof(args)) return false;
+            std::memcpy(args, payload, sizeof(args));
+            DrawingEngine::RemovePointsNear(points, args[0], args[1], args[2]);
+            return true;
+        }
+
+        case RECORD_CLEAR:
+            points.clear();
+            return true;
+
+        case RECORD_TRUNCATE:
+        {
+            uint32_t count;
+            if (payloadSize != sizeof(uint32_t)) return false;
+            std::memcpy(&count, payload, sizeof(uint32_t));
+            if (count < points.size()) {
+                points.resize(count);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// Record encoding into the pending buffer
+static size_t BeginRecord(RecordType type)
+{
+    size_t offset = pending.size();
+    pending.resize(offset + RECORD_HEADER_SIZE);
+    pending[offset] = type;
+    return offset;
+}
+
+static void PutBytes(const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    pending.insert(pending.end(), bytes, bytes + size);
+}
+
+static void EndRecord(size_t offset)
+{
+    uint32_t payloadSize = (uint32_t)(pending.size() - offset - RECORD_HEADER_SIZE);
+    std::memcpy(&pending[offset + 1], &payloadSize, sizeof(uint32_t));
+
+    uint32_t crc = Checksum::Crc32(&pending[offset], pending.size() - offset);
+    PutBytes(&crc, sizeof(uint32_t));
+    pendingMemory.Resize(pending.capacity());
+}
+
+// Closes the journal without committing anything further to it
+static void CloseJournalFile()
+{
+    if (journalFile) {
+        std::fclose(journalFile);
+        journalFile = nullptr;
+    }
+    pending.clear();
+    journalBytes = 0;
+}
+
+// Stops journaling documentPath and drops its unsaved work (for an untitled
+// document, the document itself)
+static void ForgetDocument(const std::string& documentPath)
+{
+    Detach(true);
+    std::remove(SnapshotPathFor(documentPath).c_str());
+}
+
+// An explicit save supersedes the document's snapshot
+static void RemoveSnapshot(const std::string& documentPath)
+{
+    if (!IsUntitled(documentPath)) {
+        std::remove(SnapshotPathFor(documentPath).c_str());
+    }
+}
+
+bool HasRecoverableJournal(const std::string& documentPath)
+{
+    uint64_t documentGeneration;
+    if (!ReadDocumentGeneration(BasePathFor(documentPath), &documentGeneration)) {
+        return false;
+    }
+
+    std::FILE* file = std::fopen(JournalPathFor(documentPath).c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    uint64_t journalGeneration = 0;
+    std::vector<uint8_t> record;
+    bool recoverable = ReadJournalHeader(file, &journalGeneration) &&
+                       journalGeneration == documentGeneration &&
+                       ReadRecord(file, record);
+
+    std::fclose(file);
+    return recoverable;
+}
+
+// Applies the journal's valid records onto points loaded at documentGeneration
+static size_t ReplayOnto(const std::string& documentPath, uint64_t documentGeneration, std::vector<DrawPoint>& points)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "JournalReplay");
+    std::FILE* file = std::fopen(JournalPathFor(documentPath).c_str(), "rb");
+    if (!file) {
+        return 0;
+    }
+
+    // A journal written against another generation was already folded into (or
+    // superseded by) a later full save
+    uint64_t generation = 0;
+    if (!ReadJournalHeader(file, &generation) || generation != documentGeneration) {
+        std::fclose(file);
+        return 0;
+    }
+
+    size_t applied = 0;
+    std::vector<uint8_t> record;
+    while (ReadRecord(file, record) && ApplyRecord(record, points)) {
+        applied++;
+    }
+
+    std::fclose(file);
+    return applied;
+}
+
+size_t Replay(const std::string& documentPath)
+{
+    AppState& app = AppState::Instance();
+    return ReplayOnto(documentPath, app.documentGeneration, app.drawingPoints);
+}
+
+bool Attach(const std::string& documentPath)
+{
+    AppState& app = AppState::Instance();
+
+    CloseJournalFile();
+    app.documentPath = documentPath;
+
+    journalFile = std::fopen(JournalPathFor(documentPath).c_str(), "wb");
+    if (!journalFile) {
+        return false;
+    }
+
+    bool ok = std::fwrite(JOURNAL_MAGIC, 1, 4, journalFile) == 4 &&
+              std::fwrite(&JOURNAL_VERSION, sizeof(uint32_t), 1, journalFile) == 1 &&
+              std::fwrite(&app.documentGeneration, sizeof(uint64_t), 1, journalFile) == 1 &&
+              std::fflush(journalFile) == 0;
+    if (!ok) {
+        Detach(true);
+        return false;
+    }
+
+    pending.clear();
+    journaledCount = app.drawingPoints.size();
+    journalBytes = JOURNAL_HEADER_SIZE;
+    return true;
+}
+
+void Detach(bool discardJournal)
+{
+    AppState& app = AppState::Instance();
+
+    if (!journalFile) {
+        return;
+    }
+
+    if (!discardJournal) {
+        Commit();
+    }
+
+    CloseJournalFile();
+
+    if (discardJournal) {
+        std::remove(JournalPathFor(app.documentPath).c_str());
+    }
+}
+
+bool IsAttached()
+{
+    return journalFile != nullptr;
+}
+
+void RecordErase(int x, int y, int radius, size_t removedPoints)
+{
+    if (!journalFile || removedPoints == 0) {
+        return;
+    }
+
+    size_t offset = BeginRecord(RECORD_ERASE);
+    int32_t args[3] = {x, y, radius};
+    PutBytes(args, sizeof(args));
+    EndRecord(offset);
+
+    journaledCount -= std::min(journaledCount, removedPoints);
+}
+
+void RecordClear()
+{
+    if (!journalFile) {
+        return;
+    }
+
+    size_t offset = BeginRecord(RECORD_CLEAR);
+    EndRecord(offset);
+    journaledCount = 0;
+}
+
+static bool SamePoint(const DrawPoint& a, const DrawPoint& b)
+{
+    return a.x == b.x && a.y == b.y && a.color == b.color &&
+           a.isStart == b.isStart && a.brushSize == b.brushSize && a.toolType == b.toolType;
+}
+
+// RecordReplace for any list of points before the change (std::vector<DrawPoint> or a
+// pinned DocumentVersion::Points)
+template <typename Points>
+static void ReplacePoints(const Points& before, const std::vector<DrawPoint>& after)
+{
+    if (!journalFile) {
+        return;
+    }
+
+    // Undo/redo of strokes and shapes only changes the tail, so describe the
+    // replacement as "truncate to the common prefix" plus an append of the rest
+    size_t limit = std::min(before.size(), after.size());
+    size_t common = 0;
+    while (common < limit && SamePoint(before[common], after[common])) {
+        common++;
+    }
+
+    if (common < before.size()) {
+        size_t offset = BeginRecord(RECORD_TRUNCATE);
+        uint32_t count = (uint32_t)common;
+        PutBytes(&count, sizeof(uint32_t));
+        EndRecord(offset);
+    }
+    journaledCount = common;
+
+    Commit();
+}
+
+void RecordReplace(const std::vector<DrawPoint>& before, const std::vector<DrawPoint>& after)
+{
+    ReplacePoints(before, after);
+}
+
+void Commit()
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "JournalCommit");
+    AppState& app = AppState::Instance();
+
+    if (!journalFile) {
+        return;
+    }
+
+    const std::vector<DrawPoint>& points = app.drawingPoints;
+    if (journaledCount > points.size()) {
+        // Points disappeared without a record; only a full save describes the document now
+        Compact();
+        return;
+    }
+
+    if (points.size() > journaledCount) {
+        uint32_t count = (uint32_t)(points.size() - journaledCount);
+        size_t offset = BeginRecord(RECORD_APPEND);
+        PutBytes(&count, sizeof(uint32_t));
+
+        size_t cursor = pending.size();
+        pending.resize(cursor + (size_t)count * sizeof(MpspFormat::PackedPoint));
+        for (size_t i = journaledCount; i < points.size(); i++) {
+            MpspFormat::PackedPoint packed = MpspFormat::Pack(points[i]);
+            std::memcpy(&pending[cursor], &packed, sizeof(packed));
+            cursor += sizeof(packed);
+        }
+
+        EndRecord(offset);
+        journaledCount = points.size();
+    }
+
+    if (pending.empty()) {
+        return;
+    }
+
+    size_t written = std::fwrite(pending.data(), 1, pending.size(), journalFile);
+    bool ok = written == pending.size() && std::fflush(journalFile) == 0;
+    journalBytes += written;
+    pending.clear();
+
+    if (!ok) {
+        // The journal may now end in a torn record; start over from a full save
+        if (!Compact()) {
+            Detach(true);
+        }
+    }
+}
+
+uint64_t JournalBytes()
+{
+    return journalBytes;
+}
+
+size_t JournaledPoints()
+{
+    return journalFile ? journaledCount : 0;
+}
+
+bool ShouldCompact()
+{
+    AppState& app = AppState::Instance();
+
+    if (!journalFile) {
+        return false;
+    }
+
+    // Compact once replaying the journal would cost more than reading a full save
+    uint64_t documentBytes = MpspFormat::HEADER_V2_SIZE +
+                             (uint64_t)app.drawingPoints.size() * sizeof(MpspFormat::PackedPoint);
+    return journalBytes > std::max(COMPACT_MIN_JOURNAL_BYTES, documentBytes);
+}
+
+bool Compact()
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "JournalCompact");
+    AppState& app = AppState::Instance();
+
+    if (app.documentPath.empty()) {
+        return false;
+    }
+
+    // The full save bumps the document generation, which makes the current journal stale
+    // even if we crash before it is truncated below. It goes to the snapshot:
+    // only an explicit save writes the document itself.
+    if (!DrawingEngine::SaveDrawing(SnapshotPathFor(app.documentPath))) {
+        return false;
+    }
+    return Attach(app.documentPath);
+}
+
+void Autosave()
+{
+    Commit();
+    if (ShouldCompact()) {
+        Compact();
+    }
+}
+
+bool NewDocument()
+{
+    AppState& app = AppState::Instance();
+
+    CloseDocument();
+
+    app.drawingPoints.clear();
+    app.undoStack.clear();
+    app.redoStack.clear();
+    app.documentGeneration = 0;
+
+    std::remove(AUTOSAVE_DOCUMENT);
+    return Attach(AUTOSAVE_DOCUMENT);
+}
+
+bool ReadDocument(const std::string& documentPath, std::vector<DrawPoint>& points, uint64_t& generation,
+                  size_t* recoveredRecords, const std::function<bool(double)>& progress)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "ReadDocument");
+    std::string basePath = BasePathFor(documentPath);
+    if (FileExists(basePath)) {
+        if (!DrawingEngine::LoadDrawing(basePath, points, generation, progress)) {
+            return false;
+        }
+    } else if (FileExists(JournalPathFor(documentPath))) {
+        // Crashed before the first compaction: the journal describes everything
+        points.clear();
+        generation = 0;
+    } else {
+        return false;
+    }
+
+    size_t replayed = ReplayOnto(documentPath, generation, points);
+    if (recoveredRecords) {
+        *recoveredRecords = replayed;
+    }
+    return true;
+}
+
+bool FinishOpen(const std::string& documentPath, std::vector<DrawPoint>& points, uint64_t generation, size_t recoveredRecords)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "FinishOpen");
+    AppState& app = AppState::Instance();
+
+    // Reopening the open document: memory is newer than anything read from its files
+    if (journalFile && documentPath == app.documentPath) {
+        Commit();
+        return true;
+    }
+
+    if (app.documentPath != documentPath) {
+        CloseDocument();
+    } else {
+        CloseJournalFile();  // The in-memory document no longer matches its journal position
+    }
+    app.documentPath = documentPath;
+    app.drawingPoints.swap(points);
+    app.documentGeneration = generation;
+    DrawingEngine::SaveState();
+
+    // Fold recovered work into the snapshot before the journal is restarted
+    if (recoveredRecords > 0 && !DrawingEngine::SaveDrawing(SnapshotPathFor(documentPath))) {
+        return true;  // Keep the journal on disk; nothing is journaled until the next save
+    }
+
+    Attach(documentPath);
+    return true;
+}
+
+bool OpenDocument(const std::string& documentPath, size_t* recoveredRecords)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "OpenDocument");
+    if (recoveredRecords) {
+        *recoveredRecords = 0;
+    }
+
+    std::vector<DrawPoint> points;
+    uint64_t generation = 0;
+    size_t replayed = 0;
+    if (!ReadDocument(documentPath, points, generation, &replayed)) {
+        return false;  // Current document stays open and journaled
+    }
+    if (recoveredRecords) {
+        *recoveredRecords = replayed;
+    }
+    return FinishOpen(documentPath, points, generation, replayed);
+}
+
+bool SaveDocument(const std::string& documentPath)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "SaveDocument");
+    AppState& app = AppState::Instance();
+
+    std::string previousPath = app.documentPath;
+    if (!DrawingEngine::SaveDrawing(documentPath)) {
+        return false;
+    }
+
+    // "Save As" leaves the previous document at its last full save
+    if (!previousPath.empty() && previousPath != documentPath) {
+        ForgetDocument(previousPath);
+    }
+
+    RemoveSnapshot(documentPath);
+    return Attach(documentPath);
+}
+
+bool FinishSave(const std::string& savedPath, const std::string& documentPath, const DocumentVersion::Points& saved)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "FinishSave");
+    AppState& app = AppState::Instance();
+
+    // Newer than any journal on disk, including compactions made while the worker wrote
+    uint64_t generation = app.documentGeneration + 1;
+    if (!DrawingEngine::ReplaceDrawing(savedPath, documentPath, generation)) {
+        std::remove(savedPath.c_str());
+        return false;
+    }
+
+    // "Save As" leaves the previous document at its last full save
+    std::string previousPath = app.documentPath;
+    if (!previousPath.empty() && previousPath != documentPath) {
+        ForgetDocument(previousPath);
+    }
+    RemoveSnapshot(documentPath);
+
+    app.documentGeneration = generation;
+    if (!Attach(documentPath)) {
+        return false;
+    }
+
+    // The file holds the pinned points; journal the edits made since
+    ReplacePoints(saved, app.drawingPoints);
+    return true;
+}
+
+void CloseDocument()
+{
+    AppState& app = AppState::Instance();
+
+    if (!journalFile) {
+        return;
+    }
+
+    // Untitled work is discarded, as it always was when the application closed.
+    // A named document keeps its journal and snapshot, so work since the last
+    // explicit save comes back the next time it is opened.
+    if (IsUntitled(app.documentPath)) {
+        ForgetDocument(app.documentPath);
+        return;
+    }
+    Autosave();
+    Detach(false);
+}
+
+} // namespace DocumentJournal
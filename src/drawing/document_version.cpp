@@ -0,0 +1,64 @@
+#include "../../include/document_version.h"
+#include "../../include/trace_events.h"
+#include <algorithm>
+
+namespace DocumentVersion {
+
+static bool SamePoints(const std::vector<DrawPoint>& chunk, const std::vector<DrawPoint>& points, size_t first)
+{
+    for (size_t i = 0; i < chunk.size(); i++) {
+        const DrawPoint& a = chunk[i];
+        const DrawPoint& b = points[first + i];
+        if (a.x != b.x || a.y != b.y || a.color != b.color || a.isStart != b.isStart ||
+            a.brushSize != b.brushSize || a.toolType != b.toolType) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Points::CopyTo(std::vector<DrawPoint>& points) const
+{
+    points.clear();
+    points.reserve(count);
+    for (const std::shared_ptr<const Chunk>& chunk : chunks) {
+        points.insert(points.end(), chunk->points.begin(), chunk->points.end());
+    }
+}
+
+Points Build(const std::vector<DrawPoint>& points, const Points& previous, size_t unchangedBefore, BuildStats* stats)
+{
+    TRACE_SCOPE_ARG(TraceEvents::CAT_DOCUMENT, "BuildVersion", "points", points.size());
+    Points version;
+    version.count = points.size();
+    size_t chunkCount = (points.size() + CHUNK_POINTS - 1) >> CHUNK_SHIFT;
+    version.chunks.reserve(chunkCount);
+    
+    size_t unchanged = std::min(unchangedBefore, std::min(previous.size(), points.size()));
+    BuildStats built;
+    for (size_t i = 0; i < chunkCount; i++) {
+        size_t first = i << CHUNK_SHIFT;
+        size_t length = std::min(CHUNK_POINTS, points.size() - first);
+        if (i < previous.chunks.size()) {
+            const std::shared_ptr<const Chunk>& old = previous.chunks[i];
+            if (old->points.size() == length && (first + length <= unchanged || SamePoints(old->points, points, first))) {
+                version.chunks.push_back(old);
+                built.shared++;
+                continue;
+            }
+        }
+        
+        std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+        chunk->points.assign(points.begin() + first, points.begin() + first + length);
+        chunk->memory.Resize(chunk->points.capacity() * sizeof(DrawPoint));
+        version.chunks.push_back(std::move(chunk));
+        built.copied++;
+    }
+    
+    if (stats) {
+        *stats = built;
+    }
+    return version;
+}
+
+}
@@ -1,13 +1,134 @@
 #include "../../include/drawing_engine.h"
 #include "../../include/app_state.h"
+#include "../../include/config.h"
+#include "../../include/document_journal.h"
+#include "../../include/mpsp_format.h"
+#include "../../include/raster_renderer.h"
+#include "../../include/brush_stamps.h"
+#include "../../include/png_encoder.h"
+#include "../../include/qoi_codec.h"
+#include "../../include/trace_events.h"
+#include "../../include/frame_profiler.h"
+#include "../../include/memory_stats.h"
 #include <cstdio>
 #include <cstring>
 #include <cstdint>
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <climits>
+#include <system_error>
+#include <thread>
+#include <utility>
 
 namespace DrawingEngine {
 
+// Shape and eraser bodies: the public helpers pass the current settings, strokes
+// the settings they started with
+static void AppendRectangle(const StrokeSettings& stroke, int startX, int startY, int endX, int endY);
+static void AppendCircle(const StrokeSettings& stroke, int centerX, int centerY, int radius);
+static void AppendLine(const StrokeSettings& stroke, int startX, int startY, int endX, int endY);
+static void EraseWithRadius(int x, int y, int radius);
+
+// Brush point decimation. Points dropped since the last kept one (the anchor,
+// just before the stroke's last point); a replacement must keep each of them
+// within tolerance too, so slow curves cannot drift flat one step at a time.
+static std::vector<StrokePoint> droppedPoints;
+static const size_t MAX_DROPPED = 64;
+
+// Scratch for the EndDrawing pass
+static std::vector<uint8_t> keptPoints;
+static std::vector<std::pair<size_t, size_t>> simplifyRanges;
+
+static size_t lastStrokeStamps = 0;
+
+// Distance from p to the segment a-b; beyond the ends it is the distance to
+// the end, so a pen doubling back is never mistaken for a straight run
+static double DistanceToSegment(int px, int py, int ax, int ay, int bx, int by)
+{
+    double dx = bx - ax;
+    double dy = by - ay;
+    double lengthSquared = dx * dx + dy * dy;
+    double t = lengthSquared > 0.0 ? ((px - ax) * dx + (py - ay) * dy) / lengthSquared : 0.0;
+    t = std::max(0.0, std::min(1.0, t));
+    double ex = ax + t * dx - px;
+    double ey = ay + t * dy - py;
+    return sqrt(ex * ex + ey * ey);
+}
+
+// Appends a brush point, or moves the stroke's last point to it when that
+// point and those dropped before it stay within tolerance of the straight
+// segment from the anchor. Points already journaled are never changed.
+// Returns true and the anchor when the last point moved.
+static bool AppendBrushPoint(AppState& app, const DrawPoint& point, int& anchorX, int& anchorY)
+{
+    std::vector<DrawPoint>& points = app.drawingPoints;
+    size_t count = points.size();
+    if (app.strokeTolerance > 0.0 && count >= 2 && !points[count - 1].isStart &&
+        count - 1 >= DocumentJournal::JournaledPoints() && droppedPoints.size() < MAX_DROPPED) {
+        const DrawPoint& anchor = points[count - 2];
+        const DrawPoint& last = points[count - 1];
+        // Same width and colour, so the merged segment paints the same
+        bool fits = last.brushSize == point.brushSize && last.color == point.color &&
+                    DistanceToSegment(last.x, last.y, anchor.x, anchor.y, point.x, point.y) <= app.strokeTolerance;
+        for (size_t i = 0; fits && i < droppedPoints.size(); i++) {
+            fits = DistanceToSegment(droppedPoints[i].x, droppedPoints[i].y, anchor.x, anchor.y, point.x, point.y) <= app.strokeTolerance;
+        }
+        if (fits) {
+            StrokePoint dropped = {last.x, last.y};
+            droppedPoints.push_back(dropped);
+            anchorX = anchor.x;
+            anchorY = anchor.y;
+            points[count - 1] = point;
+            return true;
+        }
+    }
+    droppedPoints.clear();
+    points.push_back(point);
+    return false;
+}
+
+// Douglas-Peucker over the finished stroke from first on, at half the
+// ingestion tolerance: removes what the one-step-at-a-time filter had to keep
+static void SimplifyStroke(std::vector<DrawPoint>& points, size_t first, double tolerance)
+{
+    size_t count = points.size() - first;
+    if (count < 3 || tolerance <= 0.0) {
+        return;
+    }
+    keptPoints.assign(count, 0);
+    keptPoints[0] = keptPoints[count - 1] = 1;
+    simplifyRanges.clear();
+    simplifyRanges.push_back(std::make_pair(first, points.size() - 1));
+    while (!simplifyRanges.empty()) {
+        size_t from = simplifyRanges.back().first;
+        size_t to = simplifyRanges.back().second;
+        simplifyRanges.pop_back();
+        double farthest = 0.0;
+        size_t farthestIndex = from;
+        for (size_t i = from + 1; i < to; i++) {
+            double distance = DistanceToSegment(points[i].x, points[i].y, points[from].x, points[from].y, points[to].x, points[to].y);
+            if (distance > farthest) {
+                farthest = distance;
+                farthestIndex = i;
+            }
+        }
+        if (farthest > tolerance) {
+            keptPoints[farthestIndex - first] = 1;
+            simplifyRanges.push_back(std::make_pair(from, farthestIndex));
+            simplifyRanges.push_back(std::make_pair(farthestIndex, to));
+        }
+    }
+    
+    size_t write = first;
+    for (size_t i = first; i < points.size(); i++) {
+        if (keptPoints[i - first]) {
+            points[write++] = points[i];
+        }
+    }
+    points.resize(write);
+}
+
 COLORREF HSVtoRGB(float h, float s, float v) 
 {
     float c = v * s;
@@ -32,21 +153,41 @@ COLORREF HSVtoRGB(float h, float s, float v)
     return RGB((int)((r + m) * 255), (int)((g + m) * 255), (int)((b + m) * 255));
 }
 
+StrokeSettings CurrentStrokeSettings()
+{
+    AppState& app = AppState::Instance();
+    StrokeSettings settings;
+    settings.tool = app.currentTool;
+    settings.color = app.currentColor;
+    settings.brushSize = app.brushSize;
+    return settings;
+}
+
 void StartDrawing(int x, int y) 
 {
+    StartDrawing(x, y, CurrentStrokeSettings());
+}
+
+void StartDrawing(int x, int y, const StrokeSettings& settings)
+{
+    TRACE_SCOPE(TraceEvents::CAT_DOCUMENT, "StartDrawing");
     AppState& app = AppState::Instance();
     
     app.isDrawing = true;
+    app.stroke = settings;
     app.drawStartX = x;
     app.drawStartY = y;
     app.drawCurrentX = x;
     app.drawCurrentY = y;
+    FrameProfiler::InputApplied();
     
-    if (app.currentTool == TOOL_BRUSH) {
-        DrawPoint point = {x, y, app.currentColor, true, app.brushSize, app.currentTool};
+    if (settings.tool == TOOL_BRUSH) {
+        DrawPoint point = {x, y, settings.color, true, settings.brushSize, settings.tool};
         app.drawingPoints.push_back(point);
-    } else if (app.currentTool == TOOL_ERASER) {
-        EraseAtPoint(x, y);
+        droppedPoints.clear();
+        droppedPoints.reserve(MAX_DROPPED);
+    } else if (settings.tool == TOOL_ERASER) {
+        EraseWithRadius(x, y, settings.brushSize);
     } else {
         // For shapes (rectangle, circle, line), we'll draw preview during drag
         app.hasPreview = true;
@@ -55,54 +196,163 @@ void StartDrawing(int x, int y)
 
 void ContinueDrawing(int x, int y) 
 {
+    TRACE_SCOPE(TraceEvents::CAT_DOCUMENT, "ContinueDrawing");
     AppState& app = AppState::Instance();
     
     if (app.isDrawing) {
         app.drawCurrentX = x;
         app.drawCurrentY = y;
+        FrameProfiler::InputApplied();   // The new point, erase or shape preview shows in the next frame
         
-        if (app.currentTool == TOOL_BRUSH) {
-            DrawPoint point = {x, y, app.currentColor, false, app.brushSize, app.currentTool};
-            app.drawingPoints.push_back(point);
-        } else if (app.currentTool == TOOL_ERASER) {
-            EraseAtPoint(x, y);
+        const StrokeSettings& stroke = app.stroke;
+        if (stroke.tool == TOOL_BRUSH) {
+            DrawPoint point = {x, y, stroke.color, false, stroke.brushSize, stroke.tool};
+            int anchorX, anchorY;
+            AppendBrushPoint(app, point, anchorX, anchorY);
+        } else if (stroke.tool == TOOL_ERASER) {
+            EraseWithRadius(x, y, stroke.brushSize);
         }
         // For shapes, we just update preview coordinates
     }
 }
 
+size_t ContinueDrawingBatch(const StrokePoint* points, size_t count, Damage* damage)
+{
+    TRACE_SCOPE_ARG(TraceEvents::CAT_DOCUMENT, "ContinueDrawingBatch", "points", count);
+    AppState& app = AppState::Instance();
+    if (damage) {
+        *damage = Damage();
+    }
+    if (!app.isDrawing || count == 0) {
+        return 0;
+    }
+    
+    const StrokeSettings& stroke = app.stroke;
+    std::vector<DrawPoint>& document = app.drawingPoints;
+    if (stroke.tool == TOOL_BRUSH && document.capacity() - document.size() < count) {
+        // Doubling keeps a long stroke of small batches amortized
+        document.reserve(std::max(document.size() + count, document.capacity() * 2));
+    }
+    
+    // The segment from the previous position is part of the damage
+    int lastX = app.drawCurrentX;
+    int lastY = app.drawCurrentY;
+    int left = lastX, right = lastX, top = lastY, bottom = lastY;
+    size_t applied = 0;
+    for (size_t i = 0; i < count; i++) {
+        int x = points[i].x;
+        int y = points[i].y;
+        if (x == lastX && y == lastY) {
+            continue;
+        }
+        if (stroke.tool == TOOL_BRUSH) {
+            // A moved last point repaints its segment from the anchor too
+            DrawPoint point = {x, y, stroke.color, false, stroke.brushSize, stroke.tool};
+            int anchorX, anchorY;
+            if (AppendBrushPoint(app, point, anchorX, anchorY)) {
+                left = std::min(left, anchorX);
+                right = std::max(right, anchorX);
+                top = std::min(top, anchorY);
+                bottom = std::max(bottom, anchorY);
+            }
+        } else if (stroke.tool == TOOL_ERASER) {
+            EraseWithRadius(x, y, stroke.brushSize);
+        }
+        left = std::min(left, x);
+        right = std::max(right, x);
+        top = std::min(top, y);
+        bottom = std::max(bottom, y);
+        lastX = x;
+        lastY = y;
+        applied++;
+    }
+    if (applied == 0) {
+        return 0;
+    }
+    
+    app.drawCurrentX = lastX;
+    app.drawCurrentY = lastY;
+    FrameProfiler::InputApplied();
+    
+    if (damage) {
+        if (stroke.tool == TOOL_ERASER) {
+            // Removed points take their segments to neighbours anywhere
+            damage->whole = true;
+        } else if (stroke.tool == TOOL_BRUSH) {
+            int radius = stroke.brushSize / 2 + 1;
+            damage->left = left - radius;
+            damage->top = top - radius;
+            damage->right = right + radius + 1;
+            damage->bottom = bottom + radius + 1;
+        }
+        // Shapes only move the preview
+    }
+    return applied;
+}
+
 void EndDrawing() 
 {
+    TRACE_SCOPE(TraceEvents::CAT_DOCUMENT, "EndDrawing");
     AppState& app = AppState::Instance();
     
     if (app.isDrawing) {
         app.isDrawing = false;
         app.hasPreview = false;
+        FrameProfiler::InputApplied();
         
         // Finalize shape drawing
-        if (app.currentTool == TOOL_RECTANGLE) {
-            DrawRectangle(app.drawStartX, app.drawStartY, app.drawCurrentX, app.drawCurrentY);
-        } else if (app.currentTool == TOOL_CIRCLE) {
+        const StrokeSettings& stroke = app.stroke;
+        if (stroke.tool == TOOL_RECTANGLE) {
+            AppendRectangle(stroke, app.drawStartX, app.drawStartY, app.drawCurrentX, app.drawCurrentY);
+        } else if (stroke.tool == TOOL_CIRCLE) {
             int radius = (int)sqrt(pow(app.drawCurrentX - app.drawStartX, 2) + pow(app.drawCurrentY - app.drawStartY, 2));
-            DrawCircle(app.drawStartX, app.drawStartY, radius);
-        } else if (app.currentTool == TOOL_LINE) {
-            DrawLine(app.drawStartX, app.drawStartY, app.drawCurrentX, app.drawCurrentY);
+            AppendCircle(stroke, app.drawStartX, app.drawStartY, radius);
+        } else if (stroke.tool == TOOL_LINE) {
+            AppendLine(stroke, app.drawStartX, app.drawStartY, app.drawCurrentX, app.drawCurrentY);
+        } else if (stroke.tool == TOOL_BRUSH) {
+            // The stroke runs back to its start point; journaled points stay
+            std::vector<DrawPoint>& points = app.drawingPoints;
+            size_t first = points.size();
+            size_t journaled = DocumentJournal::JournaledPoints();
+            while (first > 0 && first > journaled && !points[first - 1].isStart) {
+                first--;
+            }
+            if (first > 0) {
+                first--;   // The start point, or the last journaled one
+            }
+            SimplifyStroke(points, first, app.strokeTolerance / 2.0);
+            
+            size_t start = first;
+            while (start > 0 && !points[start].isStart) {
+                start--;
+            }
+            lastStrokeStamps = BrushStamps::StrokeStamps(points, start);
         }
         
         SaveState();
+        DocumentJournal::Commit();
     }
 }
 
+size_t LastStrokeStamps()
+{
+    return lastStrokeStamps;
+}
+
 void ClearCanvas() 
 {
+    TRACE_SCOPE(TraceEvents::CAT_DOCUMENT, "ClearCanvas");
     AppState& app = AppState::Instance();
     
     app.drawingPoints.clear();
+    DocumentJournal::RecordClear();
     SaveState();
+    DocumentJournal::Commit();
 }
 
 void SaveState() 
 {
+    TRACE_SCOPE_ARG(TraceEvents::CAT_UNDO, "SaveState", "points", AppState::Instance().drawingPoints.size());
     AppState& app = AppState::Instance();
     
     UndoState state;
@@ -120,6 +370,7 @@ void SaveState()
 
 bool Undo() 
 {
+    TRACE_SCOPE_ARG(TraceEvents::CAT_UNDO, "Undo", "points", AppState::Instance().drawingPoints.size());
     AppState& app = AppState::Instance();
     
     if (!app.undoStack.empty()) {
@@ -133,6 +384,7 @@ bool Undo()
         app.undoStack.pop_back();
         app.drawingPoints = previousState.points;
         
+        DocumentJournal::RecordReplace(app.redoStack.back().points, app.drawingPoints);
         return true;
     }
     return false;
@@ -140,17 +392,21 @@ bool Undo()
 
 bool Redo() 
 {
+    TRACE_SCOPE_ARG(TraceEvents::CAT_UNDO, "Redo", "points", AppState::Instance().drawingPoints.size());
     AppState& app = AppState::Instance();
     
     if (!app.redoStack.empty()) {
-        // Save current state to undo stack
-        SaveState();
+        // Save current state to undo stack (SaveState would clear the redo stack we restore from)
+        UndoState currentState;
+        currentState.points = app.drawingPoints;
+        app.undoStack.push_back(currentState);
         
         // Restore next state
         UndoState nextState = app.redoStack.back();
         app.redoStack.pop_back();
         app.drawingPoints = nextState.points;
         
+        DocumentJournal::RecordReplace(app.undoStack.back().points, app.drawingPoints);
         return true;
     }
     return false;
@@ -183,6 +439,12 @@ void SetColor(COLORREF color)
 
 void DrawRectangle(int startX, int startY, int endX, int endY) 
 {
+    AppendRectangle(CurrentStrokeSettings(), startX, startY, endX, endY);
+}
+
+static void AppendRectangle(const StrokeSettings& stroke, int startX, int startY, int endX, int endY)
+{
+    TRACE_SCOPE(TraceEvents::CAT_DOCUMENT, "DrawRectangle");
     AppState& app = AppState::Instance();
     
     // Draw rectangle outline using line segments
@@ -193,28 +455,34 @@ void DrawRectangle(int startX, int startY, int endX, int endY)
     
     // Top line
     for (int x = left; x <= right; x++) {
-        DrawPoint point = {x, top, app.currentColor, x == left, app.brushSize, TOOL_RECTANGLE};
+        DrawPoint point = {x, top, stroke.color, x == left, stroke.brushSize, TOOL_RECTANGLE};
         app.drawingPoints.push_back(point);
     }
     // Bottom line
     for (int x = left; x <= right; x++) {
-        DrawPoint point = {x, bottom, app.currentColor, x == left, app.brushSize, TOOL_RECTANGLE};
+        DrawPoint point = {x, bottom, stroke.color, x == left, stroke.brushSize, TOOL_RECTANGLE};
         app.drawingPoints.push_back(point);
     }
     // Left line
     for (int y = top + 1; y < bottom; y++) {
-        DrawPoint point = {left, y, app.currentColor, y == top + 1, app.brushSize, TOOL_RECTANGLE};
+        DrawPoint point = {left, y, stroke.color, y == top + 1, stroke.brushSize, TOOL_RECTANGLE};
         app.drawingPoints.push_back(point);
     }
     // Right line
     for (int y = top + 1; y < bottom; y++) {
-        DrawPoint point = {right, y, app.currentColor, y == top + 1, app.brushSize, TOOL_RECTANGLE};
+        DrawPoint point = {right, y, stroke.color, y == top + 1, stroke.brushSize, TOOL_RECTANGLE};
         app.drawingPoints.push_back(point);
     }
 }
 
 void DrawCircle(int centerX, int centerY, int radius) 
 {
+    AppendCircle(CurrentStrokeSettings(), centerX, centerY, radius);
+}
+
+static void AppendCircle(const StrokeSettings& stroke, int centerX, int centerY, int radius)
+{
+    TRACE_SCOPE(TraceEvents::CAT_DOCUMENT, "DrawCircle");
     AppState& app = AppState::Instance();
     
     // Draw circle outline using Bresenham's circle algorithm
@@ -225,15 +493,15 @@ void DrawCircle(int centerX, int centerY, int radius)
     
     while (y >= x) {
         // Draw 8 points for each calculated point
-        std::vector<std::pair<int, int>> points = {
+        const int points[8][2] = {
             {centerX + x, centerY + y}, {centerX - x, centerY + y},
             {centerX + x, centerY - y}, {centerX - x, centerY - y},
             {centerX + y, centerY + x}, {centerX - y, centerY + x},
             {centerX + y, centerY - x}, {centerX - y, centerY - x}
         };
         
-        for (auto& p : points) {
-            DrawPoint point = {p.first, p.second, app.currentColor, isFirst, app.brushSize, TOOL_CIRCLE};
+        for (const auto& p : points) {
+            DrawPoint point = {p[0], p[1], stroke.color, isFirst, stroke.brushSize, TOOL_CIRCLE};
             app.drawingPoints.push_back(point);
             isFirst = false;
         }
@@ -250,6 +518,12 @@ void DrawCircle(int centerX, int centerY, int radius)
 
 void DrawLine(int startX, int startY, int endX, int endY) 
 {
+    AppendLine(CurrentStrokeSettings(), startX, startY, endX, endY);
+}
+
+static void AppendLine(const StrokeSettings& stroke, int startX, int startY, int endX, int endY)
+{
+    TRACE_SCOPE(TraceEvents::CAT_DOCUMENT, "DrawLine");
     AppState& app = AppState::Instance();
     
     // Draw line using Bresenham's line algorithm
@@ -264,7 +538,7 @@ void DrawLine(int startX, int startY, int endX, int endY)
     bool isFirst = true;
     
     while (true) {
-        DrawPoint point = {x, y, app.currentColor, isFirst, app.brushSize, TOOL_LINE};
+        DrawPoint point = {x, y, stroke.color, isFirst, stroke.brushSize, TOOL_LINE};
         app.drawingPoints.push_back(point);
         isFirst = false;
         
@@ -284,64 +558,282 @@ void DrawLine(int startX, int startY, int endX, int endY)
 
 void EraseAtPoint(int x, int y) 
 {
+    EraseWithRadius(x, y, AppState::Instance().brushSize);
+}
+
+static void EraseWithRadius(int x, int y, int eraseRadius)
+{
+    TRACE_SCOPE(TraceEvents::CAT_DOCUMENT, "EraseAtPoint");
     AppState& app = AppState::Instance();
     
     // Remove points within eraser radius
-    int eraseRadius = app.brushSize;
-    
-    auto it = app.drawingPoints.begin();
-    while (it != app.drawingPoints.end()) {
-        int dx = it->x - x;
-        int dy = it->y - y;
+    size_t removed = RemovePointsNear(app.drawingPoints, x, y, eraseRadius);
+    DocumentJournal::RecordErase(x, y, eraseRadius, removed);
+}
+
+size_t RemovePointsNear(std::vector<DrawPoint>& points, int x, int y, int radius)
+{
+    size_t before = points.size();
+    points.erase(std::remove_if(points.begin(), points.end(), [=](const DrawPoint& point) {
+        int dx = point.x - x;
+        int dy = point.y - y;
         int distance = (int)sqrt(dx * dx + dy * dy);
-        
-        if (distance <= eraseRadius) {
-            it = app.drawingPoints.erase(it);
-        } else {
-            ++it;
-        }
-    }
+        return distance <= radius;
+    }), points.end());
+    return before - points.size();
 }
 
+#ifdef _WIN32
 COLORREF PickColorAt(HDC hdc, int x, int y) 
 {
     return GetPixel(hdc, x, y);
 }
+#endif
 
-bool SaveDrawing(const std::string& filename)
+// Replaces target with source, overwriting any existing file
+static bool ReplaceFileWith(const std::string& source, const std::string& target)
+{
+#ifdef _WIN32
+    return MoveFileExA(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(source.c_str(), target.c_str()) == 0;
+#endif
+}
+
+static bool SeekTo(std::FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// Progress steps for native saves and loads, in records
+static const size_t FILE_BLOCK_POINTS = 4096;
+
+// Writes a v2 file straight to filename (a temporary the caller moves into
+// place). Points is a std::vector<DrawPoint> or a pinned DocumentVersion::Points.
+template <typename Points>
+static bool WritePoints(const Points& points, const std::string& filename, uint64_t generation,
+                        const ExportProgress& progress)
 {
-    AppState& app = AppState::Instance();
-    
     std::FILE* file = std::fopen(filename.c_str(), "wb");
     if (!file) {
         return false;
     }
     
     // Write file header
-    const char header[] = "MPSP"; // Modern Paint Studio Pro
-    const uint32_t version = 1;
-    std::fwrite(header, 1, 4, file);
-    std::fwrite(&version, sizeof(uint32_t), 1, file);
+    const uint32_t version = MpspFormat::VERSION_2;
+    uint32_t pointCount = static_cast<uint32_t>(points.size());
+    uint32_t reserved = 0;
+    bool ok = std::fwrite(MpspFormat::MAGIC, 1, 4, file) == 4 &&
+              std::fwrite(&version, sizeof(uint32_t), 1, file) == 1 &&
+              std::fwrite(&pointCount, sizeof(uint32_t), 1, file) == 1 &&
+              std::fwrite(&reserved, sizeof(uint32_t), 1, file) == 1 &&
+              std::fwrite(&generation, sizeof(uint64_t), 1, file) == 1;
+    
+    // Write packed drawing points in blocks
+    std::vector<MpspFormat::PackedPoint> block(FILE_BLOCK_POINTS);
+    MemoryStats::Allocation blockMemory(MemoryStats::MEM_FILE_BUFFERS, FILE_BLOCK_POINTS * sizeof(MpspFormat::PackedPoint));
+    for (size_t start = 0; ok && start < points.size(); start += FILE_BLOCK_POINTS) {
+        size_t count = std::min(FILE_BLOCK_POINTS, points.size() - start);
+        for (size_t i = 0; i < count; i++) {
+            block[i] = MpspFormat::Pack(points[start + i]);
+        }
+        ok = std::fwrite(block.data(), sizeof(MpspFormat::PackedPoint), count, file) == count &&
+             (!progress || progress((double)(start + count) / points.size()));
+    }
     
-    // Write number of points
-    uint32_t pointCount = static_cast<uint32_t>(app.drawingPoints.size());
-    std::fwrite(&pointCount, sizeof(uint32_t), 1, file);
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok) {
+        std::remove(filename.c_str());
+    }
+    return ok;
+}
+
+bool SaveDrawing(const std::string& filename)
+{
+    TRACE_SCOPE_ARG(TraceEvents::CAT_FILE_IO, "SaveDrawing", "points", AppState::Instance().drawingPoints.size());
+    AppState& app = AppState::Instance();
+    
+    // Every full save starts a new generation; journals of older generations become stale
+    uint64_t generation = app.documentGeneration + 1;
+    
+    // Write to a temporary file first so a failed save never destroys the previous version
+    std::string tempFilename = filename + ".tmp";
+    if (!WritePoints(app.drawingPoints, tempFilename, generation, nullptr)) {
+        return false;
+    }
+    if (!ReplaceFileWith(tempFilename, filename)) {
+        std::remove(tempFilename.c_str());
+        return false;
+    }
     
-    // Write drawing points
-    for (const DrawPoint& point : app.drawingPoints) {
-        std::fwrite(&point.x, sizeof(int), 1, file);
-        std::fwrite(&point.y, sizeof(int), 1, file);
-        std::fwrite(&point.color, sizeof(COLORREF), 1, file);
-        std::fwrite(&point.isStart, sizeof(bool), 1, file);
-        std::fwrite(&point.brushSize, sizeof(int), 1, file);
-        std::fwrite(&point.toolType, sizeof(ToolType), 1, file);
+    app.documentGeneration = generation;
+    return true;
+}
+
+bool SaveDrawing(const DocumentVersion::Points& points, const std::string& filename, const ExportProgress& progress)
+{
+    TRACE_SCOPE_ARG(TraceEvents::CAT_FILE_IO, "SaveDrawing", "points", points.size());
+    return WritePoints(points, filename, 0, progress);
+}
+
+bool ReplaceDrawing(const std::string& savedPath, const std::string& filename, uint64_t generation)
+{
+    std::FILE* file = std::fopen(savedPath.c_str(), "r+b");
+    if (!file) {
+        return false;
     }
+    bool ok = SeekTo(file, MpspFormat::HEADER_V2_SIZE - sizeof(uint64_t)) &&
+              std::fwrite(&generation, sizeof(uint64_t), 1, file) == 1;
+    ok = (std::fclose(file) == 0) && ok;
+    return ok && ReplaceFileWith(savedPath, filename);
+}
+
+// Bytes between the read position and the end of the file, 0 if unknown
+static size_t RemainingBytes(std::FILE* file)
+{
+    long position = std::ftell(file);
+    if (position < 0 || std::fseek(file, 0, SEEK_END) != 0) {
+        return 0;
+    }
+    long end = std::ftell(file);
+    if (std::fseek(file, position, SEEK_SET) != 0 || end < position) {
+        return 0;
+    }
+    return (size_t)(end - position);
+}
+
+// Reads version 1 point records (one fread per field)
+static bool ReadPointsV1(std::FILE* file, uint32_t pointCount, std::vector<DrawPoint>& points, const ExportProgress& progress)
+{
+    for (uint32_t i = 0; i < pointCount; i++) {
+        DrawPoint point;
+        if (std::fread(&point.x, sizeof(int), 1, file) != 1 ||
+            std::fread(&point.y, sizeof(int), 1, file) != 1 ||
+            std::fread(&point.color, sizeof(COLORREF), 1, file) != 1 ||
+            std::fread(&point.isStart, sizeof(bool), 1, file) != 1 ||
+            std::fread(&point.brushSize, sizeof(int), 1, file) != 1 ||
+            std::fread(&point.toolType, sizeof(ToolType), 1, file) != 1) {
+            return false;
+        }
+        points.push_back(point);
+        if (progress && (i + 1) % FILE_BLOCK_POINTS == 0 && !progress((double)(i + 1) / pointCount)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads version 2 packed point records in blocks
+static bool ReadPointsV2(std::FILE* file, uint32_t pointCount, std::vector<DrawPoint>& points, const ExportProgress& progress)
+{
+    std::vector<MpspFormat::PackedPoint> block(FILE_BLOCK_POINTS);
+    MemoryStats::Allocation blockMemory(MemoryStats::MEM_FILE_BUFFERS, FILE_BLOCK_POINTS * sizeof(MpspFormat::PackedPoint));
     
+    size_t remaining = pointCount;
+    while (remaining > 0) {
+        size_t count = std::min(FILE_BLOCK_POINTS, remaining);
+        if (std::fread(block.data(), sizeof(MpspFormat::PackedPoint), count, file) != count) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            points.push_back(MpspFormat::Unpack(block[i]));
+        }
+        remaining -= count;
+        if (progress && !progress((double)(pointCount - remaining) / pointCount)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Shared by the slices of one parallel load
+struct SliceProgress {
+    const ExportProgress& progress;
+    size_t total;
+    std::atomic<size_t> decoded{0};
+    std::atomic<bool> stopped{false};      // A slice failed or the load was cancelled
+};
+
+// Decodes records [first, first + count) of a v2 file into points[first...]
+// through its own handle
+static bool ReadSliceV2(const std::string& filename, uint64_t payloadOffset, size_t first, size_t count,
+                        DrawPoint* points, SliceProgress& shared)
+{
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+        shared.stopped = true;
+        return false;
+    }
+    
+    std::vector<MpspFormat::PackedPoint> block(FILE_BLOCK_POINTS);
+    MemoryStats::Allocation blockMemory(MemoryStats::MEM_FILE_BUFFERS, FILE_BLOCK_POINTS * sizeof(MpspFormat::PackedPoint));
+    bool ok = SeekTo(file, payloadOffset + (uint64_t)first * sizeof(MpspFormat::PackedPoint));
+    for (size_t done = 0; ok && done < count && !shared.stopped; ) {
+        size_t n = std::min(FILE_BLOCK_POINTS, count - done);
+        ok = std::fread(block.data(), sizeof(MpspFormat::PackedPoint), n, file) == n;
+        for (size_t i = 0; ok && i < n; i++) {
+            points[first + done + i] = MpspFormat::Unpack(block[i]);
+        }
+        done += n;
+        size_t decoded = shared.decoded += n;
+        ok = ok && (!shared.progress || shared.progress((double)decoded / shared.total));
+    }
     std::fclose(file);
+    if (!ok) {
+        shared.stopped = true;
+    }
+    return ok && !shared.stopped;
+}
+
+// Records are fixed-size, so a large v2 file splits into independent slices
+// that decode on several threads. They decode into a buffer left
+// uninitialized, so each slice is the first to touch its range; the points
+// are then copied into the caller's vector in one pass.
+static bool ReadPointsParallel(const std::string& filename, uint64_t payloadOffset, uint32_t pointCount,
+                               std::vector<DrawPoint>& points, const ExportProgress& progress)
+{
+    TRACE_SCOPE_ARG(TraceEvents::CAT_FILE_IO, "ReadPointsParallel", "points", pointCount);
+    size_t slices = std::max(1u, std::min(std::thread::hardware_concurrency(), pointCount / (LOAD_PARALLEL_MIN_POINTS / 4)));
+    std::unique_ptr<DrawPoint[]> decoded(new DrawPoint[pointCount]);
+    MemoryStats::Allocation decodedMemory(MemoryStats::MEM_FILE_BUFFERS, (size_t)pointCount * sizeof(DrawPoint));
+    
+    SliceProgress shared{progress, pointCount};
+    std::vector<uint8_t> sliceOk(slices, 0);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < slices; i++) {
+        size_t first = (size_t)pointCount * i / slices;
+        size_t count = (size_t)pointCount * (i + 1) / slices - first;
+        auto decode = [&, i, first, count]() {
+            sliceOk[i] = ReadSliceV2(filename, payloadOffset, first, count, decoded.get(), shared);
+        };
+        try {
+            if (i + 1 < slices) {
+                workers.emplace_back(decode);
+            } else {
+                decode();   // The last slice on the calling thread
+            }
+        } catch (const std::system_error&) {
+            decode();
+        }
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    
+    if (std::find(sliceOk.begin(), sliceOk.end(), 0) != sliceOk.end()) {
+        return false;
+    }
+    points.assign(decoded.get(), decoded.get() + pointCount);
     return true;
 }
 
-bool LoadDrawing(const std::string& filename)
+// Reads a native file into points and generation; the caller's document is untouched
+static bool ReadDrawing(const std::string& filename, std::vector<DrawPoint>& points, uint64_t& documentGeneration,
+                        const ExportProgress& progress)
 {
     std::FILE* file = std::fopen(filename.c_str(), "rb");
     if (!file) {
@@ -354,170 +846,254 @@ bool LoadDrawing(const std::string& filename)
     if (std::fread(header, 1, 4, file) != 4 ||
         std::strcmp(header, "MPSP") != 0 ||
         std::fread(&version, sizeof(uint32_t), 1, file) != 1 ||
-        version != 1) {
+        (version != MpspFormat::VERSION_1 && version != MpspFormat::VERSION_2)) {
         std::fclose(file);
         return false;
     }
     
-    // Read number of points
+    // Read number of points (and the v2 header tail)
     uint32_t pointCount;
-    if (std::fread(&pointCount, sizeof(uint32_t), 1, file) != 1) {
+    uint32_t reserved = 0;
+    uint64_t generation = 0;
+    if (std::fread(&pointCount, sizeof(uint32_t), 1, file) != 1 ||
+        (version == MpspFormat::VERSION_2 &&
+         (std::fread(&reserved, sizeof(uint32_t), 1, file) != 1 ||
+          std::fread(&generation, sizeof(uint64_t), 1, file) != 1))) {
         std::fclose(file);
         return false;
     }
     
-    // Clear current drawing
+    // Reserve once, but no more than the file can hold so a corrupt count fails cleanly
+    points.clear();
+    size_t recordSize = (version == MpspFormat::VERSION_1) ? MpspFormat::RECORD_V1_SIZE : sizeof(MpspFormat::PackedPoint);
+    size_t available = RemainingBytes(file) / recordSize;
+    bool ok;
+    if (version == MpspFormat::VERSION_2 && pointCount >= LOAD_PARALLEL_MIN_POINTS) {
+        ok = pointCount <= available && ReadPointsParallel(filename, MpspFormat::HEADER_V2_SIZE, pointCount, points, progress);
+    } else {
+        points.reserve(std::min((size_t)pointCount, available));
+        ok = (version == MpspFormat::VERSION_1) ? ReadPointsV1(file, pointCount, points, progress)
+                                                : ReadPointsV2(file, pointCount, points, progress);
+    }
+    std::fclose(file);
+    if (ok) {
+        documentGeneration = generation;
+    }
+    return ok;
+}
+
+bool LoadDrawing(const std::string& filename)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "LoadDrawing");
+    
+    // The current drawing is only replaced once the whole file is valid
+    std::vector<DrawPoint> points;
+    uint64_t generation = 0;
+    if (!ReadDrawing(filename, points, generation, nullptr)) {
+        return false;
+    }
+    
     AppState& app = AppState::Instance();
-    app.drawingPoints.clear();
+    app.drawingPoints.swap(points);
+    app.documentGeneration = generation;
     
-    // Read drawing points
-    for (uint32_t i = 0; i < pointCount; i++) {
-        DrawPoint point;
-        if (std::fread(&point.x, sizeof(int), 1, file) != 1 ||
-            std::fread(&point.y, sizeof(int), 1, file) != 1 ||
-            std::fread(&point.color, sizeof(COLORREF), 1, file) != 1 ||
-            std::fread(&point.isStart, sizeof(bool), 1, file) != 1 ||
-            std::fread(&point.brushSize, sizeof(int), 1, file) != 1 ||
-            std::fread(&point.toolType, sizeof(ToolType), 1, file) != 1) {
-            std::fclose(file);
+    SaveState(); // Add to undo stack
+    return true;
+}
+
+bool LoadDrawing(const std::string& filename, std::vector<DrawPoint>& points, uint64_t& generation, const ExportProgress& progress)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "LoadDrawing");
+    return ReadDrawing(filename, points, generation, progress);
+}
+
+// Case-insensitive suffix test, e.g. HasExtension("a.QOI", ".qoi")
+static bool HasExtension(const std::string& filename, const char* extension)
+{
+    size_t length = std::strlen(extension);
+    if (filename.length() < length) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (std::tolower((unsigned char)filename[filename.length() - length + i]) != extension[i]) {
             return false;
         }
-        app.drawingPoints.push_back(point);
     }
-    
-    std::fclose(file);
-    SaveState(); // Add to undo stack
     return true;
 }
 
-bool ExportAsBitmap(const std::string& filename, int width, int height)
+// Strokes plus the reference layer; false if both are empty
+static bool ExportBounds(const std::vector<DrawPoint>& points, const RasterImage& reference, RasterRenderer::Bounds& bounds)
 {
-    AppState& app = AppState::Instance();
-    
-    // Create a bitmap
-    HDC hdcScreen = GetDC(NULL);
-    HDC hdcMem = CreateCompatibleDC(hdcScreen);
-    HBITMAP hBitmap = CreateCompatibleBitmap(hdcScreen, width, height);
-    HBITMAP hOldBitmap = (HBITMAP)SelectObject(hdcMem, hBitmap);
-    
-    // Fill with white background
-    RECT rect = {0, 0, width, height};
-    FillRect(hdcMem, &rect, (HBRUSH)GetStockObject(WHITE_BRUSH));
-    
-    // Draw strokes properly by connecting points
-    if (!app.drawingPoints.empty()) {
-        HPEN currentPen = NULL;
-        HBRUSH currentBrush = NULL;
-        COLORREF currentColor = RGB(0, 0, 0);
-        int currentSize = 1;
-        
-        for (size_t i = 0; i < app.drawingPoints.size(); i++) {
-            const DrawPoint& point = app.drawingPoints[i];
-            
-            // Skip points outside canvas bounds
-            if (point.x < 0 || point.x >= width || point.y < 0 || point.y >= height) {
-                continue;
-            }
-            
-            // Create new pen/brush if color or size changed
-            if (currentColor != point.color || currentSize != point.brushSize) {
-                if (currentPen) DeleteObject(currentPen);
-                if (currentBrush) DeleteObject(currentBrush);
-                
-                currentColor = point.color;
-                currentSize = point.brushSize;
-                currentPen = CreatePen(PS_SOLID, currentSize, currentColor);
-                currentBrush = CreateSolidBrush(currentColor);
-            }
-            
-            // Handle different drawing tools
-            if (point.toolType == TOOL_BRUSH) {
-                SelectObject(hdcMem, currentPen);
-                
-                if (point.isStart) {
-                    // Start a new stroke
-                    MoveToEx(hdcMem, point.x, point.y, NULL);
-                } else {
-                    // Continue the stroke
-                    LineTo(hdcMem, point.x, point.y);
-                }
-                
-                // Also draw a circle at each point for brush texture
-                SelectObject(hdcMem, currentBrush);
-                int radius = currentSize / 2;
-                Ellipse(hdcMem, 
-                       point.x - radius, point.y - radius, 
-                       point.x + radius, point.y + radius);
-            }
-            else if (point.toolType == TOOL_ERASER) {
-                // Draw white circles for eraser
-                HBRUSH whiteBrush = CreateSolidBrush(RGB(255, 255, 255));
-                SelectObject(hdcMem, whiteBrush);
-                int radius = currentSize / 2;
-                Ellipse(hdcMem, 
-                       point.x - radius, point.y - radius, 
-                       point.x + radius, point.y + radius);
-                DeleteObject(whiteBrush);
-            }
-            else {
-                // For shapes (rectangle, circle, line), just draw points for now
-                // The actual shape reconstruction would require more complex logic
-                SelectObject(hdcMem, currentBrush);
-                int radius = std::max(1, currentSize / 2);
-                Ellipse(hdcMem, 
-                       point.x - radius, point.y - radius, 
-                       point.x + radius, point.y + radius);
-            }
+    bool any = RasterRenderer::DocumentBounds(points, bounds);
+    if (!reference.pixels.empty()) {
+        if (!any) {
+            bounds = { 0, 0, 0, 0 };
         }
-        
-        // Cleanup
-        if (currentPen) DeleteObject(currentPen);
-        if (currentBrush) DeleteObject(currentBrush);
+        RasterRenderer::IncludeReference(reference, bounds);
+        any = true;
     }
+    return any;
+}
+
+static bool ExportPoints(const std::vector<DrawPoint>& points, const RasterImage& reference, const std::string& filename,
+                         int left, int top, int width, int height, double scale, int samples, const ExportProgress* progress)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "ExportRegion");
     
-    // Save bitmap using GDI+
-    SelectObject(hdcMem, hOldBitmap);
+    double outputWidth = std::ceil(width * scale);
+    double outputHeight = std::ceil(height * scale);
+    if (width <= 0 || height <= 0 || !(scale > 0) || samples < 1 || samples > EXPORT_MAX_SAMPLES ||
+        outputWidth * samples > INT_MAX || outputHeight * samples > INT_MAX) {
+        return false;
+    }
     
-    // Convert filename to wide string
-    std::wstring wFilename(filename.begin(), filename.end());
+    RasterRenderer::View view;
+    view.originX = left;
+    view.originY = top;
+    view.scale = scale;
+    RasterRenderer::SceneIndex scene(points, view, (int)outputHeight, samples, &reference);
+    MemoryStats::Allocation sceneMemory(MemoryStats::MEM_RASTER, scene.MemoryBytes());
     
-    Bitmap bitmap(hBitmap, NULL);
-    CLSID pngClsid;
-    GetEncoderClsid(L"image/png", &pngClsid);
-    Status status = bitmap.Save(wFilename.c_str(), &pngClsid, NULL);
+    // Rows are rendered band by band on the encoder's workers and streamed to
+    // disk, so memory does not grow with the output size
+    int rowWidth = (int)outputWidth;
+    std::atomic<int64_t> rowsDone{0};
+    ImageStream::RowSource rows = [&scene, &rowsDone, rowWidth, outputHeight, progress](int firstRow, int rowCount, uint32_t* pixels) {
+        scene.RenderRows(rowWidth, firstRow, rowCount, RGB(255, 255, 255), pixels);
+        if (progress) {
+            // PNG groups render a row of overlap each, so the count runs slightly over
+            return (*progress)(std::min(1.0, (rowsDone += rowCount) / outputHeight));
+        }
+        return true;
+    };
     
-    // Cleanup
-    DeleteDC(hdcMem);
-    DeleteObject(hBitmap);
-    ReleaseDC(NULL, hdcScreen);
+    if (HasExtension(filename, ".qoi")) {
+        return QoiCodec::EncodeToFile(filename, rowWidth, (int)outputHeight, rows);
+    }
     
-    return status == Ok;
+    PngEncoder::Options options;
+    options.memoryBudget = EXPORT_MEMORY_BUDGET;
+    options.sourceScratchBytes = scene.ScratchBytes(rowWidth);
+    options.dpi = EXPORT_BASE_DPI * scale;
+    return PngEncoder::EncodeToFile(filename, rowWidth, (int)outputHeight, rows, options);
 }
 
-// Helper function to get encoder CLSID for bitmap export
-int GetEncoderClsid(const WCHAR* format, CLSID* pClsid)
+static bool ExportCanvas(const std::vector<DrawPoint>& points, const RasterImage& reference, const std::string& filename,
+                         int width, int height, const ExportProgress* progress)
 {
-    UINT num = 0;
-    UINT size = 0;
-    
-    GetImageEncodersSize(&num, &size);
-    if (size == 0) return -1;
-    
-    ImageCodecInfo* pImageCodecInfo = (ImageCodecInfo*)(malloc(size));
-    if (pImageCodecInfo == NULL) return -1;
-    
-    GetImageEncoders(num, size, pImageCodecInfo);
+    // Never clip the drawing to the window: grow the canvas to the document bounds
+    RasterRenderer::Bounds bounds = { 0, 0, width, height };
+    RasterRenderer::Bounds document;
+    if (ExportBounds(points, reference, document)) {
+        bounds.left = std::min(bounds.left, document.left);
+        bounds.top = std::min(bounds.top, document.top);
+        bounds.right = std::max(bounds.right, document.right);
+        bounds.bottom = std::max(bounds.bottom, document.bottom);
+    }
     
-    for (UINT j = 0; j < num; ++j) {
-        if (wcscmp(pImageCodecInfo[j].MimeType, format) == 0) {
-            *pClsid = pImageCodecInfo[j].Clsid;
-            free(pImageCodecInfo);
-            return j;
-        }
+    return ExportPoints(points, reference, filename, bounds.left, bounds.top, bounds.right - bounds.left, bounds.bottom - bounds.top,
+                        1.0, 1, progress);
+}
+
+static bool ExportBounded(const std::vector<DrawPoint>& points, const RasterImage& reference, const std::string& filename,
+                          double scale, int samples, const ExportProgress* progress)
+{
+    RasterRenderer::Bounds bounds;
+    if (!ExportBounds(points, reference, bounds)) {
+        return false;
     }
+    return ExportPoints(points, reference, filename, bounds.left, bounds.top, bounds.right - bounds.left, bounds.bottom - bounds.top,
+                        scale, samples, progress);
+}
+
+bool ExportAsBitmap(const std::string& filename, int width, int height)
+{
+    AppState& app = AppState::Instance();
+    return ExportCanvas(app.drawingPoints, app.referenceImage, filename, width, height, nullptr);
+}
+
+bool ExportRegion(const std::string& filename, int left, int top, int width, int height, double scale, int samples)
+{
+    AppState& app = AppState::Instance();
+    return ExportPoints(app.drawingPoints, app.referenceImage, filename, left, top, width, height, scale, samples, nullptr);
+}
+
+bool ExportDocument(const std::string& filename, double scale, int samples)
+{
+    AppState& app = AppState::Instance();
+    return ExportBounded(app.drawingPoints, app.referenceImage, filename, scale, samples, nullptr);
+}
+
+std::shared_ptr<const DocumentCopy> CopyDocument()
+{
+    return CopyDocument(DocumentVersion::Build(AppState::Instance().drawingPoints));
+}
+
+std::shared_ptr<const DocumentCopy> CopyDocument(const DocumentVersion::Points& points)
+{
+    std::shared_ptr<DocumentCopy> copy = std::make_shared<DocumentCopy>();
+    copy->points = points;
+    copy->reference = AppState::Instance().referenceImage;
+    copy->memory.Resize(copy->reference.pixels.capacity() * sizeof(uint32_t));
+    return copy;
+}
+
+// The renderer indexes points directly, so an export flattens its version first
+struct FlatPoints {
+    std::vector<DrawPoint> points;
+    MemoryStats::Allocation memory{MemoryStats::MEM_FILE_BUFFERS};
     
-    free(pImageCodecInfo);
-    return -1;
+    explicit FlatPoints(const DocumentVersion::Points& version) {
+        version.CopyTo(points);
+        memory.Resize(points.capacity() * sizeof(DrawPoint));
+    }
+};
+
+bool ExportAsBitmap(const DocumentCopy& document, const std::string& filename, int width, int height, const ExportProgress& progress)
+{
+    FlatPoints flat(document.points);
+    return ExportCanvas(flat.points, document.reference, filename, width, height, progress ? &progress : nullptr);
+}
+
+bool ExportDocument(const DocumentCopy& document, const std::string& filename, double scale, int samples,
+                    const ExportProgress& progress)
+{
+    FlatPoints flat(document.points);
+    return ExportBounded(flat.points, document.reference, filename, scale, samples, progress ? &progress : nullptr);
+}
+
+// Tracked rather than measured, so reports collected off the UI thread never
+// read the image while the UI replaces it
+static MemoryStats::Allocation referenceMemory(MemoryStats::MEM_REFERENCE);
+
+bool ImportReferenceImage(const std::string& filename)
+{
+    RasterImage image;
+    if (!DecodeReferenceImage(filename, image)) {
+        return false;
+    }
+    SetReferenceImage(std::move(image));
+    return true;
+}
+
+bool DecodeReferenceImage(const std::string& filename, RasterImage& image)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "ImportReferenceImage");
+    return QoiCodec::DecodeFile(filename, image);
+}
+
+void SetReferenceImage(RasterImage image)
+{
+    AppState& app = AppState::Instance();
+    app.referenceImage = std::move(image);
+    app.referenceRevision++;
+    referenceMemory.Resize(app.referenceImage.pixels.capacity() * sizeof(uint32_t));
+}
+
+void ClearReferenceImage()
+{
+    SetReferenceImage(RasterImage());
 }
 
 std::string EnsureFileExtension(const std::string& filename, const std::string& extension)
@@ -0,0 +1,608 @@
+#include "../../include/engine_thread.h"
+#include "../../include/spsc_queue.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/document_journal.h"
+#include "../../include/app_state.h"
+#include "../../include/frame_profiler.h"
+#include "../../include/trace_events.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace EngineThread {
+
+enum CommandType : uint8_t {
+    CMD_START,
+    CMD_CONTINUE,
+    CMD_END,
+    CMD_UNDO,
+    CMD_REDO,
+    CMD_CLEAR,
+    CMD_AUTOSAVE,
+    CMD_TASK                       // Front of queuedTasks
+};
+
+struct Command {
+    CommandType type = CMD_CONTINUE;
+    int x = 0, y = 0;              // CMD_START only
+    uint32_t points = 0;           // CMD_CONTINUE: its moves, next in pointQueue
+    StrokeSettings settings;       // CMD_START only
+    uint64_t sequence = 0;
+};
+
+struct QueuedTask {
+    Task task;
+    TaskDone done;
+};
+
+struct FinishedTask {
+    TaskDone done;
+    bool result = false;
+    std::shared_ptr<const Snapshot> snapshot;
+};
+
+struct PendingInput {
+    uint64_t sequence;             // Command that carries the input
+    uint64_t arrivalMicros;
+};
+
+static SpscQueue<Command, QUEUE_CAPACITY> queue;
+static SpscQueue<DrawingEngine::StrokePoint, POINT_CAPACITY> pointQueue;   // Pushed before their command
+static std::thread engine;
+static std::atomic<bool> running{false};
+static std::atomic<bool> stopRequested{false};
+static std::function<void()> notify;
+static std::atomic<bool> notifyPending{false};
+static std::shared_ptr<const Snapshot> latest;   // atomic_load/atomic_store only
+
+// The engine sleeps on wakeSignal once the ring is empty; producers only take
+// the lock when it says it is sleeping.
+static std::atomic<bool> sleeping{false};
+static std::mutex wakeLock;
+static std::condition_variable wakeSignal;
+static bool wakeRequested = false;
+
+// Run's tasks, in the order of their CMD_TASK commands
+static std::mutex taskLock;
+static std::deque<QueuedTask> queuedTasks;
+
+// UI thread only
+static std::deque<Command> overflow;             // In order, behind everything in the ring
+static std::deque<DrawingEngine::StrokePoint> overflowPoints;   // The overflowed CMD_CONTINUEs' moves
+static std::deque<PendingInput> pendingInputs;
+static uint64_t nextSequence = 0;
+
+// Engine thread only
+static uint64_t appliedSequence = 0;
+static uint64_t publishedVersion = 0;
+static std::vector<DrawingEngine::StrokePoint> moveRun;   // Consecutive CMD_CONTINUE of a batch
+static DrawingEngine::Damage unpublishedDamage;
+static size_t changedFrom = 0;     // Lowest point index changed since the last publish
+static size_t strokeFloor = 0;     // Lowest point index the stroke in progress can change
+static std::vector<FinishedTask> unpublishedTasks;       // Completions waiting for their snapshot
+
+// Changed area and task completions published but not yet taken by HandlePublished
+static std::mutex damageLock;
+static DrawingEngine::Damage pendingDamage;
+static std::deque<FinishedTask> finishedTasks;
+
+static std::atomic<uint64_t> commandsApplied{0};
+static std::atomic<uint64_t> batchesPublished{0};
+static std::atomic<uint64_t> overflowedCommands{0};
+static std::atomic<size_t> maxQueueDepth{0};
+static std::atomic<uint64_t> chunksShared{0};
+static std::atomic<uint64_t> chunksCopied{0};
+
+// damage stays empty when the points are unchanged: shape drags only move the
+// preview, which the UI draws itself, and a repaint would wipe it
+static void Apply(const Command& command, DrawingEngine::Damage& damage)
+{
+    damage = DrawingEngine::Damage();
+    damage.whole = true;
+    switch (command.type) {
+        case CMD_START:
+            DrawingEngine::StartDrawing(command.x, command.y, command.settings);
+            if (command.settings.tool == TOOL_BRUSH) {
+                int radius = command.settings.brushSize / 2 + 1;
+                damage.whole = false;
+                damage.left = command.x - radius;
+                damage.top = command.y - radius;
+                damage.right = command.x + radius + 1;
+                damage.bottom = command.y + radius + 1;
+            } else if (command.settings.tool != TOOL_ERASER) {
+                damage.whole = false;
+            }
+            break;
+        case CMD_CONTINUE: break;   // Gathered into moveRun
+        case CMD_END:      DrawingEngine::EndDrawing(); break;
+        case CMD_UNDO:     DrawingEngine::Undo(); break;
+        case CMD_REDO:     DrawingEngine::Redo(); break;
+        case CMD_CLEAR:    DrawingEngine::ClearCanvas(); break;
+        case CMD_AUTOSAVE: DocumentJournal::Autosave(); damage.whole = false; break;
+        case CMD_TASK:     break;   // RunTask
+    }
+}
+
+static bool IsEmpty(const DrawingEngine::Damage& damage)
+{
+    return !damage.whole && (damage.right <= damage.left || damage.bottom <= damage.top);
+}
+
+static void MergeDamage(DrawingEngine::Damage& into, const DrawingEngine::Damage& damage)
+{
+    if (IsEmpty(damage)) {
+        return;
+    }
+    if (damage.whole) {
+        into.whole = true;
+    } else if (into.right <= into.left) {
+        into.left = damage.left;
+        into.top = damage.top;
+        into.right = damage.right;
+        into.bottom = damage.bottom;
+    } else {
+        into.left = std::min(into.left, damage.left);
+        into.top = std::min(into.top, damage.top);
+        into.right = std::max(into.right, damage.right);
+        into.bottom = std::max(into.bottom, damage.bottom);
+    }
+}
+
+// Engine thread: adds to the area the next publish repaints; false when there is none
+static bool AddDamage(const DrawingEngine::Damage& damage)
+{
+    MergeDamage(unpublishedDamage, damage);
+    return !IsEmpty(damage);
+}
+
+static void NoteChanged(size_t from)
+{
+    changedFrom = std::min(changedFrom, from);
+}
+
+// Engine thread: marks the points a command may change before it applies. A
+// stroke other than an erase appends to the document and only edits its own
+// points (decimation, simplification), never those before its start point.
+static void NoteCommand(const Command& command)
+{
+    switch (command.type) {
+        case CMD_START:
+            strokeFloor = (command.settings.tool == TOOL_ERASER) ? 0 : AppState::Instance().drawingPoints.size();
+            NoteChanged(strokeFloor);
+            break;
+        case CMD_CONTINUE:
+        case CMD_END:      NoteChanged(strokeFloor); break;
+        case CMD_AUTOSAVE: break;
+        default:           NoteChanged(0); break;
+    }
+}
+
+// Engine thread: hands the moves gathered so far to DrawingEngine in one call
+static bool ApplyMoveRun()
+{
+    if (moveRun.empty()) {
+        return false;
+    }
+    NoteChanged(strokeFloor);
+    DrawingEngine::Damage damage;
+    DrawingEngine::ContinueDrawingBatch(moveRun.data(), moveRun.size(), &damage);
+    moveRun.clear();
+    return AddDamage(damage);
+}
+
+// Engine thread: builds the next version of the document, sharing the chunks
+// unchanged since the previous snapshot, and swaps it in; frames and exports
+// still holding the previous one keep it alive until they finish
+static void Publish()
+{
+    TRACE_SCOPE(TraceEvents::CAT_DOCUMENT, "PublishSnapshot");
+    AppState& app = AppState::Instance();
+    
+    static const DocumentVersion::Points none;
+    std::shared_ptr<const Snapshot> previous = std::atomic_load(&latest);
+    std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+    DocumentVersion::BuildStats built;
+    snapshot->points = DocumentVersion::Build(app.drawingPoints, previous ? previous->points : none, changedFrom, &built);
+    changedFrom = SIZE_MAX;
+    chunksShared.fetch_add(built.shared, std::memory_order_relaxed);
+    chunksCopied.fetch_add(built.copied, std::memory_order_relaxed);
+    snapshot->version = ++publishedVersion;
+    snapshot->appliedSequence = appliedSequence;
+    snapshot->memory = MemoryStats::Collect();
+    std::shared_ptr<const Snapshot> published(std::move(snapshot));
+    std::atomic_store(&latest, published);
+    batchesPublished.fetch_add(1, std::memory_order_relaxed);
+    
+    // After the store: damage the UI takes always has a snapshot to show it
+    {
+        std::lock_guard<std::mutex> guard(damageLock);
+        MergeDamage(pendingDamage, unpublishedDamage);
+        for (FinishedTask& finished : unpublishedTasks) {
+            finished.snapshot = published;
+            finishedTasks.push_back(std::move(finished));
+        }
+    }
+    unpublishedDamage = DrawingEngine::Damage();
+    unpublishedTasks.clear();
+    
+    if (notify && !notifyPending.exchange(true)) {
+        notify();
+    }
+}
+
+// Engine thread: runs the next task with every earlier command applied and
+// published, then publishes what it did for its completion
+static void RunTask()
+{
+    TRACE_SCOPE(TraceEvents::CAT_DOCUMENT, "EngineTask");
+    QueuedTask queued;
+    {
+        std::lock_guard<std::mutex> guard(taskLock);
+        queued = std::move(queuedTasks.front());
+        queuedTasks.pop_front();
+    }
+    
+    bool result = true;
+    if (queued.task) {
+        Publish();
+        NoteChanged(0);
+        result = queued.task();
+        DrawingEngine::Damage damage;
+        damage.whole = true;   // The task may have changed anything
+        AddDamage(damage);
+    }
+    if (queued.done) {
+        FinishedTask finished;
+        finished.done = std::move(queued.done);
+        finished.result = result;
+        unpublishedTasks.push_back(std::move(finished));
+    }
+    Publish();
+}
+
+static void Sleep()
+{
+    sleeping.store(true, std::memory_order_relaxed);
+    // Pairs with the fence in Wake: either the producer sees sleeping, or this sees its push
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (queue.Empty() && !stopRequested.load(std::memory_order_acquire)) {
+        std::unique_lock<std::mutex> lock(wakeLock);
+        wakeSignal.wait(lock, [] { return wakeRequested; });
+        wakeRequested = false;
+    }
+    sleeping.store(false, std::memory_order_relaxed);
+}
+
+static void EngineMain()
+{
+#ifdef MPS_TRACE_EVENTS
+    TraceEvents::SetThreadName("engine");
+#endif
+    bool dirty = true;   // The first snapshot goes out right away
+    
+    for (;;) {
+        // A batch is what was queued when it began, so a steady stream of input
+        // still gets a snapshot per batch
+        size_t depth = queue.Size();
+        if (depth > maxQueueDepth.load(std::memory_order_relaxed)) {
+            maxQueueDepth.store(depth, std::memory_order_relaxed);
+        }
+        if (depth > 0) {
+            TRACE_SCOPE_ARG(TraceEvents::CAT_DOCUMENT, "EngineBatch", "commands", depth);
+            Command command;
+            DrawingEngine::Damage damage;
+            for (size_t i = 0; i < depth && queue.Pop(command); i++) {
+                appliedSequence = command.sequence;
+                if (command.type == CMD_CONTINUE) {
+                    DrawingEngine::StrokePoint point;
+                    for (uint32_t j = 0; j < command.points && pointQueue.Pop(point); j++) {
+                        moveRun.push_back(point);
+                    }
+                    commandsApplied.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                dirty |= ApplyMoveRun();
+                if (command.type == CMD_TASK) {
+                    RunTask();
+                    dirty = false;
+                    commandsApplied.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    NoteCommand(command);
+                    Apply(command, damage);
+                    dirty |= AddDamage(damage);
+                    commandsApplied.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            dirty |= ApplyMoveRun();
+        }
+        
+        if (dirty) {
+            Publish();
+            dirty = false;
+        }
+        if (queue.Empty()) {
+            if (stopRequested.load(std::memory_order_acquire)) {
+                break;
+            }
+            Sleep();
+        }
+    }
+}
+
+static void Wake()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> guard(wakeLock);
+        wakeRequested = true;
+        wakeSignal.notify_one();
+    }
+}
+
+static void ForceWake()
+{
+    std::lock_guard<std::mutex> guard(wakeLock);
+    wakeRequested = true;
+    wakeSignal.notify_one();
+}
+
+// UI thread: a CMD_CONTINUE's moves go into pointQueue first, and only once
+// the command is sure of its slot (the engine only ever shrinks the ring)
+template <typename Iterator>
+static bool PushCommand(const Command& command, Iterator points)
+{
+    if (command.type == CMD_CONTINUE &&
+        (queue.Size() == QUEUE_CAPACITY || !pointQueue.Push(points, command.points))) {
+        return false;
+    }
+    return queue.Push(command);
+}
+
+// UI thread: moves waiting commands into the rings while there is room
+static void FlushOverflow()
+{
+    while (!overflow.empty() && PushCommand(overflow.front(), overflowPoints.begin())) {
+        if (overflow.front().type == CMD_CONTINUE) {
+            overflowPoints.erase(overflowPoints.begin(), overflowPoints.begin() + overflow.front().points);
+        }
+        overflow.pop_front();
+    }
+}
+
+static void Post(CommandType type, int x = 0, int y = 0, const StrokeSettings& settings = StrokeSettings(),
+                 const DrawingEngine::StrokePoint* points = nullptr, uint32_t pointCount = 0)
+{
+    Command command;
+    command.type = type;
+    command.x = x;
+    command.y = y;
+    command.points = pointCount;
+    command.settings = settings;
+    
+    if (!running.load(std::memory_order_relaxed)) {
+        DrawingEngine::Damage damage;
+        Apply(command, damage);
+        return;
+    }
+    
+    command.sequence = ++nextSequence;
+    uint64_t arrival = FrameProfiler::TakeArrivingInput();
+    if (arrival && pendingInputs.size() < FrameProfiler::LATENCY_HISTORY) {
+        pendingInputs.push_back({command.sequence, arrival});
+    }
+    
+    FlushOverflow();
+    if (!overflow.empty() || !PushCommand(command, points)) {
+        overflow.push_back(command);
+        overflowPoints.insert(overflowPoints.end(), points, points + pointCount);
+        overflowedCommands.fetch_add(1, std::memory_order_relaxed);
+    }
+    Wake();
+}
+
+bool Start(std::function<void()> notifyCallback)
+{
+    if (running.load()) {
+        return false;
+    }
+    notify = std::move(notifyCallback);
+    notifyPending.store(false);
+    stopRequested.store(false);
+    appliedSequence = 0;
+    nextSequence = 0;
+    moveRun.reserve(POINT_CAPACITY);   // A batch never holds more
+    unpublishedDamage = DrawingEngine::Damage();
+    unpublishedDamage.whole = true;   // Goes out with the first snapshot
+    pendingDamage = DrawingEngine::Damage();
+    finishedTasks.clear();
+    changedFrom = 0;
+    strokeFloor = 0;
+    
+    running.store(true);
+    try {
+        engine = std::thread(EngineMain);
+    } catch (const std::system_error&) {
+        running.store(false);
+        notify = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void Stop()
+{
+    if (!running.load()) {
+        return;
+    }
+    
+    // Everything the UI queued is applied before the thread exits
+    while (FlushOverflow(), !overflow.empty()) {
+        ForceWake();
+        std::this_thread::yield();
+    }
+    stopRequested.store(true, std::memory_order_release);
+    ForceWake();
+    engine.join();
+    
+    running.store(false);
+    notify = nullptr;
+    std::atomic_store(&latest, std::shared_ptr<const Snapshot>());
+    pendingInputs.clear();
+    finishedTasks.clear();   // Every task ran; only the UI's follow-up is dropped
+}
+
+bool IsRunning()
+{
+    return running.load();
+}
+
+void StartDrawing(int x, int y, const StrokeSettings& settings)
+{
+    Post(CMD_START, x, y, settings);
+}
+
+void ContinueDrawing(int x, int y)
+{
+    DrawingEngine::StrokePoint point = {x, y};
+    ContinueDrawing(&point, 1);
+}
+
+void ContinueDrawing(const DrawingEngine::StrokePoint* points, size_t count)
+{
+    if (!running.load(std::memory_order_relaxed)) {
+        DrawingEngine::ContinueDrawingBatch(points, count);
+        return;
+    }
+    // One command per batch; a huge one is split so it never needs the whole ring
+    for (size_t done = 0; done < count; done += MAX_BATCH_POINTS) {
+        size_t part = std::min(count - done, MAX_BATCH_POINTS);
+        Post(CMD_CONTINUE, 0, 0, StrokeSettings(), points + done, (uint32_t)part);
+    }
+}
+
+void EndDrawing()
+{
+    Post(CMD_END);
+}
+
+void Undo()
+{
+    Post(CMD_UNDO);
+}
+
+void Redo()
+{
+    Post(CMD_REDO);
+}
+
+void ClearCanvas()
+{
+    Post(CMD_CLEAR);
+}
+
+void Autosave()
+{
+    Post(CMD_AUTOSAVE);
+}
+
+bool HandlePublished(DrawingEngine::Damage* damage)
+{
+    {
+        std::lock_guard<std::mutex> guard(damageLock);
+        if (damage) {
+            *damage = pendingDamage;
+        }
+        pendingDamage = DrawingEngine::Damage();
+    }
+    notifyPending.store(false);
+    if (!overflow.empty()) {
+        FlushOverflow();
+        Wake();
+    }
+    
+    // One at a time and outside the lock: a completion may open a message box,
+    // whose loop can come back here for the next one
+    for (;;) {
+        FinishedTask finished;
+        {
+            std::lock_guard<std::mutex> guard(damageLock);
+            if (finishedTasks.empty()) {
+                break;
+            }
+            finished = std::move(finishedTasks.front());
+            finishedTasks.pop_front();
+        }
+        finished.done(finished.result, *finished.snapshot);
+    }
+    return overflow.empty();
+}
+
+std::shared_ptr<const Snapshot> Latest()
+{
+    return std::atomic_load(&latest);
+}
+
+void ReportApplied(const Snapshot& snapshot)
+{
+    while (!pendingInputs.empty() && pendingInputs.front().sequence <= snapshot.appliedSequence) {
+        FrameProfiler::InputArrived(pendingInputs.front().arrivalMicros);
+        FrameProfiler::InputApplied();
+        pendingInputs.pop_front();
+    }
+}
+
+Status CurrentStatus()
+{
+    Status status;
+    if (!running.load()) {
+        status.points = AppState::Instance().drawingPoints.size();
+        status.memory = MemoryStats::Collect();
+    } else if (std::shared_ptr<const Snapshot> snapshot = Latest()) {
+        status.points = snapshot->points.size();
+        status.memory = snapshot->memory;
+    }
+    return status;
+}
+
+void Run(Task task, TaskDone done)
+{
+    if (!running.load()) {
+        bool result = task ? task() : true;
+        if (done) {
+            Snapshot snapshot;
+            snapshot.points = DocumentVersion::Build(AppState::Instance().drawingPoints);
+            snapshot.memory = MemoryStats::Collect();
+            done(result, snapshot);
+        }
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> guard(taskLock);
+        QueuedTask queued;
+        queued.task = std::move(task);
+        queued.done = std::move(done);
+        queuedTasks.push_back(std::move(queued));
+    }
+    Post(CMD_TASK);
+}
+
+Stats GetStats()
+{
+    Stats stats;
+    stats.commands = commandsApplied.load(std::memory_order_relaxed);
+    stats.batches = batchesPublished.load(std::memory_order_relaxed);
+    stats.overflowed = overflowedCommands.load(std::memory_order_relaxed);
+    stats.maxQueueDepth = maxQueueDepth.load(std::memory_order_relaxed);
+    stats.chunksShared = chunksShared.load(std::memory_order_relaxed);
+    stats.chunksCopied = chunksCopied.load(std::memory_order_relaxed);
+    return stats;
+}
+
+}
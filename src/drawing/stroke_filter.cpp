@@ -0,0 +1,63 @@
+#include "../../include/stroke_filter.h"
+#include <cmath>
+
+namespace StrokeFilter {
+
+static const double PI = 3.14159265358979323846;
+
+// Exponential smoothing factor for a first-order low-pass at cutoff Hz
+static double Alpha(double cutoff, double seconds)
+{
+    double tau = 1.0 / (2.0 * PI * cutoff);
+    return 1.0 / (1.0 + tau / seconds);
+}
+
+void Reset(Filter& filter, double x, double y, uint64_t micros)
+{
+    filter.position.x = x;
+    filter.position.y = y;
+    filter.sample = filter.position;
+    filter.velocity = Position();
+    filter.lastMicros = micros;
+}
+
+Position Apply(Filter& filter, double x, double y, uint64_t micros)
+{
+    double seconds = micros > filter.lastMicros ? (micros - filter.lastMicros) / 1e6 : 1e-3;
+    filter.lastMicros = micros > filter.lastMicros ? micros : filter.lastMicros;
+    const Params& params = filter.params;
+    
+    // Velocity from the raw samples, itself smoothed. (The original filter
+    // differentiates against its lagging output, which overstates the speed
+    // the prediction extrapolates.)
+    double derivativeAlpha = Alpha(params.derivativeCutoff, seconds);
+    filter.velocity.x += derivativeAlpha * ((x - filter.sample.x) / seconds - filter.velocity.x);
+    filter.velocity.y += derivativeAlpha * ((y - filter.sample.y) / seconds - filter.velocity.y);
+    filter.sample.x = x;
+    filter.sample.y = y;
+    double speed = std::sqrt(filter.velocity.x * filter.velocity.x + filter.velocity.y * filter.velocity.y);
+    
+    // One cutoff for both axes keeps diagonal strokes straight
+    double alpha = Alpha(params.minCutoff + params.beta * speed, seconds);
+    filter.position.x += alpha * (x - filter.position.x);
+    filter.position.y += alpha * (y - filter.position.y);
+    return filter.position;
+}
+
+Position Predict(const Filter& filter, uint64_t aheadMicros, double maxDistance)
+{
+    double seconds = aheadMicros / 1e6;
+    double moveX = filter.velocity.x * seconds;
+    double moveY = filter.velocity.y * seconds;
+    double distance = std::sqrt(moveX * moveX + moveY * moveY);
+    if (distance > maxDistance && distance > 0.0) {
+        moveX *= maxDistance / distance;
+        moveY *= maxDistance / distance;
+    }
+    Position predicted;
+    predicted.x = filter.position.x + moveX;
+    predicted.y = filter.position.y + moveY;
+    return predicted;
+}
+
+}
@@ -0,0 +1,471 @@
+#include "../../include/deflate.h"
+#include <algorithm>
+#include <queue>
+#include <cstring>
+
+namespace Deflate {
+
+static const int WINDOW_SIZE = 32768;
+static const int MIN_MATCH = 3;
+static const int MAX_MATCH = 258;
+static const int HASH_BITS = 15;
+static const size_t BLOCK_SYMBOLS = 32768;   // Symbols per block before a new Huffman table is worth it
+
+static const int LITLEN_CODES = 286;
+static const int DIST_CODES = 30;
+static const int CODELEN_CODES = 19;
+static const int MAX_CODE_BITS = 15;
+static const int MAX_CODELEN_BITS = 7;
+
+static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DIST_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DIST_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t CODELEN_ORDER[CODELEN_CODES] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Length -> length code index and distance -> distance code index lookups
+struct CodeTables {
+    uint8_t lengthCode[MAX_MATCH + 1];
+    uint8_t distCode[WINDOW_SIZE + 1];
+    
+    CodeTables() {
+        for (int code = 0; code < 29; code++) {
+            int end = (code == 28) ? MAX_MATCH + 1 : LENGTH_BASE[code + 1];
+            for (int len = LENGTH_BASE[code]; len < end; len++) {
+                lengthCode[len] = (uint8_t)code;
+            }
+        }
+        lengthCode[MAX_MATCH] = 28;
+        for (int code = 0; code < 30; code++) {
+            int end = (code == 29) ? WINDOW_SIZE + 1 : DIST_BASE[code + 1];
+            for (int dist = DIST_BASE[code]; dist < end; dist++) {
+                distCode[dist] = (uint8_t)code;
+            }
+        }
+    }
+};
+
+static const CodeTables& Tables()
+{
+    static const CodeTables tables;
+    return tables;
+}
+
+// LSB-first bit packer
+struct BitWriter {
+    std::vector<uint8_t>& out;
+    uint64_t bits = 0;
+    int count = 0;
+    
+    explicit BitWriter(std::vector<uint8_t>& target) : out(target) {}
+    
+    void Put(uint32_t value, int n) {
+        bits |= (uint64_t)value << count;
+        count += n;
+        while (count >= 8) {
+            out.push_back((uint8_t)bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+    
+    void AlignToByte() {
+        if (count > 0) {
+            out.push_back((uint8_t)bits);
+            bits = 0;
+            count = 0;
+        }
+    }
+};
+
+// A literal (length < 256, dist 0) or a back-reference (256 + length, dist)
+struct Symbol {
+    uint16_t litlen;
+    uint16_t dist;
+};
+
+static uint16_t ReverseBits(uint16_t code, int length)
+{
+    uint16_t result = 0;
+    for (int i = 0; i < length; i++) {
+        result = (uint16_t)((result << 1) | (code & 1));
+        code >>= 1;
+    }
+    return result;
+}
+
+// Huffman code lengths limited to maxBits
+static void BuildLengths(const uint32_t* frequencies, int n, int maxBits, uint8_t* lengths)
+{
+    std::vector<uint32_t> freq(frequencies, frequencies + n);
+    
+    // Decoders expect at least two codes per tree
+    int used = 0;
+    for (int i = 0; i < n; i++) {
+        if (freq[i]) used++;
+    }
+    for (int i = 0; used < 2 && i < n; i++) {
+        if (!freq[i]) {
+            freq[i] = 1;
+            used++;
+        }
+    }
+    
+    while (true) {
+        struct Node { uint32_t freq; int left, right; };
+        std::vector<Node> nodes;
+        typedef std::pair<uint32_t, int> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+        
+        for (int i = 0; i < n; i++) {
+            if (freq[i]) {
+                nodes.push_back({freq[i], -1, i});
+                heap.push(Entry(freq[i], (int)nodes.size() - 1));
+            }
+        }
+        while (heap.size() > 1) {
+            Entry a = heap.top(); heap.pop();
+            Entry b = heap.top(); heap.pop();
+            nodes.push_back({a.first + b.first, a.second, b.second});
+            heap.push(Entry(a.first + b.first, (int)nodes.size() - 1));
+        }
+        
+        // Leaves store their symbol in 'right' with left == -1
+        std::fill(lengths, lengths + n, 0);
+        int maxDepth = 0;
+        std::vector<std::pair<int, int>> stack;
+        stack.push_back(std::make_pair(heap.top().second, 0));
+        while (!stack.empty()) {
+            std::pair<int, int> item = stack.back();
+            stack.pop_back();
+            const Node& node = nodes[item.first];
+            if (node.left < 0) {
+                lengths[node.right] = (uint8_t)item.second;
+                maxDepth = std::max(maxDepth, item.second);
+            } else {
+                stack.push_back(std::make_pair(node.left, item.second + 1));
+                stack.push_back(std::make_pair(node.right, item.second + 1));
+            }
+        }
+        
+        if (maxDepth <= maxBits) {
+            return;
+        }
+        
+        // Flatten the distribution and try again
+        for (uint32_t& f : freq) {
+            if (f) f = (f + 1) / 2;
+        }
+    }
+}
+
+// Canonical codes (bit-reversed for LSB-first output)
+static void BuildCodes(const uint8_t* lengths, int n, uint16_t* codes)
+{
+    uint16_t lengthCount[MAX_CODE_BITS + 1] = {0};
+    for (int i = 0; i < n; i++) {
+        lengthCount[lengths[i]]++;
+    }
+    lengthCount[0] = 0;
+    
+    uint16_t nextCode[MAX_CODE_BITS + 1] = {0};
+    uint16_t code = 0;
+    for (int bits = 1; bits <= MAX_CODE_BITS; bits++) {
+        code = (uint16_t)((code + lengthCount[bits - 1]) << 1);
+        nextCode[bits] = code;
+    }
+    
+    for (int i = 0; i < n; i++) {
+        codes[i] = lengths[i] ? ReverseBits(nextCode[lengths[i]]++, lengths[i]) : 0;
+    }
+}
+
+// Run-length encoded code length sequence for the dynamic block header
+struct CodeLengthSymbol {
+    uint8_t symbol;
+    uint8_t extra;
+};
+
+static void EncodeCodeLengths(const uint8_t* lengths, int total, std::vector<CodeLengthSymbol>& out)
+{
+    int i = 0;
+    while (i < total) {
+        uint8_t current = lengths[i];
+        int run = 1;
+        while (i + run < total && lengths[i + run] == current) {
+            run++;
+        }
+        i += run;
+        
+        if (current == 0) {
+            while (run >= 11) {
+                int r = std::min(run, 138);
+                out.push_back({18, (uint8_t)(r - 11)});
+                run -= r;
+            }
+            if (run >= 3) {
+                out.push_back({17, (uint8_t)(run - 3)});
+                run = 0;
+            }
+        } else {
+            out.push_back({current, 0});
+            run--;
+            while (run >= 3) {
+                int r = std::min(run, 6);
+                out.push_back({16, (uint8_t)(r - 3)});
+                run -= r;
+            }
+        }
+        while (run-- > 0) {
+            out.push_back({current, 0});
+        }
+    }
+}
+
+static int CodeLengthExtraBits(uint8_t symbol)
+{
+    return symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0;
+}
+
+static void WriteSymbols(BitWriter& writer, const std::vector<Symbol>& symbols,
+                         const uint8_t* litLengths, const uint16_t* litCodes,
+                         const uint8_t* distLengths, const uint16_t* distCodes)
+{
+    const CodeTables& tables = Tables();
+    
+    for (const Symbol& symbol : symbols) {
+        if (symbol.litlen < 256) {
+            writer.Put(litCodes[symbol.litlen], litLengths[symbol.litlen]);
+        } else {
+            int length = symbol.litlen - 256;
+            int lc = tables.lengthCode[length];
+            writer.Put(litCodes[257 + lc], litLengths[257 + lc]);
+            writer.Put(length - LENGTH_BASE[lc], LENGTH_EXTRA[lc]);
+            
+            int dc = tables.distCode[symbol.dist];
+            writer.Put(distCodes[dc], distLengths[dc]);
+            writer.Put(symbol.dist - DIST_BASE[dc], DIST_EXTRA[dc]);
+        }
+    }
+    writer.Put(litCodes[256], litLengths[256]);
+}
+
+static void WriteStoredBlocks(BitWriter& writer, const uint8_t* raw, size_t size, bool last)
+{
+    do {
+        size_t chunk = std::min<size_t>(size, 65535);
+        size -= chunk;
+        writer.Put((last && size == 0) ? 1 : 0, 1);
+        writer.Put(0, 2);
+        writer.AlignToByte();
+        uint16_t len = (uint16_t)chunk;
+        uint16_t nlen = (uint16_t)~len;
+        writer.Put(len, 16);
+        writer.Put(nlen, 16);
+        writer.out.insert(writer.out.end(), raw, raw + chunk);
+        raw += chunk;
+    } while (size > 0);
+}
+
+// Emits symbols as a dynamic, fixed or stored block, whichever is smallest
+static void EmitBlock(BitWriter& writer, const std::vector<Symbol>& symbols,
+                      const uint8_t* raw, size_t rawSize, bool last)
+{
+    const CodeTables& tables = Tables();
+    
+    uint32_t litFreq[LITLEN_CODES] = {0};
+    uint32_t distFreq[DIST_CODES] = {0};
+    for (const Symbol& symbol : symbols) {
+        if (symbol.litlen < 256) {
+            litFreq[symbol.litlen]++;
+        } else {
+            litFreq[257 + tables.lengthCode[symbol.litlen - 256]]++;
+            distFreq[tables.distCode[symbol.dist]]++;
+        }
+    }
+    litFreq[256] = 1;
+    
+    // Bits spent on length/distance extra bits (same for dynamic and fixed)
+    uint64_t extraBits = 0;
+    for (int i = 0; i < 29; i++) extraBits += (uint64_t)litFreq[257 + i] * LENGTH_EXTRA[i];
+    for (int i = 0; i < DIST_CODES; i++) extraBits += (uint64_t)distFreq[i] * DIST_EXTRA[i];
+    
+    // Dynamic tables
+    uint8_t litLengths[LITLEN_CODES];
+    uint8_t distLengths[DIST_CODES];
+    BuildLengths(litFreq, LITLEN_CODES, MAX_CODE_BITS, litLengths);
+    BuildLengths(distFreq, DIST_CODES, MAX_CODE_BITS, distLengths);
+    
+    int hlit = LITLEN_CODES;
+    while (hlit > 257 && litLengths[hlit - 1] == 0) hlit--;
+    int hdist = DIST_CODES;
+    while (hdist > 1 && distLengths[hdist - 1] == 0) hdist--;
+    
+    uint8_t allLengths[LITLEN_CODES + DIST_CODES];
+    std::memcpy(allLengths, litLengths, hlit);
+    std::memcpy(allLengths + hlit, distLengths, hdist);
+    std::vector<CodeLengthSymbol> codeLengthSymbols;
+    EncodeCodeLengths(allLengths, hlit + hdist, codeLengthSymbols);
+    
+    uint32_t clFreq[CODELEN_CODES] = {0};
+    for (const CodeLengthSymbol& cl : codeLengthSymbols) clFreq[cl.symbol]++;
+    uint8_t clLengths[CODELEN_CODES];
+    BuildLengths(clFreq, CODELEN_CODES, MAX_CODELEN_BITS, clLengths);
+    int hclen = CODELEN_CODES;
+    while (hclen > 4 && clLengths[CODELEN_ORDER[hclen - 1]] == 0) hclen--;
+    
+    uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * (uint64_t)hclen + extraBits;
+    for (const CodeLengthSymbol& cl : codeLengthSymbols) {
+        dynamicBits += clLengths[cl.symbol] + CodeLengthExtraBits(cl.symbol);
+    }
+    for (int i = 0; i < LITLEN_CODES; i++) dynamicBits += (uint64_t)litFreq[i] * litLengths[i];
+    for (int i = 0; i < DIST_CODES; i++) dynamicBits += (uint64_t)distFreq[i] * distLengths[i];
+    
+    // Fixed tables
+    uint8_t fixedLit[288];
+    uint8_t fixedDist[DIST_CODES];
+    for (int i = 0; i < 288; i++) {
+        fixedLit[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+    }
+    std::fill(fixedDist, fixedDist + DIST_CODES, 5);
+    uint64_t fixedBits = 3 + extraBits;
+    for (int i = 0; i < LITLEN_CODES; i++) fixedBits += (uint64_t)litFreq[i] * fixedLit[i];
+    for (int i = 0; i < DIST_CODES; i++) fixedBits += (uint64_t)distFreq[i] * fixedDist[i];
+    
+    uint64_t storedBits = (uint64_t)rawSize * 8 + ((rawSize / 65535) + 1) * 40 + 7;
+    
+    if (storedBits < dynamicBits && storedBits < fixedBits) {
+        WriteStoredBlocks(writer, raw, rawSize, last);
+    } else if (fixedBits <= dynamicBits) {
+        uint16_t litCodes[288];
+        uint16_t distCodes[DIST_CODES];
+        BuildCodes(fixedLit, 288, litCodes);
+        BuildCodes(fixedDist, DIST_CODES, distCodes);
+        writer.Put(last ? 1 : 0, 1);
+        writer.Put(1, 2);
+        WriteSymbols(writer, symbols, fixedLit, litCodes, fixedDist, distCodes);
+    } else {
+        uint16_t litCodes[LITLEN_CODES];
+        uint16_t distCodes[DIST_CODES];
+        uint16_t clCodes[CODELEN_CODES];
+        BuildCodes(litLengths, LITLEN_CODES, litCodes);
+        BuildCodes(distLengths, DIST_CODES, distCodes);
+        BuildCodes(clLengths, CODELEN_CODES, clCodes);
+        
+        writer.Put(last ? 1 : 0, 1);
+        writer.Put(2, 2);
+        writer.Put(hlit - 257, 5);
+        writer.Put(hdist - 1, 5);
+        writer.Put(hclen - 4, 4);
+        for (int i = 0; i < hclen; i++) {
+            writer.Put(clLengths[CODELEN_ORDER[i]], 3);
+        }
+        for (const CodeLengthSymbol& cl : codeLengthSymbols) {
+            writer.Put(clCodes[cl.symbol], clLengths[cl.symbol]);
+            writer.Put(cl.extra, CodeLengthExtraBits(cl.symbol));
+        }
+        WriteSymbols(writer, symbols, litLengths, litCodes, distLengths, distCodes);
+    }
+}
+
+static inline uint32_t Hash3(const uint8_t* p)
+{
+    uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void CompressPiece(const uint8_t* data, size_t size, bool finalPiece, std::vector<uint8_t>& out, int level)
+{
+    level = std::max(LEVEL_FAST, std::min(LEVEL_BEST, level));
+    const int maxChain = (level <= 1) ? 4 : (level <= 3) ? 8 : (level <= 6) ? 32 : (level <= 8) ? 128 : 1024;
+    const int niceLength = (level <= 3) ? 32 : (level <= 6) ? 128 : MAX_MATCH;
+    
+    BitWriter writer(out);
+    std::vector<int32_t> head((size_t)1 << HASH_BITS, -1);
+    std::vector<int32_t> prev(WINDOW_SIZE);   // Chain links, indexed by position within the window
+    std::vector<Symbol> symbols;
+    symbols.reserve(BLOCK_SYMBOLS);
+    
+    size_t blockStart = 0;
+    size_t i = 0;
+    
+    auto insert = [&](size_t pos) {
+        uint32_t h = Hash3(data + pos);
+        prev[pos & (WINDOW_SIZE - 1)] = head[h];
+        head[h] = (int32_t)pos;
+    };
+    
+    while (i < size) {
+        int bestLength = 0;
+        int bestDistance = 0;
+        
+        if (i + MIN_MATCH <= size) {
+            int maxLength = (int)std::min<size_t>(MAX_MATCH, size - i);
+            int32_t candidate = head[Hash3(data + i)];
+            int chain = maxChain;
+            
+            while (candidate >= 0 && (int64_t)(i - candidate) <= WINDOW_SIZE && chain-- > 0) {
+                const uint8_t* a = data + candidate;
+                const uint8_t* b = data + i;
+                if (a[bestLength] == b[bestLength] && a[0] == b[0]) {
+                    int length = 0;
+                    while (length < maxLength && a[length] == b[length]) {
+                        length++;
+                    }
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = (int)(i - candidate);
+                        if (length >= niceLength || length == maxLength) break;
+                    }
+                }
+                candidate = prev[candidate & (WINDOW_SIZE - 1)];
+            }
+            insert(i);
+        }
+        
+        if (bestLength >= MIN_MATCH) {
+            symbols.push_back({(uint16_t)(256 + bestLength), (uint16_t)bestDistance});
+            for (size_t j = i + 1; j < i + bestLength && j + MIN_MATCH <= size; j++) {
+                insert(j);
+            }
+            i += bestLength;
+        } else {
+            symbols.push_back({data[i], 0});
+            i++;
+        }
+        
+        if (symbols.size() >= BLOCK_SYMBOLS && i < size) {
+            EmitBlock(writer, symbols, data + blockStart, i - blockStart, false);
+            symbols.clear();
+            blockStart = i;
+        }
+    }
+    
+    EmitBlock(writer, symbols, data + blockStart, size - blockStart, finalPiece);
+    
+    if (!finalPiece) {
+        // Empty stored block: leaves the stream byte-aligned for the next piece
+        writer.Put(0, 1);
+        writer.Put(0, 2);
+        writer.AlignToByte();
+        writer.Put(0x0000, 16);
+        writer.Put(0xFFFF, 16);
+    }
+    writer.AlignToByte();
+}
+
+} // namespace Deflate
@@ -0,0 +1,312 @@
+#include "../../include/png_encoder.h"
+#include "../../include/checksum.h"
+#include "../../include/trace_events.h"
+#include "../../include/memory_stats.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace PngEncoder {
+
+static const uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+enum FilterType {
+    FILTER_NONE,
+    FILTER_SUB,
+    FILTER_UP,
+    FILTER_AVERAGE,
+    FILTER_PAETH,
+    FILTER_COUNT
+};
+
+// One independently compressed row group
+struct GroupResult {
+    bool ok = false;
+    std::vector<uint8_t> deflated;
+    uint32_t adler = 1;
+    size_t rawSize = 0;
+};
+
+static void PutBigEndian(uint8_t* out, uint32_t value)
+{
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+static bool WriteChunk(const ByteSink& sink, const char type[4], const uint8_t* data, size_t size)
+{
+    uint8_t header[8];
+    PutBigEndian(header, (uint32_t)size);
+    std::memcpy(header + 4, type, 4);
+    
+    uint32_t crc = Checksum::Crc32(header + 4, 4);
+    crc = Checksum::Crc32(data, size, crc);
+    uint8_t trailer[4];
+    PutBigEndian(trailer, crc);
+    
+    return sink(header, 8) && (size == 0 || sink(data, size)) && sink(trailer, 4);
+}
+
+static inline uint8_t Paeth(int a, int b, int c)
+{
+    int pa = std::abs(b - c);
+    int pb = std::abs(a - c);
+    int pc = std::abs(a + b - 2 * c);
+    int nearest = (pb < pa) ? b : a;
+    int nearestDistance = (pb < pa) ? pb : pa;
+    return (uint8_t)((pc < nearestDistance) ? c : nearest);
+}
+
+static inline uint32_t Cost(uint8_t residual)
+{
+    return (uint32_t)std::abs((int)(int8_t)residual);
+}
+
+// Filters one scanline with every filter type and keeps the one with the
+// smallest sum of absolute (signed) residuals, the usual libpng heuristic.
+// prior is the previous scanline, or all zeros for the first row.
+static void FilterRow(const uint8_t* row, const uint8_t* prior, size_t length, int bpp,
+                      uint8_t* candidates, uint8_t* out)
+{
+    uint8_t* sub = candidates + length;
+    uint8_t* up = candidates + 2 * length;
+    uint8_t* average = candidates + 3 * length;
+    uint8_t* paeth = candidates + 4 * length;
+    
+    // The first pixel has no left neighbour; the rest run branch-free.
+    // Local sums keep the residual stores from aliasing the scores.
+    const size_t first = std::min(length, (size_t)bpp);
+    uint32_t noneScore = 0, subScore = 0, upScore = 0, averageScore = 0, paethScore = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t residual = (uint8_t)(row[i] - prior[i]);
+        up[i] = residual;
+        upScore += Cost(residual);
+    }
+    
+    // Rows repeating the one above (blank canvas) cannot do better than Up
+    if (upScore == 0) {
+        out[0] = FILTER_UP;
+        std::memcpy(out + 1, up, length);
+        return;
+    }
+    
+    for (size_t i = 0; i < length; i++) {
+        noneScore += Cost(row[i]);
+    }
+    for (size_t i = 0; i < first; i++) {
+        sub[i] = row[i];
+        subScore += Cost(row[i]);
+        average[i] = (uint8_t)(row[i] - (prior[i] >> 1));
+        averageScore += Cost(average[i]);
+        paeth[i] = (uint8_t)(row[i] - prior[i]);
+        paethScore += Cost(paeth[i]);
+    }
+    for (size_t i = first; i < length; i++) {
+        uint8_t residual = (uint8_t)(row[i] - row[i - bpp]);
+        sub[i] = residual;
+        subScore += Cost(residual);
+    }
+    for (size_t i = first; i < length; i++) {
+        uint8_t residual = (uint8_t)(row[i] - ((row[i - bpp] + prior[i]) >> 1));
+        average[i] = residual;
+        averageScore += Cost(residual);
+    }
+    for (size_t i = first; i < length; i++) {
+        uint8_t residual = (uint8_t)(row[i] - Paeth(row[i - bpp], prior[i], prior[i - bpp]));
+        paeth[i] = residual;
+        paethScore += Cost(residual);
+    }
+    
+    const uint32_t scores[FILTER_COUNT] = { noneScore, subScore, upScore, averageScore, paethScore };
+    int bestFilter = FILTER_NONE;
+    for (int filter = 1; filter < FILTER_COUNT; filter++) {
+        if (scores[filter] < scores[bestFilter]) {
+            bestFilter = filter;
+        }
+    }
+    
+    out[0] = (uint8_t)bestFilter;
+    std::memcpy(out + 1, (bestFilter == FILTER_NONE) ? row : candidates + bestFilter * length, length);
+}
+
+// Renders, filters and deflates rows [firstRow, lastRow)
+static GroupResult EncodeGroup(const RowSource& rows, int width, int firstRow, int lastRow,
+                               bool finalGroup, const Options& options)
+{
+    GroupResult result;
+    const int bpp = options.alpha ? 4 : 3;
+    const size_t length = (size_t)width * bpp;
+    
+    // Filters look at the row above, so render one extra row unless at the top
+    int renderFirst = (firstRow > 0) ? firstRow - 1 : firstRow;
+    int renderCount = lastRow - renderFirst;
+    std::vector<uint32_t> pixels((size_t)renderCount * width);
+    if (!rows(renderFirst, renderCount, pixels.data())) {
+        return result;
+    }
+    
+    std::vector<uint8_t> current(length), prior(length, 0), candidates(length * FILTER_COUNT);
+    std::vector<uint8_t> filtered((size_t)(lastRow - firstRow) * (length + 1));
+    MemoryStats::Allocation groupMemory(MemoryStats::MEM_FILE_BUFFERS, pixels.size() * sizeof(uint32_t) +
+                                        filtered.size() + length * (FILTER_COUNT + 2));
+    
+    for (int y = renderFirst; y < lastRow; y++) {
+        const uint32_t* source = pixels.data() + (size_t)(y - renderFirst) * width;
+        uint8_t* dest = current.data();
+        for (int x = 0; x < width; x++) {
+            uint32_t pixel = source[x];
+            *dest++ = (uint8_t)pixel;
+            *dest++ = (uint8_t)(pixel >> 8);
+            *dest++ = (uint8_t)(pixel >> 16);
+            if (options.alpha) *dest++ = (uint8_t)(pixel >> 24);
+        }
+        
+        if (y >= firstRow) {
+            uint8_t* out = filtered.data() + (size_t)(y - firstRow) * (length + 1);
+            FilterRow(current.data(), prior.data(), length, bpp, candidates.data(), out);
+        }
+        current.swap(prior);
+    }
+    
+    Deflate::CompressPiece(filtered.data(), filtered.size(), finalGroup, result.deflated, options.level);
+    result.adler = Checksum::Adler32(filtered.data(), filtered.size());
+    result.rawSize = filtered.size();
+    result.ok = true;
+    return result;
+}
+
+size_t GroupFootprint(int width, int rowsPerGroup, bool alpha)
+{
+    const size_t DEFLATE_STATE_BYTES = 512 * 1024;   // Hash chains, symbol buffer, Huffman tables
+    size_t length = (size_t)width * (alpha ? 4 : 3);
+    size_t pixelBytes = (size_t)(rowsPerGroup + 1) * width * sizeof(uint32_t);
+    size_t filteredBytes = (size_t)rowsPerGroup * (length + 1);
+    
+    // Pixels, filtered rows, worst-case deflate output, per-row filter candidates
+    return pixelBytes + 2 * filteredBytes + (FILTER_COUNT + 2) * length + DEFLATE_STATE_BYTES;
+}
+
+bool Encode(int width, int height, const RowSource& rows, const ByteSink& sink, const Options& options)
+{
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+    
+    const int bpp = options.alpha ? 4 : 3;
+    const size_t stride = (size_t)width * bpp + 1;
+    const int rowsPerGroup = (int)std::max<size_t>(1, std::min<size_t>(height, options.groupBytes / stride));
+    const int groupCount = (height + rowsPerGroup - 1) / rowsPerGroup;
+    int threads = options.threads > 0 ? options.threads : (int)std::thread::hardware_concurrency();
+    if (options.memoryBudget > 0) {
+        size_t footprint = GroupFootprint(width, rowsPerGroup, options.alpha) + options.sourceScratchBytes;
+        size_t affordable = options.memoryBudget / footprint;
+        threads = (int)std::min<size_t>(threads, affordable);
+    }
+    threads = std::max(1, threads);
+    
+    // Signature and header
+    uint8_t ihdr[13];
+    PutBigEndian(ihdr, (uint32_t)width);
+    PutBigEndian(ihdr + 4, (uint32_t)height);
+    ihdr[8] = 8;                           // Bit depth
+    ihdr[9] = options.alpha ? 6 : 2;       // Truecolor (+ alpha)
+    ihdr[10] = 0;                          // Deflate
+    ihdr[11] = 0;                          // Adaptive filtering
+    ihdr[12] = 0;                          // No interlace
+    if (!sink(PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) || !WriteChunk(sink, "IHDR", ihdr, sizeof(ihdr))) {
+        return false;
+    }
+    
+    if (options.dpi > 0) {
+        uint8_t phys[9];
+        uint32_t pixelsPerMeter = (uint32_t)(options.dpi / 0.0254 + 0.5);
+        PutBigEndian(phys, pixelsPerMeter);
+        PutBigEndian(phys + 4, pixelsPerMeter);
+        phys[8] = 1;                       // Unit: meter
+        if (!WriteChunk(sink, "pHYs", phys, sizeof(phys))) {
+            return false;
+        }
+    }
+    
+    // Keep up to 'threads' groups in flight and write them back in order
+    std::deque<std::future<GroupResult>> inFlight;
+    int nextGroup = 0;
+    auto launch = [&]() {
+        int first = nextGroup * rowsPerGroup;
+        int last = std::min(height, first + rowsPerGroup);
+        bool finalGroup = (nextGroup == groupCount - 1);
+        inFlight.push_back(std::async(std::launch::async, EncodeGroup, std::cref(rows),
+                                      width, first, last, finalGroup, std::cref(options)));
+        nextGroup++;
+    };
+    
+    // zlib stream header: deflate, 32K window, FLEVEL matching the effort
+    uint8_t zlibHeader[2] = { 0x78, (uint8_t)(options.level <= 1 ? 0x01 : options.level >= 7 ? 0xDA : 0x9C) };
+    uint32_t adler = 1;
+    int written = 0;
+    bool ok = true;
+    
+    while (ok && written < groupCount) {
+        while (nextGroup < groupCount && (int)inFlight.size() < threads) {
+            launch();
+        }
+        
+        GroupResult group = inFlight.front().get();
+        inFlight.pop_front();
+        if (!group.ok) {
+            ok = false;
+            break;
+        }
+        
+        // Stitch the per-group checksums into the stream's Adler-32
+        adler = Checksum::Adler32Combine(adler, group.adler, group.rawSize);
+        std::vector<uint8_t>& data = group.deflated;
+        if (written == 0) {
+            data.insert(data.begin(), zlibHeader, zlibHeader + 2);
+        }
+        if (written == groupCount - 1) {
+            uint8_t trailer[4];
+            PutBigEndian(trailer, adler);
+            data.insert(data.end(), trailer, trailer + 4);
+        }
+        ok = WriteChunk(sink, "IDAT", data.data(), data.size());
+        written++;
+    }
+    
+    // Let outstanding workers finish before the row source goes out of scope
+    for (std::future<GroupResult>& pending : inFlight) {
+        pending.wait();
+    }
+    
+    return ok && WriteChunk(sink, "IEND", nullptr, 0);
+}
+
+bool EncodeToFile(const std::string& filename, int width, int height, const RowSource& rows, const Options& options)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "WritePng");
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    
+    bool ok = Encode(width, height, rows, [file](const void* data, size_t size) {
+        return std::fwrite(data, 1, size, file) == size;
+    }, options);
+    
+    if (std::fclose(file) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        std::remove(filename.c_str());
+    }
+    return ok;
+}
+
+} // namespace PngEncoder
@@ -0,0 +1,350 @@
+#include "../../include/qoi_codec.h"
+#include "../../include/trace_events.h"
+#include "../../include/memory_stats.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace QoiCodec {
+
+static const uint8_t OP_INDEX = 0x00;
+static const uint8_t OP_DIFF = 0x40;
+static const uint8_t OP_LUMA = 0x80;
+static const uint8_t OP_RUN = 0xC0;
+static const uint8_t OP_RGB = 0xFE;
+static const uint8_t OP_RGBA = 0xFF;
+static const uint8_t OP_MASK = 0xC0;
+
+static const size_t HEADER_SIZE = 14;
+static const uint8_t END_MARKER[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+static const uint64_t MAX_PIXELS = 400000000;   // Same limit as the reference implementation
+static const int MAX_RUN = 62;
+static const size_t READ_BUFFER_SIZE = 64 * 1024;
+
+static const uint32_t OPAQUE = 0xFF000000u;
+
+static inline uint32_t Hash(uint32_t pixel)
+{
+    uint32_t r = pixel & 0xFF, g = (pixel >> 8) & 0xFF, b = (pixel >> 16) & 0xFF, a = pixel >> 24;
+    return (r * 3 + g * 5 + b * 7 + a * 11) & 63;
+}
+
+static void PutBigEndian(uint8_t* out, uint32_t value)
+{
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+static uint32_t GetBigEndian(const uint8_t* in)
+{
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+// Encoder state carried across row chunks (the pixel stream runs on across rows)
+struct EncoderState {
+    uint32_t index[64] = {0};
+    uint32_t previous = OPAQUE;
+    int run = 0;
+};
+
+// Encodes count pixels; out needs room for 5 bytes per pixel plus a pending run
+static uint8_t* EncodePixels(EncoderState& state, const uint32_t* pixels, size_t count, bool alpha, uint8_t* out)
+{
+    const uint32_t alphaFill = alpha ? 0 : OPAQUE;
+    uint32_t previous = state.previous;
+    int run = state.run;
+    
+    for (size_t i = 0; i < count; i++) {
+        uint32_t pixel = pixels[i] | alphaFill;
+        
+        if (pixel == previous) {
+            if (++run == MAX_RUN) {
+                *out++ = OP_RUN | (MAX_RUN - 1);
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            *out++ = (uint8_t)(OP_RUN | (run - 1));
+            run = 0;
+        }
+        
+        uint32_t hash = Hash(pixel);
+        if (state.index[hash] == pixel) {
+            *out++ = (uint8_t)(OP_INDEX | hash);
+        } else {
+            state.index[hash] = pixel;
+            
+            if ((pixel >> 24) == (previous >> 24)) {
+                int8_t vr = (int8_t)((pixel & 0xFF) - (previous & 0xFF));
+                int8_t vg = (int8_t)(((pixel >> 8) & 0xFF) - ((previous >> 8) & 0xFF));
+                int8_t vb = (int8_t)(((pixel >> 16) & 0xFF) - ((previous >> 16) & 0xFF));
+                int8_t vgr = (int8_t)(vr - vg);
+                int8_t vgb = (int8_t)(vb - vg);
+                
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    *out++ = (uint8_t)(OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                } else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+                    *out++ = (uint8_t)(OP_LUMA | (vg + 32));
+                    *out++ = (uint8_t)((vgr + 8) << 4 | (vgb + 8));
+                } else {
+                    *out++ = OP_RGB;
+                    *out++ = (uint8_t)pixel;
+                    *out++ = (uint8_t)(pixel >> 8);
+                    *out++ = (uint8_t)(pixel >> 16);
+                }
+            } else {
+                *out++ = OP_RGBA;
+                *out++ = (uint8_t)pixel;
+                *out++ = (uint8_t)(pixel >> 8);
+                *out++ = (uint8_t)(pixel >> 16);
+                *out++ = (uint8_t)(pixel >> 24);
+            }
+        }
+        previous = pixel;
+    }
+    
+    state.previous = previous;
+    state.run = run;
+    return out;
+}
+
+bool Encode(int width, int height, const ImageStream::RowSource& rows, const ImageStream::ByteSink& sink,
+            const Options& options)
+{
+    if (width <= 0 || height <= 0 || (uint64_t)width * height > MAX_PIXELS) {
+        return false;
+    }
+    
+    uint8_t header[HEADER_SIZE] = { 'q', 'o', 'i', 'f' };
+    PutBigEndian(header + 4, (uint32_t)width);
+    PutBigEndian(header + 8, (uint32_t)height);
+    header[12] = options.alpha ? 4 : 3;
+    header[13] = 0;                        // sRGB with linear alpha
+    if (!sink(header, sizeof(header))) {
+        return false;
+    }
+    
+    const int rowsPerChunk = (int)std::max<size_t>(1, std::min<size_t>(height, options.chunkBytes / ((size_t)width * 4)));
+    const int chunkCount = (height + rowsPerChunk - 1) / rowsPerChunk;
+    int threads = options.threads > 0 ? options.threads : (int)std::thread::hardware_concurrency();
+    threads = std::max(1, threads);
+    
+    // Encoding is inherently sequential; rendering runs ahead on workers
+    typedef std::vector<uint32_t> Chunk;
+    std::deque<std::future<Chunk>> inFlight;
+    int nextChunk = 0;
+    auto launch = [&]() {
+        int first = nextChunk * rowsPerChunk;
+        int count = std::min(rowsPerChunk, height - first);
+        inFlight.push_back(std::async(std::launch::async, [&rows, width, first, count]() {
+            Chunk pixels((size_t)count * width);
+            if (!rows(first, count, pixels.data())) {
+                pixels.clear();
+            }
+            return pixels;
+        }));
+        nextChunk++;
+    };
+    
+    EncoderState state;
+    std::vector<uint8_t> encoded((size_t)rowsPerChunk * width * 5 + 16);
+    // Output buffer plus up to 'threads' rendered chunks waiting for it
+    MemoryStats::Allocation bufferMemory(MemoryStats::MEM_FILE_BUFFERS,
+                                         encoded.size() + (size_t)threads * rowsPerChunk * width * sizeof(uint32_t));
+    bool ok = true;
+    
+    for (int chunk = 0; ok && chunk < chunkCount; chunk++) {
+        while (nextChunk < chunkCount && (int)inFlight.size() < threads) {
+            launch();
+        }
+        
+        Chunk pixels = inFlight.front().get();
+        inFlight.pop_front();
+        if (pixels.empty()) {
+            ok = false;
+            break;
+        }
+        
+        uint8_t* end = EncodePixels(state, pixels.data(), pixels.size(), options.alpha, encoded.data());
+        if (chunk == chunkCount - 1 && state.run > 0) {
+            *end++ = (uint8_t)(OP_RUN | (state.run - 1));
+        }
+        ok = sink(encoded.data(), end - encoded.data());
+    }
+    
+    // Let outstanding workers finish before the row source goes out of scope
+    for (std::future<Chunk>& pending : inFlight) {
+        pending.wait();
+    }
+    
+    return ok && sink(END_MARKER, sizeof(END_MARKER));
+}
+
+bool EncodeToFile(const std::string& filename, int width, int height, const ImageStream::RowSource& rows,
+                  const Options& options)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "WriteQoi");
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    
+    bool ok = Encode(width, height, rows, [file](const void* data, size_t size) {
+        return std::fwrite(data, 1, size, file) == size;
+    }, options);
+    
+    if (std::fclose(file) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        std::remove(filename.c_str());
+    }
+    return ok;
+}
+
+// Buffered byte reader over a ByteSource
+struct Reader {
+    const ImageStream::ByteSource& source;
+    std::vector<uint8_t> buffer;
+    MemoryStats::Allocation bufferMemory;
+    size_t position = 0;
+    size_t end = 0;
+    
+    explicit Reader(const ImageStream::ByteSource& input)
+        : source(input), buffer(READ_BUFFER_SIZE), bufferMemory(MemoryStats::MEM_FILE_BUFFERS, READ_BUFFER_SIZE) {}
+    
+    bool Refill() {
+        position = 0;
+        end = source(buffer.data(), buffer.size());
+        return end > 0;
+    }
+    
+    inline bool Next(uint8_t& value) {
+        if (position == end && !Refill()) {
+            return false;
+        }
+        value = buffer[position++];
+        return true;
+    }
+    
+    bool Read(uint8_t* out, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            if (!Next(out[i])) return false;
+        }
+        return true;
+    }
+};
+
+bool Decode(const ImageStream::ByteSource& source, Info& info, const ImageStream::RowSink& rows)
+{
+    Reader reader(source);
+    
+    uint8_t header[HEADER_SIZE];
+    if (!reader.Read(header, sizeof(header)) || std::memcmp(header, "qoif", 4) != 0) {
+        return false;
+    }
+    uint32_t width = GetBigEndian(header + 4);
+    uint32_t height = GetBigEndian(header + 8);
+    int channels = header[12];
+    if (width == 0 || height == 0 || (uint64_t)width * height > MAX_PIXELS || (channels != 3 && channels != 4)) {
+        return false;
+    }
+    info.width = (int)width;
+    info.height = (int)height;
+    info.channels = channels;
+    
+    uint32_t index[64] = {0};
+    uint32_t pixel = OPAQUE;
+    int run = 0;
+    std::vector<uint32_t> row(width);
+    
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            if (run > 0) {
+                run--;
+                row[x] = pixel;
+                continue;
+            }
+            
+            uint8_t op;
+            if (!reader.Next(op)) {
+                return false;
+            }
+            
+            if (op == OP_RGB || op == OP_RGBA) {
+                uint8_t bytes[4];
+                if (!reader.Read(bytes, op == OP_RGB ? 3 : 4)) {
+                    return false;
+                }
+                uint32_t alpha = (op == OP_RGB) ? (pixel & OPAQUE) : (uint32_t)bytes[3] << 24;
+                pixel = bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | alpha;
+            } else if ((op & OP_MASK) == OP_INDEX) {
+                pixel = index[op];
+            } else if ((op & OP_MASK) == OP_DIFF) {
+                uint8_t r = (uint8_t)((pixel & 0xFF) + ((op >> 4) & 3) - 2);
+                uint8_t g = (uint8_t)(((pixel >> 8) & 0xFF) + ((op >> 2) & 3) - 2);
+                uint8_t b = (uint8_t)(((pixel >> 16) & 0xFF) + (op & 3) - 2);
+                pixel = r | (uint32_t)g << 8 | (uint32_t)b << 16 | (pixel & OPAQUE);
+            } else if ((op & OP_MASK) == OP_LUMA) {
+                uint8_t second;
+                if (!reader.Next(second)) {
+                    return false;
+                }
+                int vg = (op & 0x3F) - 32;
+                uint8_t r = (uint8_t)((pixel & 0xFF) + vg - 8 + ((second >> 4) & 0x0F));
+                uint8_t g = (uint8_t)(((pixel >> 8) & 0xFF) + vg);
+                uint8_t b = (uint8_t)(((pixel >> 16) & 0xFF) + vg - 8 + (second & 0x0F));
+                pixel = r | (uint32_t)g << 8 | (uint32_t)b << 16 | (pixel & OPAQUE);
+            } else {
+                run = op & 0x3F;
+            }
+            
+            index[Hash(pixel)] = pixel;
+            row[x] = pixel;
+        }
+        
+        if (!rows((int)y, row.data())) {
+            return false;
+        }
+    }
+    
+    uint8_t trailer[sizeof(END_MARKER)];
+    return reader.Read(trailer, sizeof(trailer)) && std::memcmp(trailer, END_MARKER, sizeof(END_MARKER)) == 0;
+}
+
+bool DecodeFile(const std::string& filename, RasterImage& image)
+{
+    TRACE_SCOPE(TraceEvents::CAT_FILE_IO, "ReadQoi");
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    
+    RasterImage decoded;
+    Info info;
+    bool ok = Decode([file](void* data, size_t size) { return std::fread(data, 1, size, file); }, info,
+        [&](int row, const uint32_t* pixels) {
+            if (row == 0) {
+                decoded.width = info.width;
+                decoded.height = info.height;
+                decoded.pixels.resize((size_t)info.width * info.height);
+            }
+            std::memcpy(&decoded.pixels[(size_t)row * info.width], pixels, (size_t)info.width * sizeof(uint32_t));
+            return true;
+        });
+    std::fclose(file);
+    
+    if (ok) {
+        image = std::move(decoded);
+    }
+    return ok;
+}
+
+} // namespace QoiCodec
@@ -5,11 +5,22 @@
 #include "../include/drawing_engine.h"
 #include "../include/event_handler.h"
 #include "../include/gpu_renderer.h"
+#include "../include/document_journal.h"
+#include "../include/engine_thread.h"
+#include "../include/job_pool.h"
+#include "../include/frame_scheduler.h"
+#include "../include/trace_events.h"
 
 int WINAPI WinMain(HINSTANCE hThisInstance, HINSTANCE hPrevInstance, LPSTR lpszArgument, int nCmdShow)
 {
     AppState& app = AppState::Instance();
     
+#ifdef MPS_TRACE_EVENTS
+    // Timeline of the whole session, written when the process exits
+    TraceEvents::SetThreadName("UI");
+    TraceEvents::FlushOnExit("modernpaint_trace.json");
+#endif
+    
     // Initialize COM for DirectX components
     if (FAILED(CoInitialize(nullptr))) {
         MessageBoxW(NULL, L"Failed to initialize COM", L"Error", MB_OK | MB_ICONERROR);
@@ -63,17 +74,64 @@ int WINAPI WinMain(HINSTANCE hThisInstance, HINSTANCE hPrevInstance, LPSTR lpszA
                    L"Performance Warning", MB_OK | MB_ICONWARNING);
     }
     
+    // Recover untitled work from a session that did not exit cleanly
+    bool recovered = false;
+    if (DocumentJournal::HasRecoverableJournal(AUTOSAVE_DOCUMENT) &&
+        MessageBoxW(hwnd, L"The previous session did not exit cleanly.\n\nRecover unsaved drawing?",
+                    L"Recovery", MB_YESNO | MB_ICONQUESTION) == IDYES) {
+        recovered = DocumentJournal::OpenDocument(AUTOSAVE_DOCUMENT);
+    }
+    if (!recovered) {
+        DocumentJournal::NewDocument();
+    }
+    SetTimer(hwnd, IDT_AUTOSAVE, AUTOSAVE_INTERVAL_MS, NULL);
+    
+    // Document mutation runs on the engine thread from here on; without it
+    // commands apply inline
+    EngineThread::Start([hwnd]() { PostMessage(hwnd, WM_ENGINE_PUBLISHED, 0, 0); });
+    // Exports and other long operations run on these workers
+    JobPool::Start(JOB_WORKERS, [hwnd]() { PostMessage(hwnd, WM_JOBS_CHANGED, 0, 0); });
+    
+    // Frames are paced to the display refresh rate (0 and 1 mean the default)
+    HDC screenDC = GetDC(hwnd);
+    int refreshRate = GetDeviceCaps(screenDC, VREFRESH);
+    ReleaseDC(hwnd, screenDC);
+    if (refreshRate > 1) {
+        FrameScheduler::SetTargetInterval(1000000 / refreshRate);
+    }
+    
     // Make the window visible on the screen
     ShowWindow(hwnd, nCmdShow);
     SetForegroundWindow(hwnd);
     UpdateWindow(hwnd);
 
-    // Run the message loop. It will run until GetMessage() returns 0
-    while (GetMessage(&messages, NULL, 0, 0))
+    // Run the message loop until WM_QUIT. Repaints are presented between
+    // messages once FrameScheduler says a frame is due, so a flood of input
+    // cannot hold them back; with nothing to paint it sleeps until a message
+    for (;;)
     {
-        TranslateMessage(&messages);
-        DispatchMessage(&messages);
+        if (FrameScheduler::TimeUntilDue() == 0) {
+            EventHandler::PresentFrame(hwnd);
+        }
+        if (PeekMessage(&messages, NULL, 0, 0, PM_REMOVE)) {
+            if (messages.message == WM_QUIT) {
+                break;
+            }
+            TranslateMessage(&messages);
+            DispatchMessage(&messages);
+            continue;
+        }
+        
+        uint64_t wait = FrameScheduler::TimeUntilDue();
+        if (wait != 0) {
+            DWORD timeout = (wait == FrameScheduler::IDLE) ? INFINITE : (DWORD)((wait + 999) / 1000);
+            MsgWaitForMultipleObjectsEx(0, NULL, timeout, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+        }
     }
+    
+    // Applies whatever is still queued (already stopped if the window was destroyed)
+    JobPool::Stop();
+    EngineThread::Stop();
 
     // Cleanup GPU renderer
     GPURenderer::GPURenderingEngine::Shutdown();
@@ -0,0 +1,248 @@
+#include "../../include/brush_mask.h"
+#include "../../include/memory_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BRUSH_MASK_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace BrushMask {
+
+static const size_t MASK_BYTES = (size_t)MAX_SIZE * MAX_SIZE;
+static const size_t BUCKETS = 1024;     // Power of two, about twice CAPACITY
+
+struct Key {
+    int brushSize;
+    int hardness;
+    double scale;
+    int subX, subY;
+};
+
+struct Slot {
+    Key key;
+    Mask mask;
+    uint64_t lastUse;
+    int32_t next;                      // Next slot in the bucket, or -1
+};
+
+struct Cache {
+    std::vector<uint8_t> arena;        // CAPACITY masks of MASK_BYTES
+    std::vector<Slot> slots;           // The first stats.masks are in use
+    std::vector<int32_t> buckets;      // First slot per hash bucket, or -1
+    uint64_t clock = 0;
+    Stats stats;
+    MemoryStats::Allocation memory{MemoryStats::MEM_RASTER};
+};
+
+static thread_local Cache cache;
+
+static bool SameKey(const Key& a, const Key& b)
+{
+    return a.brushSize == b.brushSize && a.hardness == b.hardness && a.scale == b.scale &&
+           a.subX == b.subX && a.subY == b.subY;
+}
+
+static size_t Hash(const Key& key)
+{
+    uint64_t scaleBits;
+    std::memcpy(&scaleBits, &key.scale, sizeof(scaleBits));
+    uint64_t hash = scaleBits ^ (scaleBits >> 29);
+    hash = hash * 31 + (uint64_t)key.brushSize;
+    hash = hash * 31 + (uint64_t)key.hardness;
+    hash = hash * 31 + (uint64_t)(key.subY * SUBPIXEL_STEPS + key.subX);
+    hash *= 0x9E3779B97F4A7C15ull;
+    return (size_t)(hash >> 40) & (BUCKETS - 1);
+}
+
+static int SubpixelStep(double fraction)
+{
+    return std::max(0, std::min(SUBPIXEL_STEPS - 1, (int)(fraction * SUBPIXEL_STEPS)));
+}
+
+double Radius(int brushSize, double scale)
+{
+    return std::max(0.5, brushSize / 2.0 * scale);
+}
+
+// Falls from full to none over one pixel at the rim of a hard tip, and over
+// the outer part of the radius as hardness drops
+uint8_t Coverage(double distance, double radius, int hardness)
+{
+    double ramp = std::max(1.0, radius * (HARD - hardness) / HARD);
+    double amount = std::max(0.0, std::min(1.0, (radius + 0.5 - distance) / ramp));
+    return (uint8_t)(amount * 255.0 + 0.5);
+}
+
+static void Generate(Slot& slot, uint8_t* coverage)
+{
+    const Key& key = slot.key;
+    double radius = Radius(key.brushSize, key.scale);
+    double cx = (key.subX + 0.5) / SUBPIXEL_STEPS;
+    double cy = (key.subY + 0.5) / SUBPIXEL_STEPS;
+    
+    Mask& mask = slot.mask;
+    mask.left = (int)std::ceil(cx - radius - 0.5);
+    mask.top = (int)std::ceil(cy - radius - 0.5);
+    mask.width = (int)std::floor(cx + radius + 0.5) - mask.left + 1;
+    mask.height = (int)std::floor(cy + radius + 0.5) - mask.top + 1;
+    mask.coverage = coverage;
+    
+    for (int j = 0; j < mask.height; j++) {
+        double dy = mask.top + j - cy;
+        for (int i = 0; i < mask.width; i++) {
+            double dx = mask.left + i - cx;
+            coverage[(size_t)j * mask.width + i] = Coverage(std::sqrt(dx * dx + dy * dy), radius, key.hardness);
+        }
+    }
+}
+
+const Mask* Find(int brushSize, int hardness, double scale, double fracX, double fracY)
+{
+    if (2.0 * Radius(brushSize, scale) + 2.0 > MAX_SIZE) {
+        return nullptr;
+    }
+    Cache& c = cache;
+    if (c.slots.empty()) {
+        c.arena.resize(CAPACITY * MASK_BYTES);
+        c.slots.resize(CAPACITY);
+        c.buckets.assign(BUCKETS, -1);
+        c.memory.Resize(c.arena.size() + c.slots.size() * sizeof(Slot) + c.buckets.size() * sizeof(int32_t));
+    }
+    
+    Key key = {brushSize, hardness, scale, SubpixelStep(fracX), SubpixelStep(fracY)};
+    size_t bucket = Hash(key);
+    for (int32_t i = c.buckets[bucket]; i >= 0; i = c.slots[i].next) {
+        if (SameKey(c.slots[i].key, key)) {
+            c.slots[i].lastUse = ++c.clock;
+            c.stats.hits++;
+            return &c.slots[i].mask;
+        }
+    }
+    
+    // Miss: a free slot while there is one, then the least recently used
+    size_t index;
+    if (c.stats.masks < CAPACITY) {
+        index = c.stats.masks++;
+    } else {
+        index = 0;
+        for (size_t i = 1; i < CAPACITY; i++) {
+            if (c.slots[i].lastUse < c.slots[index].lastUse) {
+                index = i;
+            }
+        }
+        int32_t* link = &c.buckets[Hash(c.slots[index].key)];
+        while (*link != (int32_t)index) {
+            link = &c.slots[*link].next;
+        }
+        *link = c.slots[index].next;
+        c.stats.evictions++;
+    }
+    
+    Slot& slot = c.slots[index];
+    slot.key = key;
+    slot.lastUse = ++c.clock;
+    slot.next = c.buckets[bucket];
+    c.buckets[bucket] = (int32_t)index;
+    Generate(slot, &c.arena[index * MASK_BYTES]);
+    c.stats.misses++;
+    return &slot.mask;
+}
+
+// Per channel (src * a + dst * (255 - a)) / 255, rounded; the SIMD kernel
+// computes the same sum and the same division by 255, so both agree exactly
+static inline uint32_t BlendPixel(uint32_t dst, uint32_t src, uint32_t alpha)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t sum = ((src >> shift) & 0xFF) * alpha + ((dst >> shift) & 0xFF) * (255 - alpha) + 128;
+        result |= ((sum + (sum >> 8)) >> 8) << shift;
+    }
+    return result;
+}
+
+void BlendRowScalar(uint32_t* row, const uint8_t* coverage, int count, uint32_t pixel)
+{
+    for (int i = 0; i < count; i++) {
+        uint32_t alpha = coverage[i];
+        if (alpha == 255) {
+            row[i] = pixel;
+        } else if (alpha != 0) {
+            row[i] = BlendPixel(row[i], pixel, alpha);
+        }
+    }
+}
+
+#ifdef BRUSH_MASK_SSE2
+
+// Four pixels per step: channels widen to 16 bits, where the products and
+// the division by 255 fit without overflow
+void BlendRow(uint32_t* row, const uint8_t* coverage, int count, uint32_t pixel)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i source = _mm_unpacklo_epi8(_mm_set1_epi32((int)pixel), zero);
+    
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32_t alphas;
+        std::memcpy(&alphas, coverage + i, sizeof(alphas));
+        if (alphas == 0) {
+            continue;
+        }
+        if (alphas == 0xFFFFFFFFu) {
+            _mm_storeu_si128((__m128i*)(row + i), _mm_set1_epi32((int)pixel));
+            continue;
+        }
+        
+        // Each coverage byte repeated across its pixel's four channels
+        __m128i alpha = _mm_cvtsi32_si128((int)alphas);
+        alpha = _mm_unpacklo_epi8(alpha, alpha);
+        alpha = _mm_unpacklo_epi16(alpha, alpha);
+        __m128i alphaLow = _mm_unpacklo_epi8(alpha, zero);
+        __m128i alphaHigh = _mm_unpackhi_epi8(alpha, zero);
+        
+        __m128i dest = _mm_loadu_si128((const __m128i*)(row + i));
+        __m128i destLow = _mm_unpacklo_epi8(dest, zero);
+        __m128i destHigh = _mm_unpackhi_epi8(dest, zero);
+        
+        __m128i sumLow = _mm_add_epi16(_mm_mullo_epi16(source, alphaLow),
+                                       _mm_mullo_epi16(destLow, _mm_sub_epi16(full, alphaLow)));
+        __m128i sumHigh = _mm_add_epi16(_mm_mullo_epi16(source, alphaHigh),
+                                        _mm_mullo_epi16(destHigh, _mm_sub_epi16(full, alphaHigh)));
+        sumLow = _mm_add_epi16(sumLow, half);
+        sumHigh = _mm_add_epi16(sumHigh, half);
+        sumLow = _mm_srli_epi16(_mm_add_epi16(sumLow, _mm_srli_epi16(sumLow, 8)), 8);
+        sumHigh = _mm_srli_epi16(_mm_add_epi16(sumHigh, _mm_srli_epi16(sumHigh, 8)), 8);
+        _mm_storeu_si128((__m128i*)(row + i), _mm_packus_epi16(sumLow, sumHigh));
+    }
+    BlendRowScalar(row + i, coverage + i, count - i, pixel);
+}
+
+#else
+
+void BlendRow(uint32_t* row, const uint8_t* coverage, int count, uint32_t pixel)
+{
+    BlendRowScalar(row, coverage, count, pixel);
+}
+
+#endif
+
+Stats GetStats()
+{
+    return cache.stats;
+}
+
+void Clear()
+{
+    Cache& c = cache;
+    std::fill(c.buckets.begin(), c.buckets.end(), -1);
+    c.clock = 0;
+    c.stats = Stats();
+}
+
+}
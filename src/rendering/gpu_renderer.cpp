@@ -1,5 +1,6 @@
 #include "../../include/gpu_renderer.h"
 #include "../../include/app_state.h"
+#include "../../include/memory_stats.h"
 #include <algorithm>
 
 namespace GPURenderer {
@@ -7,6 +8,9 @@ namespace GPURenderer {
 // Static member definitions
 GPUContext GPURenderingEngine::context = {};
 
+// Back buffer of the render target, estimated at 4 bytes per client pixel
+static MemoryStats::Allocation renderTargetMemory(MemoryStats::MEM_GPU);
+
 bool GPURenderingEngine::Initialize(HWND hwnd) {
     HRESULT hr = S_OK;
     
@@ -83,6 +87,9 @@ bool GPURenderingEngine::CreateDeviceResources(HWND hwnd) {
         &context.renderTarget
     );
     
+    if (SUCCEEDED(hr)) {
+        renderTargetMemory.Resize((size_t)size.width * size.height * 4);
+    }
     return SUCCEEDED(hr);
 }
 
@@ -165,6 +172,7 @@ void GPURenderingEngine::EndDraw() {
             ReleaseBrushes();
             context.renderTarget->Release();
             context.renderTarget = nullptr;
+            renderTargetMemory.Resize(0);
             // Will be recreated on next draw
         }
     }
@@ -323,6 +331,40 @@ void GPURenderingEngine::DrawText(const WCHAR* text, float x, float y, float wid
     );
 }
 
+ID2D1Bitmap* GPURenderingEngine::CreateBitmapFromPixels(const uint32_t* pixels, int width, int height) {
+    if (!context.renderTarget || width <= 0 || height <= 0) return nullptr;
+    
+    // D2D wants premultiplied BGRA
+    std::vector<uint32_t> bgra((size_t)width * height);
+    for (size_t i = 0; i < bgra.size(); i++) {
+        uint32_t pixel = pixels[i];
+        uint32_t alpha = pixel >> 24;
+        uint32_t r = ((pixel & 0xFF) * alpha + 127) / 255;
+        uint32_t g = (((pixel >> 8) & 0xFF) * alpha + 127) / 255;
+        uint32_t b = (((pixel >> 16) & 0xFF) * alpha + 127) / 255;
+        bgra[i] = b | g << 8 | r << 16 | alpha << 24;
+    }
+    
+    ID2D1Bitmap* bitmap = nullptr;
+    D2D1_BITMAP_PROPERTIES properties = D2D1::BitmapProperties(
+        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+    HRESULT hr = context.renderTarget->CreateBitmap(
+        D2D1::SizeU(width, height), bgra.data(), width * sizeof(uint32_t), properties, &bitmap);
+    
+    // Fails past the device's maximum bitmap size; the layer is then not shown
+    return SUCCEEDED(hr) ? bitmap : nullptr;
+}
+
+void GPURenderingEngine::DrawBitmap(ID2D1Bitmap* bitmap, float x, float y, float opacity) {
+    if (!context.renderTarget || !bitmap) return;
+    
+    D2D1_SIZE_F size = bitmap->GetSize();
+    D2D1_RECT_F destination = D2D1::RectF(x, y, x + size.width, y + size.height);
+    
+    // Nearest neighbor, so zoomed-in pixels match exports
+    context.renderTarget->DrawBitmap(bitmap, destination, opacity, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR);
+}
+
 D2D1::ColorF GPURenderingEngine::ColorFromCOLORREF(COLORREF color, float alpha) {
     return D2D1::ColorF(
         GetRValue(color) / 255.0f,
@@ -339,6 +381,10 @@ void GPURenderingEngine::UpdateDynamicBrush(COLORREF color, float alpha) {
     }
 }
 
+FrameProfiler::Summary GPURenderingEngine::GetPerformanceStats() {
+    return FrameProfiler::Summarize();
+}
+
 void GPURenderingEngine::SetTransform(const D2D1_MATRIX_3X2_F& transform) {
     if (context.renderTarget) {
         context.renderTarget->SetTransform(transform);
@@ -369,6 +415,7 @@ void GPURenderingEngine::Shutdown() {
     if (context.dashedStroke) { context.dashedStroke->Release(); context.dashedStroke = nullptr; }
     if (context.defaultTextFormat) { context.defaultTextFormat->Release(); context.defaultTextFormat = nullptr; }
     if (context.renderTarget) { context.renderTarget->Release(); context.renderTarget = nullptr; }
+    renderTargetMemory.Resize(0);
     if (context.writeFactory) { context.writeFactory->Release(); context.writeFactory = nullptr; }
     if (context.wicFactory) { context.wicFactory->Release(); context.wicFactory = nullptr; }
     if (context.d2dFactory) { context.d2dFactory->Release(); context.d2dFactory = nullptr; }
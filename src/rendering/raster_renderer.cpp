@@ -0,0 +1,408 @@
+#include "../../include/raster_renderer.h"
+#include "../../include/trace_events.h"
+#include "../../include/brush_stamps.h"
+#include "../../include/brush_mask.h"
+#include <cmath>
+#include <climits>
+#include <algorithm>
+
+namespace RasterRenderer {
+
+static const int MIN_BAND_ROWS = 32;
+static const size_t SUPERSAMPLE_SCRATCH_PIXELS = 256 * 1024;   // Sample pixels rendered per pass
+
+// Destination band: output rows [firstRow, lastRow) of a width-wide image
+struct Band {
+    uint32_t* pixels;
+    int width;
+    int firstRow;
+    int lastRow;
+};
+
+static void FillSpan(const Band& band, int y, double left, double right, uint32_t pixel)
+{
+    int x0 = (int)std::max(0.0, std::ceil(left));
+    int x1 = (int)std::min(band.width - 1.0, std::floor(right));
+    if (x0 > x1) return;
+    
+    uint32_t* row = band.pixels + (size_t)(y - band.firstRow) * band.width;
+    std::fill(row + x0, row + x1 + 1, pixel);
+}
+
+static int FirstRow(const Band& band, double top)
+{
+    return (int)std::max((double)band.firstRow, std::ceil(top));
+}
+
+static int LastRow(const Band& band, double bottom)
+{
+    return (int)std::min(band.lastRow - 1.0, std::floor(bottom));
+}
+
+// Pixels whose centers lie within radius of (cx, cy)
+static void FillDisc(const Band& band, double cx, double cy, double radius, uint32_t pixel)
+{
+    int top = FirstRow(band, cy - radius);
+    int bottom = LastRow(band, cy + radius);
+    
+    for (int y = top; y <= bottom; y++) {
+        double dy = y - cy;
+        double half = std::sqrt(std::max(0.0, radius * radius - dy * dy));
+        FillSpan(band, y, cx - half, cx + half, pixel);
+    }
+}
+
+// Document-space radius a point paints with (brush points paint stamps of
+// max(0.5, size / 2) along their stroke instead, see BrushStamps and BrushMask)
+static double PointRadius(const DrawPoint& point)
+{
+    if (point.toolType == TOOL_BRUSH || point.toolType == TOOL_ERASER) {
+        return point.brushSize / 2;
+    }
+    return std::max(1, point.brushSize / 2);   // Shape outlines are stored as dense point runs
+}
+
+static double StrokeRadius(const DrawPoint& point)
+{
+    return std::max(0.5, point.brushSize / 2.0);
+}
+
+// One anti-aliased brush stamp centred at (cx, cy): a cached coverage mask
+// blended into the band, or the same coverage computed per pixel for tips
+// too wide to cache
+static void StampTip(const Band& band, double cx, double cy, int brushSize, double scale, uint32_t pixel)
+{
+    double radius = BrushMask::Radius(brushSize, scale);
+    if (cy + radius + 1.0 < band.firstRow || cy - radius - 1.0 >= band.lastRow ||
+        cx + radius + 1.0 < 0.0 || cx - radius - 1.0 >= band.width) {
+        return;
+    }
+    
+    double floorX = std::floor(cx);
+    double floorY = std::floor(cy);
+    const BrushMask::Mask* mask = BrushMask::Find(brushSize, BrushMask::HARD, scale, cx - floorX, cy - floorY);
+    if (!mask) {
+        int top = FirstRow(band, cy - radius - 0.5);
+        int bottom = LastRow(band, cy + radius + 0.5);
+        int left = (int)std::max(0.0, std::ceil(cx - radius - 0.5));
+        int right = (int)std::min(band.width - 1.0, std::floor(cx + radius + 0.5));
+        for (int y = top; y <= bottom; y++) {
+            uint32_t* row = band.pixels + (size_t)(y - band.firstRow) * band.width;
+            for (int x = left; x <= right; x++) {
+                uint8_t coverage = BrushMask::Coverage(std::hypot(x - cx, y - cy), radius, BrushMask::HARD);
+                BrushMask::BlendRow(row + x, &coverage, 1, pixel);
+            }
+        }
+        return;
+    }
+    
+    int left = (int)floorX + mask->left;
+    int top = (int)floorY + mask->top;
+    int skip = std::max(0, -left);
+    int count = std::min(mask->width, band.width - left) - skip;
+    int first = std::max(0, band.firstRow - top);
+    int last = std::min(mask->height, band.lastRow - top);
+    for (int j = first; j < last && count > 0; j++) {
+        uint32_t* row = band.pixels + (size_t)(top + j - band.firstRow) * band.width + left + skip;
+        BrushMask::BlendRow(row, mask->coverage + (size_t)j * mask->width + skip, count, pixel);
+    }
+}
+
+void StampBrush(uint32_t* pixels, int width, int height, double cx, double cy,
+                int brushSize, double scale, uint32_t pixel)
+{
+    Band band = { pixels, width, 0, height };
+    StampTip(band, cx, cy, brushSize, scale, pixel);
+}
+
+// Paints one point. A brush point stamps its stroke segment from pen, the
+// first stamp 'carried' along from the previous one, and returns the
+// distance carried on; without a pen it starts a stroke with one stamp.
+static double DrawElement(const Band& band, const View& view, const DrawPoint& point, const DrawPoint* pen,
+                          double carried, bool endsStroke)
+{
+    double cx = (point.x - view.originX) * view.scale;
+    double cy = (point.y - view.originY) * view.scale;
+    
+    if (point.toolType == TOOL_BRUSH) {
+        uint32_t pixel = ToPixel(point.color);
+        if (!pen) {
+            StampTip(band, cx, cy, point.brushSize, view.scale, pixel);
+            return 0.0;
+        }
+        carried = BrushStamps::WalkSegment(pen->x, pen->y, point.x, point.y, BrushStamps::Spacing(point.brushSize), carried,
+                                           [&](double x, double y) {
+            StampTip(band, (x - view.originX) * view.scale, (y - view.originY) * view.scale, point.brushSize, view.scale, pixel);
+        });
+        if (endsStroke && carried > 0.0) {
+            StampTip(band, cx, cy, point.brushSize, view.scale, pixel);
+        }
+        return carried;
+    } else if (point.toolType == TOOL_ERASER) {
+        FillDisc(band, cx, cy, PointRadius(point) * view.scale, ToPixel(RGB(255, 255, 255)));
+    } else {
+        FillDisc(band, cx, cy, PointRadius(point) * view.scale, ToPixel(point.color));
+    }
+    return 0.0;
+}
+
+bool DocumentBounds(const std::vector<DrawPoint>& points, Bounds& bounds)
+{
+    if (points.empty()) {
+        return false;
+    }
+    
+    bounds = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+    for (const DrawPoint& point : points) {
+        int reach = (int)std::ceil(std::max(PointRadius(point), StrokeRadius(point)));
+        bounds.left = std::min(bounds.left, point.x - reach);
+        bounds.top = std::min(bounds.top, point.y - reach);
+        bounds.right = std::max(bounds.right, point.x + reach + 1);
+        bounds.bottom = std::max(bounds.bottom, point.y + reach + 1);
+    }
+    return true;
+}
+
+void IncludeReference(const RasterImage& reference, Bounds& bounds)
+{
+    if (reference.width <= 0 || reference.height <= 0) {
+        return;
+    }
+    bounds.left = std::min(bounds.left, 0);
+    bounds.top = std::min(bounds.top, 0);
+    bounds.right = std::max(bounds.right, reference.width);
+    bounds.bottom = std::max(bounds.bottom, reference.height);
+}
+
+void RenderRows(const std::vector<DrawPoint>& points, const View& view, int width,
+                int firstRow, int rowCount, COLORREF background, uint32_t* pixels)
+{
+    TRACE_SCOPE_ARG(TraceEvents::CAT_RASTER, "RenderRows", "rows", rowCount);
+    Band band = { pixels, width, firstRow, firstRow + rowCount };
+    std::fill(pixels, pixels + (size_t)rowCount * width, ToPixel(background));
+    
+    // Brush strokes connect consecutive brush points, like a GDI pen position
+    const DrawPoint* pen = nullptr;
+    double carried = 0.0;
+    for (size_t i = 0; i < points.size(); i++) {
+        const DrawPoint& point = points[i];
+        if (point.toolType == TOOL_BRUSH) {
+            carried = DrawElement(band, view, point, point.isStart ? nullptr : pen, carried, BrushStamps::EndsStroke(points, i));
+            pen = &point;
+        } else {
+            DrawElement(band, view, point, nullptr, 0.0, false);
+        }
+    }
+}
+
+SceneIndex::SceneIndex(const std::vector<DrawPoint>& documentPoints, const View& outputView, int outputHeight, int sampleCount,
+                       const RasterImage* referenceImage)
+    : points(documentPoints), reference(referenceImage), view(outputView), samples(std::max(1, sampleCount)), bandRows(MIN_BAND_ROWS)
+{
+    TRACE_SCOPE_ARG(TraceEvents::CAT_RASTER, "BuildSceneIndex", "points", documentPoints.size());
+    if (reference && (reference->width <= 0 || reference->height <= 0)) {
+        reference = nullptr;
+    }
+    
+    // Index the sample grid. Its origin is shifted so each output pixel's
+    // samples are centered on where the single sample would have been.
+    view.scale = outputView.scale * samples;
+    view.originX = outputView.originX - (samples - 1) / (2.0 * view.scale);
+    view.originY = outputView.originY - (samples - 1) / (2.0 * view.scale);
+    outputHeight *= samples;
+    
+    const size_t count = points.size();
+    penFrom.assign(count, -1);
+    stampCarry.assign(count, 0.0);
+    
+    // Output row span of each element
+    std::vector<std::pair<int, int>> spans(count);
+    double totalRows = 0;
+    int32_t pen = -1;
+    double carried = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        const DrawPoint& point = points[i];
+        double top = point.y, bottom = point.y;
+        double reach = PointRadius(point);
+        
+        if (point.toolType == TOOL_BRUSH) {
+            reach = std::max(reach, StrokeRadius(point));
+            if (!point.isStart && pen >= 0) {
+                // Stamp spacing carries along the stroke, so each element
+                // starts where the walk from the stroke's start would be
+                const DrawPoint& from = points[pen];
+                penFrom[i] = pen;
+                stampCarry[i] = carried;
+                carried = BrushStamps::WalkSegment(from.x, from.y, point.x, point.y, BrushStamps::Spacing(point.brushSize),
+                                                   carried, [](double, double) {});
+                top = std::min(top, (double)from.y);
+                bottom = std::max(bottom, (double)from.y);
+            } else {
+                carried = 0.0;
+            }
+            pen = (int32_t)i;
+        }
+        
+        double first = std::floor((top - reach - view.originY) * view.scale) - 1;
+        double last = std::ceil((bottom + reach - view.originY) * view.scale) + 1;
+        first = std::max(0.0, first);
+        last = std::min(outputHeight - 1.0, last);
+        spans[i] = (first <= last) ? std::make_pair((int)first, (int)last) : std::make_pair(1, 0);
+        totalRows += (first <= last) ? last - first + 1 : 0;
+    }
+    
+    // Bands about as tall as the average element keep each element in ~2 bands
+    if (count > 0) {
+        bandRows = (int)std::max<double>(MIN_BAND_ROWS, std::min<double>(outputHeight, totalRows / count));
+    }
+    bandRows = std::max(1, bandRows);
+    int bandCount = std::max(1, (outputHeight + bandRows - 1) / bandRows);
+    
+    // Counting pass, then fill (CSR layout)
+    bandStart.assign((size_t)bandCount + 1, 0);
+    for (const std::pair<int, int>& span : spans) {
+        if (span.first > span.second) continue;
+        for (int b = span.first / bandRows; b <= span.second / bandRows; b++) {
+            bandStart[b + 1]++;
+        }
+    }
+    for (int b = 0; b < bandCount; b++) {
+        bandStart[b + 1] += bandStart[b];
+    }
+    
+    entries.resize(bandStart[bandCount]);
+    std::vector<uint32_t> cursor(bandStart.begin(), bandStart.end() - 1);
+    for (size_t i = 0; i < count; i++) {
+        if (spans[i].first > spans[i].second) continue;
+        for (int b = spans[i].first / bandRows; b <= spans[i].second / bandRows; b++) {
+            entries[cursor[b]++] = (uint32_t)i;
+        }
+    }
+}
+
+void SceneIndex::RenderRows(int width, int firstRow, int rowCount, COLORREF background, uint32_t* pixels) const
+{
+    TRACE_SCOPE_ARG(TraceEvents::CAT_RASTER, "RenderBand", "rows", rowCount);
+    if (samples == 1) {
+        RenderSamples(width, firstRow, rowCount, background, pixels);
+        return;
+    }
+    
+    // Render a few output rows' worth of samples at a time and box-filter them down
+    const int sampleWidth = width * samples;
+    const int chunkRows = ScratchRows(width);
+    const uint32_t area = (uint32_t)(samples * samples);
+    std::vector<uint32_t> scratch((size_t)chunkRows * samples * sampleWidth);
+    std::vector<uint32_t> sums((size_t)width * 3);
+    
+    for (int row = 0; row < rowCount; row += chunkRows) {
+        int rows = std::min(chunkRows, rowCount - row);
+        RenderSamples(sampleWidth, (firstRow + row) * samples, rows * samples, background, scratch.data());
+        
+        for (int r = 0; r < rows; r++) {
+            std::fill(sums.begin(), sums.end(), 0);
+            for (int sy = 0; sy < samples; sy++) {
+                const uint32_t* source = scratch.data() + (size_t)(r * samples + sy) * sampleWidth;
+                for (int x = 0; x < width; x++) {
+                    uint32_t* sum = &sums[(size_t)x * 3];
+                    for (int sx = 0; sx < samples; sx++) {
+                        uint32_t pixel = *source++;
+                        sum[0] += pixel & 0xFF;
+                        sum[1] += (pixel >> 8) & 0xFF;
+                        sum[2] += (pixel >> 16) & 0xFF;
+                    }
+                }
+            }
+            
+            uint32_t* out = pixels + (size_t)(row + r) * width;
+            for (int x = 0; x < width; x++) {
+                const uint32_t* sum = &sums[(size_t)x * 3];
+                out[x] = RGB((sum[0] + area / 2) / area, (sum[1] + area / 2) / area, (sum[2] + area / 2) / area) | 0xFF000000u;
+            }
+        }
+    }
+}
+
+int SceneIndex::ScratchRows(int width) const
+{
+    size_t perOutputRow = (size_t)width * samples * samples;
+    return (int)std::max<size_t>(1, SUPERSAMPLE_SCRATCH_PIXELS / std::max<size_t>(1, perOutputRow));
+}
+
+size_t SceneIndex::ScratchBytes(int width) const
+{
+    if (samples == 1) {
+        return 0;
+    }
+    return (size_t)ScratchRows(width) * width * samples * samples * sizeof(uint32_t) + (size_t)width * 3 * sizeof(uint32_t);
+}
+
+void SceneIndex::RenderSamples(int width, int firstRow, int rowCount, COLORREF background, uint32_t* pixels) const
+{
+    std::fill(pixels, pixels + (size_t)rowCount * width, ToPixel(background));
+    if (reference) {
+        DrawReference(width, firstRow, rowCount, pixels);
+    }
+    
+    // Each band's elements are clipped to the band's rows, so elements that
+    // straddle bands are painted exactly once per row
+    int lastRow = firstRow + rowCount;
+    int bandCount = (int)bandStart.size() - 1;
+    for (int b = firstRow / bandRows; b < bandCount && b * bandRows < lastRow; b++) {
+        int top = std::max(firstRow, b * bandRows);
+        int bottom = std::min(lastRow, (b + 1) * bandRows);
+        Band band = { pixels + (size_t)(top - firstRow) * width, width, top, bottom };
+        
+        for (uint32_t e = bandStart[b]; e < bandStart[b + 1]; e++) {
+            uint32_t i = entries[e];
+            bool brush = points[i].toolType == TOOL_BRUSH;
+            DrawElement(band, view, points[i], penFrom[i] >= 0 ? &points[penFrom[i]] : nullptr, stampCarry[i],
+                        brush && BrushStamps::EndsStroke(points, i));
+        }
+    }
+}
+
+// Nearest-sampled reference image, alpha-blended over the background
+void SceneIndex::DrawReference(int width, int firstRow, int rowCount, uint32_t* pixels) const
+{
+    // Reference column under each output column, or -1 outside the image
+    std::vector<int> columns(width);
+    for (int x = 0; x < width; x++) {
+        double column = std::floor(view.originX + x / view.scale);
+        columns[x] = (column >= 0 && column < reference->width) ? (int)column : -1;
+    }
+    
+    for (int y = 0; y < rowCount; y++) {
+        double row = std::floor(view.originY + (firstRow + y) / view.scale);
+        if (row < 0 || row >= reference->height) continue;
+        
+        const uint32_t* source = &reference->pixels[(size_t)row * reference->width];
+        uint32_t* out = pixels + (size_t)y * width;
+        for (int x = 0; x < width; x++) {
+            if (columns[x] < 0) continue;
+            
+            uint32_t pixel = source[columns[x]];
+            uint32_t alpha = pixel >> 24;
+            if (alpha == 255) {
+                out[x] = pixel;
+            } else if (alpha > 0) {
+                uint32_t under = out[x];
+                uint32_t blended = 0;
+                for (int shift = 0; shift < 24; shift += 8) {
+                    uint32_t top = (pixel >> shift) & 0xFF;
+                    uint32_t bottom = (under >> shift) & 0xFF;
+                    blended |= ((top * alpha + bottom * (255 - alpha) + 127) / 255) << shift;
+                }
+                out[x] = blended | 0xFF000000u;
+            }
+        }
+    }
+}
+
+size_t SceneIndex::MemoryBytes() const
+{
+    return penFrom.capacity() * sizeof(int32_t) + stampCarry.capacity() * sizeof(double) + bandStart.capacity() * sizeof(uint32_t) +
+           entries.capacity() * sizeof(uint32_t);
+}
+
+} // namespace RasterRenderer
@@ -0,0 +1,411 @@
+#include "../../include/drawing_engine.h"
+#include "../../include/app_state.h"
+#include "../../include/document_generator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Microbenchmarks for the DrawingEngine hot paths. Every case runs against
+// documents of each requested size with warmup and repetitions, reports the
+// median and p95 time per operation, and can write its results as JSON. A
+// results file from an earlier run serves as the baseline: any case whose
+// median regresses past the threshold fails the run.
+//
+//   engine_bench [--sizes 1000,10000,...] [--max-points N] [--filter TEXT]
+//                [--reps N] [--warmup N] [--json out.json]
+//                [--baseline base.json] [--threshold 0.25]
+
+struct Options {
+    std::vector<size_t> sizes = {1000, 10000, 100000, 1000000, 10000000};
+    size_t maxPoints = SIZE_MAX;
+    std::string filter;
+    int reps = 15;
+    int warmup = 3;
+    std::string jsonFile;
+    std::string baselineFile;
+    double threshold = 0.25;      // Allowed median slowdown before a case fails
+    std::string tempFile = "engine_bench.mpsp";
+};
+
+struct BenchCase {
+    const char* name;
+    bool sized;                   // false: independent of the document, runs once
+    size_t copiesPerOp;           // Full document copies each operation keeps alive until reset
+    std::function<void(size_t ops)> prepare;    // Untimed
+    std::function<void(size_t ops)> run;        // Timed
+};
+
+struct Result {
+    std::string name;
+    size_t points = 0;
+    size_t batch = 0;             // Operations per timed repetition
+    int reps = 0;
+    double medianNs = 0.0;        // Per operation
+    double p95Ns = 0.0;
+    double minNs = 0.0;
+    double baselineNs = 0.0;      // 0 when the baseline has no such case
+    bool regressed = false;
+};
+
+static const double TARGET_BATCH_NS = 5e6;            // Batch cheap operations up to ~5 ms
+static const size_t MAX_BATCH = 1 << 20;
+static const size_t COPY_BUDGET = 256u << 20;         // Memory for copies held by one batch
+static const size_t UNDO_LIMIT = 50;                  // SaveState trims the undo stack past this
+
+static double ElapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Generated documents with the default mix; the same size always builds the same document
+static void BuildDocument(size_t pointCount)
+{
+    DocumentGenerator::Params params;
+    params.points = pointCount;
+    DocumentGenerator::Generate(params, AppState::Instance().drawingPoints);
+}
+
+// Returns AppState to the benchmark document after a batch (cases only append or replace)
+static void ResetState(size_t pointCount)
+{
+    AppState& app = AppState::Instance();
+    app.isDrawing = false;
+    app.hasPreview = false;
+    app.currentTool = TOOL_BRUSH;
+    app.undoStack.clear();
+    app.redoStack.clear();
+    if (app.drawingPoints.size() > pointCount) {
+        app.drawingPoints.resize(pointCount);
+    }
+}
+
+static std::vector<BenchCase> BuildCases(const Options& options)
+{
+    AppState& app = AppState::Instance();
+    std::vector<BenchCase> cases;
+    auto nothing = [](size_t) {};
+    
+    cases.push_back({"HSVtoRGB", false, 0, nothing, [](size_t ops) {
+        volatile COLORREF sink = 0;
+        for (size_t i = 0; i < ops; i++) {
+            sink = sink ^ DrawingEngine::HSVtoRGB((float)(i % 360), 0.75f, 0.9f);
+        }
+    }});
+    
+    // Capacity survives ResetState, so this is the steady-state append cost
+    cases.push_back({"ContinueDrawing", true, 0, [&app](size_t) {
+        app.isDrawing = true;
+        app.stroke = StrokeSettings();
+    }, [](size_t ops) {
+        for (size_t i = 0; i < ops; i++) {
+            DrawingEngine::ContinueDrawing(100 + (int)(i % 512), 100 + (int)(i % 384));
+        }
+    }});
+    
+    // Erases where the document has no points: the full scan without removals
+    cases.push_back({"EraseAtPoint", true, 0, nothing, [](size_t ops) {
+        for (size_t i = 0; i < ops; i++) {
+            DrawingEngine::EraseAtPoint(-1000 - (int)(i % 64), -1000);
+        }
+    }});
+    
+    cases.push_back({"SaveState", true, 1, nothing, [](size_t ops) {
+        for (size_t i = 0; i < ops; i++) {
+            DrawingEngine::SaveState();
+        }
+    }});
+    
+    cases.push_back({"Undo", true, 2, [&app](size_t ops) {
+        app.undoStack.assign(ops, UndoState{app.drawingPoints});
+    }, [](size_t ops) {
+        for (size_t i = 0; i < ops; i++) {
+            DrawingEngine::Undo();
+        }
+    }});
+    
+    cases.push_back({"Redo", true, 2, [&app](size_t ops) {
+        app.redoStack.assign(ops, UndoState{app.drawingPoints});
+    }, [](size_t ops) {
+        for (size_t i = 0; i < ops; i++) {
+            DrawingEngine::Redo();
+        }
+    }});
+    
+    cases.push_back({"DrawLine", true, 0, nothing, [](size_t ops) {
+        for (size_t i = 0; i < ops; i++) {
+            DrawingEngine::DrawLine(100, 100, 300, 250);
+        }
+    }});
+    
+    cases.push_back({"DrawCircle", true, 0, nothing, [](size_t ops) {
+        for (size_t i = 0; i < ops; i++) {
+            DrawingEngine::DrawCircle(500, 400, 100);
+        }
+    }});
+    
+    cases.push_back({"DrawRectangle", true, 0, nothing, [](size_t ops) {
+        for (size_t i = 0; i < ops; i++) {
+            DrawingEngine::DrawRectangle(100, 100, 300, 250);
+        }
+    }});
+    
+    std::string tempFile = options.tempFile;
+    cases.push_back({"SaveDrawing", true, 0, nothing, [tempFile](size_t ops) {
+        for (size_t i = 0; i < ops; i++) {
+            DrawingEngine::SaveDrawing(tempFile);
+        }
+    }});
+    
+    // Each load also pushes an undo state
+    cases.push_back({"LoadDrawing", true, 1, nothing, [tempFile](size_t ops) {
+        for (size_t i = 0; i < ops; i++) {
+            DrawingEngine::LoadDrawing(tempFile);
+        }
+    }});
+    
+    return cases;
+}
+
+static double TimeBatch(const BenchCase& benchCase, size_t pointCount, size_t batch)
+{
+    benchCase.prepare(batch);
+    auto start = std::chrono::steady_clock::now();
+    benchCase.run(batch);
+    double ns = ElapsedNs(start);
+    ResetState(pointCount);
+    return ns;
+}
+
+static Result Measure(const BenchCase& benchCase, size_t pointCount, const Options& options)
+{
+    size_t maxBatch = MAX_BATCH;
+    if (benchCase.copiesPerOp > 0) {
+        size_t copyBytes = benchCase.copiesPerOp * std::max<size_t>(pointCount, 1) * sizeof(DrawPoint);
+        maxBatch = std::max<size_t>(1, std::min(COPY_BUDGET / copyBytes, UNDO_LIMIT - 1));
+    }
+    
+    // Grow the batch until one repetition is long enough to time reliably; the
+    // first run is discarded so one-time costs (vector growth) don't stall it
+    size_t batch = 1;
+    TimeBatch(benchCase, pointCount, batch);
+    double ns = TimeBatch(benchCase, pointCount, batch);
+    while (ns < TARGET_BATCH_NS && batch < maxBatch) {
+        double growth = std::max(2.0, std::min(64.0, TARGET_BATCH_NS / std::max(ns, 1.0)));
+        batch = std::min(maxBatch, (size_t)(batch * growth));
+        ns = TimeBatch(benchCase, pointCount, batch);
+    }
+    
+    for (int i = 0; i < options.warmup; i++) {
+        TimeBatch(benchCase, pointCount, batch);
+    }
+    
+    std::vector<double> samples;
+    for (int i = 0; i < options.reps; i++) {
+        samples.push_back(TimeBatch(benchCase, pointCount, batch) / batch);
+    }
+    std::sort(samples.begin(), samples.end());
+    
+    Result result;
+    result.name = benchCase.name;
+    result.points = pointCount;
+    result.batch = batch;
+    result.reps = options.reps;
+    result.medianNs = samples[samples.size() / 2];
+    result.p95Ns = samples[(size_t)std::ceil(samples.size() * 0.95) - 1];
+    result.minNs = samples.front();
+    return result;
+}
+
+static std::string FormatNs(double ns)
+{
+    char text[32];
+    if (ns < 1e3) {
+        std::snprintf(text, sizeof(text), "%.1f ns", ns);
+    } else if (ns < 1e6) {
+        std::snprintf(text, sizeof(text), "%.2f us", ns / 1e3);
+    } else if (ns < 1e9) {
+        std::snprintf(text, sizeof(text), "%.2f ms", ns / 1e6);
+    } else {
+        std::snprintf(text, sizeof(text), "%.2f s", ns / 1e9);
+    }
+    return text;
+}
+
+static bool WriteJson(const std::string& filename, const std::vector<Result>& results)
+{
+    std::FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    
+    // One case per line; ReadBaseline relies on it
+    std::fprintf(file, "{\n  \"tool\": \"engine_bench\",\n  \"version\": 1,\n  \"cases\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        std::fprintf(file, "    {\"name\": \"%s\", \"points\": %zu, \"batch\": %zu, \"reps\": %d, "
+                     "\"median_ns\": %.1f, \"p95_ns\": %.1f, \"min_ns\": %.1f}%s\n",
+                     r.name.c_str(), r.points, r.batch, r.reps, r.medianNs, r.p95Ns, r.minNs,
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+    return std::fclose(file) == 0;
+}
+
+// Reads a file written by WriteJson: each case line gives name, points and median
+static bool ReadBaseline(const std::string& filename, std::vector<Result>& baseline)
+{
+    std::FILE* file = std::fopen(filename.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+    
+    char line[512];
+    while (std::fgets(line, sizeof(line), file)) {
+        const char* name = std::strstr(line, "\"name\": \"");
+        const char* points = std::strstr(line, "\"points\": ");
+        const char* median = std::strstr(line, "\"median_ns\": ");
+        if (!name || !points || !median) continue;
+        
+        name += std::strlen("\"name\": \"");
+        const char* nameEnd = std::strchr(name, '"');
+        if (!nameEnd) continue;
+        
+        Result entry;
+        entry.name.assign(name, nameEnd);
+        entry.points = std::strtoull(points + std::strlen("\"points\": "), nullptr, 10);
+        entry.medianNs = std::strtod(median + std::strlen("\"median_ns\": "), nullptr);
+        baseline.push_back(entry);
+    }
+    std::fclose(file);
+    return true;
+}
+
+static bool ParseSizes(const char* text, std::vector<size_t>& sizes)
+{
+    sizes.clear();
+    while (*text) {
+        char* end = nullptr;
+        unsigned long long size = std::strtoull(text, &end, 10);
+        if (end == text) return false;
+        sizes.push_back((size_t)size);
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return !sizes.empty();
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--sizes") && hasValue) {
+            if (!ParseSizes(argv[++i], options.sizes)) return false;
+        } else if (!std::strcmp(argv[i], "--max-points") && hasValue) {
+            options.maxPoints = std::strtoull(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--filter") && hasValue) {
+            options.filter = argv[++i];
+        } else if (!std::strcmp(argv[i], "--reps") && hasValue) {
+            options.reps = std::max(1, std::atoi(argv[++i]));
+        } else if (!std::strcmp(argv[i], "--warmup") && hasValue) {
+            options.warmup = std::max(0, std::atoi(argv[++i]));
+        } else if (!std::strcmp(argv[i], "--json") && hasValue) {
+            options.jsonFile = argv[++i];
+        } else if (!std::strcmp(argv[i], "--baseline") && hasValue) {
+            options.baselineFile = argv[++i];
+        } else if (!std::strcmp(argv[i], "--threshold") && hasValue) {
+            options.threshold = std::max(0.0, std::atof(argv[++i]));
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--sizes 1000,10000,...] [--max-points N] [--filter TEXT]\n"
+                     "       [--reps N] [--warmup N] [--json out.json] [--baseline base.json] [--threshold 0.25]\n",
+                     argv[0]);
+        return 2;
+    }
+    
+    std::vector<Result> baseline;
+    if (!options.baselineFile.empty() && !ReadBaseline(options.baselineFile, baseline)) {
+        std::fprintf(stderr, "cannot read baseline: %s\n", options.baselineFile.c_str());
+        return 2;
+    }
+    
+    std::vector<size_t> sizes;
+    for (size_t size : options.sizes) {
+        if (size <= options.maxPoints) sizes.push_back(size);
+    }
+    
+    std::vector<BenchCase> cases = BuildCases(options);
+    auto selected = [&options](const BenchCase& benchCase) {
+        return options.filter.empty() || std::strstr(benchCase.name, options.filter.c_str()) != nullptr;
+    };
+    
+    std::printf("  %-16s %10s %8s %12s %12s %12s\n", "case", "points", "batch", "median", "p95", "baseline");
+    
+    std::vector<Result> results;
+    auto report = [&](Result result) {
+        for (const Result& base : baseline) {
+            if (base.name == result.name && base.points == result.points && base.medianNs > 0.0) {
+                result.baselineNs = base.medianNs;
+                result.regressed = result.medianNs > base.medianNs * (1.0 + options.threshold);
+            }
+        }
+        
+        char change[32] = "";
+        if (result.baselineNs > 0.0) {
+            std::snprintf(change, sizeof(change), "%+.0f%%%s", (result.medianNs / result.baselineNs - 1.0) * 100.0,
+                          result.regressed ? "  REGRESSED" : "");
+        }
+        std::printf("  %-16s %10zu %8zu %12s %12s %12s\n", result.name.c_str(), result.points, result.batch,
+                    FormatNs(result.medianNs).c_str(), FormatNs(result.p95Ns).c_str(), change);
+        std::fflush(stdout);
+        results.push_back(result);
+    };
+    
+    for (const BenchCase& benchCase : cases) {
+        if (!benchCase.sized && selected(benchCase)) {
+            ResetState(0);
+            report(Measure(benchCase, 0, options));
+        }
+    }
+    
+    for (size_t size : sizes) {
+        BuildDocument(size);
+        if (!DrawingEngine::SaveDrawing(options.tempFile)) {
+            std::fprintf(stderr, "cannot write %s\n", options.tempFile.c_str());
+            return 1;
+        }
+        for (const BenchCase& benchCase : cases) {
+            if (benchCase.sized && selected(benchCase)) {
+                ResetState(size);
+                report(Measure(benchCase, size, options));
+            }
+        }
+    }
+    std::remove(options.tempFile.c_str());
+    
+    if (!options.jsonFile.empty() && !WriteJson(options.jsonFile, results)) {
+        std::fprintf(stderr, "cannot write %s\n", options.jsonFile.c_str());
+        return 1;
+    }
+    
+    size_t regressions = std::count_if(results.begin(), results.end(), [](const Result& r) { return r.regressed; });
+    if (regressions > 0) {
+        std::printf("\n%zu case(s) regressed more than %.0f%% against %s\n", regressions,
+                    options.threshold * 100.0, options.baselineFile.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "../../include/input_trace.h"
+#include "../../include/app_state.h"
+#include "../../include/trace_events.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Headless input trace replay: feeds a recorded session through the drawing
+// engine as fast as possible and reports throughput and per-event latency.
+// --paced feeds events at their recorded times, paints software frames when
+// idle and reports input-to-present latency as well. Built with ALLOCS=1 it
+// also counts heap allocations per event type and per painted frame.
+//
+//   trace_replay <trace.mpst> [--repeat N] [--paced]
+
+static void PrintLatency(const char* name, const InputTrace::Latency& latency)
+{
+    if (latency.count == 0) return;
+    std::printf("  %-12s %10zu %10.2f %10.2f %10.2f %10.2f", name, latency.count,
+                latency.p50Micros, latency.p90Micros, latency.p99Micros, latency.maxMicros);
+    if (AllocStats::Enabled()) {
+        std::printf(" %10.2f", latency.allocationsPerEvent);
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <trace.mpst> [--repeat N] [--paced]\n", argv[0]);
+        return 2;
+    }
+    
+    int repeat = 1;
+    bool paced = false;
+    for (int i = 2; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--repeat") && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (!std::strcmp(argv[i], "--paced")) {
+            paced = true;
+        }
+    }
+
+#ifdef MPS_TRACE_EVENTS
+    TraceEvents::SetThreadName("replay");
+    TraceEvents::FlushOnExit("trace_replay_trace.json");
+#endif
+    
+    InputTrace::Trace trace;
+    if (!InputTrace::Load(argv[1], trace)) {
+        std::fprintf(stderr, "cannot read trace: %s\n", argv[1]);
+        return 1;
+    }
+    
+    double recordedSeconds = trace.events.empty() ? 0.0 : trace.events.back().timeMicros / 1e6;
+    std::printf("Trace: %zu events over %.1f s, starting document %zu points, client %dx%d\n",
+                trace.events.size(), recordedSeconds, trace.session.document.size(),
+                trace.session.clientWidth, trace.session.clientHeight);
+    
+    // Every run starts from the recorded session, so runs are identical
+    std::vector<double> rates;
+    InputTrace::ReplayStats stats;
+    for (int run = 0; run < repeat; run++) {
+        stats = InputTrace::Replay(trace, paced);
+        rates.push_back(stats.eventsPerSecond);
+    }
+    std::sort(rates.begin(), rates.end());
+    
+    std::printf("Replay: %zu events (%zu ignored), %zu points, %.3f s, %.0f events/s",
+                stats.events, stats.ignored, AppState::Instance().drawingPoints.size(),
+                stats.seconds, rates[rates.size() / 2]);
+    std::printf(repeat > 1 ? " (median of %d runs)\n" : "\n", repeat);
+    
+    std::printf("\n  %-12s %10s %10s %10s %10s %10s%s\n", "event", "count", "p50 us", "p90 us", "p99 us", "max us",
+                AllocStats::Enabled() ? "   allocs/e" : "");
+    for (int type = 0; type < InputTrace::EVENT_TYPE_COUNT; type++) {
+        PrintLatency(InputTrace::EventName((InputTrace::EventType)type), stats.byType[type]);
+    }
+    PrintLatency("all", stats.all);
+    if (AllocStats::Enabled()) {
+        std::printf("\nAllocations: %llu (%.1f KB) applying events, at most %llu in one event\n",
+                    (unsigned long long)stats.allocated.allocations, stats.allocated.bytes / 1024.0,
+                    (unsigned long long)stats.maxEventAllocations);
+    }
+    
+    if (paced) {
+        const FrameProfiler::Summary& paint = stats.paint;
+        std::printf("\nFrames: %zu painted; last %zu mean %.2f ms, p99 %.2f ms\n", stats.frames, paint.frames,
+                    paint.meanMicros / 1000.0, paint.p99Micros / 1000.0);
+        std::printf("Input to present: %zu inputs, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+                    paint.latencySamples, paint.latencyP50Micros / 1000.0, paint.latencyP95Micros / 1000.0,
+                    paint.latencyP99Micros / 1000.0, paint.latencyMaxMicros / 1000.0);
+        if (AllocStats::Enabled()) {
+            std::printf("Frame allocations: %.1f per frame (%.1f KB), max %u\n", paint.allocationsPerFrame,
+                        paint.allocatedBytesPerFrame / 1024.0, paint.maxAllocations);
+        }
+    }
+    return 0;
+}
@@ -4,6 +4,8 @@
 #include "../../include/drawing_engine.h"
 #include "../../include/icon_resources.h"
 #include "../../include/gpu_renderer.h"
+#include "../../include/memory_stats.h"
+#include "../../include/engine_thread.h"
 
 namespace UIRenderer {
 
@@ -279,16 +281,23 @@ void DrawStatusBarGPU(RECT clientRect)
                           (app.currentTool == TOOL_LINE) ? L"Line" : L"Color Picker";
     
     // Format status text
-    WCHAR statusText1[200];
-    swprintf(statusText1, 200, L"Tool: %s | Size: %d | Zoom: %.0f%% | Grid: %s | Theme: %s | Points: %zu | F1: Help", 
+    // Undo snapshots are full copies, so they usually dominate the total
+    EngineThread::Status status = EngineThread::CurrentStatus();
+    const MemoryStats::Report& memory = status.memory;
+    WCHAR statusText1[256];
+    swprintf(statusText1, 256, L"Tool: %s | Size: %d | Zoom: %.0f%% | Grid: %s | Theme: %s | Points: %zu | Memory: %.1f MB (Undo/Redo: %.1f MB) | F1: Help", 
             toolName, app.brushSize, app.zoomLevel * 100,
             app.showGrid ? L"On" : L"Off",
             (app.currentTheme == THEME_LIGHT) ? L"Light" : L"Dark", 
-            app.drawingPoints.size());
+            status.points, memory.totalBytes / 1048576.0,
+            (memory.bytes[MemoryStats::MEM_UNDO] + memory.bytes[MemoryStats::MEM_REDO]) / 1048576.0);
+    
+    std::wstring text = statusText1;
+    text += JobsStatusText();
     
     // Draw status text with GPU acceleration
     GPURenderer::GPURenderingEngine::DrawText(
-        statusText1, 
+        text.c_str(), 
         10.0f, 
         statusTop + 5.0f, 
         (float)(clientRect.right - 20), 
@@ -359,4 +368,18 @@ void DrawAdvancedColorPickerGPU(RECT clientRect)
     );
 }
 
+void DrawPerformanceHudGPU(RECT clientRect)
+{
+    std::vector<std::wstring> lines = PerformanceHudLines();
+    const float lineHeight = 16.0f;
+    float left = (float)(clientRect.right - 290);
+    float top = (float)(TOOLBAR_HEIGHT + 10);
+    
+    GPURenderer::GPURenderingEngine::FillRectangle(left, top, 280.0f, 8.0f + lines.size() * lineHeight, RGB(20, 20, 20));
+    for (size_t i = 0; i < lines.size(); i++) {
+        GPURenderer::GPURenderingEngine::DrawText(lines[i].c_str(), left + 8.0f, top + 4.0f + i * lineHeight,
+                                                  270.0f, lineHeight, RGB(120, 255, 120));
+    }
+}
+
 } // namespace UIRenderer
\ No newline at end of file
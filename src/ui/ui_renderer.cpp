@@ -4,6 +4,10 @@
 #include "../../include/drawing_engine.h"
 #include "../../include/icon_resources.h"
 #include "../../include/gpu_renderer.h"
+#include "../../include/frame_profiler.h"
+#include "../../include/memory_stats.h"
+#include "../../include/engine_thread.h"
+#include "../../include/job_pool.h"
 
 namespace UIRenderer {
 
@@ -36,20 +40,26 @@ void DrawStatusBar(HDC hdc, RECT clientRect)
         COLORREF statusText = (app.currentTheme == THEME_LIGHT) ? RGB(0, 0, 0) : RGB(255, 255, 255);
         SetTextColor(hdc, statusText);
         
-        WCHAR statusText1[200];
+        WCHAR statusText1[256];
         const WCHAR* toolName = (app.currentTool == TOOL_BRUSH) ? L"Brush" :
                               (app.currentTool == TOOL_ERASER) ? L"Eraser" :
                               (app.currentTool == TOOL_RECTANGLE) ? L"Rectangle" :
                               (app.currentTool == TOOL_CIRCLE) ? L"Circle" :
                               (app.currentTool == TOOL_LINE) ? L"Line" : L"Color Picker";
         
-        swprintf(statusText1, 200, L"Tool: %s | Size: %d | Zoom: %.0f%% | Grid: %s | Theme: %s | Points: %zu | F1: Help", 
+        // Undo snapshots are full copies, so they usually dominate the total
+        EngineThread::Status status = EngineThread::CurrentStatus();
+        const MemoryStats::Report& memory = status.memory;
+        swprintf(statusText1, 256, L"Tool: %s | Size: %d | Zoom: %.0f%% | Grid: %s | Theme: %s | Points: %zu | Memory: %.1f MB (Undo/Redo: %.1f MB) | F1: Help", 
                 toolName, app.brushSize, app.zoomLevel * 100,
                 app.showGrid ? L"On" : L"Off",
                 (app.currentTheme == THEME_LIGHT) ? L"Light" : L"Dark", 
-                app.drawingPoints.size());
+                status.points, memory.totalBytes / 1048576.0,
+                (memory.bytes[MemoryStats::MEM_UNDO] + memory.bytes[MemoryStats::MEM_REDO]) / 1048576.0);
         
-        TextOut(hdc, 10, clientRect.bottom - STATUSBAR_HEIGHT + 5, statusText1, wcslen(statusText1));
+        std::wstring text = statusText1;
+        text += JobsStatusText();
+        TextOut(hdc, 10, clientRect.bottom - STATUSBAR_HEIGHT + 5, text.c_str(), text.size());
     }
 }
 
@@ -116,6 +126,86 @@ void DrawAdvancedColorPicker(HDC hdc)
     }
 }
 
+std::wstring JobsStatusText()
+{
+    std::vector<JobPool::JobStatus> jobs = JobPool::ActiveJobs();
+    std::wstring text;
+    for (size_t i = 0; i < jobs.size() && i < 3; i++) {
+        const JobPool::JobStatus& job = jobs[i];
+        std::wstring name(MultiByteToWideChar(CP_UTF8, 0, job.name.c_str(), -1, NULL, 0), L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, job.name.c_str(), -1, &name[0], (int)name.size());
+        name.resize(wcslen(name.c_str()));
+        
+        WCHAR state[32];
+        if (job.cancelling) {
+            swprintf(state, 32, L"cancelling");
+        } else if (job.running) {
+            swprintf(state, 32, L"%.0f%%", job.progress * 100);
+        } else {
+            swprintf(state, 32, L"queued");
+        }
+        text += (i == 0) ? L" | Jobs: " : L", ";
+        text += name + L" " + state;
+    }
+    if (jobs.size() > 3) {
+        text += L", +" + std::to_wstring(jobs.size() - 3) + L" more";
+    }
+    return text;
+}
+
+std::vector<std::wstring> PerformanceHudLines()
+{
+    FrameProfiler::Summary stats = GPURenderer::GPURenderingEngine::GetPerformanceStats();
+    std::vector<std::wstring> lines;
+    WCHAR line[128];
+    
+    swprintf(line, 128, L"Frame %.2f ms  p99 %.2f ms  max %.2f ms",
+             stats.meanMicros / 1000.0, stats.p99Micros / 1000.0, stats.maxMicros / 1000.0);
+    lines.push_back(line);
+    swprintf(line, 128, L"%.0f paints/s (%s)  Points drawn: %u",
+             stats.framesPerSecond, stats.gpu ? L"GPU" : L"GDI", stats.pointsDrawn);
+    lines.push_back(line);
+    swprintf(line, 128, L"Input to present p50 %.1f  p95 %.1f  p99 %.1f ms",
+             stats.latencyP50Micros / 1000.0, stats.latencyP95Micros / 1000.0, stats.latencyP99Micros / 1000.0);
+    lines.push_back(line);
+    if (AllocStats::Enabled()) {
+        swprintf(line, 128, L"Allocations %.1f/frame (%.1f KB)  max %u",
+                 stats.allocationsPerFrame, stats.allocatedBytesPerFrame / 1024.0, stats.maxAllocations);
+        lines.push_back(line);
+    }
+    
+    // Per-phase means, skipping phases that took no time (hidden grid, picker)
+    for (int phase = 0; phase < FrameProfiler::PHASE_COUNT; phase++) {
+        if (stats.phaseMeanMicros[phase] < 1.0) continue;
+        swprintf(line, 128, L"  %-14hs %8.2f ms", FrameProfiler::PhaseName((FrameProfiler::Phase)phase),
+                 stats.phaseMeanMicros[phase] / 1000.0);
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+void DrawPerformanceHud(HDC hdc, RECT clientRect)
+{
+    if (GPURenderer::GPURenderingEngine::GetContext().initialized) {
+        DrawPerformanceHudGPU(clientRect);
+        return;
+    }
+    
+    std::vector<std::wstring> lines = PerformanceHudLines();
+    const int lineHeight = 16;
+    RECT hudRect = {clientRect.right - 290, TOOLBAR_HEIGHT + 10, clientRect.right - 10,
+                    TOOLBAR_HEIGHT + 18 + (int)lines.size() * lineHeight};
+    HBRUSH hudBrush = CreateSolidBrush(RGB(20, 20, 20));
+    FillRect(hdc, &hudRect, hudBrush);
+    DeleteObject(hudBrush);
+    
+    SetBkMode(hdc, TRANSPARENT);
+    SetTextColor(hdc, RGB(120, 255, 120));
+    for (size_t i = 0; i < lines.size(); i++) {
+        TextOut(hdc, hudRect.left + 8, hudRect.top + 4 + (int)i * lineHeight, lines[i].c_str(), lines[i].size());
+    }
+}
+
 HMENU CreateMenuBar()
 {
     HMENU hMenuBar = CreateMenu();
@@ -131,6 +221,11 @@ HMENU CreateMenuBar()
     AppendMenu(hFileMenu, MF_SEPARATOR, 0, NULL);
     AppendMenu(hFileMenu, MF_STRING, IDM_FILE_SAVE, L"&Save\tCtrl+S");
     AppendMenu(hFileMenu, MF_STRING, IDM_FILE_SAVEAS, L"Save &As...");
+    AppendMenu(hFileMenu, MF_STRING, IDM_FILE_EXPORT_PRINT, L"Export for &Print (4x)...");
+    AppendMenu(hFileMenu, MF_STRING, IDM_FILE_CANCEL_JOBS, L"&Cancel Background Jobs");
+    AppendMenu(hFileMenu, MF_SEPARATOR, 0, NULL);
+    AppendMenu(hFileMenu, MF_STRING, IDM_FILE_IMPORT_REFERENCE, L"Import &Reference Image...");
+    AppendMenu(hFileMenu, MF_STRING, IDM_FILE_CLEAR_REFERENCE, L"Clear Reference Ima&ge");
     AppendMenu(hFileMenu, MF_SEPARATOR, 0, NULL);
     AppendMenu(hFileMenu, MF_STRING, IDM_FILE_EXIT, L"E&xit\tAlt+F4");
 
@@ -146,6 +241,10 @@ HMENU CreateMenuBar()
     AppendMenu(hViewMenu, MF_STRING, IDM_VIEW_ZOOM_FIT, L"&Fit to Window\tCtrl+0");
     AppendMenu(hViewMenu, MF_SEPARATOR, 0, NULL);
     AppendMenu(hViewMenu, MF_STRING, IDM_VIEW_GRID, L"Show &Grid\tG");
+    AppendMenu(hViewMenu, MF_STRING, IDM_VIEW_PERF_HUD, L"&Performance Overlay\tF3");
+    AppendMenu(hViewMenu, MF_STRING | MF_CHECKED, IDM_VIEW_SMOOTH_STROKES, L"&Smooth Strokes");
+    AppendMenu(hViewMenu, MF_STRING, IDM_VIEW_PREDICT_TAIL, L"P&redicted Stroke Tail");
+    AppendMenu(hViewMenu, MF_STRING, IDM_VIEW_MEMORY_USAGE, L"&Memory Usage...");
     AppendMenu(hViewMenu, MF_SEPARATOR, 0, NULL);
     AppendMenu(hViewMenu, MF_STRING, IDM_VIEW_THEME, L"Toggle &Theme\tCtrl+T");
 
@@ -156,6 +255,12 @@ HMENU CreateMenuBar()
     AppendMenu(hToolsMenu, MF_STRING, IDM_TOOLS_RECT, L"&Rectangle Tool\tR");
     AppendMenu(hToolsMenu, MF_STRING, IDM_TOOLS_CIRCLE, L"&Circle Tool\tC");
     AppendMenu(hToolsMenu, MF_STRING, IDM_TOOLS_LINE, L"&Line Tool\tL");
+    AppendMenu(hToolsMenu, MF_SEPARATOR, 0, NULL);
+    AppendMenu(hToolsMenu, MF_STRING, IDM_TOOLS_RECORD_TRACE, L"Record &Input Trace...");
+    AppendMenu(hToolsMenu, MF_STRING, IDM_TOOLS_SAVE_PERF_REPORT, L"Save &Performance Report...");
+#ifdef MPS_TRACE_EVENTS
+    AppendMenu(hToolsMenu, MF_STRING, IDM_TOOLS_SAVE_TRACE, L"Save Engine &Timeline...");
+#endif
 
     // Help Menu
     AppendMenu(hHelpMenu, MF_STRING, IDM_HELP_ABOUT, L"&About\tF1");
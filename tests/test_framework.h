@@ -1,27 +1,68 @@
 #ifndef TEST_FRAMEWORK_H
 #define TEST_FRAMEWORK_H
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <vector>
 #include <string>
 #include <functional>
 #include <iostream>
+#include <sstream>
 #include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
 
 // Simple testing framework for Win32 applications
 class TestFramework {
 public:
+    // Benchmark settings. The body is called with an iteration count and
+    // repeats its work that many times; the count grows until one call lasts
+    // minSampleMs, so timer resolution does not dominate fast operations.
+    struct BenchmarkOptions {
+        int warmupRuns = 3;                 // Untimed single-iteration calls first
+        int minSamples = 10;
+        int maxSamples = 50;
+        double minSampleMs = 2.0;
+        double maxTotalMs = 1000.0;         // Sampling stops here once minSamples are in
+        double unitsPerIteration = 0.0;     // Work per iteration for throughput (0: none)
+        std::string unit;                   // "points", "bytes", ...
+        double maxMedianNs = 0.0;           // Fail above this median per iteration (0: no limit)
+    };
+
+    // Per-iteration times over all samples
+    struct BenchmarkStats {
+        size_t iterationsPerSample = 0;
+        size_t samples = 0;
+        double minNs = 0.0;
+        double medianNs = 0.0;
+        double p95Ns = 0.0;
+        double meanNs = 0.0;
+        double stddevNs = 0.0;
+        double unitsPerSecond = 0.0;        // At the median
+    };
+
     struct TestResult {
         std::string testName;
         bool passed;
         std::string errorMessage;
         long long executionTimeMs;
+        bool benchmark = false;
+        BenchmarkStats stats;
+        std::string unit;
     };
 
     struct TestSuite {
         std::string suiteName;
         std::vector<std::function<bool()>> tests;
         std::vector<std::string> testNames;
+        bool independent = false;           // Shares no state with other suites; may run in parallel
+        std::vector<std::function<bool(size_t)>> benchmarks;   // Parallel to tests; empty for plain tests
+        std::vector<std::shared_ptr<BenchmarkOptions>> benchmarkOptions;
     };
 
 private:
@@ -31,10 +72,12 @@ private:
     int passedTests = 0;
 
 public:
-    // Add a test suite
-    void AddSuite(const std::string& suiteName) {
+    // Add a test suite. Independent suites run concurrently with each other;
+    // their benchmarks still run one at a time afterwards, on a quiet machine.
+    void AddSuite(const std::string& suiteName, bool independent = false) {
         TestSuite suite;
         suite.suiteName = suiteName;
+        suite.independent = independent;
         testSuites.push_back(suite);
     }
 
@@ -43,6 +86,23 @@ public:
         if (!testSuites.empty()) {
             testSuites.back().testNames.push_back(testName);
             testSuites.back().tests.push_back(testFunc);
+            testSuites.back().benchmarks.push_back(nullptr);
+            testSuites.back().benchmarkOptions.push_back(nullptr);
+        }
+    }
+
+    // Add a benchmark to the current suite; the body returns false to fail
+    void AddBenchmark(const std::string& testName, std::function<bool(size_t iterations)> body) {
+        AddBenchmark(testName, body, BenchmarkOptions());
+    }
+
+    void AddBenchmark(const std::string& testName, std::function<bool(size_t iterations)> body,
+                      const BenchmarkOptions& options) {
+        if (!testSuites.empty()) {
+            testSuites.back().testNames.push_back(testName);
+            testSuites.back().tests.push_back(nullptr);
+            testSuites.back().benchmarks.push_back(body);
+            testSuites.back().benchmarkOptions.push_back(std::make_shared<BenchmarkOptions>(options));
         }
     }
 
@@ -53,8 +113,37 @@ public:
 
         auto startTime = std::chrono::high_resolution_clock::now();
 
-        for (const auto& suite : testSuites) {
-            RunTestSuite(suite);
+        // Plain tests of independent suites first, across cores, output held back
+        std::vector<std::ostringstream> held(testSuites.size());
+        std::vector<std::vector<TestResult>> heldResults(testSuites.size());
+        std::vector<size_t> parallel;
+        for (size_t s = 0; s < testSuites.size(); s++) {
+            if (testSuites[s].independent) parallel.push_back(s);
+        }
+        std::atomic<size_t> next(0);
+        auto worker = [&]() {
+            for (size_t i = next++; i < parallel.size(); i = next++) {
+                size_t s = parallel[i];
+                RunSuiteTests(testSuites[s], RUN_PLAIN, held[s], heldResults[s]);
+            }
+        };
+        size_t threadCount = std::min<size_t>(parallel.size(), std::max(1u, std::thread::hardware_concurrency()));
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < threadCount; t++) threads.emplace_back(worker);
+        for (std::thread& thread : threads) thread.join();
+
+        // Then, in order: held output and benchmarks, or whole dependent suites
+        for (size_t s = 0; s < testSuites.size(); s++) {
+            const TestSuite& suite = testSuites[s];
+            if (suite.independent) {
+                std::cout << held[s].str() << std::flush;
+                RunSuiteTests(suite, RUN_BENCHMARKS, std::cout, heldResults[s]);
+            } else {
+                std::cout << "Running " << suite.suiteName << " tests:" << std::endl;
+                RunSuiteTests(suite, RUN_ALL, std::cout, heldResults[s]);
+            }
+            for (const TestResult& result : heldResults[s]) Count(result);
+            std::cout << std::endl;
         }
 
         auto endTime = std::chrono::high_resolution_clock::now();
@@ -63,22 +152,109 @@ public:
         PrintSummary(duration.count());
     }
 
+    bool AllTestsPassed() const {
+        return passedTests == totalTests;
+    }
+
+    const std::vector<TestResult>& Results() const {
+        return results;
+    }
+
+    // Times a benchmark body: warmup, batch calibration, then samples until
+    // maxSamples or (minSamples and maxTotalMs). False if the body failed.
+    static bool MeasureBenchmark(const std::function<bool(size_t)>& body, const BenchmarkOptions& options,
+                                 BenchmarkStats& stats) {
+        typedef std::chrono::steady_clock Clock;
+        auto elapsedNs = [](Clock::time_point start) {
+            return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        };
+        const size_t MAX_ITERATIONS = (size_t)1 << 30;
+
+        for (int i = 0; i < options.warmupRuns; i++) {
+            if (!body(1)) return false;
+        }
+
+        size_t iterations = 1;
+        for (;;) {
+            auto start = Clock::now();
+            if (!body(iterations)) return false;
+            double ms = elapsedNs(start) / 1e6;
+            if (ms >= options.minSampleMs || iterations >= MAX_ITERATIONS) break;
+            double growth = ms > 0.0 ? 1.2 * options.minSampleMs / ms : 10.0;
+            iterations = std::min(MAX_ITERATIONS, (size_t)std::ceil(iterations * std::min(10.0, std::max(2.0, growth))));
+        }
+
+        std::vector<double> perIteration;
+        double totalMs = 0.0;
+        while ((int)perIteration.size() < std::max(1, options.maxSamples) &&
+               ((int)perIteration.size() < options.minSamples || totalMs < options.maxTotalMs)) {
+            auto start = Clock::now();
+            if (!body(iterations)) return false;
+            double ns = elapsedNs(start);
+            perIteration.push_back(ns / iterations);
+            totalMs += ns / 1e6;
+        }
+
+        stats = Summarize(perIteration);
+        stats.iterationsPerSample = iterations;
+        if (options.unitsPerIteration > 0.0 && stats.medianNs > 0.0) {
+            stats.unitsPerSecond = options.unitsPerIteration * 1e9 / stats.medianNs;
+        }
+        return true;
+    }
+
+    // Nearest-rank percentiles and sample standard deviation
+    static BenchmarkStats Summarize(std::vector<double> samples) {
+        BenchmarkStats stats;
+        stats.samples = samples.size();
+        if (samples.empty()) return stats;
+
+        std::sort(samples.begin(), samples.end());
+        auto rank = [&](double q) { return samples[(size_t)std::ceil(samples.size() * q) - 1]; };
+        stats.minNs = samples.front();
+        stats.medianNs = rank(0.50);
+        stats.p95Ns = rank(0.95);
+        for (double sample : samples) stats.meanNs += sample;
+        stats.meanNs /= samples.size();
+        if (samples.size() > 1) {
+            double squares = 0.0;
+            for (double sample : samples) squares += (sample - stats.meanNs) * (sample - stats.meanNs);
+            stats.stddevNs = std::sqrt(squares / (samples.size() - 1));
+        }
+        return stats;
+    }
+
 private:
-    void RunTestSuite(const TestSuite& suite) {
-        std::cout << "Running " << suite.suiteName << " tests:" << std::endl;
-        
-        for (size_t i = 0; i < suite.tests.size(); i++) {
-            RunSingleTest(suite.testNames[i], suite.tests[i]);
+    enum RunMode { RUN_PLAIN, RUN_BENCHMARKS, RUN_ALL };
+
+    // Runs a suite's tests of one kind (or all, in order), appending results
+    void RunSuiteTests(const TestSuite& suite, RunMode mode, std::ostream& out, std::vector<TestResult>& suiteResults) {
+        if (mode == RUN_PLAIN) {
+            out << "Running " << suite.suiteName << " tests:" << std::endl;
         }
-        std::cout << std::endl;
+        for (size_t i = 0; i < suite.testNames.size(); i++) {
+            bool isBenchmark = suite.benchmarks[i] != nullptr;
+            if ((mode == RUN_PLAIN && isBenchmark) || (mode == RUN_BENCHMARKS && !isBenchmark)) continue;
+            TestResult result = isBenchmark
+                ? RunSingleBenchmark(suite.testNames[i], suite.benchmarks[i], *suite.benchmarkOptions[i])
+                : RunSingleTest(suite.testNames[i], suite.tests[i]);
+            PrintResult(out, result);
+            suiteResults.push_back(result);
+        }
+    }
+
+    void Count(const TestResult& result) {
+        results.push_back(result);
+        totalTests++;
+        if (result.passed) passedTests++;
     }
 
-    void RunSingleTest(const std::string& testName, std::function<bool()> testFunc) {
+    TestResult RunSingleTest(const std::string& testName, std::function<bool()> testFunc) {
         TestResult result;
         result.testName = testName;
 
         auto startTime = std::chrono::high_resolution_clock::now();
-        
+
         try {
             result.passed = testFunc();
             if (!result.passed) {
@@ -94,19 +270,54 @@ private:
 
         auto endTime = std::chrono::high_resolution_clock::now();
         result.executionTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+        return result;
+    }
 
-        results.push_back(result);
-        totalTests++;
-        if (result.passed) passedTests++;
+    TestResult RunSingleBenchmark(const std::string& testName, const std::function<bool(size_t)>& body,
+                                  const BenchmarkOptions& options) {
+        BenchmarkStats stats;
+        TestResult result = RunSingleTest(testName, [&]() { return MeasureBenchmark(body, options, stats); });
+        result.benchmark = true;
+        result.stats = stats;
+        if (result.passed && options.maxMedianNs > 0.0 && stats.medianNs > options.maxMedianNs) {
+            result.passed = false;
+            result.errorMessage = "Median " + FormatNanos(stats.medianNs) + " over the " +
+                                  FormatNanos(options.maxMedianNs) + " limit";
+        }
+        result.unit = options.unit;
+        return result;
+    }
+
+    static std::string FormatNanos(double ns) {
+        char text[32];
+        if (ns < 1e3) std::snprintf(text, sizeof(text), "%.1f ns", ns);
+        else if (ns < 1e6) std::snprintf(text, sizeof(text), "%.2f us", ns / 1e3);
+        else if (ns < 1e9) std::snprintf(text, sizeof(text), "%.2f ms", ns / 1e6);
+        else std::snprintf(text, sizeof(text), "%.2f s", ns / 1e9);
+        return text;
+    }
 
-        // Print result
-        std::cout << "  " << (result.passed ? "✓ PASS" : "✗ FAIL") 
-                  << " - " << testName 
-                  << " (" << result.executionTimeMs << "ms)";
+    static void PrintResult(std::ostream& out, const TestResult& result) {
+        out << "  " << (result.passed ? "✓ PASS" : "✗ FAIL")
+            << " - " << result.testName
+            << " (" << result.executionTimeMs << "ms)";
         if (!result.passed) {
-            std::cout << " - " << result.errorMessage;
+            out << " - " << result.errorMessage;
+        }
+        out << std::endl;
+
+        if (result.benchmark && result.stats.samples > 0) {
+            const BenchmarkStats& stats = result.stats;
+            out << "      median " << FormatNanos(stats.medianNs) << ", min " << FormatNanos(stats.minNs)
+                << ", p95 " << FormatNanos(stats.p95Ns) << ", stddev " << FormatNanos(stats.stddevNs)
+                << " (" << stats.samples << " samples x " << stats.iterationsPerSample << ")";
+            if (stats.unitsPerSecond > 0.0) {
+                char rate[64];
+                std::snprintf(rate, sizeof(rate), "%.3g", stats.unitsPerSecond);
+                out << " | " << rate << " " << (result.unit.empty() ? std::string("units") : result.unit) << "/s";
+            }
+            out << std::endl;
         }
-        std::cout << std::endl;
     }
 
     void PrintSummary(long long totalTimeMs) {
@@ -146,4 +357,4 @@ private:
         return false; \
     }
 
-#endif // TEST_FRAMEWORK_H
\ No newline at end of file
+#endif // TEST_FRAMEWORK_H
@@ -0,0 +1,310 @@
+#include "../test_framework.h"
+#include "../../include/alloc_stats.h"
+#include "../../include/frame_profiler.h"
+#include "../../include/input_trace.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/document_generator.h"
+#include "../../include/raster_renderer.h"
+#include "../../include/app_state.h"
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+// Built with MPS_ALLOC_STATS (see the Makefile), so operator new is counted
+class AllocStatsTests {
+private:
+    TestFramework framework;
+
+public:
+    AllocStatsTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Allocation Counting");
+        framework.AddTest("Counters Follow New And Delete", [this]() { return TestCounters(); });
+        framework.AddTest("Threads Count Separately", [this]() { return TestThreads(); });
+        framework.AddTest("Frames Record Their Allocations", [this]() { return TestFrames(); });
+        framework.AddTest("Replay Reports Allocations Per Event", [this]() { return TestReplay(); });
+
+        framework.AddSuite("Allocation-Free Hot Paths");
+        framework.AddTest("Software Paint", [this]() { return TestPaint(); });
+        framework.AddTest("Shape Tools", [this]() { return TestShapes(); });
+        framework.AddTest("Brush Strokes In Steady State", [this]() { return TestStrokes(); });
+        framework.AddTest("Batched Moves Grow The Document Once", [this]() { return TestBatchedMoves(); });
+        framework.AddTest("Loading Reserves The Document Once", [this]() { return TestLoad(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static void ResetDocument() {
+        AppState& app = AppState::Instance();
+        app.drawingPoints.clear();
+        app.undoStack.clear();
+        app.redoStack.clear();
+        app.isDrawing = false;
+        app.hasPreview = false;
+        app.currentTool = TOOL_BRUSH;
+    }
+
+    // Keeps the compiler from eliding a new/delete pair
+    static void Escape(void* pointer) {
+        static void* volatile sink;
+        sink = pointer;
+        (void)sink;
+    }
+
+    static void Generate(size_t points) {
+        DocumentGenerator::Params params;
+        params.points = points;
+        DocumentGenerator::Generate(params, AppState::Instance().drawingPoints);
+    }
+
+    bool TestCounters() {
+        ASSERT_TRUE(AllocStats::Enabled());
+
+        AllocStats::Scope scope;
+        int* values = new int[100];
+        Escape(values);
+        delete[] values;
+        std::unique_ptr<double> single(new double(1.0));
+        Escape(single.get());
+        single.reset();
+        AllocStats::Counters counted = scope.Elapsed();
+        ASSERT_EQ((uint64_t)2, counted.allocations);
+        ASSERT_EQ((uint64_t)2, counted.frees);
+        ASSERT_EQ((uint64_t)(100 * sizeof(int) + sizeof(double)), counted.bytes);
+
+        // Reserved capacity is reused without touching the heap
+        std::vector<int> buffer;
+        buffer.reserve(64);
+        AllocStats::Scope reuse;
+        for (int i = 0; i < 64; i++) buffer.push_back(i);
+        buffer.clear();
+        ASSERT_EQ((uint64_t)0, reuse.Elapsed().allocations);
+        return true;
+    }
+
+    bool TestThreads() {
+        AllocStats::Counters threadBefore = AllocStats::ThreadCounters();
+        AllocStats::Counters totalBefore = AllocStats::TotalCounters();
+
+        std::thread worker([]() {
+            for (int i = 0; i < 1000; i++) {
+                std::unique_ptr<int> value(new int(i));
+                Escape(value.get());
+            }
+        });
+        worker.join();
+
+        // The worker's allocations show in the total only
+        AllocStats::Counters total = AllocStats::TotalCounters() - totalBefore;
+        ASSERT_TRUE(total.allocations >= 1000);
+        ASSERT_TRUE(total.bytes >= 1000 * sizeof(int));
+        ASSERT_TRUE((AllocStats::ThreadCounters() - threadBefore).allocations < 1000);
+        return true;
+    }
+
+    bool TestFrames() {
+        FrameProfiler::Reset();
+
+        FrameProfiler::BeginFrame(false);
+        {
+            std::vector<uint32_t> scratch(1000);
+            std::string label(100, 'x');
+        }
+        FrameProfiler::EndFrame(0);
+
+        FrameProfiler::BeginFrame(false);
+        FrameProfiler::EndFrame(0);
+
+        std::vector<FrameProfiler::FrameRecord> frames;
+        ASSERT_EQ((size_t)2, FrameProfiler::Snapshot(frames));
+        ASSERT_EQ((uint32_t)2, frames[0].allocations);
+        ASSERT_TRUE(frames[0].allocatedBytes >= 1000 * sizeof(uint32_t) + 100);
+        ASSERT_EQ((uint32_t)0, frames[1].allocations);
+        ASSERT_EQ((uint64_t)0, frames[1].allocatedBytes);
+
+        FrameProfiler::Summary summary = FrameProfiler::Summarize(frames);
+        ASSERT_EQ((uint32_t)2, summary.maxAllocations);
+        ASSERT_TRUE(summary.allocationsPerFrame == 1.0);
+        FrameProfiler::Reset();
+        return true;
+    }
+
+    bool TestReplay() {
+        InputTrace::Trace trace;
+        trace.session.clientWidth = 1200;
+        trace.session.clientHeight = 800;
+        uint64_t time = 0;
+        for (int stroke = 0; stroke < 5; stroke++) {
+            InputTrace::Event down;
+            down.timeMicros = time += 1000;
+            down.type = InputTrace::EVENT_BUTTON_DOWN;
+            down.x = 100;
+            down.y = 200 + stroke * 40;
+            trace.events.push_back(down);
+            for (int i = 1; i <= 200; i++) {
+                InputTrace::Event move = down;
+                move.timeMicros = time += 1000;
+                move.type = InputTrace::EVENT_MOUSE_MOVE;
+                move.flags = InputTrace::FLAG_LBUTTON;
+                move.x = 100 + i * 2;
+                trace.events.push_back(move);
+            }
+            InputTrace::Event up = down;
+            up.timeMicros = time += 1000;
+            up.type = InputTrace::EVENT_BUTTON_UP;
+            trace.events.push_back(up);
+        }
+
+        InputTrace::ReplayStats stats = InputTrace::Replay(trace);
+        ASSERT_EQ(trace.events.size(), stats.events);
+        ASSERT_TRUE(stats.allocated.allocations > 0);
+        ASSERT_TRUE(stats.maxEventAllocations > 0);
+        ASSERT_TRUE(stats.all.allocationsPerEvent > 0.0);
+
+        // Moves append into amortized capacity; button up snapshots the document
+        ASSERT_TRUE(stats.byType[InputTrace::EVENT_MOUSE_MOVE].allocationsPerEvent < 0.1);
+        ASSERT_TRUE(stats.byType[InputTrace::EVENT_BUTTON_UP].allocationsPerEvent >= 1.0);
+        ResetDocument();
+        return true;
+    }
+
+    bool TestPaint() {
+        ResetDocument();
+        Generate(20000);
+        const int width = 640;
+        const int height = 480;
+        std::vector<uint32_t> canvas((size_t)width * height);
+        RasterRenderer::View view;
+        view.scale = 0.5;
+
+        // The first stamp on a thread allocates its brush mask cache, once
+        RasterRenderer::RenderRows(AppState::Instance().drawingPoints, view, width, 0, height,
+                                   RGB(255, 255, 255), canvas.data());
+
+        AllocStats::Scope scope;
+        RasterRenderer::RenderRows(AppState::Instance().drawingPoints, view, width, 0, height,
+                                   RGB(255, 255, 255), canvas.data());
+        ASSERT_EQ((uint64_t)0, scope.Elapsed().allocations);
+        ResetDocument();
+        return true;
+    }
+
+    bool TestShapes() {
+        ResetDocument();
+        AppState& app = AppState::Instance();
+        app.drawingPoints.reserve(100000);
+
+        AllocStats::Scope scope;
+        DrawingEngine::DrawCircle(500, 500, 300);
+        DrawingEngine::DrawLine(0, 0, 900, 400);
+        DrawingEngine::DrawRectangle(10, 10, 800, 600);
+        ASSERT_EQ((uint64_t)0, scope.Elapsed().allocations);
+        ASSERT_TRUE(app.drawingPoints.size() > 3000);
+        ResetDocument();
+        return true;
+    }
+
+    bool TestStrokes() {
+        ResetDocument();
+        AppState& app = AppState::Instance();
+
+        // The first stroke grows every buffer; the second must fit in them
+        for (int stroke = 0; stroke < 2; stroke++) {
+            app.drawingPoints.clear();
+            app.drawingPoints.reserve(4096);
+            DrawingEngine::StartDrawing(10, 10 + stroke);
+            AllocStats::Scope scope;
+            for (int i = 1; i < 2000; i++) {
+                DrawingEngine::ContinueDrawing(10 + i, 10 + stroke);
+            }
+            if (stroke == 1) {
+                ASSERT_EQ((uint64_t)0, scope.Elapsed().allocations);
+            }
+            DrawingEngine::EndDrawing();
+        }
+        ResetDocument();
+        return true;
+    }
+
+    bool TestBatchedMoves() {
+        ResetDocument();
+        AppState& app = AppState::Instance();
+        std::vector<DrawingEngine::StrokePoint> burst;
+        for (int i = 1; i <= 5000; i++) {
+            burst.push_back({i, i % 13});
+        }
+
+        // Full: one reserve for the whole burst
+        app.drawingPoints.shrink_to_fit();
+        DrawingEngine::StartDrawing(0, 0);
+        AllocStats::Scope scope;
+        ASSERT_EQ(burst.size(), DrawingEngine::ContinueDrawingBatch(burst.data(), burst.size()));
+        ASSERT_EQ((uint64_t)1, scope.Elapsed().allocations);
+        DrawingEngine::EndDrawing();
+
+        // Many small bursts still grow geometrically
+        ResetDocument();
+        app.drawingPoints.shrink_to_fit();
+        DrawingEngine::StartDrawing(0, 0);
+        AllocStats::Scope small;
+        for (size_t i = 0; i < burst.size(); i += 4) {
+            DrawingEngine::ContinueDrawingBatch(&burst[i], 4);
+        }
+        ASSERT_TRUE(small.Elapsed().allocations <= 16);
+        ASSERT_EQ((size_t)5001, app.drawingPoints.size());
+        DrawingEngine::EndDrawing();
+        ResetDocument();
+        return true;
+    }
+
+    bool TestLoad() {
+        ResetDocument();
+        Generate(100000);
+        const char* filename = "alloc_stats_test.mpsp";
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(filename));
+        ResetDocument();
+
+        // Growing point by point would reallocate ~17 times for 100k points
+        AllocStats::Scope scope;
+        ASSERT_TRUE(DrawingEngine::LoadDrawing(filename));
+        AllocStats::Counters counted = scope.Elapsed();
+        std::remove(filename);
+        ASSERT_EQ((size_t)100000, AppState::Instance().drawingPoints.size());
+        ASSERT_TRUE(counted.allocations <= 6);
+
+        // A count larger than the file fails without reserving for it
+        std::FILE* file = std::fopen(filename, "wb");
+        ASSERT_TRUE(file != nullptr);
+        uint32_t header[6] = {0x5053504D, 2, 0xFFFFFFFFu, 0, 0, 0};
+        std::fwrite(header, sizeof(header), 1, file);
+        std::fclose(file);
+        AllocStats::Scope corrupt;
+        ASSERT_FALSE(DrawingEngine::LoadDrawing(filename));
+        ASSERT_TRUE(corrupt.Elapsed().bytes < (1u << 20));
+        std::remove(filename);
+        ResetDocument();
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Allocation Tests" << std::endl;
+
+    // These tests count stored points; decimation has its own tests
+    AppState::Instance().strokeTolerance = 0.0;
+
+    AllocStatsTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
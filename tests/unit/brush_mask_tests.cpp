@@ -0,0 +1,224 @@
+#include "../test_framework.h"
+#include "../../include/brush_mask.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/raster_renderer.h"
+#include "../../include/app_state.h"
+#include <cstdlib>
+#include <vector>
+
+class BrushMaskTests {
+private:
+    TestFramework framework;
+
+public:
+    BrushMaskTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Brush Masks");
+        framework.AddTest("Coverage Falls Off At The Rim", [this]() { return TestCoverage(); });
+        framework.AddTest("Sub-Pixel Offsets Get Their Own Masks", [this]() { return TestSubpixel(); });
+        framework.AddTest("Cache Hits, Misses And Evictions", [this]() { return TestCache(); });
+        framework.AddTest("SIMD Blend Matches Scalar Blend", [this]() { return TestBlend(); });
+        framework.AddTest("Redrawing Reuses Every Mask", [this]() { return TestRender(); });
+        framework.AddTest("Screen Stamps Match Rendered Strokes", [this]() { return TestStamp(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static uint8_t At(const BrushMask::Mask& mask, int x, int y) {
+        return mask.coverage[(size_t)(y - mask.top) * mask.width + (x - mask.left)];
+    }
+
+    // Distinct small tips: eight sizes at a run of zooms
+    static const BrushMask::Mask* FindKey(size_t i) {
+        return BrushMask::Find(1 + (int)(i % 8), BrushMask::HARD, 1.0 + (double)(i / 8) / 64.0, 0.0, 0.0);
+    }
+
+    bool TestCoverage() {
+        ASSERT_EQ(255, (int)BrushMask::Coverage(0.0, 5.0, BrushMask::HARD));
+        ASSERT_EQ(255, (int)BrushMask::Coverage(4.5, 5.0, BrushMask::HARD));
+        ASSERT_EQ(128, (int)BrushMask::Coverage(5.0, 5.0, BrushMask::HARD));
+        ASSERT_EQ(0, (int)BrushMask::Coverage(5.5, 5.0, BrushMask::HARD));
+        ASSERT_TRUE(BrushMask::Coverage(3.0, 5.0, 0) < 255);   // Soft tips fade from further in
+        ASSERT_EQ(2.5, BrushMask::Radius(10, 0.5));
+        ASSERT_EQ(0.5, BrushMask::Radius(0, 1.0));
+
+        // A 10 pixel tip centred on a pixel: solid middle, nothing past the rim
+        BrushMask::Clear();
+        const BrushMask::Mask* mask = BrushMask::Find(10, BrushMask::HARD, 1.0, 0.0, 0.0);
+        ASSERT_TRUE(mask != nullptr);
+        ASSERT_TRUE(mask->width <= BrushMask::MAX_SIZE && mask->height <= BrushMask::MAX_SIZE);
+        ASSERT_EQ(255, (int)At(*mask, 0, 0));
+        ASSERT_EQ(255, (int)At(*mask, 4, 0));
+        for (int y = mask->top; y < mask->top + mask->height; y++) {
+            for (int x = mask->left; x < mask->left + mask->width; x++) {
+                double dx = x - 0.125, dy = y - 0.125;   // Centre of sub-pixel step 0
+                if (dx * dx + dy * dy >= 5.5 * 5.5) {
+                    ASSERT_EQ(0, (int)At(*mask, x, y));
+                }
+            }
+        }
+
+        // Tips wider than a cached mask fill analytically instead
+        ASSERT_TRUE(BrushMask::Find(40, BrushMask::HARD, 1.0, 0.0, 0.0) == nullptr);
+        ASSERT_TRUE(BrushMask::Find(20, BrushMask::HARD, 2.0, 0.0, 0.0) == nullptr);
+        ASSERT_TRUE(BrushMask::Find(20, BrushMask::HARD, 1.0, 0.0, 0.0) != nullptr);
+        return true;
+    }
+
+    bool TestSubpixel() {
+        BrushMask::Clear();
+        const BrushMask::Mask* left = BrushMask::Find(5, BrushMask::HARD, 1.0, 0.1, 0.5);
+        std::vector<uint8_t> first(left->coverage, left->coverage + (size_t)left->width * left->height);
+        const BrushMask::Mask* right = BrushMask::Find(5, BrushMask::HARD, 1.0, 0.9, 0.5);
+        ASSERT_EQ((uint64_t)2, BrushMask::GetStats().misses);
+        ASSERT_TRUE(first != std::vector<uint8_t>(right->coverage, right->coverage + (size_t)right->width * right->height));
+
+        // Offsets within one step share a mask, as do zooms that match exactly
+        BrushMask::Find(5, BrushMask::HARD, 1.0, 0.2, 0.6);
+        ASSERT_EQ((uint64_t)1, BrushMask::GetStats().hits);
+        BrushMask::Find(5, BrushMask::HARD, 0.5, 0.1, 0.5);
+        BrushMask::Find(5, 50, 1.0, 0.1, 0.5);
+        ASSERT_EQ((uint64_t)4, BrushMask::GetStats().misses);
+        return true;
+    }
+
+    bool TestCache() {
+        BrushMask::Clear();
+        const size_t keys = BrushMask::CAPACITY + 40;
+        for (size_t i = 0; i < keys; i++) {
+            FindKey(i);
+        }
+        BrushMask::Stats stats = BrushMask::GetStats();
+        ASSERT_EQ((uint64_t)keys, stats.misses);
+        ASSERT_EQ((uint64_t)0, stats.hits);
+        ASSERT_EQ((uint64_t)40, stats.evictions);
+        ASSERT_EQ(BrushMask::CAPACITY, stats.masks);
+
+        // The newest keys are still cached; the oldest were evicted
+        ASSERT_TRUE(FindKey(keys - 1) != nullptr);
+        ASSERT_EQ((uint64_t)1, BrushMask::GetStats().hits);
+        FindKey(0);
+        ASSERT_EQ((uint64_t)keys + 1, BrushMask::GetStats().misses);
+
+        BrushMask::Clear();
+        ASSERT_EQ((size_t)0, BrushMask::GetStats().masks);
+        BrushMask::Find(1, BrushMask::HARD, 1.0, 0.0, 0.0);
+        ASSERT_EQ((uint64_t)1, BrushMask::GetStats().misses);
+        return true;
+    }
+
+    bool TestBlend() {
+        // Odd lengths exercise the scalar tail; runs of 0 and 255 the shortcuts
+        std::srand(47);
+        for (int round = 0; round < 200; round++) {
+            int count = 1 + std::rand() % 37;
+            std::vector<uint32_t> row((size_t)count);
+            std::vector<uint8_t> coverage((size_t)count);
+            for (int i = 0; i < count; i++) {
+                row[i] = ((uint32_t)std::rand() << 16) ^ (uint32_t)std::rand();
+                int kind = std::rand() % 4;
+                coverage[i] = (uint8_t)(kind == 0 ? 0 : kind == 1 ? 255 : std::rand() % 256);
+            }
+            uint32_t pixel = ((uint32_t)std::rand() << 16) ^ (uint32_t)std::rand();
+            std::vector<uint32_t> reference = row;
+            BrushMask::BlendRowScalar(reference.data(), coverage.data(), count, pixel);
+            BrushMask::BlendRow(row.data(), coverage.data(), count, pixel);
+            ASSERT_TRUE(reference == row);
+        }
+
+        // Half coverage lands halfway, in every channel
+        uint32_t pixel = 0x00000000u;
+        uint8_t half = 128;
+        BrushMask::BlendRow(&pixel, &half, 1, 0xFFFFFFFFu);
+        ASSERT_EQ(0x80808080u, pixel);
+        return true;
+    }
+
+    bool TestRender() {
+        AppState& app = AppState::Instance();
+        app.drawingPoints.clear();
+        app.undoStack.clear();
+        app.redoStack.clear();
+        app.isDrawing = false;
+        app.currentTool = TOOL_BRUSH;
+        app.currentColor = RGB(20, 40, 200);
+        app.brushSize = 9;
+        app.strokeTolerance = 0.0;
+        DrawingEngine::StartDrawing(10, 10);
+        for (int i = 1; i <= 60; i++) {
+            DrawingEngine::ContinueDrawing(10 + i * 3, 10 + (i * i) % 50);
+        }
+        DrawingEngine::EndDrawing();
+
+        const int width = 200, height = 70;
+        std::vector<uint32_t> first((size_t)width * height), second((size_t)width * height);
+        BrushMask::Clear();
+        RasterRenderer::RenderRows(app.drawingPoints, RasterRenderer::View(), width, 0, height, RGB(255, 255, 255), first.data());
+        BrushMask::Stats cold = BrushMask::GetStats();
+        ASSERT_TRUE(cold.misses > 0);
+        ASSERT_TRUE(cold.misses <= (uint64_t)(BrushMask::SUBPIXEL_STEPS * BrushMask::SUBPIXEL_STEPS));
+        RasterRenderer::RenderRows(app.drawingPoints, RasterRenderer::View(), width, 0, height, RGB(255, 255, 255), second.data());
+        BrushMask::Stats warm = BrushMask::GetStats();
+        ASSERT_EQ(cold.misses, warm.misses);
+        ASSERT_TRUE(warm.hits > cold.hits);
+        ASSERT_TRUE(first == second);
+
+        // The rim is anti-aliased: some pixels are neither paper nor paint
+        size_t partial = 0;
+        for (uint32_t pixel : first) {
+            partial += (pixel != 0xFFFFFFFFu && (pixel & 0xFFFFFFu) != (uint32_t)RGB(20, 40, 200)) ? 1 : 0;
+        }
+        ASSERT_TRUE(partial > 0);
+
+        app.drawingPoints.clear();
+        app.brushSize = 5;
+        return true;
+    }
+
+    bool TestStamp() {
+        DrawPoint dot = {};
+        dot.x = 21;
+        dot.y = 17;
+        dot.color = RGB(200, 30, 60);
+        dot.brushSize = 12;
+        dot.isStart = true;
+        dot.toolType = TOOL_BRUSH;
+        std::vector<DrawPoint> points(1, dot);
+
+        const int width = 40, height = 36;
+        RasterRenderer::View view;
+        view.scale = 1.5;
+        std::vector<uint32_t> rendered((size_t)width * height), stamped((size_t)width * height, 0xFFFFFFFFu);
+        RasterRenderer::RenderRows(points, view, width, 0, height, RGB(255, 255, 255), rendered.data());
+        RasterRenderer::StampBrush(stamped.data(), width, height, dot.x * view.scale, dot.y * view.scale,
+                                   dot.brushSize, view.scale, RasterRenderer::ToPixel(dot.color));
+        ASSERT_TRUE(rendered == stamped);
+
+        // Stamps hanging off the image are clipped, not wrapped
+        std::vector<uint32_t> edge((size_t)width * height, 0xFFFFFFFFu);
+        RasterRenderer::StampBrush(edge.data(), width, height, -2.0, height + 1.0, 30, 1.0, 0xFF000000u);
+        ASSERT_TRUE(edge[(size_t)(height - 1) * width] != 0xFFFFFFFFu);
+        ASSERT_EQ(0xFFFFFFFFu, edge[(size_t)(height - 1) * width + width - 1]);
+        ASSERT_EQ(0xFFFFFFFFu, edge[0]);
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Brush Mask Tests" << std::endl;
+
+    BrushMaskTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
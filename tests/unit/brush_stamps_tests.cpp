@@ -0,0 +1,177 @@
+#include "../test_framework.h"
+#include "../../include/brush_stamps.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/raster_renderer.h"
+#include "../../include/app_state.h"
+#include <algorithm>
+#include <vector>
+
+class BrushStampsTests {
+private:
+    TestFramework framework;
+
+public:
+    BrushStampsTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Brush Stamps");
+        framework.AddTest("Spacing Follows The Diameter", [this]() { return TestSpacing(); });
+        framework.AddTest("Stamps Ignore Input Density", [this]() { return TestDensity(); });
+        framework.AddTest("Slow Strokes Stamp Sparsely", [this]() { return TestSlow(); });
+        framework.AddTest("Fast Strokes Leave No Gaps", [this]() { return TestFast(); });
+        framework.AddTest("Band Index Carries The Spacing", [this]() { return TestIndex(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static const uint32_t WHITE = 0xFFFFFFFFu;
+
+    // Every position kept, so input density reaches the renderers unchanged
+    static void ResetDocument(int brushSize) {
+        AppState& app = AppState::Instance();
+        app.drawingPoints.clear();
+        app.undoStack.clear();
+        app.redoStack.clear();
+        app.isDrawing = false;
+        app.currentTool = TOOL_BRUSH;
+        app.currentColor = RGB(0, 0, 0);
+        app.brushSize = brushSize;
+        app.strokeTolerance = 0.0;
+    }
+
+    static void DrawStraight(int fromX, int toX, int y, int step) {
+        DrawingEngine::StartDrawing(fromX, y);
+        for (int x = fromX + step; x <= toX; x += step) {
+            DrawingEngine::ContinueDrawing(x, y);
+        }
+        DrawingEngine::EndDrawing();
+    }
+
+    static std::vector<uint32_t> Render(int width, int height) {
+        std::vector<uint32_t> pixels((size_t)width * height);
+        RasterRenderer::RenderRows(AppState::Instance().drawingPoints, RasterRenderer::View(), width, 0, height,
+                                   RGB(255, 255, 255), pixels.data());
+        return pixels;
+    }
+
+    bool TestSpacing() {
+        ASSERT_EQ(5.0, BrushStamps::Spacing(20));
+        ASSERT_EQ(1.25, BrushStamps::Spacing(5));
+        ASSERT_EQ(0.5, BrushStamps::Spacing(1));   // Hairlines stop at the minimum
+        ASSERT_EQ(0.5, BrushStamps::Spacing(0));
+
+        // Distance carries across segments: 3 + 3 stamps at 2, 4, 6 then 8, 10, 12
+        std::vector<double> along;
+        double carried = BrushStamps::WalkSegment(0, 0, 7, 0, 2.0, 0.0, [&](double x, double) { along.push_back(x); });
+        ASSERT_EQ(1.0, carried);
+        carried = BrushStamps::WalkSegment(7, 0, 12, 0, 2.0, carried, [&](double x, double) { along.push_back(x); });
+        ASSERT_EQ(0.0, carried);
+        ASSERT_EQ((size_t)6, along.size());
+        ASSERT_EQ(8.0, along[3]);
+        ASSERT_EQ(12.0, along[5]);
+        return true;
+    }
+
+    bool TestDensity() {
+        // 200 pixels at spacing 2: the start plus one stamp every 2 pixels,
+        // whether the pointer reported every pixel or every 50
+        ResetDocument(8);
+        DrawStraight(100, 300, 50, 1);
+        ASSERT_EQ((size_t)201, AppState::Instance().drawingPoints.size());
+        ASSERT_EQ((size_t)101, DrawingEngine::LastStrokeStamps());
+
+        ResetDocument(8);
+        DrawStraight(100, 300, 50, 50);
+        ASSERT_EQ((size_t)5, AppState::Instance().drawingPoints.size());
+        ASSERT_EQ((size_t)101, DrawingEngine::LastStrokeStamps());
+        ASSERT_EQ((size_t)101, BrushStamps::StrokeStamps(AppState::Instance().drawingPoints, 0));
+
+        // A stroke that ends between stamps still reaches its last point
+        ResetDocument(8);
+        DrawStraight(100, 103, 50, 1);
+        ASSERT_EQ((size_t)3, DrawingEngine::LastStrokeStamps());
+        ResetDocument(5);
+        return true;
+    }
+
+    bool TestSlow() {
+        // A wide brush dragged a pixel at a time: one stamp per 5 pixels, not per point
+        ResetDocument(20);
+        DrawStraight(50, 450, 100, 1);
+        std::vector<DrawPoint>& points = AppState::Instance().drawingPoints;
+        ASSERT_EQ((size_t)401, points.size());
+        ASSERT_EQ((size_t)81, DrawingEngine::LastStrokeStamps());
+
+        // Earlier strokes are measured from their start point
+        DrawStraight(50, 60, 200, 10);
+        ASSERT_EQ((size_t)3, DrawingEngine::LastStrokeStamps());
+        ASSERT_EQ((size_t)81, BrushStamps::StrokeStamps(points, 0));
+        ASSERT_EQ((size_t)0, BrushStamps::StrokeStamps(points, points.size()));
+        ResetDocument(5);
+        return true;
+    }
+
+    bool TestFast() {
+        // Two positions 300 pixels apart paint a solid band, end to end
+        ResetDocument(6);
+        DrawStraight(20, 320, 20, 300);
+        ASSERT_EQ((size_t)2, AppState::Instance().drawingPoints.size());
+        const int width = 340, height = 40;
+        std::vector<uint32_t> pixels = Render(width, height);
+        for (int x = 20; x <= 320; x++) {
+            for (int y = 18; y <= 22; y++) {
+                ASSERT_TRUE(pixels[(size_t)y * width + x] != WHITE);
+            }
+            ASSERT_EQ(WHITE, pixels[(size_t)14 * width + x]);
+            ASSERT_EQ(WHITE, pixels[(size_t)26 * width + x]);
+        }
+        ASSERT_EQ(WHITE, pixels[(size_t)20 * width + 16]);
+        ASSERT_EQ(WHITE, pixels[(size_t)20 * width + 324]);
+        ResetDocument(5);
+        return true;
+    }
+
+    bool TestIndex() {
+        // Strokes whose segments straddle bands and end between stamps: every
+        // band must pick up the spacing where the walk from the start left it
+        ResetDocument(7);
+        DrawingEngine::StartDrawing(10, 10);
+        DrawingEngine::ContinueDrawing(13, 90);
+        DrawingEngine::ContinueDrawing(71, 95);
+        DrawingEngine::ContinueDrawing(74, 170);
+        DrawingEngine::EndDrawing();
+        DrawingEngine::SetColor(RGB(200, 30, 30));
+        DrawStraight(5, 98, 60, 7);
+        DrawingEngine::DrawRectangle(40, 40, 60, 150);
+
+        const int width = 100, height = 180;
+        std::vector<uint32_t> expected = Render(width, height);
+        RasterRenderer::SceneIndex scene(AppState::Instance().drawingPoints, RasterRenderer::View(), height);
+        std::vector<uint32_t> banded((size_t)width * height);
+        for (int row = 0; row < height; row += 13) {
+            int rows = std::min(13, height - row);
+            scene.RenderRows(width, row, rows, RGB(255, 255, 255), banded.data() + (size_t)row * width);
+        }
+        ASSERT_TRUE(expected == banded);
+        ResetDocument(5);
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Brush Stamps Tests" << std::endl;
+
+    BrushStampsTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
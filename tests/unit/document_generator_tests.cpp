@@ -0,0 +1,257 @@
+#include "../test_framework.h"
+#include "../../include/document_generator.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/app_state.h"
+#include <cstdio>
+#include <set>
+
+class DocumentGeneratorTests {
+private:
+    TestFramework framework;
+
+public:
+    DocumentGeneratorTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Document Generator");
+        framework.AddTest("Same Seed Gives Same Document", [this]() { return TestDeterministic(); });
+        framework.AddTest("Point And Stroke Limits", [this]() { return TestLimits(); });
+        framework.AddTest("Brushes, Colors And Canvas Bounds", [this]() { return TestRanges(); });
+        framework.AddTest("Shape Mix Uses Engine Rasterizers", [this]() { return TestShapeMix(); });
+        framework.AddTest("Clustering Concentrates Strokes", [this]() { return TestClustering(); });
+        framework.AddTest("Application State Is Left Alone", [this]() { return TestStatePreserved(); });
+        framework.AddTest("Saved Documents Load Back", [this]() { return TestSaveLoad(); });
+
+        TestFramework::BenchmarkOptions options;
+        options.unitsPerIteration = BENCH_POINTS;
+        options.unit = "points";
+        options.maxTotalMs = 300.0;
+        framework.AddBenchmark("Generation Throughput", [this](size_t iterations) { return BenchGenerate(iterations); }, options);
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static bool SamePoints(const std::vector<DrawPoint>& a, const std::vector<DrawPoint>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].color != b[i].color || a[i].isStart != b[i].isStart ||
+                a[i].brushSize != b[i].brushSize || a[i].toolType != b[i].toolType) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Mean distance of the points from their centroid
+    static double Spread(const std::vector<DrawPoint>& points) {
+        double cx = 0.0, cy = 0.0;
+        for (const DrawPoint& p : points) { cx += p.x; cy += p.y; }
+        cx /= points.size();
+        cy /= points.size();
+        double total = 0.0;
+        for (const DrawPoint& p : points) total += std::sqrt((p.x - cx) * (p.x - cx) + (p.y - cy) * (p.y - cy));
+        return total / points.size();
+    }
+
+    static const size_t BENCH_POINTS = 100000;
+
+    bool BenchGenerate(size_t iterations) {
+        DocumentGenerator::Params params;
+        params.points = BENCH_POINTS;
+        std::vector<DrawPoint> points;
+        for (size_t i = 0; i < iterations; i++) {
+            params.seed = i + 1;
+            ASSERT_EQ(BENCH_POINTS, DocumentGenerator::Generate(params, points).points);
+        }
+        return true;
+    }
+
+    bool TestDeterministic() {
+        DocumentGenerator::Params params;
+        params.points = 50000;
+        std::vector<DrawPoint> first, second, other;
+        DocumentGenerator::Generate(params, first);
+        DocumentGenerator::Generate(params, second);
+        params.seed = 2;
+        DocumentGenerator::Generate(params, other);
+
+        ASSERT_TRUE(SamePoints(first, second));
+        ASSERT_FALSE(SamePoints(first, other));
+        return true;
+    }
+
+    bool TestLimits() {
+        DocumentGenerator::Params params;
+        params.points = 12345;
+        std::vector<DrawPoint> points;
+        DocumentGenerator::Stats stats = DocumentGenerator::Generate(params, points);
+        ASSERT_EQ((size_t)12345, points.size());
+        ASSERT_EQ((size_t)12345, stats.points);
+        ASSERT_TRUE(points.front().isStart);
+
+        // Stroke count alone decides the size; both together stop at whichever comes first
+        params.points = 0;
+        params.strokes = 40;
+        stats = DocumentGenerator::Generate(params, points);
+        ASSERT_EQ((size_t)40, stats.strokes);
+        ASSERT_EQ(points.size(), stats.points);
+        ASSERT_TRUE(points.size() > 40);
+
+        params.points = 100;
+        params.strokes = 1000;
+        stats = DocumentGenerator::Generate(params, points);
+        ASSERT_EQ((size_t)100, points.size());
+        ASSERT_TRUE(stats.strokes < 1000);
+
+        params.points = 0;
+        params.strokes = 0;
+        stats = DocumentGenerator::Generate(params, points);
+        ASSERT_TRUE(points.empty());
+        return true;
+    }
+
+    bool TestRanges() {
+        DocumentGenerator::Params params;
+        params.points = 200000;
+        params.minBrushSize = 3;
+        params.maxBrushSize = 12;
+        params.colors = 5;
+        params.canvasWidth = 800;
+        params.canvasHeight = 600;
+        std::vector<DrawPoint> points;
+        DocumentGenerator::Generate(params, points);
+
+        std::set<COLORREF> colors;
+        std::set<int> sizes;
+        for (const DrawPoint& p : points) {
+            ASSERT_TRUE(p.x >= 0 && p.x < 800 && p.y >= 0 && p.y < 600);
+            ASSERT_TRUE(p.brushSize >= 3 && p.brushSize <= 12);
+            colors.insert(p.color);
+            sizes.insert(p.brushSize);
+        }
+        ASSERT_TRUE(colors.size() <= 5);
+        ASSERT_TRUE(colors.size() >= 3);
+        ASSERT_EQ((size_t)10, sizes.size());
+        return true;
+    }
+
+    bool TestShapeMix() {
+        DocumentGenerator::Params params;
+        params.points = 0;
+        params.strokes = 30;
+        params.shapeWeights[DocumentGenerator::SHAPE_BRUSH] = 0.0;
+        params.shapeWeights[DocumentGenerator::SHAPE_LINE] = 1.0;
+        params.shapeWeights[DocumentGenerator::SHAPE_RECTANGLE] = 0.0;
+        params.shapeWeights[DocumentGenerator::SHAPE_CIRCLE] = 0.0;
+        std::vector<DrawPoint> points;
+        DocumentGenerator::Stats stats = DocumentGenerator::Generate(params, points);
+        ASSERT_EQ((size_t)30, stats.byKind[DocumentGenerator::SHAPE_LINE]);
+        size_t starts = 0;
+        for (const DrawPoint& p : points) {
+            ASSERT_EQ(TOOL_LINE, p.toolType);
+            if (p.isStart) starts++;
+        }
+        ASSERT_EQ((size_t)30, starts);
+
+        // Every generated line is exactly what DrawLine produces for its end points
+        AppState& app = AppState::Instance();
+        app.drawingPoints.clear();
+        size_t end = 1;
+        while (end < points.size() && !points[end].isStart) end++;
+        app.currentColor = points[0].color;
+        app.brushSize = points[0].brushSize;
+        DrawingEngine::DrawLine(points[0].x, points[0].y, points[end - 1].x, points[end - 1].y);
+        ASSERT_TRUE(SamePoints(std::vector<DrawPoint>(points.begin(), points.begin() + end), app.drawingPoints));
+        app.drawingPoints.clear();
+
+        // The default mix is mostly brush strokes with some of each shape
+        DocumentGenerator::Params mixed;
+        mixed.points = 0;
+        mixed.strokes = 4000;
+        stats = DocumentGenerator::Generate(mixed, points);
+        ASSERT_TRUE(stats.byKind[DocumentGenerator::SHAPE_BRUSH] > 3200);
+        for (int kind = DocumentGenerator::SHAPE_LINE; kind < DocumentGenerator::SHAPE_KIND_COUNT; kind++) {
+            ASSERT_TRUE(stats.byKind[kind] > 100 && stats.byKind[kind] < 300);
+        }
+        return true;
+    }
+
+    bool TestClustering() {
+        DocumentGenerator::Params params;
+        params.points = 100000;
+        params.clusters = 0;
+        std::vector<DrawPoint> uniform, clustered;
+        DocumentGenerator::Generate(params, uniform);
+        params.clusters = 1;
+        params.clusterSpread = 100.0;
+        DocumentGenerator::Generate(params, clustered);
+
+        ASSERT_TRUE(Spread(clustered) * 3 < Spread(uniform));
+        return true;
+    }
+
+    bool TestStatePreserved() {
+        AppState& app = AppState::Instance();
+        app.drawingPoints.assign(3, { 1, 2, RGB(3, 4, 5), true, 6, TOOL_BRUSH });
+        app.currentColor = RGB(9, 8, 7);
+        app.brushSize = 11;
+
+        DocumentGenerator::Params params;
+        params.points = 5000;
+        params.shapeWeights[DocumentGenerator::SHAPE_CIRCLE] = 1.0;
+        std::vector<DrawPoint> points;
+        DocumentGenerator::Generate(params, points);
+
+        ASSERT_EQ((size_t)5000, points.size());
+        ASSERT_EQ((size_t)3, app.drawingPoints.size());
+        ASSERT_EQ(RGB(9, 8, 7), app.currentColor);
+        ASSERT_EQ(11, app.brushSize);
+
+        // Generating straight into the document replaces it
+        DocumentGenerator::Generate(params, app.drawingPoints);
+        ASSERT_TRUE(SamePoints(points, app.drawingPoints));
+        ASSERT_EQ(11, app.brushSize);
+
+        app.drawingPoints.clear();
+        app.currentColor = RGB(0, 0, 0);
+        app.brushSize = 5;
+        return true;
+    }
+
+    bool TestSaveLoad() {
+        AppState& app = AppState::Instance();
+        DocumentGenerator::Params params;
+        params.points = 30000;
+        DocumentGenerator::Generate(params, app.drawingPoints);
+        std::vector<DrawPoint> generated = app.drawingPoints;
+
+        const char* filename = "generator_test.mpsp";
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(filename));
+        app.drawingPoints.clear();
+        ASSERT_TRUE(DrawingEngine::LoadDrawing(filename));
+        ASSERT_TRUE(SamePoints(generated, app.drawingPoints));
+
+        std::remove(filename);
+        app.drawingPoints.clear();
+        app.undoStack.clear();
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Document Generator Tests" << std::endl;
+
+    DocumentGeneratorTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
@@ -0,0 +1,419 @@
+#include "../test_framework.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/document_journal.h"
+#include "../../include/document_version.h"
+#include "../../include/app_state.h"
+#include "../../include/config.h"
+#include <cstdio>
+
+// Document journal tests - these link the real drawing engine and journal
+class DocumentJournalTests {
+private:
+    TestFramework framework;
+
+public:
+    DocumentJournalTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Native File Format");
+        framework.AddTest("v2 Save/Load Round Trip", [this]() { return TestSaveLoadRoundTrip(); });
+        framework.AddTest("Save Bumps Generation", [this]() { return TestSaveBumpsGeneration(); });
+        framework.AddTest("New Canvas Leaves The Open File Intact", [this]() { return TestNewKeepsOpenFile(); });
+        framework.AddTest("Only Explicit Saves Write The Document", [this]() { return TestOnlySavesWriteFile(); });
+        framework.AddTest("Worker Save Journals Edits Made Meanwhile", [this]() { return TestWorkerSave(); });
+        framework.AddTest("Worker Open Swaps In On Finish", [this]() { return TestWorkerOpen(); });
+        framework.AddTest("Cancelled Save And Load Leave No Trace", [this]() { return TestCancelledFileJobs(); });
+
+        framework.AddSuite("Document Journal");
+        framework.AddTest("Replay Strokes, Shapes and Erases", [this]() { return TestReplayOperations(); });
+        framework.AddTest("Replay Undo/Redo", [this]() { return TestReplayUndoRedo(); });
+        framework.AddTest("Torn Tail Is Ignored", [this]() { return TestTornTail(); });
+        framework.AddTest("Compaction Supersedes Journal", [this]() { return TestCompaction(); });
+        framework.AddTest("Journal Grows With Work Done", [this]() { return TestIncrementalCost(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static void ResetApp() {
+        AppState& app = AppState::Instance();
+        DocumentJournal::Detach(true);
+        app.drawingPoints.clear();
+        app.undoStack.clear();
+        app.redoStack.clear();
+        app.documentGeneration = 0;
+        app.documentPath.clear();
+        app.isDrawing = false;
+        app.currentTool = TOOL_BRUSH;
+        app.brushSize = 5;
+        std::remove(AUTOSAVE_DOCUMENT);
+        std::remove(DocumentJournal::JournalPathFor(AUTOSAVE_DOCUMENT).c_str());
+    }
+
+    static void DrawStroke(int x, int y, int length) {
+        DrawingEngine::SetTool(TOOL_BRUSH);
+        DrawingEngine::StartDrawing(x, y);
+        for (int i = 1; i <= length; i++) {
+            DrawingEngine::ContinueDrawing(x + i, y + i / 2);
+        }
+        DrawingEngine::EndDrawing();
+    }
+
+    static bool SamePoints(const std::vector<DrawPoint>& a, const std::vector<DrawPoint>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].color != b[i].color ||
+                a[i].isStart != b[i].isStart || a[i].brushSize != b[i].brushSize ||
+                a[i].toolType != b[i].toolType) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool FileExists(const std::string& path) {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (file) {
+            std::fclose(file);
+        }
+        return file != nullptr;
+    }
+
+    // Simulates a crash: the process state is lost but files stay on disk
+    static size_t CrashAndRecover() {
+        AppState& app = AppState::Instance();
+        DocumentJournal::Detach(false);
+        app.drawingPoints.clear();
+        app.documentGeneration = 0;
+
+        size_t recovered = 0;
+        DocumentJournal::OpenDocument(AUTOSAVE_DOCUMENT, &recovered);
+        return recovered;
+    }
+
+    bool TestSaveLoadRoundTrip() {
+        ResetApp();
+        AppState& app = AppState::Instance();
+        const char* filename = "journal_test_roundtrip.mpsp";
+
+        DrawStroke(10, 20, 40);
+        DrawingEngine::SetColor(RGB(10, 200, 30));
+        DrawingEngine::DrawRectangle(0, 0, 30, 15);
+        std::vector<DrawPoint> expected = app.drawingPoints;
+
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(filename));
+        app.drawingPoints.clear();
+        ASSERT_TRUE(DrawingEngine::LoadDrawing(filename));
+        ASSERT_TRUE(SamePoints(expected, app.drawingPoints));
+
+        std::remove(filename);
+        return true;
+    }
+
+    bool TestSaveBumpsGeneration() {
+        ResetApp();
+        AppState& app = AppState::Instance();
+        const char* filename = "journal_test_generation.mpsp";
+
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(filename));
+        uint64_t first = app.documentGeneration;
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(filename));
+        ASSERT_EQ(first + 1, app.documentGeneration);
+
+        app.documentGeneration = 0;
+        ASSERT_TRUE(DrawingEngine::LoadDrawing(filename));
+        ASSERT_EQ(first + 1, app.documentGeneration);
+
+        std::remove(filename);
+        return true;
+    }
+
+    bool TestNewKeepsOpenFile() {
+        // Open a saved file, draw on it, start a new canvas and quit
+        ResetApp();
+        AppState& app = AppState::Instance();
+        const char* filename = "journal_test_new.mpsp";
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+        DrawStroke(10, 10, 50);
+        ASSERT_TRUE(DocumentJournal::SaveDocument(filename));
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+
+        ASSERT_TRUE(DocumentJournal::OpenDocument(filename));
+        DrawStroke(100, 10, 20);
+        std::vector<DrawPoint> expected = app.drawingPoints;
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+        ASSERT_TRUE(app.drawingPoints.empty());
+        ASSERT_EQ(std::string(AUTOSAVE_DOCUMENT), app.documentPath);
+        DrawStroke(5, 5, 10);
+        DocumentJournal::CloseDocument();
+
+        // Reopening the file gives what was drawn on it, none of the new canvas
+        ASSERT_TRUE(DocumentJournal::OpenDocument(filename));
+        ASSERT_TRUE(SamePoints(expected, app.drawingPoints));
+
+        DocumentJournal::Detach(true);
+        std::remove(filename);
+        std::remove(DocumentJournal::SnapshotPathFor(filename).c_str());
+        ResetApp();
+        return true;
+    }
+
+    bool TestOnlySavesWriteFile() {
+        ResetApp();
+        AppState& app = AppState::Instance();
+        const char* filename = "journal_test_explicit.mpsp";
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+        DrawStroke(10, 10, 50);
+        ASSERT_TRUE(DocumentJournal::SaveDocument(filename));
+        std::vector<DrawPoint> saved = app.drawingPoints;
+
+        // Compaction and a clean exit keep unsaved work out of the file
+        DrawStroke(100, 10, 20);
+        ASSERT_TRUE(DocumentJournal::Compact());
+        DrawingEngine::ClearCanvas();
+        DocumentJournal::CloseDocument();
+        ASSERT_TRUE(DrawingEngine::LoadDrawing(filename));
+        ASSERT_TRUE(SamePoints(saved, app.drawingPoints));
+
+        // ...but it comes back when the document is opened
+        size_t recovered = 0;
+        ASSERT_TRUE(DocumentJournal::OpenDocument(filename, &recovered));
+        ASSERT_EQ((size_t)1, recovered);
+        ASSERT_TRUE(app.drawingPoints.empty());
+
+        // Saving writes it and supersedes the snapshot
+        DrawStroke(30, 30, 10);
+        std::vector<DrawPoint> expected = app.drawingPoints;
+        ASSERT_TRUE(DocumentJournal::SaveDocument(filename));
+        ASSERT_FALSE(FileExists(DocumentJournal::SnapshotPathFor(filename)));
+        DocumentJournal::CloseDocument();
+        ASSERT_TRUE(DrawingEngine::LoadDrawing(filename));
+        ASSERT_TRUE(SamePoints(expected, app.drawingPoints));
+
+        std::remove(filename);
+        std::remove(DocumentJournal::JournalPathFor(filename).c_str());
+        ResetApp();
+        return true;
+    }
+
+    bool TestWorkerSave() {
+        ResetApp();
+        AppState& app = AppState::Instance();
+        const char* filename = "journal_test_worker_save.mpsp";
+        const std::string savedPath = std::string(filename) + ".saving";
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+        DrawingEngine::DrawRectangle(0, 0, 30, 15);
+        ASSERT_TRUE(DocumentJournal::SaveDocument(filename));
+        DrawStroke(60, 10, 40);
+
+        // The worker writes the pinned version while editing and an autosave
+        // compaction of the same file carry on
+        DocumentVersion::Points pinned = DocumentVersion::Build(app.drawingPoints);
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(pinned, savedPath, nullptr));
+        app.drawingPoints.erase(app.drawingPoints.begin() + 5, app.drawingPoints.begin() + 10);
+        DrawStroke(100, 50, 30);
+        ASSERT_TRUE(DocumentJournal::Compact());
+        uint64_t compacted = app.documentGeneration;
+        std::vector<DrawPoint> expected = app.drawingPoints;
+
+        ASSERT_TRUE(DocumentJournal::FinishSave(savedPath, filename, pinned));
+        ASSERT_FALSE(FileExists(savedPath));
+        ASSERT_EQ(std::string(filename), app.documentPath);
+        ASSERT_TRUE(app.documentGeneration > compacted);
+
+        // After a crash the saved file and its journal give the edited document
+        DocumentJournal::Detach(false);
+        app.drawingPoints.clear();
+        size_t recovered = 0;
+        ASSERT_TRUE(DocumentJournal::OpenDocument(filename, &recovered));
+        ASSERT_TRUE(recovered > 0);
+        ASSERT_TRUE(SamePoints(expected, app.drawingPoints));
+
+        DocumentJournal::CloseDocument();
+        std::remove(filename);
+        std::remove(DocumentJournal::JournalPathFor(filename).c_str());
+        std::remove(DocumentJournal::SnapshotPathFor(filename).c_str());
+        ResetApp();
+        return true;
+    }
+
+    bool TestWorkerOpen() {
+        ResetApp();
+        AppState& app = AppState::Instance();
+        const char* filename = "journal_test_worker_open.mpsp";
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+        DrawStroke(10, 10, 30);
+        ASSERT_TRUE(DocumentJournal::SaveDocument(filename));
+        std::vector<DrawPoint> saved = app.drawingPoints;
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+        DrawStroke(200, 200, 10);
+        std::vector<DrawPoint> untitled = app.drawingPoints;
+
+        // Reading touches nothing the open document uses
+        std::vector<DrawPoint> points;
+        uint64_t generation = 0;
+        size_t recovered = 0;
+        int reports = 0;
+        ASSERT_TRUE(DocumentJournal::ReadDocument(filename, points, generation, &recovered,
+                                                  [&reports](double) { reports++; return true; }));
+        ASSERT_TRUE(reports > 0);
+        ASSERT_EQ((size_t)0, recovered);
+        ASSERT_TRUE(SamePoints(untitled, app.drawingPoints));
+        ASSERT_EQ(std::string(AUTOSAVE_DOCUMENT), app.documentPath);
+
+        ASSERT_TRUE(DocumentJournal::FinishOpen(filename, points, generation, recovered));
+        ASSERT_TRUE(SamePoints(saved, app.drawingPoints));
+        ASSERT_EQ(std::string(filename), app.documentPath);
+        ASSERT_TRUE(DocumentJournal::IsAttached());
+
+        DocumentJournal::CloseDocument();
+        std::remove(filename);
+        std::remove(DocumentJournal::JournalPathFor(filename).c_str());
+        std::remove(DocumentJournal::SnapshotPathFor(filename).c_str());
+        ResetApp();
+        return true;
+    }
+
+    bool TestCancelledFileJobs() {
+        ResetApp();
+        AppState& app = AppState::Instance();
+        const char* filename = "journal_test_cancelled.mpsp";
+        for (int i = 0; i < 100; i++) {
+            DrawStroke(i, i, 100);
+        }
+        DocumentVersion::Points pinned = DocumentVersion::Build(app.drawingPoints);
+        auto cancel = [](double) { return false; };
+
+        ASSERT_FALSE(DrawingEngine::SaveDrawing(pinned, filename, cancel));
+        ASSERT_FALSE(FileExists(filename));
+
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(pinned, filename, nullptr));
+        std::vector<DrawPoint> points;
+        uint64_t generation = 0;
+        ASSERT_FALSE(DrawingEngine::LoadDrawing(filename, points, generation, cancel));
+        ASSERT_FALSE(DocumentJournal::ReadDocument(filename, points, generation, nullptr, cancel));
+        ASSERT_TRUE(DocumentJournal::ReadDocument(filename, points, generation));
+        ASSERT_TRUE(SamePoints(app.drawingPoints, points));
+
+        std::remove(filename);
+        ResetApp();
+        return true;
+    }
+
+    bool TestReplayOperations() {
+        ResetApp();
+        AppState& app = AppState::Instance();
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+
+        DrawStroke(10, 10, 50);
+        DrawingEngine::SetTool(TOOL_LINE);
+        DrawingEngine::StartDrawing(0, 0);
+        DrawingEngine::ContinueDrawing(80, 60);
+        DrawingEngine::EndDrawing();
+        DrawingEngine::SetTool(TOOL_ERASER);
+        DrawingEngine::StartDrawing(20, 15);
+        DrawingEngine::ContinueDrawing(40, 30);
+        DrawingEngine::EndDrawing();
+        std::vector<DrawPoint> expected = app.drawingPoints;
+
+        ASSERT_TRUE(DocumentJournal::HasRecoverableJournal(AUTOSAVE_DOCUMENT));
+        ASSERT_TRUE(CrashAndRecover() > 0);
+        ASSERT_TRUE(SamePoints(expected, app.drawingPoints));
+
+        // Recovery folds the journal into a full save
+        ASSERT_FALSE(DocumentJournal::HasRecoverableJournal(AUTOSAVE_DOCUMENT));
+        ResetApp();
+        return true;
+    }
+
+    bool TestReplayUndoRedo() {
+        ResetApp();
+        AppState& app = AppState::Instance();
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+
+        DrawStroke(10, 10, 20);
+        DrawStroke(100, 100, 20);
+        DrawStroke(200, 50, 20);
+        DrawingEngine::Undo();
+        DrawingEngine::Undo();
+        DrawingEngine::Redo();
+        std::vector<DrawPoint> expected = app.drawingPoints;
+
+        CrashAndRecover();
+        ASSERT_TRUE(SamePoints(expected, app.drawingPoints));
+        ResetApp();
+        return true;
+    }
+
+    bool TestTornTail() {
+        ResetApp();
+        AppState& app = AppState::Instance();
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+
+        DrawStroke(5, 5, 10);
+        std::vector<DrawPoint> expected = app.drawingPoints;
+        DocumentJournal::Detach(false);
+
+        // A record header whose payload never made it to disk
+        std::FILE* file = std::fopen(DocumentJournal::JournalPathFor(AUTOSAVE_DOCUMENT).c_str(), "ab");
+        ASSERT_TRUE(file != nullptr);
+        std::fputc(1, file);
+        std::fputc(200, file);
+        std::fclose(file);
+
+        ASSERT_EQ((size_t)1, CrashAndRecover());
+        ASSERT_TRUE(SamePoints(expected, app.drawingPoints));
+        ResetApp();
+        return true;
+    }
+
+    bool TestCompaction() {
+        ResetApp();
+        AppState& app = AppState::Instance();
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+
+        DrawStroke(5, 5, 30);
+        ASSERT_TRUE(DocumentJournal::Compact());
+        ASSERT_FALSE(DocumentJournal::HasRecoverableJournal(AUTOSAVE_DOCUMENT));
+
+        DrawingEngine::ClearCanvas();
+        ASSERT_EQ((size_t)1, CrashAndRecover());
+        ASSERT_TRUE(app.drawingPoints.empty());
+        ResetApp();
+        return true;
+    }
+
+    bool TestIncrementalCost() {
+        ResetApp();
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+
+        for (int i = 0; i < 200; i++) {
+            DrawStroke(i, i, 100);
+        }
+        uint64_t before = DocumentJournal::JournalBytes();
+        DrawStroke(0, 0, 10);
+        uint64_t growth = DocumentJournal::JournalBytes() - before;
+
+        // One 11-point stroke costs one small record, not a rewrite of 20k points
+        ASSERT_TRUE(growth < 11 * 16 + 64);
+        ResetApp();
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Document Journal Tests" << std::endl;
+
+    DocumentJournalTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
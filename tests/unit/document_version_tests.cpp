@@ -0,0 +1,169 @@
+#include "../test_framework.h"
+#include "../../include/document_version.h"
+#include "../../include/memory_stats.h"
+#include <vector>
+
+class DocumentVersionTests {
+private:
+    TestFramework framework;
+
+public:
+    DocumentVersionTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Document Versions");
+        framework.AddTest("Chunks Cover Every Point In Order", [this]() { return TestLayout(); });
+        framework.AddTest("Untouched Prefix Is Shared Unread", [this]() { return TestUnchangedPrefix(); });
+        framework.AddTest("Equal Chunks Are Shared", [this]() { return TestEqualChunks(); });
+        framework.AddTest("Pinned Versions Outlive Newer Ones", [this]() { return TestPinned(); });
+        framework.AddTest("Shared Chunks Are Counted Once", [this]() { return TestMemory(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static std::vector<DrawPoint> MakePoints(size_t count, int seed = 0) {
+        std::vector<DrawPoint> points(count);
+        for (size_t i = 0; i < count; i++) {
+            points[i] = {(int)i, (int)(i * 7) + seed, (COLORREF)(i * 31), i % 50 == 0, 1 + (int)(i % 9), TOOL_BRUSH};
+        }
+        return points;
+    }
+
+    static bool SamePoint(const DrawPoint& a, const DrawPoint& b) {
+        return a.x == b.x && a.y == b.y && a.color == b.color && a.isStart == b.isStart &&
+               a.brushSize == b.brushSize && a.toolType == b.toolType;
+    }
+
+    static bool Matches(const DocumentVersion::Points& version, const std::vector<DrawPoint>& points) {
+        if (version.size() != points.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < points.size(); i++) {
+            if (!SamePoint(version[i], points[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool TestLayout() {
+        DocumentVersion::Points empty = DocumentVersion::Build(std::vector<DrawPoint>());
+        ASSERT_TRUE(empty.empty());
+        ASSERT_EQ((size_t)0, empty.ChunkCount());
+
+        const size_t count = 3 * DocumentVersion::CHUNK_POINTS + 17;
+        std::vector<DrawPoint> points = MakePoints(count);
+        DocumentVersion::BuildStats stats;
+        DocumentVersion::Points version = DocumentVersion::Build(points, DocumentVersion::Points(), 0, &stats);
+        ASSERT_EQ(count, version.size());
+        ASSERT_EQ((size_t)4, version.ChunkCount());
+        ASSERT_EQ((size_t)4, stats.copied);
+        ASSERT_EQ((size_t)0, stats.shared);
+        ASSERT_EQ(DocumentVersion::CHUNK_POINTS, version.ChunkAt(0)->points.size());
+        ASSERT_EQ((size_t)17, version.ChunkAt(3)->points.size());
+        ASSERT_TRUE(Matches(version, points));
+
+        std::vector<DrawPoint> flat;
+        version.CopyTo(flat);
+        ASSERT_TRUE(Matches(version, flat));
+        return true;
+    }
+
+    bool TestUnchangedPrefix() {
+        std::vector<DrawPoint> points = MakePoints(2 * DocumentVersion::CHUNK_POINTS + 100);
+        DocumentVersion::Points first = DocumentVersion::Build(points);
+
+        // Appending copies only the partial chunk at the end
+        std::vector<DrawPoint> more = MakePoints(DocumentVersion::CHUNK_POINTS);
+        points.insert(points.end(), more.begin(), more.end());
+        DocumentVersion::BuildStats stats;
+        DocumentVersion::Points second = DocumentVersion::Build(points, first, first.size(), &stats);
+        ASSERT_EQ((size_t)2, stats.shared);
+        ASSERT_EQ((size_t)2, stats.copied);
+        ASSERT_TRUE(first.ChunkAt(1) == second.ChunkAt(1));
+        ASSERT_TRUE(first.ChunkAt(2) != second.ChunkAt(2));
+        ASSERT_TRUE(Matches(second, points));
+
+        // Below the mark the caller vouches for the points; they are not read
+        points[5].x = -1;
+        DocumentVersion::Points trusted = DocumentVersion::Build(points, second, DocumentVersion::CHUNK_POINTS, &stats);
+        ASSERT_TRUE(trusted.ChunkAt(0) == second.ChunkAt(0));
+        ASSERT_EQ(5, trusted[5].x);
+        DocumentVersion::Points checked = DocumentVersion::Build(points, second, 0, &stats);
+        ASSERT_TRUE(checked.ChunkAt(0) != second.ChunkAt(0));
+        ASSERT_EQ(-1, checked[5].x);
+        ASSERT_EQ((size_t)3, stats.shared);
+        return true;
+    }
+
+    bool TestEqualChunks() {
+        // Removing the last chunk's points (an undo) leaves the rest equal
+        std::vector<DrawPoint> points = MakePoints(3 * DocumentVersion::CHUNK_POINTS);
+        DocumentVersion::Points full = DocumentVersion::Build(points);
+        points.resize(2 * DocumentVersion::CHUNK_POINTS + 10);
+        DocumentVersion::BuildStats stats;
+        DocumentVersion::Points undone = DocumentVersion::Build(points, full, 0, &stats);
+        ASSERT_EQ((size_t)2, stats.shared);
+        ASSERT_EQ((size_t)1, stats.copied);
+        ASSERT_TRUE(Matches(undone, points));
+
+        // A changed point anywhere copies its chunk alone
+        points[DocumentVersion::CHUNK_POINTS + 3].color = 1;
+        DocumentVersion::Points edited = DocumentVersion::Build(points, undone, 0, &stats);
+        ASSERT_TRUE(edited.ChunkAt(0) == undone.ChunkAt(0));
+        ASSERT_TRUE(edited.ChunkAt(1) != undone.ChunkAt(1));
+        ASSERT_TRUE(edited.ChunkAt(2) == undone.ChunkAt(2));
+        ASSERT_EQ((COLORREF)1, edited[DocumentVersion::CHUNK_POINTS + 3].color);
+        return true;
+    }
+
+    bool TestPinned() {
+        std::vector<DrawPoint> points = MakePoints(DocumentVersion::CHUNK_POINTS + 5);
+        std::vector<DrawPoint> original = points;
+        DocumentVersion::Points pinned = DocumentVersion::Build(points);
+
+        // Newer versions replace the document; the pinned one still reads the old points
+        DocumentVersion::Points latest = pinned;
+        for (int round = 1; round <= 5; round++) {
+            points = MakePoints(DocumentVersion::CHUNK_POINTS / 2, round);
+            latest = DocumentVersion::Build(points, latest);
+        }
+        ASSERT_TRUE(Matches(latest, points));
+        ASSERT_TRUE(Matches(pinned, original));
+        return true;
+    }
+
+    bool TestMemory() {
+        size_t base = MemoryStats::TrackedBytes(MemoryStats::MEM_DOCUMENT);
+        std::vector<DrawPoint> points = MakePoints(4 * DocumentVersion::CHUNK_POINTS);
+        size_t chunkBytes = DocumentVersion::CHUNK_POINTS * sizeof(DrawPoint);
+        {
+            DocumentVersion::Points first = DocumentVersion::Build(points);
+            ASSERT_EQ(base + 4 * chunkBytes, MemoryStats::TrackedBytes(MemoryStats::MEM_DOCUMENT));
+
+            points[0].x = 99;
+            DocumentVersion::Points second = DocumentVersion::Build(points, first, 0);
+            ASSERT_EQ(base + 5 * chunkBytes, MemoryStats::TrackedBytes(MemoryStats::MEM_DOCUMENT));
+        }
+        ASSERT_EQ(base, MemoryStats::TrackedBytes(MemoryStats::MEM_DOCUMENT));
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Document Version Tests" << std::endl;
+
+    DocumentVersionTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
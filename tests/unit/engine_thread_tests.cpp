@@ -0,0 +1,704 @@
+#include "../test_framework.h"
+#include "../../include/engine_thread.h"
+#include "../../include/spsc_queue.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/frame_profiler.h"
+#include "../../include/app_state.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+// Engine thread tests - commands go through the real queue and engine thread;
+// the test thread plays the UI
+class EngineThreadTests {
+private:
+    TestFramework framework;
+
+public:
+    EngineThreadTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("SPSC Queue");
+        framework.AddTest("Order Kept Across Threads", [this]() { return TestQueueOrder(); });
+        framework.AddTest("Full And Empty", [this]() { return TestQueueBounds(); });
+
+        framework.AddSuite("Engine Thread");
+        framework.AddTest("Threaded Matches Inline", [this]() { return TestMatchesInline(); });
+        framework.AddTest("Strokes Keep Their Settings", [this]() { return TestStrokeSettings(); });
+        framework.AddTest("Published Snapshots Are Immutable", [this]() { return TestSnapshotImmutable(); });
+        framework.AddTest("Tasks Run In Order With Commands", [this]() { return TestRunTask(); });
+        framework.AddTest("Overflow Keeps Order", [this]() { return TestOverflow(); });
+        framework.AddTest("Stop Applies Everything Queued", [this]() { return TestStopDrains(); });
+        framework.AddTest("Applied Inputs Reach The Frame", [this]() { return TestInputLatency(); });
+        framework.AddTest("Snapshots Share Unchanged Chunks", [this]() { return TestSharedChunks(); });
+        framework.AddTest("Every Version Matches The Document", [this]() { return TestVersionsMatch(); });
+
+        framework.AddSuite("Batched Moves");
+        framework.AddTest("Batch Matches Single Moves", [this]() { return TestBatchMatchesSingle(); });
+        framework.AddTest("A Batch Posts One Command", [this]() { return TestBatchCommand(); });
+        framework.AddTest("Published Damage Covers The Stroke", [this]() { return TestPublishedDamage(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static void ResetDocument() {
+        AppState& app = AppState::Instance();
+        app.drawingPoints.clear();
+        app.undoStack.clear();
+        app.redoStack.clear();
+        app.isDrawing = false;
+        app.hasPreview = false;
+        app.currentTool = TOOL_BRUSH;
+        app.currentColor = RGB(0, 0, 0);
+        app.brushSize = 5;
+    }
+
+    static StrokeSettings Settings(ToolType tool, COLORREF color, int brushSize) {
+        StrokeSettings settings;
+        settings.tool = tool;
+        settings.color = color;
+        settings.brushSize = brushSize;
+        return settings;
+    }
+
+    // Vectors or published versions, in any combination
+    template <typename A, typename B>
+    static bool SamePoints(const A& a, const B& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].color != b[i].color || a[i].isStart != b[i].isStart ||
+                a[i].brushSize != b[i].brushSize || a[i].toolType != b[i].toolType) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Strokes, an erase, shapes, undo and redo; the same calls inline or threaded
+    static void PostSession() {
+        for (int stroke = 0; stroke < 20; stroke++) {
+            EngineThread::StartDrawing(100, 100 + stroke * 10, Settings(TOOL_BRUSH, RGB(stroke * 10, 0, 0), 3));
+            for (int i = 1; i < 300; i++) {
+                EngineThread::ContinueDrawing(100 + i, 100 + stroke * 10 + (i % 7));
+            }
+            EngineThread::EndDrawing();
+        }
+        EngineThread::StartDrawing(200, 150, Settings(TOOL_ERASER, RGB(0, 0, 0), 12));
+        for (int i = 0; i < 50; i++) {
+            EngineThread::ContinueDrawing(200 + i, 150);
+        }
+        EngineThread::EndDrawing();
+        EngineThread::StartDrawing(50, 50, Settings(TOOL_RECTANGLE, RGB(0, 0, 255), 2));
+        EngineThread::ContinueDrawing(400, 300);
+        EngineThread::EndDrawing();
+        EngineThread::StartDrawing(500, 500, Settings(TOOL_CIRCLE, RGB(0, 255, 0), 4));
+        EngineThread::ContinueDrawing(560, 540);
+        EngineThread::EndDrawing();
+        EngineThread::Undo();
+        EngineThread::Undo();
+        EngineThread::Redo();
+    }
+
+    // Plays the UI's message loop until a snapshot covers the wanted points
+    static std::shared_ptr<const EngineThread::Snapshot> WaitForPoints(size_t points) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (std::chrono::steady_clock::now() < deadline) {
+            EngineThread::HandlePublished();
+            std::shared_ptr<const EngineThread::Snapshot> snapshot = EngineThread::Latest();
+            if (snapshot && snapshot->points.size() == points) {
+                return snapshot;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        return nullptr;
+    }
+
+    bool TestQueueOrder() {
+        static SpscQueue<uint64_t, 1024> queue;
+        const uint64_t count = 200000;
+
+        std::thread producer([]() {
+            for (uint64_t value = 1; value <= count; value++) {
+                while (!queue.Push(value)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        uint64_t expected = 1;
+        uint64_t value = 0;
+        bool ordered = true;
+        while (expected <= count) {
+            if (queue.Pop(value)) {
+                ordered = ordered && value == expected;
+                expected++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+        ASSERT_TRUE(ordered);
+        ASSERT_TRUE(queue.Empty());
+        return true;
+    }
+
+    bool TestQueueBounds() {
+        SpscQueue<int, 8> queue;
+        int value = 0;
+        ASSERT_FALSE(queue.Pop(value));
+        for (int i = 0; i < 8; i++) {
+            ASSERT_TRUE(queue.Push(i));
+        }
+        ASSERT_FALSE(queue.Push(8));
+        ASSERT_EQ((size_t)8, queue.Size());
+
+        // Wraps around once the consumer frees a slot
+        ASSERT_TRUE(queue.Pop(value));
+        ASSERT_EQ(0, value);
+        ASSERT_TRUE(queue.Push(8));
+        for (int i = 1; i <= 8; i++) {
+            ASSERT_TRUE(queue.Pop(value));
+            ASSERT_EQ(i, value);
+        }
+        ASSERT_TRUE(queue.Empty());
+
+        // Runs go in whole or not at all
+        const int run[8] = {10, 11, 12, 13, 14, 15, 16, 17};
+        ASSERT_TRUE(queue.Push(run, 5));
+        ASSERT_FALSE(queue.Push(run + 5, 4));
+        ASSERT_EQ((size_t)5, queue.Size());
+        ASSERT_TRUE(queue.Push(run + 5, 3));
+        for (int i = 0; i < 8; i++) {
+            ASSERT_TRUE(queue.Pop(value));
+            ASSERT_EQ(run[i], value);
+        }
+        ASSERT_TRUE(queue.Empty());
+        return true;
+    }
+
+    bool TestMatchesInline() {
+        ResetDocument();
+        ASSERT_FALSE(EngineThread::IsRunning());
+        PostSession();
+        std::vector<DrawPoint> inlinePoints = AppState::Instance().drawingPoints;
+        size_t inlineUndo = AppState::Instance().undoStack.size();
+        ASSERT_TRUE(inlinePoints.size() > 5000);
+
+        ResetDocument();
+        EngineThread::Stats before = EngineThread::GetStats();
+        ASSERT_TRUE(EngineThread::Start(nullptr));
+        ASSERT_TRUE(EngineThread::IsRunning());
+        PostSession();
+        EngineThread::Stop();
+        ASSERT_FALSE(EngineThread::IsRunning());
+
+        AppState& app = AppState::Instance();
+        ASSERT_TRUE(SamePoints(inlinePoints, app.drawingPoints));
+        ASSERT_EQ(inlineUndo, app.undoStack.size());
+        ASSERT_TRUE(EngineThread::GetStats().commands - before.commands > 6000);
+        ResetDocument();
+        return true;
+    }
+
+    bool TestStrokeSettings() {
+        ResetDocument();
+        ASSERT_TRUE(EngineThread::Start(nullptr));
+
+        // Changing the UI's settings mid-stroke does not touch the stroke in flight
+        EngineThread::StartDrawing(10, 10, DrawingEngine::CurrentStrokeSettings());
+        DrawingEngine::SetColor(RGB(255, 0, 0));
+        DrawingEngine::SetBrushSize(15);
+        DrawingEngine::SetTool(TOOL_ERASER);
+        for (int i = 1; i < 100; i++) {
+            EngineThread::ContinueDrawing(10 + i, 10);
+        }
+        EngineThread::EndDrawing();
+        EngineThread::Stop();
+
+        const std::vector<DrawPoint>& points = AppState::Instance().drawingPoints;
+        ASSERT_EQ((size_t)100, points.size());
+        for (const DrawPoint& point : points) {
+            ASSERT_EQ(RGB(0, 0, 0), point.color);
+            ASSERT_EQ(5, point.brushSize);
+            ASSERT_EQ(TOOL_BRUSH, point.toolType);
+        }
+        ResetDocument();
+        return true;
+    }
+
+    bool TestSnapshotImmutable() {
+        ResetDocument();
+        ASSERT_TRUE(EngineThread::Start([]() {}));
+
+        EngineThread::StartDrawing(0, 0, Settings(TOOL_BRUSH, RGB(1, 2, 3), 4));
+        for (int i = 1; i < 500; i++) {
+            EngineThread::ContinueDrawing(i, i);
+        }
+        EngineThread::EndDrawing();
+        std::shared_ptr<const EngineThread::Snapshot> pinned = WaitForPoints(500);
+        ASSERT_TRUE(pinned != nullptr);
+        std::vector<DrawPoint> copy;
+        pinned->points.CopyTo(copy);
+
+        // The engine keeps mutating the document while the snapshot is held
+        EngineThread::ClearCanvas();
+        EngineThread::StartDrawing(0, 0, Settings(TOOL_BRUSH, RGB(9, 9, 9), 1));
+        EngineThread::ContinueDrawing(1, 1);
+        EngineThread::EndDrawing();
+        std::shared_ptr<const EngineThread::Snapshot> newer = WaitForPoints(2);
+        ASSERT_TRUE(newer != nullptr);
+        ASSERT_TRUE(newer->version > pinned->version);
+        ASSERT_TRUE(newer->appliedSequence > pinned->appliedSequence);
+        ASSERT_TRUE(SamePoints(copy, pinned->points));
+        ASSERT_EQ((size_t)2, EngineThread::CurrentStatus().points);
+
+        EngineThread::Stop();
+        ASSERT_TRUE(EngineThread::Latest() == nullptr);
+        ResetDocument();
+        return true;
+    }
+
+    // Plays the UI's message loop until the flag is set (by a task's done)
+    static bool WaitFor(const bool& flag) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!flag && std::chrono::steady_clock::now() < deadline) {
+            EngineThread::HandlePublished();
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        return flag;
+    }
+
+    bool TestRunTask() {
+        ResetDocument();
+        ASSERT_TRUE(EngineThread::Start(nullptr));
+
+        EngineThread::StartDrawing(0, 0, Settings(TOOL_BRUSH, RGB(0, 0, 0), 2));
+        for (int i = 1; i < 10000; i++) {
+            EngineThread::ContinueDrawing(i % 800, i / 800);
+        }
+        size_t seen = 0;
+        size_t published = 0;
+        bool done = false;
+        EngineThread::Run(
+            [&seen]() {
+                seen = AppState::Instance().drawingPoints.size();
+                // Whole-document work, as opening a file does
+                AppState::Instance().drawingPoints.resize(10);
+                return true;
+            },
+            [&published, &done](bool result, const EngineThread::Snapshot& snapshot) {
+                published = snapshot.points.size();
+                done = result;
+            });
+        // Commands posted after the task apply after it; its done still sees
+        // the document as the task left it
+        EngineThread::ContinueDrawing(5, 5);
+        EngineThread::EndDrawing();
+        ASSERT_TRUE(WaitFor(done));
+        ASSERT_EQ((size_t)10000, seen);
+        ASSERT_EQ((size_t)10, published);
+
+        ASSERT_TRUE(WaitForPoints(11) != nullptr);
+        EngineThread::Stop();
+        ASSERT_EQ((size_t)11, AppState::Instance().drawingPoints.size());
+
+        // Inline, both halves run before Run returns
+        bool inlineDone = false;
+        EngineThread::Run([]() { return false; },
+                          [&inlineDone](bool result, const EngineThread::Snapshot& snapshot) {
+                              inlineDone = !result && snapshot.points.size() == 11;
+                          });
+        ASSERT_TRUE(inlineDone);
+        ResetDocument();
+        return true;
+    }
+
+    bool TestOverflow() {
+        ResetDocument();
+        EngineThread::Stats before = EngineThread::GetStats();
+        ASSERT_TRUE(EngineThread::Start(nullptr));
+
+        // With the engine held in a task the ring fills and the rest waits on the UI side
+        static std::atomic<bool> started{false};
+        static std::atomic<bool> release{false};
+        started = false;
+        release = false;
+        const int moves = (int)EngineThread::QUEUE_CAPACITY + 3000;
+        EngineThread::StartDrawing(0, 0, Settings(TOOL_BRUSH, RGB(0, 0, 0), 2));
+        EngineThread::Run([]() {
+            started = true;
+            while (!release) {
+                std::this_thread::yield();
+            }
+            return true;
+        });
+        while (!started) {
+            std::this_thread::yield();
+        }
+        for (int i = 1; i <= moves; i++) {
+            EngineThread::ContinueDrawing(i, 0);
+        }
+        release = true;
+        EngineThread::EndDrawing();
+        ASSERT_TRUE(EngineThread::GetStats().overflowed - before.overflowed >= 3000);
+        EngineThread::Stop();
+
+        const std::vector<DrawPoint>& points = AppState::Instance().drawingPoints;
+        ASSERT_EQ((size_t)moves + 1, points.size());
+        for (int i = 0; i <= moves; i++) {
+            ASSERT_EQ(i, points[i].x);
+        }
+        ASSERT_EQ((size_t)1, AppState::Instance().undoStack.size());
+        ResetDocument();
+        return true;
+    }
+
+    bool TestStopDrains() {
+        ResetDocument();
+        static std::atomic<int> notifications{0};
+        notifications = 0;
+        ASSERT_TRUE(EngineThread::Start([]() { notifications++; }));
+        ASSERT_FALSE(EngineThread::Start(nullptr));
+
+        EngineThread::StartDrawing(0, 0, Settings(TOOL_BRUSH, RGB(0, 0, 0), 2));
+        for (int i = 1; i < 3000; i++) {
+            EngineThread::ContinueDrawing(i, 0);
+        }
+        EngineThread::EndDrawing();
+        EngineThread::Stop();
+        ASSERT_EQ((size_t)3000, AppState::Instance().drawingPoints.size());
+        ASSERT_FALSE(AppState::Instance().isDrawing);
+
+        // Never handled, so the engine notified once however often it published
+        ASSERT_EQ(1, notifications.load());
+        EngineThread::Stop();   // A second Stop is harmless
+        ResetDocument();
+        return true;
+    }
+
+    bool TestInputLatency() {
+        ResetDocument();
+        FrameProfiler::Reset();
+        ASSERT_TRUE(EngineThread::Start(nullptr));
+
+        // Stamped on arrival, carried by the command, reported once published
+        FrameProfiler::InputArrived(FrameProfiler::NowMicros() - 5000);
+        EngineThread::StartDrawing(0, 0, Settings(TOOL_BRUSH, RGB(0, 0, 0), 2));
+        ASSERT_EQ((uint64_t)0, FrameProfiler::TakeArrivingInput());
+        FrameProfiler::InputArrived();
+        EngineThread::ContinueDrawing(1, 1);
+        std::shared_ptr<const EngineThread::Snapshot> snapshot = WaitForPoints(2);
+        ASSERT_TRUE(snapshot != nullptr);
+
+        FrameProfiler::BeginFrame(false);
+        EngineThread::ReportApplied(*snapshot);
+        EngineThread::ReportApplied(*snapshot);   // Already reported
+        {
+            FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_PRESENT);
+        }
+        FrameProfiler::EndFrame((uint32_t)snapshot->points.size());
+
+        std::vector<FrameProfiler::FrameRecord> frames;
+        ASSERT_EQ((size_t)1, FrameProfiler::Snapshot(frames));
+        ASSERT_EQ((uint32_t)2, frames[0].inputsPresented);
+        ASSERT_TRUE(frames[0].inputLatencyMicros >= 5000.0f);
+
+        EngineThread::EndDrawing();
+        EngineThread::Stop();
+        FrameProfiler::Reset();
+        ResetDocument();
+        return true;
+    }
+
+    bool TestSharedChunks() {
+        // Three full strokes inline, then one more through the engine
+        ResetDocument();
+        for (int stroke = 0; stroke < 3; stroke++) {
+            EngineThread::StartDrawing(0, stroke * 20, Settings(TOOL_BRUSH, RGB(0, 0, 0), 3));
+            for (int i = 1; i < 4000; i++) {
+                EngineThread::ContinueDrawing(i % 1000, stroke * 20 + i / 1000);
+            }
+            EngineThread::EndDrawing();
+        }
+        ASSERT_TRUE(EngineThread::Start(nullptr));
+        std::shared_ptr<const EngineThread::Snapshot> first = WaitForPoints(12000);
+        ASSERT_TRUE(first != nullptr);
+        ASSERT_EQ((size_t)3, first->points.ChunkCount());
+        EngineThread::Stats before = EngineThread::GetStats();
+
+        EngineThread::StartDrawing(0, 100, Settings(TOOL_BRUSH, RGB(255, 0, 0), 3));
+        for (int i = 1; i < 100; i++) {
+            EngineThread::ContinueDrawing(i, 100);
+        }
+        EngineThread::EndDrawing();
+        std::shared_ptr<const EngineThread::Snapshot> second = WaitForPoints(12100);
+        ASSERT_TRUE(second != nullptr);
+
+        // The stroke only reached the last chunk; the full ones before it are shared
+        ASSERT_TRUE(first->points.ChunkAt(0) == second->points.ChunkAt(0));
+        ASSERT_TRUE(first->points.ChunkAt(1) == second->points.ChunkAt(1));
+        ASSERT_TRUE(first->points.ChunkAt(2) != second->points.ChunkAt(2));
+        EngineThread::Stats after = EngineThread::GetStats();
+        ASSERT_TRUE(after.chunksShared >= before.chunksShared + 2);
+        ASSERT_TRUE(after.chunksCopied > before.chunksCopied);
+        ASSERT_TRUE(SamePoints(second->points, AppState::Instance().drawingPoints));
+
+        EngineThread::Stop();
+        ResetDocument();
+        return true;
+    }
+
+    bool TestVersionsMatch() {
+        // Decimation moves points, erases and undo reach anywhere: whatever the
+        // engine skips comparing must really be unchanged
+        ResetDocument();
+        AppState& app = AppState::Instance();
+        app.strokeTolerance = 1.5;
+        ASSERT_TRUE(EngineThread::Start(nullptr));
+        bool match = true;
+        // A task sees every earlier command applied and published
+        auto check = [&match, &app]() {
+            EngineThread::Run([&match, &app]() {
+                std::shared_ptr<const EngineThread::Snapshot> snapshot = EngineThread::Latest();
+                match = match && snapshot && SamePoints(snapshot->points, app.drawingPoints);
+                return true;
+            });
+        };
+
+        // Zigzags keep their points, near-straight strokes decimate
+        for (int stroke = 0; stroke < 12; stroke++) {
+            EngineThread::StartDrawing(0, stroke * 8, Settings(TOOL_BRUSH, RGB(stroke, 0, 0), 3));
+            for (int i = 1; i < 1500; i++) {
+                EngineThread::ContinueDrawing(i, stroke * 8 + ((stroke % 2) ? (i / 40) % 3 : (i % 2) * 4));
+            }
+            if (stroke % 4 == 3) {
+                check();   // Mid-stroke
+            }
+            EngineThread::EndDrawing();
+            check();
+        }
+        bool spansChunks = false;
+        EngineThread::Run([&spansChunks, &app]() {
+            spansChunks = app.drawingPoints.size() > 2 * DocumentVersion::CHUNK_POINTS;
+            return true;
+        });
+
+        // Undoing the erase under a later stroke restores points in early chunks
+        EngineThread::StartDrawing(300, 20, Settings(TOOL_ERASER, RGB(0, 0, 0), 20));
+        EngineThread::ContinueDrawing(700, 40);
+        EngineThread::EndDrawing();
+        check();
+        EngineThread::StartDrawing(0, 200, Settings(TOOL_BRUSH, RGB(0, 0, 255), 3));
+        for (int i = 1; i < 50; i++) {
+            EngineThread::ContinueDrawing(i * 2, 200 + (i % 2) * 4);
+        }
+        EngineThread::EndDrawing();
+        check();
+        for (int step = 0; step < 3; step++) {   // The first undo restores the state saved after the stroke
+            EngineThread::Undo();
+            check();
+        }
+        EngineThread::Redo();
+        check();
+        EngineThread::ClearCanvas();
+        check();
+
+        EngineThread::Stop();
+        app.strokeTolerance = 0.0;
+        ASSERT_TRUE(spansChunks);
+        ASSERT_TRUE(match);
+        ResetDocument();
+        return true;
+    }
+
+    bool TestBatchCommand() {
+        std::vector<DrawingEngine::StrokePoint> burst;
+        for (int i = 1; i <= 300; i++) {
+            burst.push_back({i, 50 + (i % 11)});
+        }
+        ResetDocument();
+        DrawingEngine::StartDrawing(0, 50, Settings(TOOL_BRUSH, RGB(0, 0, 0), 4));
+        DrawingEngine::ContinueDrawingBatch(burst.data(), burst.size());
+        DrawingEngine::EndDrawing();
+        std::vector<DrawPoint> expected = AppState::Instance().drawingPoints;
+
+        ResetDocument();
+        EngineThread::Stats before = EngineThread::GetStats();
+        ASSERT_TRUE(EngineThread::Start(nullptr));
+        EngineThread::StartDrawing(0, 50, Settings(TOOL_BRUSH, RGB(0, 0, 0), 4));
+        EngineThread::ContinueDrawing(burst.data(), burst.size());
+        EngineThread::EndDrawing();
+        EngineThread::Stop();
+        ASSERT_EQ((uint64_t)3, EngineThread::GetStats().commands - before.commands);
+        ASSERT_TRUE(SamePoints(expected, AppState::Instance().drawingPoints));
+
+        // Held behind a task, batches overflow to the UI side with their points
+        // and a batch longer than MAX_BATCH_POINTS splits; order survives both
+        static std::atomic<bool> started{false};
+        static std::atomic<bool> release{false};
+        started = false;
+        release = false;
+        std::vector<DrawingEngine::StrokePoint> line;
+        for (int i = 1; i <= (int)EngineThread::MAX_BATCH_POINTS * 2 + 10; i++) {
+            line.push_back({i, 0});
+        }
+        ResetDocument();
+        before = EngineThread::GetStats();
+        ASSERT_TRUE(EngineThread::Start(nullptr));
+        EngineThread::StartDrawing(0, 0, Settings(TOOL_BRUSH, RGB(0, 0, 0), 2));
+        EngineThread::Run([]() {
+            started = true;
+            while (!release) {
+                std::this_thread::yield();
+            }
+            return true;
+        });
+        while (!started) {
+            std::this_thread::yield();
+        }
+        const size_t batches = 8;
+        for (size_t b = 0; b < batches; b++) {
+            EngineThread::ContinueDrawing(line.data() + b * line.size() / batches,
+                                          (b + 1) * line.size() / batches - b * line.size() / batches);
+        }
+        EngineThread::ContinueDrawing(line.data(), line.size());   // Back along the line, split in three
+        release = true;
+        EngineThread::EndDrawing();
+        EngineThread::Stop();
+        EngineThread::Stats after = EngineThread::GetStats();
+        ASSERT_TRUE(after.overflowed > before.overflowed);
+        ASSERT_EQ((uint64_t)(1 + 1 + batches + 3 + 1), after.commands - before.commands);
+        const std::vector<DrawPoint>& points = AppState::Instance().drawingPoints;
+        ASSERT_EQ(line.size() * 2 + 1, points.size());
+        for (size_t i = 0; i < line.size(); i++) {
+            ASSERT_EQ(line[i].x, points[1 + i].x);
+            ASSERT_EQ(line[i].x, points[1 + line.size() + i].x);
+        }
+        ResetDocument();
+        return true;
+    }
+
+    bool TestBatchMatchesSingle() {
+        // A coalesced burst: repeats of a position add nothing
+        std::vector<DrawingEngine::StrokePoint> burst;
+        for (int i = 1; i <= 300; i++) {
+            burst.push_back({100 + i, 200 - (i % 9)});
+            if (i % 4 == 0) {
+                burst.push_back(burst.back());
+            }
+        }
+
+        ResetDocument();
+        DrawingEngine::StartDrawing(100, 200, Settings(TOOL_BRUSH, RGB(5, 6, 7), 8));
+        for (const DrawingEngine::StrokePoint& point : burst) {
+            DrawingEngine::ContinueDrawing(point.x, point.y);
+        }
+        std::vector<DrawPoint> single = AppState::Instance().drawingPoints;
+        ASSERT_EQ(burst.size() + 1, single.size());
+
+        ResetDocument();
+        DrawingEngine::StartDrawing(100, 200, Settings(TOOL_BRUSH, RGB(5, 6, 7), 8));
+        DrawingEngine::Damage damage;
+        ASSERT_EQ((size_t)300, DrawingEngine::ContinueDrawingBatch(burst.data(), burst.size(), &damage));
+        std::vector<DrawPoint> batched = AppState::Instance().drawingPoints;
+        ASSERT_EQ((size_t)301, batched.size());
+        size_t next = 0;
+        for (const DrawPoint& point : single) {
+            if (next > 0 && point.x == batched[next - 1].x && point.y == batched[next - 1].y) {
+                continue;
+            }
+            ASSERT_TRUE(next < batched.size());
+            ASSERT_TRUE(point.x == batched[next].x && point.y == batched[next].y && point.color == batched[next].color);
+            next++;
+        }
+        ASSERT_EQ(batched.size(), next);
+
+        // One box over the whole run, including the segment from the start and the brush radius
+        ASSERT_FALSE(damage.whole);
+        for (const DrawPoint& point : batched) {
+            ASSERT_TRUE(point.x - 4 >= damage.left && point.x + 4 < damage.right);
+            ASSERT_TRUE(point.y - 4 >= damage.top && point.y + 4 < damage.bottom);
+        }
+        ASSERT_TRUE(damage.right - damage.left < 320 && damage.bottom - damage.top < 24);
+
+        // Nothing new, no damage; erasing has no cheap bound
+        ASSERT_EQ((size_t)0, DrawingEngine::ContinueDrawingBatch(&burst.back(), 1, &damage));
+        ASSERT_TRUE(damage.right <= damage.left && !damage.whole);
+        DrawingEngine::EndDrawing();
+        DrawingEngine::StartDrawing(150, 200, Settings(TOOL_ERASER, RGB(0, 0, 0), 10));
+        ASSERT_EQ((size_t)2, DrawingEngine::ContinueDrawingBatch(burst.data(), 2, &damage));
+        ASSERT_TRUE(damage.whole);
+        DrawingEngine::EndDrawing();
+        ResetDocument();
+        return true;
+    }
+
+    bool TestPublishedDamage() {
+        ResetDocument();
+        ASSERT_TRUE(EngineThread::Start([]() {}));
+        EngineThread::StartDrawing(1000, 1000, Settings(TOOL_BRUSH, RGB(0, 0, 0), 6));
+        ASSERT_TRUE(WaitForPoints(1) != nullptr);
+        DrawingEngine::Damage damage;
+        EngineThread::HandlePublished(&damage);
+
+        std::vector<DrawingEngine::StrokePoint> burst;
+        for (int i = 1; i <= 200; i++) {
+            burst.push_back({1000 + i, 1000 + i / 4});
+        }
+        EngineThread::ContinueDrawing(burst.data(), burst.size());
+
+        // Gathered across however many snapshots the engine publishes; Stop
+        // joins the engine, so the last publish has handed over its damage
+        DrawingEngine::Damage total;
+        auto gather = [&total, &damage]() {
+            EngineThread::HandlePublished(&damage);
+            if (damage.right > damage.left) {
+                bool first = total.right <= total.left;
+                total.left = first ? damage.left : std::min(total.left, damage.left);
+                total.top = first ? damage.top : std::min(total.top, damage.top);
+                total.right = first ? damage.right : std::max(total.right, damage.right);
+                total.bottom = first ? damage.bottom : std::max(total.bottom, damage.bottom);
+            }
+            total.whole |= damage.whole;
+        };
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        std::shared_ptr<const EngineThread::Snapshot> snapshot;
+        while (!(snapshot && snapshot->points.size() == 201) && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            gather();
+            snapshot = EngineThread::Latest();
+        }
+        ASSERT_TRUE(snapshot && snapshot->points.size() == 201);
+        EngineThread::Stop();
+        gather();
+        ASSERT_FALSE(total.whole);
+        ASSERT_TRUE(total.left <= 997 && total.right > 1203);
+        ASSERT_TRUE(total.top <= 997 && total.bottom > 1053);
+        DrawingEngine::EndDrawing();
+        ResetDocument();
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Engine Thread Tests" << std::endl;
+
+    // These tests count stored points; decimation has its own tests
+    AppState::Instance().strokeTolerance = 0.0;
+
+    EngineThreadTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+#include "../test_framework.h"
+#include "../../include/frame_profiler.h"
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+class FrameProfilerTests {
+private:
+    TestFramework framework;
+
+public:
+    FrameProfilerTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Frame Profiler");
+        framework.AddTest("Scoped Phases Fill The Frame", [this]() { return TestScopedPhases(); });
+        framework.AddTest("Ring Keeps The Latest Frames", [this]() { return TestRingWraps(); });
+        framework.AddTest("Summary Percentiles And Rate", [this]() { return TestSummary(); });
+        framework.AddTest("Readers Never See Torn Frames", [this]() { return TestConcurrentReaders(); });
+        framework.AddTest("Report Dump", [this]() { return TestDump(); });
+        framework.AddTest("Input Latency Runs To Present", [this]() { return TestInputLatency(); });
+        framework.AddTest("Latency Percentiles", [this]() { return TestLatencySummary(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    // Every field derives from the value, so a torn copy is easy to spot
+    static FrameProfiler::FrameRecord MakeFrame(uint64_t startMicros, float totalMicros) {
+        FrameProfiler::FrameRecord frame;
+        frame.startMicros = startMicros;
+        frame.totalMicros = totalMicros;
+        for (int phase = 0; phase < FrameProfiler::PHASE_COUNT; phase++) {
+            frame.phaseMicros[phase] = totalMicros / FrameProfiler::PHASE_COUNT;
+        }
+        frame.pointsDrawn = (uint32_t)totalMicros;
+        return frame;
+    }
+
+    static void Spin(int micros) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(micros);
+        while (std::chrono::steady_clock::now() < end) {}
+    }
+
+    bool TestScopedPhases() {
+        FrameProfiler::Reset();
+        FrameProfiler::BeginFrame(true);
+        {
+            FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_STROKES);
+            Spin(2000);
+        }
+        {
+            FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_PRESENT);
+            Spin(500);
+        }
+        {
+            FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_STROKES);
+            Spin(1000);
+        }
+        FrameProfiler::EndFrame(1234);
+
+        // Phases outside a frame are ignored
+        {
+            FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_GRID);
+        }
+
+        std::vector<FrameProfiler::FrameRecord> frames;
+        ASSERT_EQ((size_t)1, FrameProfiler::Snapshot(frames));
+        const FrameProfiler::FrameRecord& frame = frames[0];
+        ASSERT_TRUE(frame.gpu);
+        ASSERT_EQ((uint32_t)1234, frame.pointsDrawn);
+        ASSERT_TRUE(frame.phaseMicros[FrameProfiler::PHASE_STROKES] >= 3000.0f);
+        ASSERT_TRUE(frame.phaseMicros[FrameProfiler::PHASE_PRESENT] >= 500.0f);
+        ASSERT_TRUE(frame.phaseMicros[FrameProfiler::PHASE_GRID] == 0.0f);
+        ASSERT_TRUE(frame.totalMicros >= frame.phaseMicros[FrameProfiler::PHASE_STROKES] +
+                                         frame.phaseMicros[FrameProfiler::PHASE_PRESENT]);
+        return true;
+    }
+
+    bool TestRingWraps() {
+        FrameProfiler::Reset();
+        size_t total = FrameProfiler::FRAME_HISTORY * 2 + 17;
+        for (size_t i = 0; i < total; i++) {
+            FrameProfiler::Record(MakeFrame(i * 1000, (float)i));
+        }
+
+        std::vector<FrameProfiler::FrameRecord> frames;
+        ASSERT_EQ(FrameProfiler::FRAME_HISTORY, FrameProfiler::Snapshot(frames));
+        for (size_t i = 0; i < frames.size(); i++) {
+            uint64_t index = total - FrameProfiler::FRAME_HISTORY + i;
+            ASSERT_EQ(index, frames[i].index);
+            ASSERT_EQ((float)index, frames[i].totalMicros);
+        }
+
+        FrameProfiler::Reset();
+        ASSERT_EQ((size_t)0, FrameProfiler::Snapshot(frames));
+        ASSERT_EQ((size_t)0, FrameProfiler::Summarize().frames);
+        return true;
+    }
+
+    bool TestSummary() {
+        // 100 frames of 1..100 ms, started 10 ms apart
+        std::vector<FrameProfiler::FrameRecord> frames;
+        for (int i = 1; i <= 100; i++) {
+            frames.push_back(MakeFrame((uint64_t)(i - 1) * 10000, i * 1000.0f));
+        }
+        FrameProfiler::Summary summary = FrameProfiler::Summarize(frames);
+        ASSERT_EQ((size_t)100, summary.frames);
+        ASSERT_EQ(50000.0, summary.p50Micros);
+        ASSERT_EQ(99000.0, summary.p99Micros);
+        ASSERT_EQ(100000.0, summary.maxMicros);
+        ASSERT_EQ(50500.0, summary.meanMicros);
+        ASSERT_TRUE(summary.phaseMeanMicros[FrameProfiler::PHASE_CLEAR] > 5000.0);
+        ASSERT_EQ((uint32_t)100000, summary.pointsDrawn);
+
+        // Last frame ends at 990 ms + 100 ms
+        ASSERT_TRUE(std::fabs(summary.framesPerSecond - 100 / 1.09) < 0.01);
+        return true;
+    }
+
+    bool TestConcurrentReaders() {
+        FrameProfiler::Reset();
+        std::atomic<bool> done(false);
+        std::atomic<size_t> torn(0);
+        std::atomic<size_t> reads(0);
+
+        std::thread reader([&]() {
+            std::vector<FrameProfiler::FrameRecord> frames;
+            while (!done.load()) {
+                FrameProfiler::Snapshot(frames);
+                for (size_t i = 0; i < frames.size(); i++) {
+                    const FrameProfiler::FrameRecord& frame = frames[i];
+                    bool consistent = frame.pointsDrawn == (uint32_t)frame.totalMicros &&
+                                      frame.startMicros == (uint64_t)frame.totalMicros * 7 &&
+                                      frame.phaseMicros[FrameProfiler::PHASE_COUNT - 1] == frame.totalMicros / FrameProfiler::PHASE_COUNT;
+                    bool ordered = i == 0 || frames[i - 1].index < frame.index;
+                    if (!consistent || !ordered) torn++;
+                }
+                reads++;
+            }
+        });
+
+        for (uint32_t i = 0; i < 200000 || reads.load() < 10; i++) {
+            FrameProfiler::Record(MakeFrame((uint64_t)(i % 65536) * 7, (float)(i % 65536)));
+        }
+        done = true;
+        reader.join();
+
+        ASSERT_EQ((size_t)0, torn.load());
+        ASSERT_TRUE(reads.load() > 0);
+        FrameProfiler::Reset();
+        return true;
+    }
+
+    bool TestDump() {
+        FrameProfiler::Reset();
+        for (int i = 0; i < 3; i++) {
+            FrameProfiler::Record(MakeFrame(i * 16000, 2500.0f));
+        }
+
+        const char* filename = "frame_profile_test.csv";
+        ASSERT_TRUE(FrameProfiler::DumpToFile(filename));
+        std::FILE* file = std::fopen(filename, "r");
+        ASSERT_TRUE(file != nullptr);
+
+        char line[1024];
+        std::vector<std::string> lines;
+        while (std::fgets(line, sizeof(line), file)) lines.push_back(line);
+        std::fclose(file);
+        std::remove(filename);
+
+        ASSERT_EQ((size_t)6, lines.size());
+        ASSERT_TRUE(lines[0][0] == '#' && lines[1][0] == '#');
+        ASSERT_TRUE(lines[1].find("3 frames") != std::string::npos);
+        ASSERT_TRUE(lines[2].find("frame,start_us,total_us,clear_us") == 0);
+        ASSERT_TRUE(lines[2].find("present_us,points,renderer") != std::string::npos);
+        ASSERT_TRUE(lines[5].find("2,32000,2500.0,") == 0);
+        FrameProfiler::Reset();
+        return true;
+    }
+
+    bool TestInputLatency() {
+        FrameProfiler::Reset();
+        std::vector<double> sink;
+        FrameProfiler::SetLatencySink(&sink);
+
+        // Two moves applied before the frame; one arrived 5 ms earlier than it was handled
+        FrameProfiler::InputArrived(FrameProfiler::NowMicros() - 5000);
+        FrameProfiler::InputApplied();
+        FrameProfiler::InputApplied();   // Same input again: counted once
+        FrameProfiler::InputArrived();
+        FrameProfiler::InputApplied();
+        FrameProfiler::InputArrived();   // Never changed the canvas
+
+        FrameProfiler::BeginFrame(false);
+        {
+            FrameProfiler::ScopedPhase phase(FrameProfiler::PHASE_PRESENT);
+            Spin(1000);
+        }
+        Spin(3000);                      // Cleanup after present is not latency
+        FrameProfiler::EndFrame(10);
+
+        // A frame with nothing new to show
+        FrameProfiler::BeginFrame(false);
+        FrameProfiler::EndFrame(10);
+        FrameProfiler::SetLatencySink(nullptr);
+
+        std::vector<FrameProfiler::FrameRecord> frames;
+        ASSERT_EQ((size_t)2, FrameProfiler::Snapshot(frames));
+        ASSERT_EQ((uint32_t)2, frames[0].inputsPresented);
+        ASSERT_TRUE(frames[0].inputLatencyMicros >= 6000.0f && frames[0].inputLatencyMicros < 9000.0f);
+        ASSERT_EQ((uint32_t)0, frames[1].inputsPresented);
+
+        std::vector<double> latencies;
+        ASSERT_EQ((size_t)2, FrameProfiler::LatencySnapshot(latencies));
+        ASSERT_EQ((size_t)2, sink.size());
+        ASSERT_TRUE(latencies[0] >= 6000.0 && latencies[1] >= 1000.0 && latencies[1] < 3000.0);
+
+        FrameProfiler::Summary summary = FrameProfiler::Summarize();
+        ASSERT_EQ((size_t)2, summary.latencySamples);
+        ASSERT_EQ(latencies[0], summary.latencyMaxMicros);
+        FrameProfiler::Reset();
+        return true;
+    }
+
+    bool TestLatencySummary() {
+        std::vector<double> micros;
+        for (int i = 200; i >= 1; i--) micros.push_back(i * 100.0);
+        FrameProfiler::Summary summary;
+        FrameProfiler::SummarizeLatency(micros, summary);
+        ASSERT_EQ((size_t)200, summary.latencySamples);
+        ASSERT_EQ(10000.0, summary.latencyP50Micros);
+        ASSERT_EQ(19000.0, summary.latencyP95Micros);
+        ASSERT_EQ(19800.0, summary.latencyP99Micros);
+        ASSERT_EQ(20000.0, summary.latencyMaxMicros);
+
+        // The ring keeps the latest LATENCY_HISTORY samples
+        FrameProfiler::Reset();
+        for (size_t i = 0; i < FrameProfiler::LATENCY_HISTORY + 10; i++) {
+            FrameProfiler::InputArrived(FrameProfiler::NowMicros());
+            FrameProfiler::InputApplied();
+            FrameProfiler::BeginFrame(true);
+            FrameProfiler::EndFrame(0);
+        }
+        std::vector<double> latencies;
+        ASSERT_EQ(FrameProfiler::LATENCY_HISTORY, FrameProfiler::LatencySnapshot(latencies));
+        FrameProfiler::Reset();
+        ASSERT_EQ((size_t)0, FrameProfiler::LatencySnapshot(latencies));
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Frame Profiler Tests" << std::endl;
+
+    FrameProfilerTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
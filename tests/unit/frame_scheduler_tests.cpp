@@ -0,0 +1,216 @@
+#include "../test_framework.h"
+#include "../../include/frame_scheduler.h"
+#include <algorithm>
+
+// Driven from a fake clock, so pacing is checked without sleeping
+class FrameSchedulerTests {
+private:
+    TestFramework framework;
+    static uint64_t fakeNow;
+
+public:
+    FrameSchedulerTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Frame Scheduler");
+        framework.AddTest("Idle Schedules Nothing", [this]() { return TestIdle(); });
+        framework.AddTest("One Frame Per Interval", [this]() { return TestPacing(); });
+        framework.AddTest("Damage Rectangles Merge", [this]() { return TestMerging(); });
+        framework.AddTest("Expensive Frames Stretch The Interval", [this]() { return TestAdaptive(); });
+        framework.AddTest("Fast Drag Presents At Display Rate", [this]() { return TestDrag(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static uint64_t FakeClock() {
+        return fakeNow;
+    }
+
+    static void Begin() {
+        fakeNow = 1000000;
+        FrameScheduler::SetClock(FakeClock);
+        FrameScheduler::SetTargetInterval(FrameScheduler::DEFAULT_INTERVAL_MICROS);
+        FrameScheduler::Reset();
+    }
+
+    static void End() {
+        FrameScheduler::Reset();
+        FrameScheduler::SetClock(nullptr);
+    }
+
+    static FrameScheduler::Rect MakeRect(int left, int top, int right, int bottom) {
+        FrameScheduler::Rect rect = {left, top, right, bottom};
+        return rect;
+    }
+
+    bool TestIdle() {
+        Begin();
+        FrameScheduler::Frame frame;
+        ASSERT_EQ(FrameScheduler::IDLE, FrameScheduler::TimeUntilDue());
+        ASSERT_FALSE(FrameScheduler::TakeFrame(frame));
+
+        // Empty damage is no damage
+        FrameScheduler::Invalidate(MakeRect(10, 10, 10, 50));
+        ASSERT_EQ(FrameScheduler::IDLE, FrameScheduler::TimeUntilDue());
+
+        // After a frame goes out the scheduler is idle again, however long it waits
+        FrameScheduler::Invalidate(MakeRect(0, 0, 10, 10));
+        ASSERT_TRUE(FrameScheduler::TakeFrame(frame));
+        fakeNow += 10000000;
+        ASSERT_EQ(FrameScheduler::IDLE, FrameScheduler::TimeUntilDue());
+        ASSERT_EQ((uint64_t)1, FrameScheduler::GetStats().frames);
+        End();
+        return true;
+    }
+
+    bool TestPacing() {
+        Begin();
+        FrameScheduler::Frame frame;
+
+        // The first damage after a quiet spell is due at once
+        FrameScheduler::Invalidate(MakeRect(0, 0, 100, 100));
+        ASSERT_EQ((uint64_t)0, FrameScheduler::TimeUntilDue());
+        ASSERT_TRUE(FrameScheduler::TakeFrame(frame));
+        ASSERT_EQ((size_t)1, frame.count);
+
+        // More within the interval waits for the rest of it, and coalesces
+        fakeNow += 4000;
+        for (int i = 0; i < 50; i++) {
+            FrameScheduler::Invalidate(MakeRect(i, 0, i + 10, 10));
+        }
+        ASSERT_EQ(FrameScheduler::DEFAULT_INTERVAL_MICROS - 4000, FrameScheduler::TimeUntilDue());
+        ASSERT_FALSE(FrameScheduler::TakeFrame(frame));
+        fakeNow += FrameScheduler::DEFAULT_INTERVAL_MICROS - 4000;
+        ASSERT_TRUE(FrameScheduler::TakeFrame(frame));
+        ASSERT_EQ((size_t)1, frame.count);
+        ASSERT_EQ(0, frame.rects[0].left);
+        ASSERT_EQ(59, frame.rects[0].right);
+
+        FrameScheduler::Stats stats = FrameScheduler::GetStats();
+        ASSERT_EQ((uint64_t)51, stats.requests);
+        ASSERT_EQ((uint64_t)49, stats.coalesced);
+        ASSERT_EQ((uint64_t)2, stats.frames);
+
+        // A faster display shortens the wait
+        FrameScheduler::SetTargetInterval(1000000 / 144);
+        FrameScheduler::Invalidate(MakeRect(0, 0, 1, 1));
+        ASSERT_EQ((uint64_t)(1000000 / 144), FrameScheduler::TimeUntilDue());
+        End();
+        return true;
+    }
+
+    bool TestMerging() {
+        Begin();
+        FrameScheduler::Frame frame;
+
+        // Toolbar and status bar stay apart; touching canvas damage joins up
+        FrameScheduler::Invalidate(MakeRect(0, 0, 1000, 60));
+        FrameScheduler::Invalidate(MakeRect(0, 770, 1000, 800));
+        FrameScheduler::Invalidate(MakeRect(100, 100, 200, 200));
+        FrameScheduler::Invalidate(MakeRect(200, 150, 260, 220));
+        ASSERT_TRUE(FrameScheduler::TakeFrame(frame));
+        ASSERT_FALSE(frame.whole);
+        ASSERT_EQ((size_t)3, frame.count);
+        ASSERT_EQ(260, frame.rects[2].right);
+        ASSERT_EQ(220, frame.rects[2].bottom);
+
+        // Past MAX_RECTS the damage collapses into its bounds
+        fakeNow += FrameScheduler::DEFAULT_INTERVAL_MICROS;
+        for (int i = 0; i <= (int)FrameScheduler::MAX_RECTS; i++) {
+            FrameScheduler::Invalidate(MakeRect(i * 100, i * 50, i * 100 + 10, i * 50 + 10));
+        }
+        ASSERT_TRUE(FrameScheduler::TakeFrame(frame));
+        ASSERT_EQ((size_t)1, frame.count);
+        ASSERT_EQ(0, frame.rects[0].left);
+        ASSERT_EQ((int)FrameScheduler::MAX_RECTS * 100 + 10, frame.rects[0].right);
+
+        // The whole window absorbs everything else
+        fakeNow += FrameScheduler::DEFAULT_INTERVAL_MICROS;
+        FrameScheduler::Invalidate(MakeRect(5, 5, 10, 10));
+        FrameScheduler::InvalidateAll();
+        FrameScheduler::Invalidate(MakeRect(50, 50, 60, 60));
+        ASSERT_TRUE(FrameScheduler::TakeFrame(frame));
+        ASSERT_TRUE(frame.whole);
+        ASSERT_EQ((size_t)0, frame.count);
+        End();
+        return true;
+    }
+
+    bool TestAdaptive() {
+        Begin();
+        ASSERT_EQ(FrameScheduler::DEFAULT_INTERVAL_MICROS, FrameScheduler::CurrentInterval());
+
+        // A 30 ms paint leaves input the other half of a 60 ms interval
+        FrameScheduler::FramePresented(30000);
+        ASSERT_EQ((uint64_t)60000, FrameScheduler::CurrentInterval());
+        FrameScheduler::Frame frame;
+        FrameScheduler::Invalidate(MakeRect(0, 0, 10, 10));
+        ASSERT_TRUE(FrameScheduler::TakeFrame(frame));
+        FrameScheduler::Invalidate(MakeRect(0, 0, 10, 10));
+        ASSERT_EQ((uint64_t)60000, FrameScheduler::TimeUntilDue());
+
+        // Stretching is capped, and cheap frames bring it back to the display rate
+        FrameScheduler::FramePresented(1000000);
+        ASSERT_EQ(FrameScheduler::MAX_INTERVAL_MICROS, FrameScheduler::CurrentInterval());
+        for (int i = 0; i < 100; i++) {
+            FrameScheduler::FramePresented(2000);
+        }
+        ASSERT_EQ(FrameScheduler::DEFAULT_INTERVAL_MICROS, FrameScheduler::CurrentInterval());
+        End();
+        return true;
+    }
+
+    bool TestDrag() {
+        Begin();
+
+        // A second of 1 kHz pointer input, each move damaging the canvas; the
+        // loop presents between messages whenever a frame is due
+        FrameScheduler::Frame frame;
+        uint64_t oldestDamage = 0;
+        uint64_t worstWait = 0;
+        int frames = 0;
+        for (int move = 0; move < 1000; move++) {
+            fakeNow += 1000;
+            if (!oldestDamage) {
+                oldestDamage = fakeNow;
+            }
+            FrameScheduler::Invalidate(MakeRect(move % 800, 100, move % 800 + 12, 112));
+            if (FrameScheduler::TakeFrame(frame)) {
+                worstWait = std::max(worstWait, fakeNow - oldestDamage);
+                oldestDamage = 0;
+                FrameScheduler::FramePresented(3000);
+                frames++;
+            }
+        }
+
+        // About one frame per 16.7 ms instead of one per move, and no damage
+        // waited longer than an interval
+        ASSERT_TRUE(frames >= 55 && frames <= 61);
+        ASSERT_TRUE(worstWait <= FrameScheduler::DEFAULT_INTERVAL_MICROS);
+        FrameScheduler::Stats stats = FrameScheduler::GetStats();
+        ASSERT_EQ((uint64_t)1000, stats.requests);
+        ASSERT_EQ((uint64_t)frames, stats.frames);
+        End();
+        return true;
+    }
+};
+
+uint64_t FrameSchedulerTests::fakeNow = 0;
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Frame Scheduler Tests" << std::endl;
+
+    FrameSchedulerTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
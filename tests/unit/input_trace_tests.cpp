@@ -0,0 +1,442 @@
+#include "../test_framework.h"
+#include "../../include/input_trace.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/app_state.h"
+#include "../../include/config.h"
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+class InputTraceTests {
+private:
+    TestFramework framework;
+
+public:
+    InputTraceTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Trace Format");
+        framework.AddTest("Save And Load Round Trip", [this]() { return TestRoundTrip(); });
+        framework.AddTest("Pointer Events Stay Compact", [this]() { return TestCompact(); });
+        framework.AddTest("Truncated Trace Keeps Complete Events", [this]() { return TestTruncated(); });
+        framework.AddTest("Recording Captures Session And Events", [this]() { return TestRecording(); });
+        framework.AddTest("Events Wait For A Late Document", [this]() { return TestLateDocument(); });
+
+        framework.AddSuite("Replay");
+        framework.AddTest("Replay Matches Direct Engine Calls", [this]() { return TestReplayMatchesEngine(); });
+        framework.AddTest("Toolbar, Keys And Commands", [this]() { return TestToolbarKeysCommands(); });
+        framework.AddTest("Zoom And Pan Map Later Clicks", [this]() { return TestZoomAndPan(); });
+        framework.AddTest("Replays Are Deterministic", [this]() { return TestDeterministic(); });
+        framework.AddTest("Paced Replay Measures Input To Present", [this]() { return TestPacedReplay(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static InputTrace::Event MakeEvent(uint64_t time, InputTrace::EventType type, int x, int y, int code = 0, uint8_t flags = 0) {
+        InputTrace::Event event;
+        event.timeMicros = time;
+        event.type = type;
+        event.x = x;
+        event.y = y;
+        event.code = code;
+        event.flags = flags;
+        return event;
+    }
+
+    static InputTrace::Session CanvasSession() {
+        InputTrace::Session session;
+        session.clientWidth = 1200;
+        session.clientHeight = 800;
+        session.color = RGB(10, 20, 30);
+        session.brushSize = 6;
+        return session;
+    }
+
+    // A brush stroke dragged across the canvas, in client coordinates
+    static void AddStroke(InputTrace::Trace& trace, int x, int y, int steps, uint64_t& time) {
+        trace.events.push_back(MakeEvent(time += 1000, InputTrace::EVENT_BUTTON_DOWN, x, y));
+        for (int i = 1; i <= steps; i++) {
+            trace.events.push_back(MakeEvent(time += 8000, InputTrace::EVENT_MOUSE_MOVE, x + i * 3, y + (i % 5),
+                                             0, InputTrace::FLAG_LBUTTON));
+        }
+        trace.events.push_back(MakeEvent(time += 1000, InputTrace::EVENT_BUTTON_UP, x + steps * 3, y));
+    }
+
+    static bool SameEvents(const std::vector<InputTrace::Event>& a, const std::vector<InputTrace::Event>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].timeMicros != b[i].timeMicros || a[i].type != b[i].type || a[i].flags != b[i].flags ||
+                a[i].x != b[i].x || a[i].y != b[i].y || a[i].code != b[i].code) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool SamePoints(const std::vector<DrawPoint>& a, const std::vector<DrawPoint>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].color != b[i].color || a[i].isStart != b[i].isStart ||
+                a[i].brushSize != b[i].brushSize || a[i].toolType != b[i].toolType) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static long FileSize(const char* filename) {
+        std::FILE* file = std::fopen(filename, "rb");
+        if (!file) return -1;
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fclose(file);
+        return size;
+    }
+
+    bool TestRoundTrip() {
+        const char* filename = "trace_test_roundtrip.mpst";
+        InputTrace::Trace trace;
+        trace.session = CanvasSession();
+        trace.session.zoomLevel = 1.5f;
+        trace.session.panX = -40;
+        trace.session.tool = TOOL_ERASER;
+        trace.session.document.push_back({ 5, -7, RGB(1, 2, 3), true, 4, TOOL_BRUSH });
+
+        uint64_t time = 0;
+        AddStroke(trace, 100, 200, 10, time);
+        trace.events.push_back(MakeEvent(time += 5, InputTrace::EVENT_MOUSE_MOVE, 0, 65535));
+        trace.events.push_back(MakeEvent(time += 5, InputTrace::EVENT_KEY_DOWN, 0, 0, 'Z', InputTrace::FLAG_CTRL));
+        trace.events.push_back(MakeEvent(time += 5, InputTrace::EVENT_COMMAND, 0, 0, IDM_EDIT_REDO));
+        trace.events.push_back(MakeEvent(time += 5, InputTrace::EVENT_MOUSE_WHEEL, 0, 0, -120, InputTrace::FLAG_CTRL));
+        trace.events.push_back(MakeEvent(time += 123456789, InputTrace::EVENT_RESIZE, 640, 480));
+
+        ASSERT_TRUE(InputTrace::Save(filename, trace));
+        InputTrace::Trace loaded;
+        ASSERT_TRUE(InputTrace::Load(filename, loaded));
+        std::remove(filename);
+
+        ASSERT_TRUE(SameEvents(trace.events, loaded.events));
+        ASSERT_EQ(1.5f, loaded.session.zoomLevel);
+        ASSERT_EQ(-40, loaded.session.panX);
+        ASSERT_EQ(800, loaded.session.clientHeight);
+        ASSERT_EQ(TOOL_ERASER, loaded.session.tool);
+        ASSERT_TRUE(SamePoints(trace.session.document, loaded.session.document));
+
+        ASSERT_FALSE(InputTrace::Load("trace_test_missing.mpst", loaded));
+        return true;
+    }
+
+    bool TestCompact() {
+        const char* filename = "trace_test_compact.mpst";
+        InputTrace::Trace trace;
+        trace.session = CanvasSession();
+        uint64_t time = 0;
+        AddStroke(trace, 300, 300, 1000, time);
+
+        ASSERT_TRUE(InputTrace::Save(filename, trace));
+        InputTrace::Trace empty;
+        empty.session = trace.session;
+        const char* headerOnly = "trace_test_header.mpst";
+        ASSERT_TRUE(InputTrace::Save(headerOnly, empty));
+
+        // Tag, time delta and two small coordinate deltas: 5 bytes per move,
+        // plus a few for the first event's absolute position
+        long eventBytes = FileSize(filename) - FileSize(headerOnly);
+        std::remove(filename);
+        std::remove(headerOnly);
+        ASSERT_TRUE(eventBytes <= (long)trace.events.size() * 5 + 4);
+        return true;
+    }
+
+    bool TestTruncated() {
+        const char* filename = "trace_test_truncated.mpst";
+        InputTrace::Trace trace;
+        trace.session = CanvasSession();
+        uint64_t time = 0;
+        AddStroke(trace, 100, 100, 20, time);
+        ASSERT_TRUE(InputTrace::Save(filename, trace));
+
+        // Drop the last byte, as a crash mid-write would
+        std::FILE* file = std::fopen(filename, "rb");
+        std::vector<char> bytes(FileSize(filename));
+        ASSERT_TRUE(std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size());
+        std::fclose(file);
+        file = std::fopen(filename, "wb");
+        std::fwrite(bytes.data(), 1, bytes.size() - 1, file);
+        std::fclose(file);
+
+        InputTrace::Trace loaded;
+        ASSERT_TRUE(InputTrace::Load(filename, loaded));
+        std::remove(filename);
+        ASSERT_EQ(trace.events.size() - 1, loaded.events.size());
+        trace.events.pop_back();
+        ASSERT_TRUE(SameEvents(trace.events, loaded.events));
+        return true;
+    }
+
+    bool TestRecording() {
+        const char* filename = "trace_test_recording.mpst";
+        AppState& app = AppState::Instance();
+        app.drawingPoints.clear();
+        app.drawingPoints.push_back({ 1, 2, RGB(3, 4, 5), true, 6, TOOL_BRUSH });
+        app.currentTool = TOOL_LINE;
+        app.brushSize = 9;
+        app.zoomLevel = 2.0f;
+
+        InputTrace::Record(InputTrace::EVENT_KEY_DOWN, 0, 0, 'B');   // Not recording: dropped
+        ASSERT_FALSE(InputTrace::IsRecording());
+        ASSERT_TRUE(InputTrace::StartRecording(filename, 1024, 768));
+        ASSERT_TRUE(InputTrace::IsRecording());
+        InputTrace::Record(InputTrace::EVENT_BUTTON_DOWN, 400, 300);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        InputTrace::Record(InputTrace::EVENT_MOUSE_MOVE, 410, 305, 0, InputTrace::FLAG_LBUTTON);
+        InputTrace::Record(InputTrace::EVENT_BUTTON_UP, 410, 305);
+        InputTrace::Record(InputTrace::EVENT_COMMAND, 0, 0, IDM_EDIT_UNDO);
+        ASSERT_TRUE(InputTrace::StopRecording());
+        ASSERT_FALSE(InputTrace::StopRecording());
+
+        InputTrace::Trace trace;
+        ASSERT_TRUE(InputTrace::Load(filename, trace));
+        std::remove(filename);
+
+        ASSERT_EQ((size_t)4, trace.events.size());
+        ASSERT_EQ(InputTrace::EVENT_BUTTON_DOWN, trace.events[0].type);
+        ASSERT_EQ(410, trace.events[1].x);
+        ASSERT_EQ(InputTrace::FLAG_LBUTTON, trace.events[1].flags);
+        ASSERT_EQ(IDM_EDIT_UNDO, trace.events[3].code);
+        ASSERT_TRUE(trace.events[1].timeMicros >= trace.events[0].timeMicros + 2000);
+        ASSERT_EQ(1024, trace.session.clientWidth);
+        ASSERT_EQ(TOOL_LINE, trace.session.tool);
+        ASSERT_EQ(9, trace.session.brushSize);
+        ASSERT_EQ(2.0f, trace.session.zoomLevel);
+        ASSERT_TRUE(SamePoints(app.drawingPoints, trace.session.document));
+
+        app.drawingPoints.clear();
+        app.zoomLevel = 1.0f;
+        app.currentTool = TOOL_BRUSH;
+        return true;
+    }
+
+    bool TestLateDocument() {
+        // The window begins recording, then completes it when the engine hands
+        // over the document; events in between are kept, in order
+        const char* filename = "trace_test_late.mpst";
+        std::vector<DrawPoint> document(1, DrawPoint{ 7, 8, RGB(1, 2, 3), true, 4, TOOL_BRUSH });
+        ASSERT_TRUE(InputTrace::BeginRecording(filename, 800, 600));
+        ASSERT_TRUE(InputTrace::IsRecording());
+        InputTrace::Record(InputTrace::EVENT_BUTTON_DOWN, 100, 100);
+        InputTrace::Record(InputTrace::EVENT_MOUSE_MOVE, 120, 90, 0, InputTrace::FLAG_LBUTTON);
+        ASSERT_TRUE(InputTrace::CompleteRecording(document));
+        ASSERT_FALSE(InputTrace::CompleteRecording(document));
+        InputTrace::Record(InputTrace::EVENT_BUTTON_UP, 130, 95);
+        ASSERT_TRUE(InputTrace::StopRecording());
+
+        InputTrace::Trace trace;
+        ASSERT_TRUE(InputTrace::Load(filename, trace));
+        std::remove(filename);
+        ASSERT_EQ((size_t)3, trace.events.size());
+        ASSERT_EQ(120, trace.events[1].x);
+        ASSERT_EQ(130, trace.events[2].x);
+        ASSERT_EQ(95, trace.events[2].y);
+        ASSERT_TRUE(SamePoints(document, trace.session.document));
+
+        // Stopped before the document came: nothing is left behind
+        ASSERT_TRUE(InputTrace::BeginRecording(filename, 800, 600));
+        InputTrace::Record(InputTrace::EVENT_BUTTON_DOWN, 100, 100);
+        ASSERT_FALSE(InputTrace::StopRecording());
+        ASSERT_FALSE(InputTrace::Load(filename, trace));
+        return true;
+    }
+
+    bool TestReplayMatchesEngine() {
+        AppState& app = AppState::Instance();
+        InputTrace::Trace trace;
+        trace.session = CanvasSession();
+        uint64_t time = 0;
+        AddStroke(trace, 100, 200, 30, time);
+        AddStroke(trace, 500, 400, 12, time);
+
+        InputTrace::ReplayStats stats = InputTrace::Replay(trace);
+        std::vector<DrawPoint> replayed = app.drawingPoints;
+        ASSERT_EQ(trace.events.size(), stats.events);
+        ASSERT_EQ((size_t)0, stats.ignored);
+        ASSERT_EQ(trace.events.size(), stats.all.count);
+        ASSERT_EQ((size_t)42, stats.byType[InputTrace::EVENT_MOUSE_MOVE].count);
+        ASSERT_TRUE(stats.all.p50Micros <= stats.all.p99Micros && stats.all.p99Micros <= stats.all.maxMicros);
+        ASSERT_TRUE(stats.eventsPerSecond > 0);
+
+        // The same strokes through DrawingEngine in document coordinates
+        app.drawingPoints.clear();
+        for (const InputTrace::Event& event : trace.events) {
+            int x = event.x, y = event.y - TOOLBAR_HEIGHT;
+            if (event.type == InputTrace::EVENT_BUTTON_DOWN) DrawingEngine::StartDrawing(x, y);
+            if (event.type == InputTrace::EVENT_MOUSE_MOVE) DrawingEngine::ContinueDrawing(x, y);
+            if (event.type == InputTrace::EVENT_BUTTON_UP) DrawingEngine::EndDrawing();
+        }
+        ASSERT_TRUE(SamePoints(app.drawingPoints, replayed));
+        ASSERT_EQ((size_t)44, replayed.size());
+        ASSERT_EQ(RGB(10, 20, 30), replayed[0].color);
+        ASSERT_EQ(6, replayed[0].brushSize);
+
+        app.drawingPoints.clear();
+        return true;
+    }
+
+    bool TestToolbarKeysCommands() {
+        AppState& app = AppState::Instance();
+        InputTrace::Trace trace;
+        trace.session = CanvasSession();
+        uint64_t time = 0;
+
+        // Line tool from the toolbar, then a line drag
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_BUTTON_DOWN, 4 * 50 + 10, 20));
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_BUTTON_UP, 4 * 50 + 10, 20));
+        AddStroke(trace, 100, 100, 10, time);
+        size_t afterLine = trace.events.size();
+
+        // Brush size 8 from the keyboard, a brush stroke, then undo
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_KEY_DOWN, 0, 0, 'B'));
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_KEY_DOWN, 0, 0, '4'));
+        AddStroke(trace, 300, 300, 5, time);
+        size_t beforeUndo = trace.events.size();
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_KEY_DOWN, 0, 0, 'Z'));   // No Ctrl: ignored
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_COMMAND, 0, 0, IDM_EDIT_UNDO));
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_COMMAND, 0, 0, IDM_FILE_OPEN));   // Dialog: ignored
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_MOUSE_MOVE, 700, 500));   // Hover: ignored
+
+        InputTrace::Trace lineOnly = trace;
+        lineOnly.events.resize(afterLine);
+        InputTrace::Replay(lineOnly);
+        std::vector<DrawPoint> line = app.drawingPoints;
+        ASSERT_TRUE(line.size() > 10);
+        ASSERT_EQ(TOOL_LINE, line[0].toolType);
+
+        // Undo through the trace matches the engine's own Undo
+        InputTrace::Trace noUndo = trace;
+        noUndo.events.resize(beforeUndo);
+        InputTrace::Replay(noUndo);
+        ASSERT_EQ((size_t)(line.size() + 6), app.drawingPoints.size());
+        ASSERT_EQ(8, app.drawingPoints.back().brushSize);
+        DrawingEngine::Undo();
+        std::vector<DrawPoint> undone = app.drawingPoints;
+
+        InputTrace::ReplayStats stats = InputTrace::Replay(trace);
+        ASSERT_EQ((size_t)3, stats.ignored);
+        ASSERT_EQ(8, app.brushSize);
+        ASSERT_EQ(TOOL_BRUSH, app.currentTool);
+        ASSERT_TRUE(SamePoints(undone, app.drawingPoints));
+
+        app.drawingPoints.clear();
+        app.brushSize = 5;
+        return true;
+    }
+
+    bool TestZoomAndPan() {
+        AppState& app = AppState::Instance();
+        InputTrace::Trace trace;
+        trace.session = CanvasSession();
+        uint64_t time = 0;
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_MOUSE_WHEEL, 0, 0, 120, InputTrace::FLAG_CTRL));
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_MOUSE_WHEEL, 0, 0, -120));
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_BUTTON_DOWN, 220, 280));
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_BUTTON_UP, 220, 280));
+
+        // Shrinking the window moves the status bar over the next click
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_RESIZE, 600, 300));
+        trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_BUTTON_DOWN, 100, 290));
+
+        InputTrace::ReplayStats stats = InputTrace::Replay(trace);
+        ASSERT_EQ((size_t)1, app.drawingPoints.size());
+        ASSERT_EQ((size_t)1, stats.ignored);
+        ASSERT_EQ(1.1f, app.zoomLevel);
+        ASSERT_EQ(-20, app.panY);
+        ASSERT_EQ((int)(220 / 1.1f), app.drawingPoints[0].x);
+        ASSERT_EQ((int)((280 + 20 - TOOLBAR_HEIGHT) / 1.1f), app.drawingPoints[0].y);
+
+        app.drawingPoints.clear();
+        app.zoomLevel = 1.0f;
+        app.panY = 0;
+        return true;
+    }
+
+    bool TestDeterministic() {
+        AppState& app = AppState::Instance();
+        InputTrace::Trace trace;
+        trace.session = CanvasSession();
+        trace.session.document.push_back({ 50, 50, RGB(0, 0, 0), true, 5, TOOL_BRUSH });
+        uint64_t time = 0;
+        for (int stroke = 0; stroke < 20; stroke++) {
+            AddStroke(trace, 80 + stroke * 20, 120 + stroke * 10, 25, time);
+            if (stroke % 4 == 3) {
+                trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_KEY_DOWN, 0, 0, 'E'));
+            } else if (stroke % 4 == 0) {
+                trace.events.push_back(MakeEvent(time += 10, InputTrace::EVENT_KEY_DOWN, 0, 0, 'B'));
+            }
+        }
+
+        InputTrace::Replay(trace);
+        std::vector<DrawPoint> first = app.drawingPoints;
+        InputTrace::Replay(trace);
+        ASSERT_TRUE(SamePoints(first, app.drawingPoints));
+        ASSERT_TRUE(first.size() > 1);
+
+        app.drawingPoints.clear();
+        app.currentTool = TOOL_BRUSH;
+        return true;
+    }
+
+    bool TestPacedReplay() {
+        AppState& app = AppState::Instance();
+        InputTrace::Trace trace;
+        trace.session = CanvasSession();
+        uint64_t time = 0;
+        AddStroke(trace, 100, 200, 20, time);
+        AddStroke(trace, 300, 300, 10, time);
+        trace.events.push_back(MakeEvent(time += 5000, InputTrace::EVENT_KEY_DOWN, 0, 0, 'E'));
+
+        InputTrace::Replay(trace);
+        std::vector<DrawPoint> fast = app.drawingPoints;
+        InputTrace::ReplayStats stats = InputTrace::Replay(trace, true);
+        ASSERT_TRUE(SamePoints(fast, app.drawingPoints));
+        ASSERT_TRUE(stats.seconds >= time / 1e6);
+
+        // Every pointer event reaches a frame; the tool change does not count
+        ASSERT_EQ((size_t)34, stats.paint.latencySamples);
+        ASSERT_TRUE(stats.frames >= 2 && stats.frames <= 35);
+        ASSERT_TRUE(stats.paint.latencyP50Micros > 0.0);
+        ASSERT_TRUE(stats.paint.latencyP50Micros <= stats.paint.latencyP95Micros);
+        ASSERT_TRUE(stats.paint.latencyP95Micros <= stats.paint.latencyP99Micros);
+        ASSERT_TRUE(stats.paint.latencyP99Micros <= stats.paint.latencyMaxMicros);
+
+        // Unpaced replays paint nothing
+        stats = InputTrace::Replay(trace);
+        ASSERT_EQ((size_t)0, stats.frames);
+        ASSERT_EQ((size_t)0, stats.paint.latencySamples);
+
+        app.drawingPoints.clear();
+        app.currentTool = TOOL_BRUSH;
+        FrameProfiler::Reset();
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Input Trace Tests" << std::endl;
+
+    // These tests count stored points; decimation has its own tests
+    AppState::Instance().strokeTolerance = 0.0;
+
+    InputTraceTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
@@ -0,0 +1,401 @@
+#include "../test_framework.h"
+#include "../../include/job_pool.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/app_state.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Job pool tests - jobs run on the real workers; the test thread plays the UI,
+// answering notify with HandleCompleted
+class JobPoolTests {
+private:
+    TestFramework framework;
+
+public:
+    JobPoolTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Job Pool");
+        framework.AddTest("Inline Until Started", [this]() { return TestInline(); });
+        framework.AddTest("Completions Run On The UI Thread", [this]() { return TestCompletions(); });
+        framework.AddTest("Jobs Beyond The Workers Queue", [this]() { return TestQueueing(); });
+        framework.AddTest("Cancellation", [this]() { return TestCancel(); });
+        framework.AddTest("Progress Notifies Once Per Answer", [this]() { return TestProgress(); });
+        framework.AddTest("Stop Runs Pending Completions", [this]() { return TestStop(); });
+
+        framework.AddSuite("Background Export");
+        framework.AddTest("Exports A Copy Of The Document", [this]() { return TestExportCopy(); });
+        framework.AddTest("Cancelled Export Leaves No File", [this]() { return TestExportCancel(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static std::atomic<int> notifications;
+
+    static void StartPool(int workers) {
+        notifications = 0;
+        JobPool::Start(workers, []() { notifications++; });
+    }
+
+    template <typename Condition>
+    static bool WaitUntil(Condition until) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!until()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        return true;
+    }
+
+    // Plays the UI's message loop until 'until' holds
+    template <typename Condition>
+    static bool Pump(Condition until) {
+        return WaitUntil([&until]() {
+            if (notifications > 0) {
+                notifications = 0;
+                JobPool::HandleCompleted();
+            }
+            return until();
+        });
+    }
+
+    static bool WaitFor(const std::atomic<bool>& flag) {
+        return Pump([&flag]() { return flag.load(); });
+    }
+
+    static bool FileExists(const char* filename) {
+        std::FILE* file = std::fopen(filename, "rb");
+        if (file) {
+            std::fclose(file);
+        }
+        return file != nullptr;
+    }
+
+    bool TestInline() {
+        ASSERT_FALSE(JobPool::IsRunning());
+        JobPool::Stats before = JobPool::GetStats();
+        std::thread::id worker;
+        JobPool::Result result = JobPool::JOB_FAILED;
+        JobPool::JobId id = JobPool::Submit("inline",
+            [&worker](const JobPool::Progress&) { worker = std::this_thread::get_id(); return true; },
+            [&result](JobPool::Result r) { result = r; });
+        ASSERT_TRUE(id > 0);
+        ASSERT_TRUE(worker == std::this_thread::get_id());
+        ASSERT_EQ((int)JobPool::JOB_SUCCEEDED, (int)result);
+        ASSERT_TRUE(JobPool::ActiveJobs().empty());
+        ASSERT_EQ((size_t)0, JobPool::HandleCompleted());
+
+        JobPool::Submit("fails", [](const JobPool::Progress&) { return false; }, [&result](JobPool::Result r) { result = r; });
+        ASSERT_EQ((int)JobPool::JOB_FAILED, (int)result);
+        JobPool::Stats after = JobPool::GetStats();
+        ASSERT_EQ(before.submitted + 2, after.submitted);
+        ASSERT_EQ(before.succeeded + 1, after.succeeded);
+        ASSERT_EQ(before.failed + 1, after.failed);
+        return true;
+    }
+
+    bool TestCompletions() {
+        StartPool(2);
+        ASSERT_TRUE(JobPool::IsRunning());
+        std::thread::id ui = std::this_thread::get_id();
+        std::atomic<int> ranOnWorker{0};
+        std::vector<JobPool::Result> results;
+        bool completedOnUi = true;
+        for (int i = 0; i < 6; i++) {
+            JobPool::Submit("job",
+                [&ranOnWorker, ui, i](const JobPool::Progress&) {
+                    ranOnWorker += (std::this_thread::get_id() != ui) ? 1 : 0;
+                    return i % 3 != 0;
+                },
+                [&results, &completedOnUi, ui](JobPool::Result result) {
+                    completedOnUi = completedOnUi && std::this_thread::get_id() == ui;
+                    results.push_back(result);
+                });
+        }
+        ASSERT_TRUE(Pump([&results]() { return results.size() == 6; }));
+        JobPool::Stop();
+
+        ASSERT_EQ(6, ranOnWorker.load());
+        ASSERT_TRUE(completedOnUi);
+        ASSERT_EQ((long)2, (long)std::count(results.begin(), results.end(), JobPool::JOB_FAILED));
+        ASSERT_EQ((long)4, (long)std::count(results.begin(), results.end(), JobPool::JOB_SUCCEEDED));
+        ASSERT_TRUE(JobPool::ActiveJobs().empty());
+        return true;
+    }
+
+    bool TestQueueing() {
+        StartPool(2);
+        std::atomic<bool> release{false};
+        std::atomic<int> started{0};
+        std::atomic<int> done{0};
+        for (int i = 0; i < 4; i++) {
+            JobPool::Submit(i < 2 ? "first" : "later",
+                [&release, &started](const JobPool::Progress&) {
+                    started++;
+                    while (!release) std::this_thread::yield();
+                    return true;
+                },
+                [&done](JobPool::Result) { done++; });
+        }
+        ASSERT_TRUE(Pump([&started]() { return started == 2; }));
+
+        // Two run, two wait their turn, all listed oldest first
+        std::vector<JobPool::JobStatus> jobs = JobPool::ActiveJobs();
+        ASSERT_EQ((size_t)4, jobs.size());
+        ASSERT_TRUE(jobs[0].running && jobs[1].running);
+        ASSERT_TRUE(!jobs[2].running && !jobs[3].running);
+        ASSERT_TRUE(jobs[0].id < jobs[1].id && jobs[2].id < jobs[3].id);
+        ASSERT_TRUE(jobs[2].name == "later");
+        ASSERT_EQ(2, started.load());
+
+        release = true;
+        ASSERT_TRUE(Pump([&done]() { return done == 4; }));
+        JobPool::Stop();
+        return true;
+    }
+
+    bool TestCancel() {
+        StartPool(1);
+        std::atomic<bool> runningJob{false};
+        std::atomic<bool> queuedRan{false};
+        std::vector<JobPool::Result> results;
+        JobPool::JobId first = JobPool::Submit("long",
+            [&runningJob](const JobPool::Progress& progress) {
+                runningJob = true;
+                while (!progress.Cancelled()) std::this_thread::yield();
+                return false;
+            },
+            [&results](JobPool::Result result) { results.push_back(result); });
+        JobPool::JobId second = JobPool::Submit("queued",
+            [&queuedRan](const JobPool::Progress&) { queuedRan = true; return true; },
+            [&results](JobPool::Result result) { results.push_back(result); });
+        ASSERT_TRUE(WaitFor(runningJob));
+
+        // The queued job completes at once without running; the running one
+        // completes when it notices
+        JobPool::Cancel(second);
+        ASSERT_TRUE(Pump([&results]() { return results.size() == 1; }));
+        ASSERT_EQ((int)JobPool::JOB_CANCELLED, (int)results[0]);
+        std::vector<JobPool::JobStatus> jobs = JobPool::ActiveJobs();
+        ASSERT_EQ((size_t)1, jobs.size());
+        ASSERT_FALSE(jobs[0].cancelling);
+
+        JobPool::Cancel(first);
+        ASSERT_TRUE(Pump([&results]() { return results.size() == 2; }));
+        ASSERT_EQ((int)JobPool::JOB_CANCELLED, (int)results[1]);
+        ASSERT_FALSE(queuedRan.load());
+
+        // CancelAll reaches every job; a job that finishes anyway still succeeds
+        std::atomic<bool> release{false};
+        int cancelled = 0, succeeded = 0;
+        for (int i = 0; i < 3; i++) {
+            JobPool::Submit("batch",
+                [&release](const JobPool::Progress&) { while (!release) std::this_thread::yield(); return true; },
+                [&cancelled, &succeeded](JobPool::Result result) {
+                    cancelled += result == JobPool::JOB_CANCELLED ? 1 : 0;
+                    succeeded += result == JobPool::JOB_SUCCEEDED ? 1 : 0;
+                });
+        }
+        Pump([]() { return JobPool::ActiveJobs().size() == 3 && JobPool::ActiveJobs()[0].running; });
+        JobPool::CancelAll();
+        ASSERT_TRUE(JobPool::ActiveJobs()[0].cancelling);
+        release = true;
+        ASSERT_TRUE(Pump([&cancelled, &succeeded]() { return cancelled + succeeded == 3; }));
+        ASSERT_EQ(2, cancelled);
+        ASSERT_EQ(1, succeeded);
+        JobPool::Stop();
+        return true;
+    }
+
+    bool TestProgress() {
+        StartPool(1);
+        std::atomic<int> step{0};
+        std::atomic<int> reported{0};
+        JobPool::Submit("steps", [&step, &reported](const JobPool::Progress& progress) {
+            for (int i = 1; i <= 4; i++) {
+                while (step < i) std::this_thread::yield();
+                progress.Report(i / 8.0);
+                progress.Report(i / 8.0 + 0.001);   // Within the same percent
+                reported = i;
+            }
+            while (step < 5) std::this_thread::yield();
+            return true;
+        });
+
+        step = 1;
+        ASSERT_TRUE(WaitUntil([&reported]() { return reported == 1; }));
+        ASSERT_EQ(1, notifications.load());
+        std::vector<JobPool::JobStatus> jobs = JobPool::ActiveJobs();
+        ASSERT_EQ((size_t)1, jobs.size());
+        ASSERT_TRUE(jobs[0].progress > 0.12 && jobs[0].progress < 0.13);
+
+        // Until the UI answers, further progress does not notify again
+        step = 3;
+        ASSERT_TRUE(WaitUntil([&reported]() { return reported == 3; }));
+        ASSERT_EQ(1, notifications.load());
+        ASSERT_TRUE(JobPool::ActiveJobs()[0].progress > 0.37);
+        ASSERT_EQ((size_t)0, JobPool::HandleCompleted());
+        step = 4;
+        ASSERT_TRUE(WaitUntil([&reported]() { return reported == 4; }));
+        ASSERT_EQ(2, notifications.load());
+
+        step = 5;
+        ASSERT_TRUE(Pump([]() { return JobPool::ActiveJobs().empty(); }));
+        JobPool::Stop();
+        return true;
+    }
+
+    bool TestStop() {
+        StartPool(1);
+        std::atomic<bool> started{false};
+        std::vector<JobPool::Result> results;
+        auto record = [&results](JobPool::Result result) { results.push_back(result); };
+        // Finished but not yet handled, as a save waiting to rename its file is
+        JobPool::Submit("finished", [](const JobPool::Progress&) { return true; }, record);
+        while (!JobPool::ActiveJobs().empty()) std::this_thread::yield();
+        JobPool::Submit("long",
+            [&started](const JobPool::Progress& progress) {
+                started = true;
+                while (!progress.Cancelled()) std::this_thread::yield();
+                return false;
+            },
+            record);
+        JobPool::Submit("queued", [](const JobPool::Progress&) { return true; }, record);
+        ASSERT_TRUE(WaitFor(started));
+
+        JobPool::Stats before = JobPool::GetStats();
+        JobPool::Stop();
+        ASSERT_FALSE(JobPool::IsRunning());
+        ASSERT_TRUE(JobPool::ActiveJobs().empty());
+        ASSERT_EQ((size_t)3, results.size());
+        ASSERT_EQ(JobPool::JOB_SUCCEEDED, results[0]);
+        ASSERT_EQ(JobPool::JOB_CANCELLED, results[1]);
+        ASSERT_EQ(JobPool::JOB_CANCELLED, results[2]);
+        ASSERT_EQ((size_t)0, JobPool::HandleCompleted());
+        ASSERT_EQ(before.cancelled + 2, JobPool::GetStats().cancelled);
+        return true;
+    }
+
+    static void DrawDocument() {
+        AppState& app = AppState::Instance();
+        app.drawingPoints.clear();
+        app.undoStack.clear();
+        app.redoStack.clear();
+        app.isDrawing = false;
+        app.currentTool = TOOL_BRUSH;
+        app.currentColor = RGB(200, 20, 20);
+        app.brushSize = 6;
+        app.strokeTolerance = 0.0;
+        DrawingEngine::StartDrawing(20, 20);
+        for (int i = 1; i <= 100; i++) {
+            DrawingEngine::ContinueDrawing(20 + i * 4, 20 + i * 3);
+        }
+        DrawingEngine::EndDrawing();
+    }
+
+    static std::vector<uint8_t> ReadFile(const char* filename) {
+        std::vector<uint8_t> bytes;
+        std::FILE* file = std::fopen(filename, "rb");
+        if (!file) return bytes;
+        uint8_t buffer[4096];
+        size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            bytes.insert(bytes.end(), buffer, buffer + read);
+        }
+        std::fclose(file);
+        return bytes;
+    }
+
+    bool TestExportCopy() {
+        const char* expectedFile = "job_test_expected.png";
+        const char* filename = "job_test_export.png";
+        DrawDocument();
+        ASSERT_TRUE(DrawingEngine::ExportDocument(expectedFile, 2.0, 2));
+
+        // The copy is what exports, whatever happens to the document meanwhile
+        std::shared_ptr<const DrawingEngine::DocumentCopy> copy = DrawingEngine::CopyDocument();
+        ASSERT_EQ(AppState::Instance().drawingPoints.size(), copy->points.size());
+        DrawingEngine::ClearCanvas();
+
+        StartPool(2);
+        std::atomic<bool> reachedEnd{false};
+        JobPool::Result result = JobPool::JOB_FAILED;
+        bool completed = false;
+        JobPool::Submit(filename,
+            [copy, filename, &reachedEnd](const JobPool::Progress& progress) {
+                return DrawingEngine::ExportDocument(*copy, filename, 2.0, 2, [&](double fraction) {
+                    progress.Report(fraction);
+                    reachedEnd = reachedEnd || fraction == 1.0;
+                    return !progress.Cancelled();
+                });
+            },
+            [&result, &completed](JobPool::Result r) { result = r; completed = true; });
+        ASSERT_TRUE(Pump([&completed]() { return completed; }));
+        JobPool::Stop();
+
+        ASSERT_EQ((int)JobPool::JOB_SUCCEEDED, (int)result);
+        ASSERT_TRUE(reachedEnd.load());
+        std::vector<uint8_t> expected = ReadFile(expectedFile);
+        ASSERT_TRUE(!expected.empty());
+        ASSERT_TRUE(expected == ReadFile(filename));
+        std::remove(expectedFile);
+        std::remove(filename);
+        AppState::Instance().drawingPoints.clear();
+        return true;
+    }
+
+    bool TestExportCancel() {
+        const char* filename = "job_test_cancelled.qoi";
+        DrawDocument();
+        std::shared_ptr<const DrawingEngine::DocumentCopy> copy = DrawingEngine::CopyDocument();
+
+        // Cancelled from inside, after the first rows
+        StartPool(1);
+        JobPool::Result result = JobPool::JOB_SUCCEEDED;
+        bool completed = false;
+        std::atomic<JobPool::JobId> id{0};
+        id = JobPool::Submit(filename,
+            [copy, filename, &id](const JobPool::Progress& progress) {
+                return DrawingEngine::ExportDocument(*copy, filename, 4.0, 1, [&](double) {
+                    while (id == 0) std::this_thread::yield();
+                    JobPool::Cancel(id);
+                    return !progress.Cancelled();
+                });
+            },
+            [&result, &completed](JobPool::Result r) { result = r; completed = true; });
+        ASSERT_TRUE(Pump([&completed]() { return completed; }));
+        JobPool::Stop();
+
+        ASSERT_EQ((int)JobPool::JOB_CANCELLED, (int)result);
+        ASSERT_FALSE(FileExists(filename));
+        AppState::Instance().drawingPoints.clear();
+        return true;
+    }
+};
+
+std::atomic<int> JobPoolTests::notifications{0};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Job Pool Tests" << std::endl;
+
+    JobPoolTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
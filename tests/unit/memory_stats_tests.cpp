@@ -0,0 +1,191 @@
+#include "../test_framework.h"
+#include "../../include/memory_stats.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/app_state.h"
+#include "../../include/mpsp_format.h"
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+class MemoryStatsTests {
+private:
+    TestFramework framework;
+
+public:
+    MemoryStatsTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Memory Stats");
+        framework.AddTest("Allocations Track Size And Peak", [this]() { return TestAllocations(); });
+        framework.AddTest("Counters Are Thread Safe", [this]() { return TestThreads(); });
+        framework.AddTest("Undo Snapshots Are Measured", [this]() { return TestUndoFootprint(); });
+        framework.AddTest("File And Raster Buffers Are Tracked", [this]() { return TestTransientBuffers(); });
+        framework.AddTest("Report Formatting", [this]() { return TestReport(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static void ClearDocument() {
+        AppState& app = AppState::Instance();
+        std::vector<DrawPoint>().swap(app.drawingPoints);
+        std::vector<UndoState>().swap(app.undoStack);
+        std::vector<UndoState>().swap(app.redoStack);
+        DrawingEngine::ClearReferenceImage();
+    }
+
+    static void DrawStroke(int y, int length) {
+        DrawingEngine::StartDrawing(10, y);
+        for (int i = 1; i < length; i++) DrawingEngine::ContinueDrawing(10 + i, y);
+        DrawingEngine::EndDrawing();
+    }
+
+    bool TestAllocations() {
+        size_t base = MemoryStats::TrackedBytes(MemoryStats::MEM_RASTER);
+        MemoryStats::ResetPeaks();
+        {
+            MemoryStats::Allocation cache(MemoryStats::MEM_RASTER, 1000);
+            ASSERT_EQ(base + 1000, MemoryStats::TrackedBytes(MemoryStats::MEM_RASTER));
+            cache.Resize(5000);
+            cache.Resize(2000);
+            ASSERT_EQ(base + 2000, MemoryStats::TrackedBytes(MemoryStats::MEM_RASTER));
+            ASSERT_EQ((size_t)2000, cache.Bytes());
+        }
+        ASSERT_EQ(base, MemoryStats::TrackedBytes(MemoryStats::MEM_RASTER));
+
+        // The peak outlives the allocation until reset
+        MemoryStats::Report report = MemoryStats::Collect();
+        ASSERT_EQ(base + 5000, report.peakBytes[MemoryStats::MEM_RASTER]);
+        MemoryStats::ResetPeaks();
+        report = MemoryStats::Collect();
+        ASSERT_EQ(base, report.peakBytes[MemoryStats::MEM_RASTER]);
+        return true;
+    }
+
+    bool TestThreads() {
+        size_t base = MemoryStats::TrackedBytes(MemoryStats::MEM_FILE_BUFFERS);
+        std::vector<std::thread> workers;
+        for (int w = 0; w < 4; w++) {
+            workers.emplace_back([]() {
+                for (int i = 0; i < 20000; i++) {
+                    MemoryStats::Allocation buffer(MemoryStats::MEM_FILE_BUFFERS, 64);
+                    buffer.Resize(128);
+                }
+            });
+        }
+        for (std::thread& worker : workers) worker.join();
+        ASSERT_EQ(base, MemoryStats::TrackedBytes(MemoryStats::MEM_FILE_BUFFERS));
+        return true;
+    }
+
+    bool TestUndoFootprint() {
+        ClearDocument();
+        AppState::Instance().currentTool = TOOL_BRUSH;
+        MemoryStats::Report empty = MemoryStats::Collect();
+        ASSERT_EQ((size_t)0, empty.bytes[MemoryStats::MEM_DOCUMENT]);
+        ASSERT_EQ((size_t)0, empty.bytes[MemoryStats::MEM_UNDO]);
+
+        // Every stroke snapshots the whole document, so undo grows quadratically
+        const int strokes = 20;
+        const int length = 500;
+        for (int s = 0; s < strokes; s++) DrawStroke(10 + s, length);
+        MemoryStats::Report report = MemoryStats::Collect();
+        ASSERT_EQ((size_t)(strokes * length), report.points);
+        ASSERT_EQ((size_t)strokes, report.undoStates);
+        ASSERT_TRUE(report.bytes[MemoryStats::MEM_DOCUMENT] >= report.points * sizeof(DrawPoint));
+
+        size_t snapshotPoints = (size_t)length * strokes * (strokes - 1) / 2;
+        ASSERT_TRUE(report.bytes[MemoryStats::MEM_UNDO] >= snapshotPoints * sizeof(DrawPoint));
+        ASSERT_TRUE(report.bytes[MemoryStats::MEM_UNDO] > 5 * report.bytes[MemoryStats::MEM_DOCUMENT]);
+
+        // Undo moves the newest snapshot's weight to redo
+        DrawingEngine::Undo();
+        report = MemoryStats::Collect();
+        ASSERT_EQ((size_t)1, report.redoStates);
+        ASSERT_TRUE(report.bytes[MemoryStats::MEM_REDO] >= (size_t)length * strokes * sizeof(DrawPoint));
+        ASSERT_TRUE(report.totalBytes >= report.bytes[MemoryStats::MEM_DOCUMENT] +
+                                         report.bytes[MemoryStats::MEM_UNDO] + report.bytes[MemoryStats::MEM_REDO]);
+
+        RasterImage reference;
+        reference.pixels.resize(100 * 100);
+        DrawingEngine::SetReferenceImage(std::move(reference));
+        ASSERT_EQ((size_t)40000, MemoryStats::Collect().bytes[MemoryStats::MEM_REFERENCE]);
+        ClearDocument();
+        return true;
+    }
+
+    bool TestTransientBuffers() {
+        ClearDocument();
+        AppState::Instance().currentTool = TOOL_BRUSH;
+        for (int s = 0; s < 5; s++) DrawStroke(10 + s * 20, 200);
+        size_t fileBase = MemoryStats::TrackedBytes(MemoryStats::MEM_FILE_BUFFERS);
+        size_t rasterBase = MemoryStats::TrackedBytes(MemoryStats::MEM_RASTER);
+        MemoryStats::ResetPeaks();
+
+        const char* filename = "memory_stats_test.mpsp";
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(filename));
+        ASSERT_TRUE(DrawingEngine::LoadDrawing(filename));
+        std::remove(filename);
+        MemoryStats::Report report = MemoryStats::Collect();
+        ASSERT_TRUE(report.peakBytes[MemoryStats::MEM_FILE_BUFFERS] >= fileBase + 4096 * sizeof(MpspFormat::PackedPoint));
+        ASSERT_EQ(fileBase, MemoryStats::TrackedBytes(MemoryStats::MEM_FILE_BUFFERS));
+
+        // Export holds a scene index and encoder buffers only while it runs
+        const char* exported = "memory_stats_test.png";
+        ASSERT_TRUE(DrawingEngine::ExportDocument(exported, 2.0));
+        std::remove(exported);
+        report = MemoryStats::Collect();
+        ASSERT_TRUE(report.peakBytes[MemoryStats::MEM_RASTER] > rasterBase);
+        ASSERT_EQ(rasterBase, MemoryStats::TrackedBytes(MemoryStats::MEM_RASTER));
+        ASSERT_EQ(fileBase, MemoryStats::TrackedBytes(MemoryStats::MEM_FILE_BUFFERS));
+        ClearDocument();
+        return true;
+    }
+
+    bool TestReport() {
+        ClearDocument();
+        AppState::Instance().drawingPoints.resize(1024 * 1024 / sizeof(DrawPoint));
+        MemoryStats::Report report = MemoryStats::Collect();
+        std::string text = MemoryStats::FormatReport(report);
+        ASSERT_TRUE(text.find("document") == 0);
+        ASSERT_TRUE(text.find("1.00 MB") != std::string::npos);
+        ASSERT_TRUE(text.find("file_buffers") != std::string::npos);
+        ASSERT_TRUE(text.find("total") != std::string::npos);
+        ASSERT_TRUE(text.find("0 undo / 0 redo snapshots") != std::string::npos);
+
+        const char* filename = "memory_stats_test.txt";
+        ASSERT_TRUE(MemoryStats::WriteReport(filename));
+        std::FILE* file = std::fopen(filename, "r");
+        ASSERT_TRUE(file != nullptr);
+        char line[256];
+        size_t lines = 0;
+        while (std::fgets(line, sizeof(line), file)) lines++;
+        std::fclose(file);
+        std::remove(filename);
+        ASSERT_EQ((size_t)MemoryStats::MEM_COUNT + 2, lines);
+
+        ASSERT_TRUE(std::string(MemoryStats::SubsystemName(MemoryStats::MEM_UNDO)) == "undo");
+        ClearDocument();
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Memory Stats Tests" << std::endl;
+
+    // These tests count stored points; decimation has its own tests
+    AppState::Instance().strokeTolerance = 0.0;
+
+    MemoryStatsTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
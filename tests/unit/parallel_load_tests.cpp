@@ -0,0 +1,150 @@
+#include "../test_framework.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/document_generator.h"
+#include "../../include/mpsp_format.h"
+#include "../../include/app_state.h"
+#include "../../include/config.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ParallelLoadTests {
+private:
+    TestFramework framework;
+
+public:
+    ParallelLoadTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Parallel Load");
+        framework.AddTest("Large File Round Trips Point For Point", [this]() { return TestLargeRoundTrip(); });
+        framework.AddTest("Truncated Large File Leaves Document Alone", [this]() { return TestTruncated(); });
+        framework.AddTest("Cancelling Stops Every Slice", [this]() { return TestCancelled(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static void ResetDocument() {
+        AppState& app = AppState::Instance();
+        app.drawingPoints.clear();
+        app.undoStack.clear();
+        app.redoStack.clear();
+        app.isDrawing = false;
+    }
+
+    static void Generate(size_t count) {
+        DocumentGenerator::Params params;
+        params.seed = 49;
+        params.points = count;
+        DocumentGenerator::Generate(params, AppState::Instance().drawingPoints);
+    }
+
+    static bool SamePoints(const std::vector<DrawPoint>& a, const std::vector<DrawPoint>& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++) {
+            MpspFormat::PackedPoint pa = MpspFormat::Pack(a[i]), pb = MpspFormat::Pack(b[i]);
+            if (std::memcmp(&pa, &pb, sizeof(pa)) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool TestLargeRoundTrip() {
+        // An odd count so the slices split unevenly
+        ResetDocument();
+        Generate(LOAD_PARALLEL_MIN_POINTS + 12345);
+        std::vector<DrawPoint> original = AppState::Instance().drawingPoints;
+        const char* filename = "parallel_load_test.mpsp";
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(filename));
+        ResetDocument();
+
+        ASSERT_TRUE(DrawingEngine::LoadDrawing(filename));
+        std::remove(filename);
+        ASSERT_TRUE(SamePoints(original, AppState::Instance().drawingPoints));
+        ResetDocument();
+        return true;
+    }
+
+    bool TestTruncated() {
+        ResetDocument();
+        Generate(LOAD_PARALLEL_MIN_POINTS + 100);
+        const char* filename = "parallel_load_truncated.mpsp";
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(filename));
+
+        // Cut the file off a thousand records short
+        std::FILE* file = std::fopen(filename, "rb");
+        ASSERT_TRUE(file != nullptr);
+        std::vector<char> bytes(MpspFormat::HEADER_V2_SIZE + (size_t)(LOAD_PARALLEL_MIN_POINTS - 900) * sizeof(MpspFormat::PackedPoint));
+        ASSERT_EQ(bytes.size(), std::fread(bytes.data(), 1, bytes.size(), file));
+        std::fclose(file);
+        file = std::fopen(filename, "wb");
+        ASSERT_TRUE(file != nullptr);
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        std::fclose(file);
+
+        ResetDocument();
+        Generate(300);
+        std::vector<DrawPoint> before = AppState::Instance().drawingPoints;
+        ASSERT_FALSE(DrawingEngine::LoadDrawing(filename));
+        std::remove(filename);
+        ASSERT_TRUE(SamePoints(before, AppState::Instance().drawingPoints));
+        ResetDocument();
+        return true;
+    }
+
+    bool TestCancelled() {
+        ResetDocument();
+        Generate(LOAD_PARALLEL_MIN_POINTS + 100);
+        const char* filename = "parallel_load_cancelled.mpsp";
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(filename));
+
+        // Give up after the first block; the other slices see it and stop too
+        std::atomic<int> reports{0};
+        std::vector<DrawPoint> points;
+        uint64_t generation = 0;
+        ASSERT_FALSE(DrawingEngine::LoadDrawing(filename, points, generation, [&reports](double) {
+            reports++;
+            return false;
+        }));
+        ASSERT_TRUE(reports.load() <= (int)std::max(1u, std::thread::hardware_concurrency()));
+
+        // The same file loads in full with progress reaching the end
+        double last = 0.0;
+        std::mutex lock;
+        ASSERT_TRUE(DrawingEngine::LoadDrawing(filename, points, generation, [&](double fraction) {
+            std::lock_guard<std::mutex> guard(lock);
+            last = std::max(last, fraction);
+            return true;
+        }));
+        std::remove(filename);
+        ASSERT_TRUE(SamePoints(AppState::Instance().drawingPoints, points));
+        ASSERT_TRUE(last == 1.0);
+        ResetDocument();
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Parallel Load Tests" << std::endl;
+
+    ParallelLoadTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
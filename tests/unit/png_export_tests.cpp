@@ -0,0 +1,647 @@
+#include "../test_framework.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/app_state.h"
+#include "../../include/raster_renderer.h"
+#include "../../include/png_encoder.h"
+#include "../../include/deflate.h"
+#include "../../include/checksum.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <atomic>
+#include <thread>
+
+// Reference decoder used only to check the encoder's output (inflate + PNG unfilter)
+class ReferenceDecoder {
+public:
+    static bool Inflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+        BitReader in = { data, size, 0 };
+        bool last = false;
+        while (!last) {
+            last = in.Bits(1) != 0;
+            int type = (int)in.Bits(2);
+            if (type == 0) {
+                in.bit = (in.bit + 7) & ~(size_t)7;
+                uint32_t len = in.Bits(16);
+                uint32_t nlen = in.Bits(16);
+                if ((len ^ 0xFFFF) != nlen || in.bit / 8 + len > size) return false;
+                out.insert(out.end(), data + in.bit / 8, data + in.bit / 8 + len);
+                in.bit += (size_t)len * 8;
+            } else if (type == 1 || type == 2) {
+                uint8_t lengths[320] = {0};
+                int hlit = 288, hdist = 30;
+                if (type == 1) {
+                    for (int i = 0; i < 288; i++) lengths[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+                    for (int i = 0; i < 30; i++) lengths[288 + i] = 5;
+                } else if (!ReadDynamicLengths(in, lengths, hlit, hdist)) {
+                    return false;
+                }
+                Huffman lit, dist;
+                lit.Build(lengths, hlit);
+                dist.Build(lengths + (type == 1 ? 288 : hlit), hdist);
+                if (!InflateBlock(in, lit, dist, out)) return false;
+            } else {
+                return false;
+            }
+            if (in.bit > size * 8) return false;
+        }
+        return true;
+    }
+
+    // Decodes an 8-bit RGB/RGBA PNG into RasterRenderer-layout pixels
+    static bool DecodePng(const std::vector<uint8_t>& file, int& width, int& height, std::vector<uint32_t>& pixels) {
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        if (file.size() < 8 || std::memcmp(file.data(), signature, 8) != 0) return false;
+
+        std::vector<uint8_t> idat;
+        int colorType = -1;
+        bool sawEnd = false;
+        for (size_t pos = 8; pos + 12 <= file.size() && !sawEnd; ) {
+            uint32_t length = BigEndian(&file[pos]);
+            if (pos + 12 + length > file.size()) return false;
+            const uint8_t* type = &file[pos + 4];
+            const uint8_t* body = type + 4;
+            if (Checksum::Crc32(type, 4 + length) != BigEndian(body + length)) return false;
+            if (!std::memcmp(type, "IHDR", 4)) {
+                width = (int)BigEndian(body);
+                height = (int)BigEndian(body + 4);
+                colorType = body[9];
+                if (body[8] != 8 || (colorType != 2 && colorType != 6)) return false;
+            } else if (!std::memcmp(type, "IDAT", 4)) {
+                idat.insert(idat.end(), body, body + length);
+            } else if (!std::memcmp(type, "IEND", 4)) {
+                sawEnd = true;
+            }
+            pos += 12 + length;
+        }
+        if (!sawEnd || colorType < 0 || idat.size() < 6) return false;
+        if (((idat[0] << 8) | idat[1]) % 31 != 0 || (idat[0] & 0x0F) != 8) return false;
+
+        std::vector<uint8_t> raw;
+        if (!Inflate(idat.data() + 2, idat.size() - 6, raw)) return false;
+        if (Checksum::Adler32(raw.data(), raw.size()) != BigEndian(&idat[idat.size() - 4])) return false;
+
+        int bpp = (colorType == 6) ? 4 : 3;
+        size_t length = (size_t)width * bpp;
+        if (raw.size() != (length + 1) * height) return false;
+
+        std::vector<uint8_t> prior(length, 0), row(length);
+        pixels.assign((size_t)width * height, 0);
+        for (int y = 0; y < height; y++) {
+            const uint8_t* line = &raw[(length + 1) * y];
+            for (size_t i = 0; i < length; i++) {
+                int left = (i >= (size_t)bpp) ? row[i - bpp] : 0;
+                int up = prior[i];
+                int upLeft = (i >= (size_t)bpp) ? prior[i - bpp] : 0;
+                int predicted = 0;
+                switch (line[0]) {
+                    case 0: break;
+                    case 1: predicted = left; break;
+                    case 2: predicted = up; break;
+                    case 3: predicted = (left + up) / 2; break;
+                    case 4: {
+                        int p = left + up - upLeft;
+                        int pa = abs(p - left), pb = abs(p - up), pc = abs(p - upLeft);
+                        predicted = (pa <= pb && pa <= pc) ? left : (pb <= pc) ? up : upLeft;
+                        break;
+                    }
+                    default: return false;
+                }
+                row[i] = (uint8_t)(line[1 + i] + predicted);
+            }
+            for (int x = 0; x < width; x++) {
+                const uint8_t* p = &row[(size_t)x * bpp];
+                uint32_t alpha = (bpp == 4) ? p[3] : 0xFF;
+                pixels[(size_t)y * width + x] = p[0] | (p[1] << 8) | (p[2] << 16) | (alpha << 24);
+            }
+            prior.swap(row);
+        }
+        return true;
+    }
+
+private:
+    struct BitReader {
+        const uint8_t* data;
+        size_t size;
+        size_t bit;
+
+        uint32_t Bits(int n) {
+            uint32_t value = 0;
+            for (int i = 0; i < n; i++, bit++) {
+                uint32_t b = (bit / 8 < size) ? (data[bit / 8] >> (bit % 8)) & 1 : 0;
+                value |= b << i;
+            }
+            return value;
+        }
+    };
+
+    struct Huffman {
+        uint16_t counts[16];
+        uint16_t symbols[320];
+
+        void Build(const uint8_t* lengths, int n) {
+            std::memset(counts, 0, sizeof(counts));
+            for (int i = 0; i < n; i++) counts[lengths[i]]++;
+            counts[0] = 0;
+            uint16_t offsets[16] = {0};
+            for (int i = 1; i < 16; i++) offsets[i] = offsets[i - 1] + counts[i - 1];
+            for (int i = 0; i < n; i++) {
+                if (lengths[i]) symbols[offsets[lengths[i]]++] = (uint16_t)i;
+            }
+        }
+
+        int Decode(BitReader& in) const {
+            int code = 0, first = 0, index = 0;
+            for (int len = 1; len < 16; len++) {
+                code |= (int)in.Bits(1);
+                int count = counts[len];
+                if (code - first < count) return symbols[index + code - first];
+                index += count;
+                first = (first + count) << 1;
+                code <<= 1;
+            }
+            return -1;
+        }
+    };
+
+    static uint32_t BigEndian(const uint8_t* p) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    static bool ReadDynamicLengths(BitReader& in, uint8_t* lengths, int& hlit, int& hdist) {
+        static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        hlit = (int)in.Bits(5) + 257;
+        hdist = (int)in.Bits(5) + 1;
+        int hclen = (int)in.Bits(4) + 4;
+        uint8_t codeLengths[19] = {0};
+        for (int i = 0; i < hclen; i++) codeLengths[order[i]] = (uint8_t)in.Bits(3);
+        Huffman codeLengthTree;
+        codeLengthTree.Build(codeLengths, 19);
+
+        for (int i = 0; i < hlit + hdist; ) {
+            int symbol = codeLengthTree.Decode(in);
+            if (symbol < 0) return false;
+            if (symbol < 16) {
+                lengths[i++] = (uint8_t)symbol;
+                continue;
+            }
+            int repeat = 0;
+            uint8_t value = 0;
+            if (symbol == 16) {
+                if (i == 0) return false;
+                value = lengths[i - 1];
+                repeat = 3 + (int)in.Bits(2);
+            } else if (symbol == 17) {
+                repeat = 3 + (int)in.Bits(3);
+            } else {
+                repeat = 11 + (int)in.Bits(7);
+            }
+            if (i + repeat > hlit + hdist) return false;
+            while (repeat--) lengths[i++] = value;
+        }
+        return true;
+    }
+
+    static bool InflateBlock(BitReader& in, const Huffman& lit, const Huffman& dist, std::vector<uint8_t>& out) {
+        static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const uint16_t distBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static const uint8_t distExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        while (true) {
+            int symbol = lit.Decode(in);
+            if (symbol < 0 || symbol > 285) return false;
+            if (symbol < 256) {
+                out.push_back((uint8_t)symbol);
+            } else if (symbol == 256) {
+                return true;
+            } else {
+                int length = lengthBase[symbol - 257] + (int)in.Bits(lengthExtra[symbol - 257]);
+                int d = dist.Decode(in);
+                if (d < 0 || d >= 30) return false;
+                size_t distance = distBase[d] + in.Bits(distExtra[d]);
+                if (distance > out.size()) return false;
+                for (int i = 0; i < length; i++) out.push_back(out[out.size() - distance]);
+            }
+        }
+    }
+};
+
+// PNG export tests - these link the real raster renderer, deflate and PNG encoder
+class PngExportTests {
+private:
+    TestFramework framework;
+
+public:
+    PngExportTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Deflate", true);
+        framework.AddTest("Concatenated Pieces Inflate", [this]() { return TestDeflateRoundTrip(); });
+        framework.AddTest("Adler-32 Combine", [this]() { return TestAdlerCombine(); });
+
+        framework.AddSuite("Raster Renderer", true);
+        framework.AddTest("Bands Match Full Render", [this]() { return TestBandsMatchFullRender(); });
+        framework.AddTest("Scene Index Matches Full Scan", [this]() { return TestSceneIndex(); });
+        framework.AddTest("Document Bounds Cover Brush Extent", [this]() { return TestDocumentBounds(); });
+        framework.AddTest("Supersampling Blends Edges", [this]() { return TestSupersampling(); });
+
+        framework.AddSuite("PNG Encoder");
+        framework.AddTest("Parallel Groups Decode Exactly", [this]() { return TestParallelGroups(); });
+        framework.AddTest("RGBA Output", [this]() { return TestAlphaOutput(); });
+        framework.AddTest("Failed Row Source Removes File", [this]() { return TestFailedRowSource(); });
+        framework.AddTest("Memory Budget Limits Groups In Flight", [this]() { return TestMemoryBudget(); });
+        framework.AddTest("DPI Written To pHYs", [this]() { return TestPhysicalResolution(); });
+
+        framework.AddSuite("Export");
+        framework.AddTest("ExportAsBitmap Writes Canvas", [this]() { return TestExportAsBitmap(); });
+        framework.AddTest("Points Outside Window Are Kept", [this]() { return TestExportKeepsOffscreenPoints(); });
+        framework.AddTest("Region Export Scales Output", [this]() { return TestExportRegionScale(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static std::vector<DrawPoint> SampleDrawing() {
+        std::vector<DrawPoint> points;
+        for (int i = 0; i < 60; i++) {
+            points.push_back({ 10 + i * 3, 20 + (i * i) % 50, RGB(200, 30, 40), i == 0, 7, TOOL_BRUSH });
+        }
+        for (int i = 0; i < 20; i++) {
+            points.push_back({ 100 + i * 4, 90, RGB(0, 0, 255), false, 3, TOOL_RECTANGLE });
+        }
+        points.push_back({ 40, 40, RGB(0, 0, 0), true, 20, TOOL_ERASER });
+        return points;
+    }
+
+    static std::vector<uint32_t> RenderAll(const std::vector<DrawPoint>& points, int width, int height) {
+        std::vector<uint32_t> pixels((size_t)width * height);
+        RasterRenderer::RenderRows(points, RasterRenderer::View(), width, 0, height, RGB(255, 255, 255), pixels.data());
+        return pixels;
+    }
+
+    static bool ReadFile(const char* filename, std::vector<uint8_t>& data) {
+        std::FILE* file = std::fopen(filename, "rb");
+        if (!file) return false;
+        uint8_t buffer[65536];
+        size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            data.insert(data.end(), buffer, buffer + read);
+        }
+        std::fclose(file);
+        return true;
+    }
+
+    bool TestDeflateRoundTrip() {
+        std::mt19937 rng(7);
+        std::vector<uint8_t> data;
+        for (int i = 0; i < 300000; i++) {
+            int mode = (i / 5000) % 3;
+            data.push_back(mode == 0 ? 0 : mode == 1 ? (uint8_t)rng() : (uint8_t)("stroke "[i % 7]));
+        }
+
+        for (int level : { Deflate::LEVEL_FAST, Deflate::LEVEL_DEFAULT, Deflate::LEVEL_BEST }) {
+            std::vector<uint8_t> compressed;
+            const size_t piece = 70001;
+            for (size_t start = 0; start < data.size(); start += piece) {
+                size_t count = std::min(piece, data.size() - start);
+                Deflate::CompressPiece(data.data() + start, count, start + count == data.size(), compressed, level);
+            }
+            std::vector<uint8_t> inflated;
+            ASSERT_TRUE(ReferenceDecoder::Inflate(compressed.data(), compressed.size(), inflated));
+            ASSERT_TRUE(inflated == data);
+            ASSERT_TRUE(compressed.size() < data.size());
+        }
+        return true;
+    }
+
+    bool TestAdlerCombine() {
+        std::vector<uint8_t> data(100000);
+        for (size_t i = 0; i < data.size(); i++) data[i] = (uint8_t)(i * 31 + i / 7);
+
+        uint32_t whole = Checksum::Adler32(data.data(), data.size());
+        uint32_t a = Checksum::Adler32(data.data(), 12345);
+        uint32_t b = Checksum::Adler32(data.data() + 12345, data.size() - 12345);
+        ASSERT_EQ(whole, Checksum::Adler32Combine(a, b, data.size() - 12345));
+        ASSERT_EQ(a, Checksum::Adler32Combine(a, 1, 0));
+        return true;
+    }
+
+    bool TestBandsMatchFullRender() {
+        std::vector<DrawPoint> points = SampleDrawing();
+        const int width = 220, height = 130;
+        std::vector<uint32_t> full = RenderAll(points, width, height);
+
+        std::vector<uint32_t> banded((size_t)width * height);
+        for (int row = 0; row < height; row += 17) {
+            int count = std::min(17, height - row);
+            RasterRenderer::RenderRows(points, RasterRenderer::View(), width, row, count, RGB(255, 255, 255), &banded[(size_t)row * width]);
+        }
+        ASSERT_TRUE(full == banded);
+
+        // Stroke interior is painted, untouched canvas stays white
+        ASSERT_EQ(RasterRenderer::ToPixel(RGB(200, 30, 40)), full[(size_t)20 * width + 13]);
+        ASSERT_EQ(RasterRenderer::ToPixel(RGB(255, 255, 255)), full[(size_t)125 * width + 5]);
+        return true;
+    }
+
+    bool TestSceneIndex() {
+        std::mt19937 rng(11);
+        std::vector<DrawPoint> points;
+        for (int i = 0; i < 3000; i++) {
+            ToolType tool = (i % 13 == 0) ? TOOL_ERASER : (i % 7 == 0) ? TOOL_CIRCLE : TOOL_BRUSH;
+            points.push_back({ (int)(rng() % 900) - 100, (int)(rng() % 700) - 50, RGB(rng() % 256, rng() % 256, rng() % 256),
+                               i % 40 == 0, 1 + (int)(rng() % 30), tool });
+        }
+
+        RasterRenderer::View view;
+        view.originX = -30.5;
+        view.originY = 12;
+        view.scale = 2.5;
+        const int width = 700, height = 900;
+        RasterRenderer::SceneIndex scene(points, view, height);
+
+        std::vector<uint32_t> expected((size_t)width * height), actual((size_t)width * height);
+        RasterRenderer::RenderRows(points, view, width, 0, height, RGB(255, 255, 255), expected.data());
+        for (int row = 0; row < height; ) {
+            int count = std::min(1 + (int)(rng() % 97), height - row);
+            scene.RenderRows(width, row, count, RGB(255, 255, 255), &actual[(size_t)row * width]);
+            row += count;
+        }
+        ASSERT_TRUE(expected == actual);
+        return true;
+    }
+
+    bool TestDocumentBounds() {
+        std::vector<DrawPoint> points;
+        RasterRenderer::Bounds bounds;
+        ASSERT_FALSE(RasterRenderer::DocumentBounds(points, bounds));
+
+        points.push_back({ -40, 10, RGB(0, 0, 0), true, 10, TOOL_BRUSH });
+        points.push_back({ 300, 500, RGB(0, 0, 0), false, 10, TOOL_BRUSH });
+        ASSERT_TRUE(RasterRenderer::DocumentBounds(points, bounds));
+        ASSERT_TRUE(bounds.left <= -45 && bounds.top <= 5);
+        ASSERT_TRUE(bounds.right > 305 && bounds.bottom > 505);
+
+        // Everything painted falls inside the bounds
+        RasterRenderer::View view;
+        view.originX = bounds.left - 10;
+        view.originY = bounds.top - 10;
+        int width = bounds.right - bounds.left + 20, height = bounds.bottom - bounds.top + 20;
+        std::vector<uint32_t> pixels((size_t)width * height);
+        RasterRenderer::RenderRows(points, view, width, 0, height, RGB(255, 255, 255), pixels.data());
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                bool inside = x >= 10 && y >= 10 && x < width - 10 && y < height - 10;
+                if (!inside && pixels[(size_t)y * width + x] != RasterRenderer::ToPixel(RGB(255, 255, 255))) return false;
+            }
+        }
+        return true;
+    }
+
+    bool TestSupersampling() {
+        // A 6-wide black bar from x = 7 to 13 at 1x
+        std::vector<DrawPoint> points;
+        for (int y = 0; y < 40; y++) {
+            points.push_back({ 10, y, RGB(0, 0, 0), y == 0, 6, TOOL_BRUSH });
+        }
+        RasterRenderer::View view;
+        const int width = 24, height = 40;
+
+        // One sample per pixel is exactly the unindexed renderer
+        RasterRenderer::SceneIndex single(points, view, height, 1);
+        std::vector<uint32_t> expected((size_t)width * height), actual((size_t)width * height);
+        RasterRenderer::RenderRows(points, view, width, 0, height, RGB(255, 255, 255), expected.data());
+        single.RenderRows(width, 0, height, RGB(255, 255, 255), actual.data());
+        ASSERT_TRUE(expected == actual);
+
+        // With 4x4 samples the interior stays solid, the edges turn gray,
+        // and rendering in pieces gives the same result
+        RasterRenderer::SceneIndex scene(points, view, height, 4);
+        std::vector<uint32_t> whole((size_t)width * height), pieces((size_t)width * height);
+        scene.RenderRows(width, 0, height, RGB(255, 255, 255), whole.data());
+        for (int row = 0; row < height; row += 7) {
+            scene.RenderRows(width, row, std::min(7, height - row), RGB(255, 255, 255), &pieces[(size_t)row * width]);
+        }
+        ASSERT_TRUE(whole == pieces);
+
+        const uint32_t* middle = &whole[(size_t)20 * width];
+        ASSERT_EQ(RasterRenderer::ToPixel(RGB(0, 0, 0)), middle[10]);
+        ASSERT_EQ(RasterRenderer::ToPixel(RGB(255, 255, 255)), middle[2]);
+        uint32_t edge = middle[7] & 0xFF;
+        ASSERT_TRUE(edge > 0 && edge < 255);
+        ASSERT_TRUE(scene.ScratchBytes(width) > 0);
+        ASSERT_EQ((size_t)0, single.ScratchBytes(width));
+        return true;
+    }
+
+    bool TestParallelGroups() {
+        std::vector<DrawPoint> points = SampleDrawing();
+        const int width = 220, height = 130;
+        std::vector<uint32_t> expected = RenderAll(points, width, height);
+
+        PngEncoder::Options options;
+        options.threads = 4;
+        options.groupBytes = 4096;  // Many small groups
+        std::vector<uint8_t> file;
+        bool ok = PngEncoder::Encode(width, height,
+            [&](int firstRow, int rowCount, uint32_t* pixels) {
+                RasterRenderer::RenderRows(points, RasterRenderer::View(), width, firstRow, rowCount, RGB(255, 255, 255), pixels);
+                return true;
+            },
+            [&](const void* data, size_t size) {
+                file.insert(file.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+                return true;
+            }, options);
+        ASSERT_TRUE(ok);
+
+        int decodedWidth = 0, decodedHeight = 0;
+        std::vector<uint32_t> decoded;
+        ASSERT_TRUE(ReferenceDecoder::DecodePng(file, decodedWidth, decodedHeight, decoded));
+        ASSERT_EQ(width, decodedWidth);
+        ASSERT_EQ(height, decodedHeight);
+        ASSERT_TRUE(decoded == expected);
+        return true;
+    }
+
+    bool TestAlphaOutput() {
+        const int width = 33, height = 9;
+        PngEncoder::Options options;
+        options.alpha = true;
+        std::vector<uint8_t> file;
+        bool ok = PngEncoder::Encode(width, height,
+            [&](int firstRow, int rowCount, uint32_t* pixels) {
+                for (int i = 0; i < rowCount * width; i++) {
+                    int y = firstRow + i / width;
+                    pixels[i] = (uint32_t)(i % width) * 7 | (uint32_t)y << 8 | 0x80u << 24;
+                }
+                return true;
+            },
+            [&](const void* data, size_t size) {
+                file.insert(file.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+                return true;
+            }, options);
+        ASSERT_TRUE(ok);
+
+        int decodedWidth = 0, decodedHeight = 0;
+        std::vector<uint32_t> decoded;
+        ASSERT_TRUE(ReferenceDecoder::DecodePng(file, decodedWidth, decodedHeight, decoded));
+        ASSERT_EQ((uint32_t)(5 * 7 | 4 << 8 | 0x80u << 24), decoded[(size_t)4 * width + 5]);
+        return true;
+    }
+
+    bool TestFailedRowSource() {
+        const char* filename = "png_test_failed.png";
+        PngEncoder::Options options;
+        options.groupBytes = 1024;  // Several groups, so the failure is mid-stream
+        bool ok = PngEncoder::EncodeToFile(filename, 64, 64, [](int firstRow, int, uint32_t*) {
+            return firstRow < 32;
+        }, options);
+        ASSERT_FALSE(ok);
+
+        std::FILE* file = std::fopen(filename, "rb");
+        ASSERT_TRUE(file == nullptr);
+        return true;
+    }
+
+    bool TestMemoryBudget() {
+        const int width = 256, height = 256;
+        PngEncoder::Options options;
+        options.threads = 8;
+        options.groupBytes = 8 * 1024;
+        options.memoryBudget = 2 * PngEncoder::GroupFootprint(width, options.groupBytes / (width * 3 + 1), false);
+
+        std::atomic<int> active(0), peak(0);
+        bool ok = PngEncoder::Encode(width, height,
+            [&](int, int rowCount, uint32_t* pixels) {
+                int now = ++active;
+                int seen = peak.load();
+                while (now > seen && !peak.compare_exchange_weak(seen, now)) {}
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                std::fill(pixels, pixels + (size_t)rowCount * width, 0xFF808080u);
+                --active;
+                return true;
+            },
+            [](const void*, size_t) { return true; }, options);
+        ASSERT_TRUE(ok);
+        ASSERT_TRUE(peak.load() <= 2);
+        return true;
+    }
+
+    bool TestPhysicalResolution() {
+        PngEncoder::Options options;
+        options.dpi = 300.0;
+        std::vector<uint8_t> file;
+        bool ok = PngEncoder::Encode(4, 4,
+            [](int, int rowCount, uint32_t* pixels) {
+                std::fill(pixels, pixels + rowCount * 4, 0xFFFFFFFFu);
+                return true;
+            },
+            [&](const void* data, size_t size) {
+                file.insert(file.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+                return true;
+            }, options);
+        ASSERT_TRUE(ok);
+
+        // pHYs follows IHDR: 8 signature + 25 IHDR bytes
+        const uint8_t* chunk = &file[33];
+        ASSERT_TRUE(std::memcmp(chunk + 4, "pHYs", 4) == 0);
+        uint32_t pixelsPerMeter = ((uint32_t)chunk[8] << 24) | (chunk[9] << 16) | (chunk[10] << 8) | chunk[11];
+        ASSERT_EQ((uint32_t)11811, pixelsPerMeter);
+        ASSERT_EQ(1, chunk[16]);
+
+        int width = 0, height = 0;
+        std::vector<uint32_t> decoded;
+        ASSERT_TRUE(ReferenceDecoder::DecodePng(file, width, height, decoded));
+        return true;
+    }
+
+    bool TestExportAsBitmap() {
+        AppState& app = AppState::Instance();
+        const char* filename = "png_test_export.png";
+        app.drawingPoints = SampleDrawing();
+
+        ASSERT_TRUE(DrawingEngine::ExportAsBitmap(filename, 220, 130));
+        std::vector<uint8_t> file;
+        ASSERT_TRUE(ReadFile(filename, file));
+
+        int width = 0, height = 0;
+        std::vector<uint32_t> decoded;
+        ASSERT_TRUE(ReferenceDecoder::DecodePng(file, width, height, decoded));
+        ASSERT_TRUE(decoded == RenderAll(app.drawingPoints, 220, 130));
+
+        app.drawingPoints.clear();
+        std::remove(filename);
+        return true;
+    }
+
+    bool TestExportKeepsOffscreenPoints() {
+        AppState& app = AppState::Instance();
+        const char* filename = "png_test_offscreen.png";
+        app.drawingPoints.clear();
+        app.drawingPoints.push_back({ 50, 50, RGB(255, 0, 0), true, 6, TOOL_BRUSH });
+        app.drawingPoints.push_back({ 400, 300, RGB(255, 0, 0), false, 6, TOOL_BRUSH });
+
+        ASSERT_TRUE(DrawingEngine::ExportAsBitmap(filename, 200, 100));
+        std::vector<uint8_t> file;
+        ASSERT_TRUE(ReadFile(filename, file));
+        int width = 0, height = 0;
+        std::vector<uint32_t> decoded;
+        ASSERT_TRUE(ReferenceDecoder::DecodePng(file, width, height, decoded));
+
+        // Canvas grows to the stroke's far end; the origin stays at the window's
+        ASSERT_TRUE(width > 400 && height > 300);
+        ASSERT_EQ(RasterRenderer::ToPixel(RGB(255, 0, 0)), decoded[(size_t)300 * width + 400]);
+        ASSERT_EQ(RasterRenderer::ToPixel(RGB(255, 0, 0)), decoded[(size_t)50 * width + 50]);
+
+        app.drawingPoints.clear();
+        std::remove(filename);
+        return true;
+    }
+
+    bool TestExportRegionScale() {
+        AppState& app = AppState::Instance();
+        const char* filename = "png_test_region.png";
+        app.drawingPoints = SampleDrawing();
+
+        ASSERT_TRUE(DrawingEngine::ExportRegion(filename, 10, 20, 100, 50, 3.0));
+        std::vector<uint8_t> file;
+        ASSERT_TRUE(ReadFile(filename, file));
+        int width = 0, height = 0;
+        std::vector<uint32_t> decoded;
+        ASSERT_TRUE(ReferenceDecoder::DecodePng(file, width, height, decoded));
+        ASSERT_EQ(300, width);
+        ASSERT_EQ(150, height);
+
+        RasterRenderer::View view;
+        view.originX = 10;
+        view.originY = 20;
+        view.scale = 3.0;
+        std::vector<uint32_t> expected((size_t)width * height);
+        RasterRenderer::RenderRows(app.drawingPoints, view, width, 0, height, RGB(255, 255, 255), expected.data());
+        ASSERT_TRUE(decoded == expected);
+
+        ASSERT_FALSE(DrawingEngine::ExportRegion(filename, 0, 0, 0, 10, 1.0));
+        app.drawingPoints.clear();
+        ASSERT_FALSE(DrawingEngine::ExportDocument(filename, 1.0));
+        std::remove(filename);
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - PNG Export Tests" << std::endl;
+
+    PngExportTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
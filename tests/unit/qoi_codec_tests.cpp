@@ -0,0 +1,327 @@
+#include "../test_framework.h"
+#include "../../include/qoi_codec.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/app_state.h"
+#include "../../include/raster_renderer.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+class QoiCodecTests {
+private:
+    TestFramework framework;
+
+public:
+    QoiCodecTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("QOI Codec", true);
+        framework.AddTest("Golden Bytes", [this]() { return TestGoldenBytes(); });
+        framework.AddTest("RGB Round Trip", [this]() { return TestRoundTrip(false); });
+        framework.AddTest("RGBA Round Trip", [this]() { return TestRoundTrip(true); });
+        framework.AddTest("Long Runs Span Rows", [this]() { return TestLongRuns(); });
+        framework.AddTest("Worker Count Does Not Change Output", [this]() { return TestThreadsMatch(); });
+        framework.AddTest("Truncated Or Corrupt Input Fails", [this]() { return TestTruncated(); });
+        framework.AddBenchmark("Encode Throughput", [this](size_t iterations) { return BenchEncode(iterations); },
+                               BenchOptions(BENCH_WIDTH * BENCH_HEIGHT * 4));
+        framework.AddBenchmark("Decode Throughput", [this](size_t iterations) { return BenchDecode(iterations); },
+                               BenchOptions(BENCH_WIDTH * BENCH_HEIGHT * 4));
+
+        framework.AddSuite("Reference Layer");
+        framework.AddTest("Export By Extension Decodes To Render", [this]() { return TestExportQoi(); });
+        framework.AddTest("Reference Composited Under Strokes", [this]() { return TestReferenceComposite(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    // Mix of flat areas, gradients, small and large jumps, and varying alpha:
+    // exercises every op
+    static std::vector<uint32_t> SampleImage(int width, int height, bool alpha) {
+        std::mt19937 random(7);
+        std::vector<uint32_t> pixels((size_t)width * height);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                uint32_t pixel;
+                if (y < height / 4) {
+                    pixel = 0xFF336699u;
+                } else if (y < height / 2) {
+                    pixel = (uint32_t)(x & 0xFF) | (uint32_t)((x + y) & 0xFF) << 8 | (uint32_t)(y & 0xFF) << 16 | 0xFF000000u;
+                } else if (y < 3 * height / 4) {
+                    pixel = (x % 5 == 0) ? (random() | 0xFF000000u) : 0xFF0000FFu + (uint32_t)(x % 3);
+                } else {
+                    pixel = random();
+                }
+                if (alpha && x % 7 == 0) {
+                    pixel = (pixel & 0x00FFFFFFu) | (uint32_t)(x * 13 % 256) << 24;
+                }
+                pixels[(size_t)y * width + x] = pixel;
+            }
+        }
+        return pixels;
+    }
+
+    static ImageStream::RowSource RowsOf(const std::vector<uint32_t>& image, int width) {
+        return [&image, width](int firstRow, int rowCount, uint32_t* pixels) {
+            std::memcpy(pixels, &image[(size_t)firstRow * width], (size_t)rowCount * width * sizeof(uint32_t));
+            return true;
+        };
+    }
+
+    static bool EncodeToMemory(const std::vector<uint32_t>& image, int width, int height,
+                               const QoiCodec::Options& options, std::vector<uint8_t>& file) {
+        file.clear();
+        return QoiCodec::Encode(width, height, RowsOf(image, width),
+            [&](const void* data, size_t size) {
+                file.insert(file.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+                return true;
+            }, options);
+    }
+
+    static bool DecodeFromMemory(const std::vector<uint8_t>& file, QoiCodec::Info& info, std::vector<uint32_t>& pixels) {
+        size_t position = 0;
+        pixels.clear();
+        return QoiCodec::Decode(
+            [&](void* data, size_t size) {
+                size = std::min(size, file.size() - position);
+                std::memcpy(data, file.data() + position, size);
+                position += size;
+                return size;
+            }, info,
+            [&](int, const uint32_t* row) {
+                pixels.insert(pixels.end(), row, row + info.width);
+                return true;
+            });
+    }
+
+    // Throughput in raw pixel bytes of a 512 x 512 sample image
+    static const int BENCH_WIDTH = 512;
+    static const int BENCH_HEIGHT = 512;
+
+    static TestFramework::BenchmarkOptions BenchOptions(double bytes) {
+        TestFramework::BenchmarkOptions options;
+        options.unitsPerIteration = bytes;
+        options.unit = "bytes";
+        options.maxTotalMs = 300.0;
+        return options;
+    }
+
+    bool BenchEncode(size_t iterations) {
+        static const std::vector<uint32_t> image = SampleImage(BENCH_WIDTH, BENCH_HEIGHT, false);
+        QoiCodec::Options options;
+        options.threads = 1;
+        std::vector<uint8_t> file;
+        for (size_t i = 0; i < iterations; i++) {
+            ASSERT_TRUE(EncodeToMemory(image, BENCH_WIDTH, BENCH_HEIGHT, options, file));
+        }
+        return true;
+    }
+
+    bool BenchDecode(size_t iterations) {
+        static std::vector<uint8_t> file;
+        if (file.empty()) {
+            QoiCodec::Options options;
+            ASSERT_TRUE(EncodeToMemory(SampleImage(BENCH_WIDTH, BENCH_HEIGHT, false), BENCH_WIDTH, BENCH_HEIGHT, options, file));
+        }
+        QoiCodec::Info info;
+        std::vector<uint32_t> decoded;
+        for (size_t i = 0; i < iterations; i++) {
+            ASSERT_TRUE(DecodeFromMemory(file, info, decoded));
+        }
+        return decoded.size() == (size_t)BENCH_WIDTH * BENCH_HEIGHT;
+    }
+
+    bool TestGoldenBytes() {
+        // Two pixels equal to the initial previous pixel: a single run of 2
+        std::vector<uint32_t> image(2, 0xFF000000u);
+        std::vector<uint8_t> file;
+        ASSERT_TRUE(EncodeToMemory(image, 2, 1, QoiCodec::Options(), file));
+
+        const uint8_t expected[] = { 'q', 'o', 'i', 'f', 0, 0, 0, 2, 0, 0, 0, 1, 3, 0,
+                                     0xC1, 0, 0, 0, 0, 0, 0, 0, 1 };
+        ASSERT_EQ(sizeof(expected), file.size());
+        ASSERT_TRUE(std::memcmp(expected, file.data(), sizeof(expected)) == 0);
+
+        // RGB, INDEX, DIFF and LUMA (opaque black is not in the index yet, so it is RGB too)
+        image = { 0xFF102030u, 0xFF000000u, 0xFF102030u, 0xFF112131u, 0xFF1A2838u };
+        ASSERT_TRUE(EncodeToMemory(image, 5, 1, QoiCodec::Options(), file));
+        const uint8_t ops[] = { 0xFE, 0x30, 0x20, 0x10,    // RGB
+                                0xFE, 0x00, 0x00, 0x00,    // RGB
+                                0x15,                      // INDEX of (0x30, 0x20, 0x10)
+                                0x7F,                      // DIFF +1 +1 +1
+                                0xA7, 0x8A };              // LUMA dg = 7, dr - dg = 0, db - dg = 2
+        ASSERT_EQ(14 + sizeof(ops) + 8, file.size());
+        ASSERT_TRUE(std::memcmp(ops, file.data() + 14, sizeof(ops)) == 0);
+        return true;
+    }
+
+    bool TestRoundTrip(bool alpha) {
+        const int width = 173, height = 96;
+        std::vector<uint32_t> image = SampleImage(width, height, alpha);
+        QoiCodec::Options options;
+        options.alpha = alpha;
+        options.chunkBytes = 4096;
+        std::vector<uint8_t> file;
+        ASSERT_TRUE(EncodeToMemory(image, width, height, options, file));
+
+        QoiCodec::Info info;
+        std::vector<uint32_t> decoded;
+        ASSERT_TRUE(DecodeFromMemory(file, info, decoded));
+        ASSERT_EQ(width, info.width);
+        ASSERT_EQ(height, info.height);
+        ASSERT_EQ(alpha ? 4 : 3, info.channels);
+
+        // RGB output drops alpha, so compare against the opaque image
+        if (!alpha) {
+            for (uint32_t& pixel : image) pixel |= 0xFF000000u;
+        }
+        ASSERT_TRUE(decoded == image);
+        return true;
+    }
+
+    bool TestLongRuns() {
+        const int width = 100, height = 50;
+        std::vector<uint32_t> image((size_t)width * height, 0xFFEEDDCCu);
+        image[(size_t)width * height - 1] = 0xFF000001u;
+        QoiCodec::Options options;
+        options.chunkBytes = 1;  // One row per chunk: runs carry across chunks
+        std::vector<uint8_t> file;
+        ASSERT_TRUE(EncodeToMemory(image, width, height, options, file));
+        ASSERT_TRUE(file.size() < 14 + 8 + 100);
+
+        QoiCodec::Info info;
+        std::vector<uint32_t> decoded;
+        ASSERT_TRUE(DecodeFromMemory(file, info, decoded));
+        ASSERT_TRUE(decoded == image);
+        return true;
+    }
+
+    bool TestThreadsMatch() {
+        const int width = 300, height = 200;
+        std::vector<uint32_t> image = SampleImage(width, height, false);
+        QoiCodec::Options single, many;
+        single.threads = 1;
+        many.threads = 4;
+        single.chunkBytes = many.chunkBytes = 8 * 1024;
+        std::vector<uint8_t> first, second;
+        ASSERT_TRUE(EncodeToMemory(image, width, height, single, first));
+        ASSERT_TRUE(EncodeToMemory(image, width, height, many, second));
+        ASSERT_TRUE(first == second);
+        return true;
+    }
+
+    bool TestTruncated() {
+        const int width = 40, height = 30;
+        std::vector<uint32_t> image = SampleImage(width, height, true);
+        QoiCodec::Options options;
+        options.alpha = true;
+        std::vector<uint8_t> file;
+        ASSERT_TRUE(EncodeToMemory(image, width, height, options, file));
+
+        QoiCodec::Info info;
+        std::vector<uint32_t> decoded;
+        std::vector<uint8_t> cut(file.begin(), file.end() - 1);
+        ASSERT_FALSE(DecodeFromMemory(cut, info, decoded));
+        cut.assign(file.begin(), file.begin() + file.size() / 2);
+        ASSERT_FALSE(DecodeFromMemory(cut, info, decoded));
+
+        std::vector<uint8_t> badMagic = file;
+        badMagic[0] = 'x';
+        ASSERT_FALSE(DecodeFromMemory(badMagic, info, decoded));
+
+        ASSERT_FALSE(QoiCodec::Encode(0, 10, RowsOf(image, width), [](const void*, size_t) { return true; }));
+
+        // A failing row source leaves no file behind
+        const char* filename = "qoi_test_failed.qoi";
+        options.chunkBytes = 1024;
+        ASSERT_FALSE(QoiCodec::EncodeToFile(filename, 64, 64, [](int firstRow, int, uint32_t*) {
+            return firstRow < 32;
+        }, options));
+        std::FILE* stale = std::fopen(filename, "rb");
+        ASSERT_TRUE(stale == nullptr);
+        return true;
+    }
+
+    bool TestExportQoi() {
+        AppState& app = AppState::Instance();
+        const char* filename = "qoi_test_export.QOI";
+        app.drawingPoints.clear();
+        for (int i = 0; i < 40; i++) {
+            app.drawingPoints.push_back({ 10 + i * 4, 15 + (i * i) % 40, RGB(20, 160, 90), i == 0, 9, TOOL_BRUSH });
+        }
+
+        ASSERT_TRUE(DrawingEngine::ExportAsBitmap(filename, 200, 80));
+        RasterImage image;
+        ASSERT_TRUE(QoiCodec::DecodeFile(filename, image));
+        ASSERT_EQ(200, image.width);
+        ASSERT_EQ(80, image.height);
+
+        std::vector<uint32_t> expected((size_t)200 * 80);
+        RasterRenderer::RenderRows(app.drawingPoints, RasterRenderer::View(), 200, 0, 80, RGB(255, 255, 255), expected.data());
+        ASSERT_TRUE(image.pixels == expected);
+
+        app.drawingPoints.clear();
+        std::remove(filename);
+        return true;
+    }
+
+    bool TestReferenceComposite() {
+        AppState& app = AppState::Instance();
+        const char* referenceFile = "qoi_test_reference.qoi";
+        const char* exportFile = "qoi_test_composite.qoi";
+
+        // 30x20 reference: opaque red left half, half-transparent blue right half
+        const int width = 30, height = 20;
+        std::vector<uint32_t> reference((size_t)width * height);
+        for (int i = 0; i < width * height; i++) {
+            reference[i] = (i % width < 15) ? 0xFF0000FFu : 0x80FF0000u;
+        }
+        QoiCodec::Options options;
+        options.alpha = true;
+        ASSERT_TRUE(QoiCodec::EncodeToFile(referenceFile, width, height, RowsOf(reference, width), options));
+
+        uint32_t revision = app.referenceRevision;
+        ASSERT_TRUE(DrawingEngine::ImportReferenceImage(referenceFile));
+        ASSERT_TRUE(app.referenceRevision != revision);
+        ASSERT_TRUE(app.referenceImage.pixels == reference);
+
+        app.drawingPoints.clear();
+        app.drawingPoints.push_back({ 5, 5, RGB(0, 0, 0), true, 2, TOOL_BRUSH });
+
+        // The reference alone extends the document; strokes paint over it
+        ASSERT_TRUE(DrawingEngine::ExportDocument(exportFile, 2.0));
+        RasterImage image;
+        ASSERT_TRUE(QoiCodec::DecodeFile(exportFile, image));
+        ASSERT_EQ(2 * width, image.width);
+        ASSERT_EQ(2 * height, image.height);
+        ASSERT_EQ(0xFF0000FFu, image.pixels[(size_t)30 * image.width + 2]);
+        ASSERT_EQ(0xFF000000u, image.pixels[(size_t)10 * image.width + 10]);
+        ASSERT_EQ(0xFFFF7F7Fu, image.pixels[(size_t)30 * image.width + 50]);
+
+        DrawingEngine::ClearReferenceImage();
+        ASSERT_TRUE(app.referenceImage.pixels.empty());
+        ASSERT_FALSE(DrawingEngine::ImportReferenceImage("qoi_test_missing.qoi"));
+
+        app.drawingPoints.clear();
+        std::remove(referenceFile);
+        std::remove(exportFile);
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - QOI Codec Tests" << std::endl;
+
+    QoiCodecTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
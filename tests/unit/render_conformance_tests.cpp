@@ -0,0 +1,516 @@
+#include "../test_framework.h"
+#include "../../include/raster_renderer.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/app_state.h"
+#include "../../include/document_generator.h"
+#include "../../include/png_encoder.h"
+#include "../../include/qoi_codec.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Golden-image conformance: every .mpsp document in the corpus is rendered
+// through the reference rasterizer (RasterRenderer::RenderRows, one pass over
+// every point) and through each optimized path, and the outputs are compared
+// pixel by pixel. Mismatches write a diff image; every path is timed.
+//
+//   render_conformance_tests [--diffs DIR] [--csv FILE] [--reps N] [--tolerance N] [extra.mpsp ...]
+//
+// The built-in corpus is generated and saved as .mpsp, so loading is part of
+// the round trip; extra documents on the command line join it.
+
+struct ConformanceOptions {
+    std::vector<std::string> extraDocuments;
+    std::string diffDir = ".";
+    std::string csvFile;
+    int reps = 3;                  // Timed runs per path; the fastest counts
+    int tolerance = 0;             // Allowed per-channel difference
+};
+
+// One output to produce: a document rectangle at a scale, optionally supersampled
+struct RenderCase {
+    std::string name;              // document/view
+    const std::vector<DrawPoint>* points = nullptr;
+    int left = 0, top = 0, width = 0, height = 0;   // Document units
+    double scale = 1.0;
+    int samples = 1;
+
+    int OutputWidth() const { return (int)std::ceil(width * scale); }
+    int OutputHeight() const { return (int)std::ceil(height * scale); }
+    RasterRenderer::View OutputView() const {
+        RasterRenderer::View view;
+        view.originX = left;
+        view.originY = top;
+        view.scale = scale;
+        return view;
+    }
+};
+
+struct RenderPath {
+    const char* name;
+    std::function<bool(const RenderCase&, std::vector<uint32_t>&)> render;
+};
+
+struct Comparison {
+    size_t mismatches = 0;         // Pixels past the tolerance
+    size_t differing = 0;          // Pixels not bit-identical
+    int maxDelta = 0;
+};
+
+struct PathResult {
+    std::string caseName;
+    std::string path;
+    double bestMs = 0.0;
+    double megapixelsPerSecond = 0.0;
+    Comparison comparison;
+};
+
+static const COLORREF BACKGROUND = RGB(255, 255, 255);
+
+class RenderConformanceTests {
+private:
+    TestFramework framework;
+    ConformanceOptions options;
+    std::vector<RenderPath> paths;
+    std::vector<PathResult> results;
+
+public:
+    explicit RenderConformanceTests(const ConformanceOptions& conformanceOptions) : options(conformanceOptions) {
+        paths = BuildPaths();
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Render Conformance");
+        framework.AddTest("Mixed Document", [this]() { return TestCorpusDocument("mixed", MixedParams()); });
+        framework.AddTest("Thick Brushes", [this]() { return TestCorpusDocument("thick", ThickParams()); });
+        framework.AddTest("Hairlines And Shapes", [this]() { return TestCorpusDocument("hairline", HairlineParams()); });
+        framework.AddTest("Sparse Strokes To The Edges", [this]() { return TestCorpusDocument("sparse", SparseParams()); });
+        framework.AddTest("Isolated Dots Of Every Size", [this]() { return TestDots(); });
+        for (const std::string& filename : options.extraDocuments) {
+            framework.AddTest("Corpus File " + filename, [this, filename]() { return TestDocumentFile(filename); });
+        }
+
+        framework.AddSuite("Conformance Harness");
+        framework.AddTest("Mismatch Writes A Diff Image", [this]() { return TestMismatchDiff(); });
+        framework.AddTest("Tolerance Admits Small Differences", [this]() { return TestTolerance(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+        PrintReport();
+        if (!options.csvFile.empty() && !WriteCsv(options.csvFile)) {
+            std::cout << "Could not write " << options.csvFile << std::endl;
+        }
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    // Corpus documents: seeded, so every run renders the same pixels
+    static DocumentGenerator::Params BaseParams(uint64_t seed, size_t points) {
+        DocumentGenerator::Params params;
+        params.seed = seed;
+        params.points = points;
+        params.canvasWidth = 1600;
+        params.canvasHeight = 1200;
+        params.clusterSpread = 200.0;
+        return params;
+    }
+
+    static DocumentGenerator::Params MixedParams() {
+        return BaseParams(1, 20000);
+    }
+
+    static DocumentGenerator::Params ThickParams() {
+        DocumentGenerator::Params params = BaseParams(2, 8000);
+        params.minBrushSize = 24;
+        params.maxBrushSize = 64;
+        return params;
+    }
+
+    static DocumentGenerator::Params HairlineParams() {
+        DocumentGenerator::Params params = BaseParams(3, 20000);
+        params.minBrushSize = 1;
+        params.maxBrushSize = 2;
+        params.shapeWeights[DocumentGenerator::SHAPE_BRUSH] = 0.4;
+        params.shapeWeights[DocumentGenerator::SHAPE_LINE] = 0.2;
+        params.shapeWeights[DocumentGenerator::SHAPE_RECTANGLE] = 0.2;
+        params.shapeWeights[DocumentGenerator::SHAPE_CIRCLE] = 0.2;
+        return params;
+    }
+
+    static DocumentGenerator::Params SparseParams() {
+        DocumentGenerator::Params params = BaseParams(4, 3000);
+        params.clusters = 0;
+        params.medianLength = 400.0;
+        return params;
+    }
+
+    // Full image through SceneIndex bands of 'bandRows' rows (0: one call)
+    static bool RenderScene(const RenderCase& renderCase, int bandRows, std::vector<uint32_t>& pixels) {
+        int width = renderCase.OutputWidth(), height = renderCase.OutputHeight();
+        RasterRenderer::SceneIndex scene(*renderCase.points, renderCase.OutputView(), height, renderCase.samples);
+        int step = bandRows > 0 ? bandRows : height;
+        for (int row = 0; row < height; row += step) {
+            scene.RenderRows(width, row, std::min(step, height - row), BACKGROUND, &pixels[(size_t)row * width]);
+        }
+        return true;
+    }
+
+    std::vector<RenderPath> BuildPaths() {
+        std::vector<RenderPath> built;
+
+        built.push_back({"scene_index", [](const RenderCase& renderCase, std::vector<uint32_t>& pixels) {
+            return RenderScene(renderCase, 0, pixels);
+        }});
+
+        // Odd band height, so bands never line up with the index's own
+        built.push_back({"scene_index_bands", [](const RenderCase& renderCase, std::vector<uint32_t>& pixels) {
+            return RenderScene(renderCase, 13, pixels);
+        }});
+
+        built.push_back({"scene_index_threads", [](const RenderCase& renderCase, std::vector<uint32_t>& pixels) {
+            int width = renderCase.OutputWidth(), height = renderCase.OutputHeight();
+            RasterRenderer::SceneIndex scene(*renderCase.points, renderCase.OutputView(), height, renderCase.samples);
+            const int bandRows = 48;
+            const int threads = 4;
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&, t]() {
+                    for (int row = t * bandRows; row < height; row += threads * bandRows) {
+                        scene.RenderRows(width, row, std::min(bandRows, height - row), BACKGROUND, &pixels[(size_t)row * width]);
+                    }
+                });
+            }
+            for (std::thread& worker : workers) worker.join();
+            return true;
+        }});
+
+        // The export pipeline end to end: streamed to QOI on encoder workers and decoded back
+        built.push_back({"export_qoi", [](const RenderCase& renderCase, std::vector<uint32_t>& pixels) {
+            AppState& app = AppState::Instance();
+            if (&app.drawingPoints != renderCase.points) return false;
+            const char* filename = "render_conformance_export.qoi";
+            RasterImage image;
+            bool ok = DrawingEngine::ExportRegion(filename, renderCase.left, renderCase.top, renderCase.width,
+                                                  renderCase.height, renderCase.scale, renderCase.samples) &&
+                      QoiCodec::DecodeFile(filename, image);
+            std::remove(filename);
+            if (!ok || image.width != renderCase.OutputWidth() || image.height != renderCase.OutputHeight()) return false;
+            pixels.swap(image.pixels);
+            return true;
+        }});
+        return built;
+    }
+
+    // Scalar reference: every point visited for the whole image, then (when
+    // supersampling) a box filter over the same sample grid SceneIndex uses
+    static void RenderReference(const RenderCase& renderCase, std::vector<uint32_t>& pixels) {
+        int width = renderCase.OutputWidth(), height = renderCase.OutputHeight();
+        int samples = renderCase.samples;
+        RasterRenderer::View view = renderCase.OutputView();
+        if (samples == 1) {
+            RasterRenderer::RenderRows(*renderCase.points, view, width, 0, height, BACKGROUND, pixels.data());
+            return;
+        }
+
+        RasterRenderer::View sampleView;
+        sampleView.scale = view.scale * samples;
+        sampleView.originX = view.originX - (samples - 1) / (2.0 * sampleView.scale);
+        sampleView.originY = view.originY - (samples - 1) / (2.0 * sampleView.scale);
+        int sampleWidth = width * samples;
+        std::vector<uint32_t> grid((size_t)sampleWidth * height * samples);
+        RasterRenderer::RenderRows(*renderCase.points, sampleView, sampleWidth, 0, height * samples, BACKGROUND, grid.data());
+
+        const uint32_t area = (uint32_t)(samples * samples);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                uint32_t sum[3] = {};
+                for (int sy = 0; sy < samples; sy++) {
+                    for (int sx = 0; sx < samples; sx++) {
+                        uint32_t pixel = grid[(size_t)(y * samples + sy) * sampleWidth + x * samples + sx];
+                        for (int c = 0; c < 3; c++) sum[c] += (pixel >> (8 * c)) & 0xFF;
+                    }
+                }
+                pixels[(size_t)y * width + x] = RGB((sum[0] + area / 2) / area, (sum[1] + area / 2) / area,
+                                                    (sum[2] + area / 2) / area) | 0xFF000000u;
+            }
+        }
+    }
+
+    static Comparison Compare(const std::vector<uint32_t>& expected, const std::vector<uint32_t>& actual, int tolerance) {
+        Comparison comparison;
+        for (size_t i = 0; i < expected.size(); i++) {
+            if (expected[i] == actual[i]) continue;
+            int delta = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                delta = std::max(delta, std::abs((int)((expected[i] >> shift) & 0xFF) - (int)((actual[i] >> shift) & 0xFF)));
+            }
+            comparison.differing++;
+            comparison.maxDelta = std::max(comparison.maxDelta, delta);
+            if (delta > tolerance) comparison.mismatches++;
+        }
+        return comparison;
+    }
+
+    // Matching pixels are a faded copy of the reference; differences within
+    // the tolerance are yellow and mismatches red
+    static bool WriteDiffImage(const std::string& filename, const std::vector<uint32_t>& expected,
+                               const std::vector<uint32_t>& actual, int width, int height, int tolerance) {
+        std::vector<uint32_t> diff(expected.size());
+        for (size_t i = 0; i < expected.size(); i++) {
+            uint32_t pixel = expected[i];
+            if (pixel == actual[i]) {
+                uint32_t gray = (((pixel & 0xFF) + ((pixel >> 8) & 0xFF) + ((pixel >> 16) & 0xFF)) / 3) / 4 + 191;
+                diff[i] = RasterRenderer::ToPixel(RGB(gray, gray, gray));
+                continue;
+            }
+            Comparison single = Compare(std::vector<uint32_t>(1, pixel), std::vector<uint32_t>(1, actual[i]), tolerance);
+            diff[i] = RasterRenderer::ToPixel(single.mismatches ? RGB(255, 0, 0) : RGB(255, 200, 0));
+        }
+        return PngEncoder::EncodeToFile(filename, width, height, [&](int firstRow, int rowCount, uint32_t* pixels) {
+            std::memcpy(pixels, &diff[(size_t)firstRow * width], (size_t)rowCount * width * sizeof(uint32_t));
+            return true;
+        });
+    }
+
+    std::string DiffFilename(const RenderCase& renderCase, const char* path) const {
+        std::string name = renderCase.name + "_" + path + "_diff.png";
+        std::replace(name.begin(), name.end(), '/', '_');
+        return options.diffDir + "/" + name;
+    }
+
+    // Best of options.reps runs
+    double TimeRender(const std::function<void()>& render) const {
+        double best = 1e300;
+        for (int rep = 0; rep < std::max(1, options.reps); rep++) {
+            auto start = std::chrono::steady_clock::now();
+            render();
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    void Record(const RenderCase& renderCase, const char* path, double bestMs, const Comparison& comparison) {
+        PathResult result;
+        result.caseName = renderCase.name;
+        result.path = path;
+        result.bestMs = bestMs;
+        double pixels = (double)renderCase.OutputWidth() * renderCase.OutputHeight();
+        result.megapixelsPerSecond = bestMs > 0.0 ? pixels / (bestMs * 1000.0) : 0.0;
+        result.comparison = comparison;
+        results.push_back(result);
+    }
+
+    // Renders one case through the reference and every path; false on any mismatch
+    bool CheckCase(const RenderCase& renderCase) {
+        size_t pixelCount = (size_t)renderCase.OutputWidth() * renderCase.OutputHeight();
+        std::vector<uint32_t> expected(pixelCount);
+        double referenceMs = TimeRender([&]() { RenderReference(renderCase, expected); });
+        Record(renderCase, "reference", referenceMs, Comparison());
+
+        bool allMatch = true;
+        for (const RenderPath& path : paths) {
+            std::vector<uint32_t> actual(pixelCount);
+            bool rendered = true;
+            double bestMs = TimeRender([&]() {
+                actual.assign(pixelCount, 0);
+                rendered = path.render(renderCase, actual) && rendered;
+            });
+            if (!rendered || actual.size() != pixelCount) {
+                std::cout << "    " << renderCase.name << ": " << path.name << " failed to render" << std::endl;
+                allMatch = false;
+                continue;
+            }
+
+            Comparison comparison = Compare(expected, actual, options.tolerance);
+            Record(renderCase, path.name, bestMs, comparison);
+            if (comparison.mismatches > 0) {
+                std::string diffFile = DiffFilename(renderCase, path.name);
+                WriteDiffImage(diffFile, expected, actual, renderCase.OutputWidth(), renderCase.OutputHeight(), options.tolerance);
+                std::cout << "    " << renderCase.name << ": " << path.name << " differs in " << comparison.mismatches
+                          << " pixels (max delta " << comparison.maxDelta << "), see " << diffFile << std::endl;
+                allMatch = false;
+            }
+        }
+        return allMatch;
+    }
+
+    // Whole document fitted to ~800 px, a zoomed detail, and a supersampled overview
+    bool CheckDocument(const std::string& name) {
+        AppState& app = AppState::Instance();
+        RasterRenderer::Bounds bounds;
+        if (!RasterRenderer::DocumentBounds(app.drawingPoints, bounds)) return false;
+        int width = bounds.right - bounds.left, height = bounds.bottom - bounds.top;
+
+        RenderCase fit;
+        fit.name = name + "/fit";
+        fit.points = &app.drawingPoints;
+        fit.left = bounds.left;
+        fit.top = bounds.top;
+        fit.width = width;
+        fit.height = height;
+        fit.scale = std::min(1.0, 800.0 / std::max(width, height));
+
+        RenderCase zoom = fit;
+        zoom.name = name + "/zoom";
+        zoom.width = std::min(width, 160);
+        zoom.height = std::min(height, 120);
+        zoom.left = bounds.left + (width - zoom.width) / 2;
+        zoom.top = bounds.top + (height - zoom.height) / 2;
+        zoom.scale = 2.5;
+
+        RenderCase antialiased = fit;
+        antialiased.name = name + "/aa3";
+        antialiased.scale = std::min(1.0, 300.0 / std::max(width, height));
+        antialiased.samples = 3;
+
+        bool fitOk = CheckCase(fit);
+        bool zoomOk = CheckCase(zoom);
+        bool antialiasedOk = CheckCase(antialiased);
+        return fitOk && zoomOk && antialiasedOk;
+    }
+
+    static void ClearDocument() {
+        AppState& app = AppState::Instance();
+        app.drawingPoints.clear();
+        app.undoStack.clear();
+        app.redoStack.clear();
+        app.referenceImage = RasterImage();
+    }
+
+    // Generated, saved as .mpsp and loaded back before rendering
+    bool TestCorpusDocument(const char* name, const DocumentGenerator::Params& params) {
+        AppState& app = AppState::Instance();
+        ClearDocument();
+        DocumentGenerator::Generate(params, app.drawingPoints);
+        std::string filename = std::string("render_conformance_") + name + ".mpsp";
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(filename));
+        app.drawingPoints.clear();
+        ASSERT_TRUE(DrawingEngine::LoadDrawing(filename));
+        std::remove(filename.c_str());
+        ASSERT_EQ(params.points, app.drawingPoints.size());
+
+        bool ok = CheckDocument(name);
+        ClearDocument();
+        return ok;
+    }
+
+    bool TestDocumentFile(const std::string& filename) {
+        ClearDocument();
+        ASSERT_TRUE(DrawingEngine::LoadDrawing(filename));
+        std::string name = filename.substr(filename.find_last_of("/\\") + 1);
+        bool ok = CheckDocument(name);
+        ClearDocument();
+        return ok;
+    }
+
+    // Single-point strokes of sizes 0..15 on and off the pixel grid, each tool
+    bool TestDots() {
+        AppState& app = AppState::Instance();
+        ClearDocument();
+        const ToolType tools[] = { TOOL_BRUSH, TOOL_LINE, TOOL_RECTANGLE, TOOL_CIRCLE };
+        for (int size = 0; size < 16; size++) {
+            for (int t = 0; t < 4; t++) {
+                DrawPoint point = { 20 + size * 37, 20 + t * 41, RGB(size * 15, t * 60, 200), true, size, tools[t] };
+                app.drawingPoints.push_back(point);
+            }
+        }
+        bool ok = CheckDocument("dots");
+        ClearDocument();
+        return ok;
+    }
+
+    bool TestMismatchDiff() {
+        std::vector<uint32_t> expected(40 * 30, RasterRenderer::ToPixel(RGB(255, 255, 255)));
+        std::vector<uint32_t> actual = expected;
+        actual[5 * 40 + 7] = RasterRenderer::ToPixel(RGB(0, 0, 0));
+        actual[6 * 40 + 7] = RasterRenderer::ToPixel(RGB(250, 255, 255));
+
+        Comparison comparison = Compare(expected, actual, 0);
+        ASSERT_EQ((size_t)2, comparison.mismatches);
+        ASSERT_EQ(255, comparison.maxDelta);
+
+        const char* filename = "render_conformance_diff_test.png";
+        ASSERT_TRUE(WriteDiffImage(filename, expected, actual, 40, 30, 0));
+        std::FILE* file = std::fopen(filename, "rb");
+        ASSERT_TRUE(file != nullptr);
+        unsigned char signature[8] = {};
+        size_t read = std::fread(signature, 1, sizeof(signature), file);
+        std::fclose(file);
+        std::remove(filename);
+        ASSERT_EQ(sizeof(signature), read);
+        ASSERT_TRUE(signature[1] == 'P' && signature[2] == 'N' && signature[3] == 'G');
+        return true;
+    }
+
+    bool TestTolerance() {
+        std::vector<uint32_t> expected(16, RasterRenderer::ToPixel(RGB(100, 100, 100)));
+        std::vector<uint32_t> actual = expected;
+        actual[3] = RasterRenderer::ToPixel(RGB(101, 99, 100));
+        actual[9] = RasterRenderer::ToPixel(RGB(100, 100, 103));
+
+        Comparison strict = Compare(expected, actual, 0);
+        ASSERT_EQ((size_t)2, strict.mismatches);
+        Comparison loose = Compare(expected, actual, 1);
+        ASSERT_EQ((size_t)1, loose.mismatches);
+        ASSERT_EQ((size_t)2, loose.differing);
+        ASSERT_EQ(3, loose.maxDelta);
+        ASSERT_EQ((size_t)0, Compare(expected, actual, 3).mismatches);
+        return true;
+    }
+
+    void PrintReport() const {
+        std::printf("%-22s %-20s %10s %12s %10s\n", "case", "path", "best ms", "Mpixel/s", "mismatch");
+        for (const PathResult& result : results) {
+            std::printf("%-22s %-20s %10.2f %12.1f %10zu\n", result.caseName.c_str(), result.path.c_str(),
+                        result.bestMs, result.megapixelsPerSecond, result.comparison.mismatches);
+        }
+    }
+
+    bool WriteCsv(const std::string& filename) const {
+        std::FILE* file = std::fopen(filename.c_str(), "w");
+        if (!file) {
+            return false;
+        }
+        std::fprintf(file, "case,path,best_ms,megapixels_per_s,mismatched_pixels,differing_pixels,max_delta\n");
+        for (const PathResult& result : results) {
+            std::fprintf(file, "%s,%s,%.3f,%.2f,%zu,%zu,%d\n", result.caseName.c_str(), result.path.c_str(), result.bestMs,
+                         result.megapixelsPerSecond, result.comparison.mismatches, result.comparison.differing,
+                         result.comparison.maxDelta);
+        }
+        return std::fclose(file) == 0;
+    }
+};
+
+int main(int argc, char** argv) {
+    std::cout << "Modern Paint Studio Pro - Render Conformance Tests" << std::endl;
+
+    ConformanceOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--diffs" && i + 1 < argc) {
+            options.diffDir = argv[++i];
+        } else if (arg == "--csv" && i + 1 < argc) {
+            options.csvFile = argv[++i];
+        } else if (arg == "--reps" && i + 1 < argc) {
+            options.reps = std::atoi(argv[++i]);
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            options.tolerance = std::atoi(argv[++i]);
+        } else {
+            options.extraDocuments.push_back(arg);
+        }
+    }
+
+    RenderConformanceTests tests(options);
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
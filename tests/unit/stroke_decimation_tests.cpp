@@ -0,0 +1,242 @@
+#include "../test_framework.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/document_journal.h"
+#include "../../include/app_state.h"
+#include "../../include/config.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+class StrokeDecimationTests {
+private:
+    TestFramework framework;
+
+public:
+    StrokeDecimationTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Stroke Decimation");
+        framework.AddTest("Straight Runs Keep Their Ends", [this]() { return TestStraight(); });
+        framework.AddTest("Slow Curves Stay Within Tolerance", [this]() { return TestCurves(); });
+        framework.AddTest("Turns And Stroke Starts Are Kept", [this]() { return TestTurns(); });
+        framework.AddTest("Batched Damage Covers Moved Points", [this]() { return TestBatch(); });
+        framework.AddTest("Journaled Points Are Never Rewritten", [this]() { return TestJournal(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static void ResetDocument() {
+        AppState& app = AppState::Instance();
+        DocumentJournal::Detach(true);
+        app.drawingPoints.clear();
+        app.undoStack.clear();
+        app.redoStack.clear();
+        app.isDrawing = false;
+        app.currentTool = TOOL_BRUSH;
+        app.currentColor = RGB(0, 0, 0);
+        app.brushSize = 5;
+        app.strokeTolerance = STROKE_TOLERANCE;
+    }
+
+    // Integer pointer positions along a circle, one pixel of travel apart
+    static std::vector<DrawingEngine::StrokePoint> Arc(int centerX, int centerY, double radius, double sweep) {
+        std::vector<DrawingEngine::StrokePoint> positions;
+        int steps = (int)(radius * sweep);
+        for (int i = 0; i <= steps; i++) {
+            double angle = sweep * i / steps;
+            DrawingEngine::StrokePoint point = {(int)std::lround(centerX + radius * std::cos(angle)),
+                                                (int)std::lround(centerY + radius * std::sin(angle))};
+            if (positions.empty() || point.x != positions.back().x || point.y != positions.back().y) {
+                positions.push_back(point);
+            }
+        }
+        return positions;
+    }
+
+    static void Draw(const std::vector<DrawingEngine::StrokePoint>& positions) {
+        DrawingEngine::StartDrawing(positions[0].x, positions[0].y);
+        for (size_t i = 1; i < positions.size(); i++) {
+            DrawingEngine::ContinueDrawing(positions[i].x, positions[i].y);
+        }
+        DrawingEngine::EndDrawing();
+    }
+
+    static double DistanceToSegment(double px, double py, const DrawPoint& a, const DrawPoint& b) {
+        double dx = b.x - a.x;
+        double dy = b.y - a.y;
+        double lengthSquared = dx * dx + dy * dy;
+        double t = lengthSquared > 0.0 ? ((px - a.x) * dx + (py - a.y) * dy) / lengthSquared : 0.0;
+        t = std::max(0.0, std::min(1.0, t));
+        return std::hypot(a.x + t * dx - px, a.y + t * dy - py);
+    }
+
+    // How far the stored polyline strays from any raw position
+    static double WorstDeviation(const std::vector<DrawingEngine::StrokePoint>& positions, const std::vector<DrawPoint>& stroke) {
+        double worst = 0.0;
+        for (const DrawingEngine::StrokePoint& position : positions) {
+            double nearest = 1e9;
+            for (size_t i = 1; i < stroke.size(); i++) {
+                nearest = std::min(nearest, DistanceToSegment(position.x, position.y, stroke[i - 1], stroke[i]));
+            }
+            worst = std::max(worst, nearest);
+        }
+        return worst;
+    }
+
+    bool TestStraight() {
+        ResetDocument();
+        AppState& app = AppState::Instance();
+        std::vector<DrawingEngine::StrokePoint> positions;
+        for (int i = 0; i <= 300; i++) {
+            DrawingEngine::StrokePoint point = {100 + i, 200 + (i + 1) / 3};
+            positions.push_back(point);
+        }
+        Draw(positions);
+
+        // A shallow staircase is one segment; both ends are exact
+        ASSERT_EQ((size_t)2, app.drawingPoints.size());
+        ASSERT_TRUE(app.drawingPoints[0].isStart);
+        ASSERT_EQ(400, app.drawingPoints[1].x);
+        ASSERT_EQ(300, app.drawingPoints[1].y);
+        ASSERT_TRUE(WorstDeviation(positions, app.drawingPoints) <= app.strokeTolerance * 1.5);
+
+        // Without a tolerance every position is kept
+        ResetDocument();
+        app.strokeTolerance = 0.0;
+        Draw(positions);
+        ASSERT_EQ(positions.size(), app.drawingPoints.size());
+        ResetDocument();
+        return true;
+    }
+
+    bool TestCurves() {
+        ResetDocument();
+        AppState& app = AppState::Instance();
+        for (double radius : {30.0, 120.0, 400.0}) {
+            app.drawingPoints.clear();
+            std::vector<DrawingEngine::StrokePoint> positions = Arc(500, 500, radius, 3.0);
+            Draw(positions);
+
+            // Far fewer points, none of the shape lost: the online pass holds
+            // each raw point to the tolerance, the final pass adds half again
+            ASSERT_TRUE(app.drawingPoints.size() * 5 <= positions.size());
+            ASSERT_TRUE(app.drawingPoints.size() >= 4);
+            ASSERT_TRUE(WorstDeviation(positions, app.drawingPoints) <= app.strokeTolerance * 1.5 + 1e-9);
+            ASSERT_EQ(positions.back().x, app.drawingPoints.back().x);
+            ASSERT_EQ(positions.back().y, app.drawingPoints.back().y);
+        }
+        ResetDocument();
+        return true;
+    }
+
+    bool TestTurns() {
+        ResetDocument();
+        AppState& app = AppState::Instance();
+
+        // Out and straight back: the turnaround is off neither segment's line
+        std::vector<DrawingEngine::StrokePoint> positions;
+        for (int i = 0; i <= 50; i++) {
+            DrawingEngine::StrokePoint point = {100 + i, 100};
+            positions.push_back(point);
+        }
+        for (int i = 49; i >= 0; i--) {
+            DrawingEngine::StrokePoint point = {100 + i, 100};
+            positions.push_back(point);
+        }
+        Draw(positions);
+        ASSERT_EQ((size_t)3, app.drawingPoints.size());
+        ASSERT_EQ(150, app.drawingPoints[1].x);
+
+        // A second stroke continuing the same line starts on its own
+        DrawingEngine::SetColor(RGB(200, 0, 0));
+        DrawingEngine::StartDrawing(101, 100);
+        DrawingEngine::ContinueDrawing(102, 100);
+        DrawingEngine::ContinueDrawing(103, 100);
+        DrawingEngine::EndDrawing();
+        ASSERT_EQ((size_t)5, app.drawingPoints.size());
+        ASSERT_TRUE(app.drawingPoints[3].isStart);
+        ASSERT_EQ(RGB(200, 0, 0), app.drawingPoints[4].color);
+        ASSERT_EQ(103, app.drawingPoints[4].x);
+        ASSERT_EQ(RGB(0, 0, 0), app.drawingPoints[2].color);
+        ResetDocument();
+        return true;
+    }
+
+    bool TestBatch() {
+        ResetDocument();
+        AppState& app = AppState::Instance();
+        std::vector<DrawingEngine::StrokePoint> positions = Arc(300, 300, 80.0, 2.0);
+        Draw(positions);
+        std::vector<DrawPoint> single = app.drawingPoints;
+
+        // The same positions in small batches decimate the same way, and each
+        // batch's damage covers the segment its moved point now ends
+        app.drawingPoints.clear();
+        DrawingEngine::StartDrawing(positions[0].x, positions[0].y);
+        for (size_t i = 1; i < positions.size(); i += 5) {
+            size_t count = std::min((size_t)5, positions.size() - i);
+            DrawingEngine::Damage damage;
+            ASSERT_EQ(count, DrawingEngine::ContinueDrawingBatch(&positions[i], count, &damage));
+            const DrawPoint& anchor = app.drawingPoints[app.drawingPoints.size() - 2];
+            const DrawPoint& last = app.drawingPoints.back();
+            ASSERT_TRUE(damage.left <= std::min(anchor.x, last.x) && std::max(anchor.x, last.x) < damage.right);
+            ASSERT_TRUE(damage.top <= std::min(anchor.y, last.y) && std::max(anchor.y, last.y) < damage.bottom);
+        }
+        DrawingEngine::EndDrawing();
+        ASSERT_EQ(single.size(), app.drawingPoints.size());
+        for (size_t i = 0; i < single.size(); i++) {
+            ASSERT_EQ(single[i].x, app.drawingPoints[i].x);
+            ASSERT_EQ(single[i].y, app.drawingPoints[i].y);
+        }
+        ResetDocument();
+        return true;
+    }
+
+    bool TestJournal() {
+        ResetDocument();
+        AppState& app = AppState::Instance();
+        ASSERT_TRUE(DocumentJournal::NewDocument());
+
+        // An autosave mid-stroke fixes what it wrote, even on a straight line
+        DrawingEngine::StartDrawing(10, 10);
+        for (int i = 1; i <= 20; i++) {
+            DrawingEngine::ContinueDrawing(10 + i, 10);
+        }
+        DocumentJournal::Commit();
+        std::vector<DrawPoint> journaled = app.drawingPoints;
+        ASSERT_EQ(journaled.size(), DocumentJournal::JournaledPoints());
+        for (int i = 21; i <= 60; i++) {
+            DrawingEngine::ContinueDrawing(10 + i, 10);
+        }
+        DrawingEngine::EndDrawing();
+
+        ASSERT_EQ(journaled.size() + 1, app.drawingPoints.size());
+        for (size_t i = 0; i < journaled.size(); i++) {
+            ASSERT_EQ(journaled[i].x, app.drawingPoints[i].x);
+        }
+        ASSERT_EQ(70, app.drawingPoints.back().x);
+
+        DocumentJournal::Detach(true);
+        std::remove(AUTOSAVE_DOCUMENT);
+        ResetDocument();
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Stroke Decimation Tests" << std::endl;
+
+    StrokeDecimationTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
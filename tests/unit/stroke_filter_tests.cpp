@@ -0,0 +1,144 @@
+#include "../test_framework.h"
+#include "../../include/stroke_filter.h"
+#include <cmath>
+#include <cstdint>
+
+class StrokeFilterTests {
+private:
+    TestFramework framework;
+
+public:
+    StrokeFilterTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Stroke Filter");
+        framework.AddTest("Jitter At Rest Is Smoothed", [this]() { return TestJitterAtRest(); });
+        framework.AddTest("Jagged Lines Come Out Straighter", [this]() { return TestJaggedLine(); });
+        framework.AddTest("Fast Strokes Keep Up", [this]() { return TestFastStroke(); });
+        framework.AddTest("Prediction Leads The Pen", [this]() { return TestPrediction(); });
+        framework.AddTest("Repeated Timestamps", [this]() { return TestRepeatedTime(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    // Deterministic +-amplitude noise, as integer mouse positions have
+    static double Noise(uint32_t& seed, double amplitude) {
+        seed = seed * 1664525u + 1013904223u;
+        return ((seed >> 8) / (double)(1u << 24) * 2.0 - 1.0) * amplitude;
+    }
+
+    bool TestJitterAtRest() {
+        StrokeFilter::Filter filter;
+        StrokeFilter::Reset(filter, 100.0, 100.0, 0);
+        uint32_t seed = 1;
+        double rawSpread = 0.0;
+        double filteredSpread = 0.0;
+        for (int i = 1; i <= 1000; i++) {
+            double x = std::round(100.0 + Noise(seed, 2.0));
+            double y = std::round(100.0 + Noise(seed, 2.0));
+            StrokeFilter::Position out = StrokeFilter::Apply(filter, x, y, (uint64_t)i * 1000);
+            rawSpread += std::fabs(x - 100.0) + std::fabs(y - 100.0);
+            filteredSpread += std::fabs(out.x - 100.0) + std::fabs(out.y - 100.0);
+        }
+        ASSERT_TRUE(filteredSpread < rawSpread / 4.0);
+        return true;
+    }
+
+    bool TestJaggedLine() {
+        // A slow diagonal with pixel jitter; distance from the true line shrinks
+        StrokeFilter::Filter filter;
+        StrokeFilter::Reset(filter, 0.0, 0.0, 0);
+        uint32_t seed = 7;
+        double rawError = 0.0;
+        double filteredError = 0.0;
+        for (int i = 1; i <= 500; i++) {
+            double t = i * 0.2;
+            double x = std::round(t + Noise(seed, 1.5));
+            double y = std::round(t + Noise(seed, 1.5));
+            StrokeFilter::Position out = StrokeFilter::Apply(filter, x, y, (uint64_t)i * 4000);
+            rawError += std::fabs(x - y) / std::sqrt(2.0);
+            filteredError += std::fabs(out.x - out.y) / std::sqrt(2.0);
+        }
+        ASSERT_TRUE(filteredError < rawError / 2.0);
+        return true;
+    }
+
+    bool TestFastStroke() {
+        // 2000 px/s at 1 kHz: every sample moves the output at once, and the
+        // lag settles to a few pixels
+        StrokeFilter::Filter filter;
+        StrokeFilter::Reset(filter, 0.0, 0.0, 0);
+        double previous = 0.0;
+        double lag = 0.0;
+        for (int i = 1; i <= 300; i++) {
+            double x = i * 2.0;
+            StrokeFilter::Position out = StrokeFilter::Apply(filter, x, 50.0, (uint64_t)i * 1000);
+            ASSERT_TRUE(out.x > previous);
+            ASSERT_TRUE(std::fabs(out.y - 50.0) < 50.0);
+            previous = out.x;
+            lag = x - out.x;
+        }
+        ASSERT_TRUE(lag >= 0.0 && lag < 6.0);
+        return true;
+    }
+
+    bool TestPrediction() {
+        StrokeFilter::Filter filter;
+        StrokeFilter::Reset(filter, 0.0, 0.0, 0);
+        for (int i = 1; i <= 300; i++) {
+            StrokeFilter::Apply(filter, i * 1.0, i * 0.5, (uint64_t)i * 1000);
+        }
+
+        // 1000 x 500 px/s: a frame ahead is ~16 px further along x and
+        // closer to the real pen than the filtered position is
+        StrokeFilter::Position ahead = StrokeFilter::Predict(filter, 16667, 100.0);
+        ASSERT_TRUE(ahead.x > filter.position.x + 12.0 && ahead.x < filter.position.x + 20.0);
+        ASSERT_TRUE(std::fabs((ahead.y - filter.position.y) * 2.0 - (ahead.x - filter.position.x)) < 1.0);
+        ASSERT_TRUE(std::fabs(ahead.x - 300.0) < std::fabs(filter.position.x - 300.0) + 12.0);
+
+        // Clamped to the longest tail
+        StrokeFilter::Position clamped = StrokeFilter::Predict(filter, 1000000, 10.0);
+        double dx = clamped.x - filter.position.x;
+        double dy = clamped.y - filter.position.y;
+        ASSERT_TRUE(std::fabs(std::sqrt(dx * dx + dy * dy) - 10.0) < 1e-6);
+
+        // At rest there is nothing to predict
+        StrokeFilter::Reset(filter, 5.0, 5.0, 0);
+        StrokeFilter::Position still = StrokeFilter::Predict(filter, 16667, 100.0);
+        ASSERT_TRUE(still.x == 5.0 && still.y == 5.0);
+        return true;
+    }
+
+    bool TestRepeatedTime() {
+        // Coalesced moves can share a millisecond timestamp
+        StrokeFilter::Filter filter;
+        StrokeFilter::Reset(filter, 0.0, 0.0, 5000);
+        StrokeFilter::Position out = StrokeFilter::Position();
+        for (int i = 1; i <= 10; i++) {
+            out = StrokeFilter::Apply(filter, i * 3.0, 0.0, 5000);
+        }
+        ASSERT_TRUE(std::isfinite(out.x) && std::isfinite(filter.velocity.x));
+        ASSERT_TRUE(out.x > 0.0 && out.x <= 30.0);
+        out = StrokeFilter::Apply(filter, 31.0, 0.0, 4000);   // Out of order counts as 1 ms too
+        ASSERT_TRUE(std::isfinite(out.x) && out.x <= 31.0);
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Stroke Filter Tests" << std::endl;
+
+    StrokeFilterTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
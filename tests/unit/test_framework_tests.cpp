@@ -0,0 +1,175 @@
+#include "../test_framework.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+class TestFrameworkTests {
+private:
+    TestFramework framework;
+
+public:
+    TestFrameworkTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Test Framework");
+        framework.AddTest("Independent Suites Run In Parallel", [this]() { return TestParallelSuites(); });
+        framework.AddTest("Parallel Results Aggregate In Order", [this]() { return TestAggregation(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    // What the inner suites saw while they ran
+    struct Observed {
+        std::thread::id caller;
+        std::atomic<int> plainDone{0};          // Plain tests of independent suites finished
+        std::atomic<int> arrived{0};
+        std::atomic<bool> offCaller{true};      // Every independent plain test ran on a worker
+        std::atomic<bool> overlapped{true};     // Both rendezvous tests saw each other
+        bool benchmarkOnCaller = false;
+        bool dependentOnCaller = false;
+        int plainDoneBeforeDependent = -1;
+    };
+
+    // Waits (bounded) until both rendezvous tests are running at once
+    static bool Rendezvous(Observed& observed) {
+        observed.arrived++;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (observed.arrived.load() < 2 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        return observed.arrived.load() >= 2;
+    }
+
+    // Three independent suites with a pass, a failure, a throw and a
+    // benchmark, plus one dependent suite registered between them
+    static void Populate(TestFramework& inner, Observed& observed, bool rendezvous) {
+        auto plain = [&observed](bool result) {
+            return [&observed, result]() {
+                if (std::this_thread::get_id() == observed.caller) observed.offCaller = false;
+                observed.plainDone++;
+                return result;
+            };
+        };
+        auto meeting = [&observed, rendezvous]() {
+            if (std::this_thread::get_id() == observed.caller) observed.offCaller = false;
+            if (rendezvous && !Rendezvous(observed)) observed.overlapped = false;
+            observed.plainDone++;
+            return true;
+        };
+
+        TestFramework::BenchmarkOptions quick;
+        quick.warmupRuns = 0;
+        quick.minSamples = 1;
+        quick.maxSamples = 1;
+        quick.minSampleMs = 0.0;
+
+        inner.AddSuite("Alpha", true);
+        inner.AddTest("Alpha Meets Beta", meeting);
+        inner.AddTest("Alpha Fails", plain(false));
+        inner.AddBenchmark("Alpha Bench", [&observed](size_t) {
+            observed.benchmarkOnCaller = std::this_thread::get_id() == observed.caller;
+            return true;
+        }, quick);
+
+        inner.AddSuite("Beta", true);
+        inner.AddTest("Beta Meets Alpha", meeting);
+        inner.AddTest("Beta Throws", [&observed]() -> bool {
+            observed.plainDone++;
+            throw std::runtime_error("beta failed");
+        });
+
+        inner.AddSuite("Gamma");
+        inner.AddTest("Gamma Runs Alone", [&observed]() {
+            observed.dependentOnCaller = std::this_thread::get_id() == observed.caller;
+            observed.plainDoneBeforeDependent = observed.plainDone.load();
+            return true;
+        });
+
+        inner.AddSuite("Delta", true);
+        inner.AddTest("Delta Passes", plain(true));
+    }
+
+    // Runs the inner framework with its report captured
+    static std::string RunQuietly(TestFramework& inner) {
+        std::ostringstream output;
+        std::streambuf* saved = std::cout.rdbuf(output.rdbuf());
+        inner.RunAllTests();
+        std::cout.rdbuf(saved);
+        return output.str();
+    }
+
+    bool TestParallelSuites() {
+        Observed observed;
+        observed.caller = std::this_thread::get_id();
+        // One worker on a single core: the rendezvous could never complete
+        bool rendezvous = std::thread::hardware_concurrency() > 1;
+        TestFramework inner;
+        Populate(inner, observed, rendezvous);
+        RunQuietly(inner);
+
+        ASSERT_TRUE(observed.offCaller.load());
+        ASSERT_TRUE(observed.overlapped.load());
+        // Benchmarks and dependent suites wait for the parallel phase, on the caller
+        ASSERT_TRUE(observed.benchmarkOnCaller);
+        ASSERT_TRUE(observed.dependentOnCaller);
+        ASSERT_EQ(5, observed.plainDoneBeforeDependent);
+        return true;
+    }
+
+    bool TestAggregation() {
+        Observed observed;
+        observed.caller = std::this_thread::get_id();
+        TestFramework inner;
+        Populate(inner, observed, std::thread::hardware_concurrency() > 1);
+        std::string output = RunQuietly(inner);
+
+        // Every test counted once, failures and exceptions included, in registration order
+        const std::vector<TestFramework::TestResult>& results = inner.Results();
+        const char* names[] = {"Alpha Meets Beta", "Alpha Fails", "Alpha Bench", "Beta Meets Alpha",
+                               "Beta Throws", "Gamma Runs Alone", "Delta Passes"};
+        const bool passed[] = {true, false, true, true, false, true, true};
+        ASSERT_EQ((size_t)7, results.size());
+        for (size_t i = 0; i < results.size(); i++) {
+            ASSERT_EQ(std::string(names[i]), results[i].testName);
+            ASSERT_EQ(passed[i], results[i].passed);
+        }
+        ASSERT_TRUE(results[2].benchmark);
+        ASSERT_EQ(std::string("beta failed"), results[4].errorMessage);
+        ASSERT_FALSE(inner.AllTestsPassed());
+        ASSERT_TRUE(output.find("Total Tests: 7") != std::string::npos);
+        ASSERT_TRUE(output.find("Passed: 5") != std::string::npos);
+        ASSERT_TRUE(output.find("Failed: 2") != std::string::npos);
+
+        // Held output is printed suite by suite, never interleaved
+        const char* sequence[] = {"Running Alpha tests:", "- Alpha Meets Beta (", "- Alpha Fails (", "- Alpha Bench (",
+                                  "Running Beta tests:", "- Beta Meets Alpha (", "- Beta Throws (",
+                                  "Running Gamma tests:", "- Gamma Runs Alone (",
+                                  "Running Delta tests:", "- Delta Passes (", "=== Test Summary ==="};
+        size_t position = 0;
+        for (const char* text : sequence) {
+            size_t found = output.find(text, position);
+            ASSERT_TRUE(found != std::string::npos);
+            position = found + 1;
+        }
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Test Framework Tests" << std::endl;
+
+    TestFrameworkTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+#include "../test_framework.h"
+#include "../../include/trace_events.h"
+#include "../../include/drawing_engine.h"
+#include "../../include/app_state.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <thread>
+
+class TraceEventsTests {
+private:
+    TestFramework framework;
+
+public:
+    TraceEventsTests() {
+        SetupTests();
+    }
+
+    void SetupTests() {
+        framework.AddSuite("Trace Events");
+        framework.AddTest("Scopes Become Complete Events", [this]() { return TestScopes(); });
+        framework.AddTest("Nested Scopes Stay Inside Their Parent", [this]() { return TestNesting(); });
+        framework.AddTest("Engine Operations Are Instrumented", [this]() { return TestEngineInstrumentation(); });
+        framework.AddTest("Threads Keep Separate Buffers", [this]() { return TestThreads(); });
+        framework.AddTest("Full Buffers Drop And Count", [this]() { return TestDropping(); });
+    }
+
+    void RunTests() {
+        framework.RunAllTests();
+    }
+
+    bool AllTestsPassed() const {
+        return framework.AllTestsPassed();
+    }
+
+private:
+    static const char* TraceFile() { return "trace_events_test.json"; }
+
+    static std::vector<std::string> FlushLines() {
+        std::vector<std::string> lines;
+        if (!TraceEvents::Flush(TraceFile())) return lines;
+        std::FILE* file = std::fopen(TraceFile(), "r");
+        char line[1024];
+        while (file && std::fgets(line, sizeof(line), file)) lines.push_back(line);
+        if (file) std::fclose(file);
+        std::remove(TraceFile());
+        return lines;
+    }
+
+    static std::string FindEvent(const std::vector<std::string>& lines, const char* name) {
+        std::string quoted = std::string("\"name\":\"") + name + "\"";
+        for (const std::string& line : lines) {
+            if (line.find(quoted) != std::string::npos) return line;
+        }
+        return std::string();
+    }
+
+    static double Field(const std::string& line, const char* key) {
+        std::string quoted = std::string("\"") + key + "\":";
+        size_t at = line.find(quoted);
+        return at == std::string::npos ? -1.0 : std::atof(line.c_str() + at + quoted.size());
+    }
+
+    static void Spin(int micros) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(micros);
+        while (std::chrono::steady_clock::now() < end) {}
+    }
+
+    bool TestScopes() {
+        TraceEvents::Clear();
+        {
+            TRACE_SCOPE_ARG(TraceEvents::CAT_RASTER, "TestScope", "rows", 42);
+            Spin(300);
+        }
+        TRACE_INSTANT(TraceEvents::CAT_INPUT, "TestInstant");
+        ASSERT_EQ((size_t)2, TraceEvents::EventCount());
+
+        std::vector<std::string> lines = FlushLines();
+        ASSERT_TRUE(lines.size() >= 4);
+        ASSERT_TRUE(lines.front().find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") == 0);
+        ASSERT_TRUE(lines.back() == "]}\n");
+
+        std::string scope = FindEvent(lines, "TestScope");
+        ASSERT_TRUE(scope.find("\"ph\":\"X\",\"cat\":\"raster\"") != std::string::npos);
+        ASSERT_TRUE(scope.find("\"args\":{\"rows\":42}") != std::string::npos);
+        ASSERT_TRUE(Field(scope, "dur") >= 300.0);
+
+        std::string instant = FindEvent(lines, "TestInstant");
+        ASSERT_TRUE(instant.find("\"ph\":\"i\",\"cat\":\"input\"") != std::string::npos);
+        ASSERT_TRUE(Field(instant, "ts") >= Field(scope, "ts") + Field(scope, "dur"));
+
+        // Flushing keeps the buffers; Clear empties them
+        ASSERT_EQ((size_t)2, TraceEvents::EventCount());
+        TraceEvents::Clear();
+        ASSERT_EQ((size_t)0, TraceEvents::EventCount());
+        return true;
+    }
+
+    bool TestNesting() {
+        TraceEvents::Clear();
+        {
+            TRACE_SCOPE(TraceEvents::CAT_DOCUMENT, "Outer");
+            Spin(100);
+            {
+                TRACE_SCOPE(TraceEvents::CAT_UNDO, "Inner");
+                Spin(200);
+            }
+            Spin(100);
+        }
+        std::vector<std::string> lines = FlushLines();
+        std::string outer = FindEvent(lines, "Outer");
+        std::string inner = FindEvent(lines, "Inner");
+        ASSERT_FALSE(outer.empty());
+        ASSERT_FALSE(inner.empty());
+        ASSERT_TRUE(Field(inner, "ts") >= Field(outer, "ts"));
+        ASSERT_TRUE(Field(inner, "ts") + Field(inner, "dur") <= Field(outer, "ts") + Field(outer, "dur"));
+        ASSERT_EQ(Field(inner, "tid"), Field(outer, "tid"));
+        TraceEvents::Clear();
+        return true;
+    }
+
+    bool TestEngineInstrumentation() {
+        AppState& app = AppState::Instance();
+        app.drawingPoints.clear();
+        app.undoStack.clear();
+        app.redoStack.clear();
+        app.currentTool = TOOL_BRUSH;
+        TraceEvents::Clear();
+
+        DrawingEngine::StartDrawing(10, 10);
+        for (int i = 0; i < 99; i++) DrawingEngine::ContinueDrawing(11 + i, 10);
+        DrawingEngine::EndDrawing();
+        DrawingEngine::Undo();
+        const char* filename = "trace_events_test.mpsp";
+        DrawingEngine::Redo();
+        ASSERT_TRUE(DrawingEngine::SaveDrawing(filename));
+        ASSERT_TRUE(DrawingEngine::LoadDrawing(filename));
+        std::remove(filename);
+
+        std::vector<std::string> lines = FlushLines();
+        size_t continues = 0;
+        for (const std::string& line : lines) {
+            if (line.find("\"name\":\"ContinueDrawing\"") != std::string::npos) continues++;
+        }
+        ASSERT_EQ((size_t)99, continues);
+
+        // Snapshot cost shows up with the document size it copied
+        std::string save = FindEvent(lines, "SaveState");
+        ASSERT_TRUE(save.find("\"cat\":\"undo\"") != std::string::npos);
+        ASSERT_TRUE(save.find("\"args\":{\"points\":100}") != std::string::npos);
+        ASSERT_TRUE(FindEvent(lines, "Undo").find("\"cat\":\"undo\"") != std::string::npos);
+        ASSERT_TRUE(FindEvent(lines, "Redo").find("\"cat\":\"undo\"") != std::string::npos);
+        ASSERT_TRUE(FindEvent(lines, "SaveDrawing").find("\"cat\":\"file_io\"") != std::string::npos);
+        ASSERT_TRUE(FindEvent(lines, "LoadDrawing").find("\"cat\":\"file_io\"") != std::string::npos);
+        ASSERT_TRUE(FindEvent(lines, "EndDrawing").find("\"cat\":\"document\"") != std::string::npos);
+
+        app.drawingPoints.clear();
+        app.undoStack.clear();
+        app.redoStack.clear();
+        TraceEvents::Clear();
+        return true;
+    }
+
+    bool TestThreads() {
+        TraceEvents::Clear();
+        TraceEvents::SetThreadName("main");
+        TRACE_INSTANT(TraceEvents::CAT_INPUT, "MainEvent");
+
+        // Workers exit before the flush; their events must survive them
+        std::vector<std::thread> workers;
+        for (int w = 0; w < 4; w++) {
+            workers.emplace_back([w]() {
+                static const char* names[4] = { "worker \"0\"", "worker 1", "worker 2", "worker 3" };
+                TraceEvents::SetThreadName(names[w]);
+                for (int i = 0; i < 1000; i++) {
+                    TRACE_SCOPE(TraceEvents::CAT_RASTER, "WorkerEvent");
+                }
+            });
+        }
+        for (std::thread& worker : workers) worker.join();
+        ASSERT_EQ((size_t)4001, TraceEvents::EventCount());
+
+        std::vector<std::string> lines = FlushLines();
+        std::map<int, size_t> perThread;
+        for (const std::string& line : lines) {
+            if (line.find("\"name\":\"WorkerEvent\"") != std::string::npos) perThread[(int)Field(line, "tid")]++;
+        }
+        ASSERT_EQ((size_t)4, perThread.size());
+        for (const auto& entry : perThread) {
+            ASSERT_EQ((size_t)1000, entry.second);
+        }
+        int mainThread = (int)Field(FindEvent(lines, "MainEvent"), "tid");
+        ASSERT_TRUE(perThread.find(mainThread) == perThread.end());
+
+        // Thread names are metadata events, escaped
+        ASSERT_TRUE(FindEvent(lines, "thread_name").find("\"args\":{\"name\":\"main\"}") != std::string::npos);
+        bool escaped = false;
+        for (const std::string& line : lines) {
+            if (line.find("\"args\":{\"name\":\"worker \\\"0\\\"\"}") != std::string::npos) escaped = true;
+        }
+        ASSERT_TRUE(escaped);
+        TraceEvents::Clear();
+        return true;
+    }
+
+    bool TestDropping() {
+        TraceEvents::Clear();
+        for (size_t i = 0; i < TraceEvents::MAX_EVENTS_PER_THREAD + 25; i++) {
+            TRACE_INSTANT(TraceEvents::CAT_INPUT, "Flood");
+        }
+        ASSERT_EQ(TraceEvents::MAX_EVENTS_PER_THREAD, TraceEvents::EventCount());
+        ASSERT_EQ((size_t)25, TraceEvents::DroppedCount());
+
+        TraceEvents::Clear();
+        ASSERT_EQ((size_t)0, TraceEvents::DroppedCount());
+        return true;
+    }
+};
+
+int main() {
+    std::cout << "Modern Paint Studio Pro - Trace Events Tests" << std::endl;
+
+    // These tests count stored points; decimation has its own tests
+    AppState::Instance().strokeTolerance = 0.0;
+
+    TraceEventsTests tests;
+    tests.RunTests();
+
+    return tests.AllTestsPassed() ? 0 : 1;
+}